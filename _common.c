@@ -18,8 +18,12 @@
 
 #include "_common.h"
 
+#include <stdlib.h>
+#include <stdio.h>
 #include <string.h>
 
+#include "heap.h" // heap_pause, heap_resume
+
 
 bool string_eq( char const * const s1, char const * const s2 )
 {
@@ -29,3 +33,109 @@ bool string_eq( char const * const s1, char const * const s2 )
           && strcmp( s1, s2 ) == 0 );
 }
 
+
+
+void * untracked_malloc( size_t const size )
+{
+    heap_pause();
+    void * const ptr = malloc( size );
+    heap_resume();
+    return ptr;
+}
+
+
+void * untracked_calloc( size_t const n, size_t const size )
+{
+    heap_pause();
+    void * const ptr = calloc( n, size );
+    heap_resume();
+    return ptr;
+}
+
+
+void * untracked_realloc( void * const old, size_t const size )
+{
+    heap_pause();
+    void * const ptr = realloc( old, size );
+    heap_resume();
+    return ptr;
+}
+
+
+void untracked_free( void * const ptr )
+{
+    heap_pause();
+    free( ptr );
+    heap_resume();
+}
+
+
+char * untracked_strdup( char const * const string )
+{
+    if ( string == NULL ) {
+        return NULL;
+    }
+    size_t const size = strlen( string ) + 1;
+    char * const copy = untracked_malloc( size );
+    memcpy( copy, string, size );
+    return copy;
+}
+
+
+char * untracked_repeat( char const * const string, size_t const times )
+{
+    char * const new = untracked_calloc( ( strlen( string ) * times ) + 1, 1 );
+    for ( size_t i = 0; i < times; i += 1 ) {
+        strcat( new, string );
+    }
+    return new;
+}
+
+
+
+void format_duration( char * const buffer, size_t const size,
+                      double const ns )
+{
+    double const magnitude = ( ns < 0 ) ? -ns : ns;
+    if ( magnitude < 1e3 ) {
+        snprintf( buffer, size, "%.3g ns", ns );
+    } else if ( magnitude < 1e6 ) {
+        snprintf( buffer, size, "%.3g us", ns / 1e3 );
+    } else if ( magnitude < 1e9 ) {
+        snprintf( buffer, size, "%.3g ms", ns / 1e6 );
+    } else if ( magnitude < 60e9 ) {
+        snprintf( buffer, size, "%.3g s", ns / 1e9 );
+    } else {
+        snprintf( buffer, size, "%.3g min", ns / 60e9 );
+    }
+}
+
+
+void print_duration( FILE * const file, double const ns )
+{
+    char buffer[ 16 ];
+    format_duration( buffer, sizeof buffer, ns );
+    fputs( buffer, file );
+}
+
+
+void format_rate( char * const buffer, size_t const size, double const rate )
+{
+    if ( rate < 1e3 ) {
+        snprintf( buffer, size, "%.3g", rate );
+    } else if ( rate < 1e6 ) {
+        snprintf( buffer, size, "%.3gk", rate / 1e3 );
+    } else if ( rate < 1e9 ) {
+        snprintf( buffer, size, "%.3gM", rate / 1e6 );
+    } else {
+        snprintf( buffer, size, "%.3gG", rate / 1e9 );
+    }
+}
+
+
+void print_rate( FILE * const file, double const rate )
+{
+    char buffer[ 16 ];
+    format_rate( buffer, sizeof buffer, rate );
+    fputs( buffer, file );
+}
@@ -22,6 +22,8 @@
 
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
 
 
 #define MAX( A, B ) \
@@ -41,5 +43,46 @@
 bool string_eq( char const * const s1, char const * const s2 );
 
 
+// Like `malloc()`, `calloc()`, `realloc()` and `free()`, but for the
+// memory that Test.c allocates for itself, so it's never counted by the
+// heap instrumentation of `heap.h`.
+void * untracked_malloc( size_t size );
+void * untracked_calloc( size_t n, size_t size );
+void * untracked_realloc( void * ptr, size_t size );
+void untracked_free( void * ptr );
+
+
+// Returns an untracked copy of the given string, or `NULL` if it's
+// `NULL`.
+char * untracked_strdup( char const * string );
+
+
+// Returns an untracked string of the given `string` repeated `times`
+// times.
+char * untracked_repeat( char const * string, size_t times );
+
+
+// Writes the given duration in nanoseconds to the given `buffer` of
+// `size` bytes, with three significant digits in the most fitting unit,
+// e.g. `"1.94 us"`. A `buffer` of 16 bytes is always large enough.
+void format_duration( char * buffer, size_t size, double ns );
+
+
+// Prints the given duration in nanoseconds to the given file, as
+// written by `format_duration()`.
+void print_duration( FILE * file, double ns );
+
+
+// Writes the given rate to the given `buffer` of `size` bytes, with
+// three significant digits and a suffix for its magnitude, e.g.
+// `"7.93M"`. A `buffer` of 16 bytes is always large enough.
+void format_rate( char * buffer, size_t size, double rate );
+
+
+// Prints the given rate to the given file, as written by
+// `format_rate()`.
+void print_rate( FILE * file, double rate );
+
+
 #endif // ifndef INCLUDED_TESTC__COMMON_H
 
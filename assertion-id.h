@@ -25,14 +25,15 @@
 #include <macromap.h/macromap.h> // MACROMAP
 
 
-// An assertion identification is an `int` expression and its result.
+// An assertion identification is an integer expression and its result.
 typedef struct AssertionId {
 
-    // The stringification of the `int` expression.
+    // The stringification of the integer expression.
     char const * expr;
 
-    // The result of the `int` expression.
-    int value;
+    // The result of the integer expression, which is wide enough for
+    // any index or file offset.
+    long long value;
 
     // Invariants:
     // - `expr` is not null
@@ -40,7 +41,8 @@ typedef struct AssertionId {
 } AssertionId;
 
 
-// Evaluates to a literal `AssertionId` with the given `int` expression.
+// Evaluates to a literal `AssertionId` with the given integer
+// expression.
 #define ASSERTION_ID( EXPR ) { .expr = #EXPR, .value = EXPR }
 
 
@@ -52,7 +54,7 @@ typedef struct AssertionId {
 extern AssertionId const assertion_id_array_end;
 
 
-// Takes a series of `int` expressions, and evaluates to a literal
+// Takes a series of integer expressions, and evaluates to a literal
 // `AssertionId[]` with those expressions, terminated by
 // `ASSERTION_ID_ARRAY_END`.
 //
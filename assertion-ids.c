@@ -77,11 +77,11 @@ AssertionIds * assertion_ids_new_( struct assertion_ids_new_options const o )
     size_t const capacity =
         ( o.capacity == 0 ) ? assertion_ids_initial_capacity : o.capacity;
 
-    AssertionIds * const ids = malloc( sizeof ( AssertionIds ) );
+    AssertionIds * const ids = untracked_malloc( sizeof ( AssertionIds ) );
     *ids = ( AssertionIds ){
         .size = 0,
         .capacity = capacity,
-        .array = malloc( capacity * sizeof ( AssertionId ) )
+        .array = untracked_malloc( capacity * sizeof ( AssertionId ) )
     };
     if ( array != NULL ) {
         assertion_ids_add_all( ids, array );
@@ -112,8 +112,8 @@ void assertion_ids_free( AssertionIds * const ids )
 {
     if ( ids != NULL ) {
         assertion_ids_assert_valid( *ids );
-        free( ids->array );
-        free( ids );
+        untracked_free( ids->array );
+        untracked_free( ids );
     }
 }
 
@@ -156,13 +156,68 @@ void assertion_ids_print_( struct assertion_ids_print_options const o )
     fprintf( file, "(for " );
     for ( size_t i = 0; i < ids.size; i += 1 ) {
         AssertionId const id = assertion_ids_get( ids, i );
-        fprintf( file, "%s%s = %d", ( i > 0 ) ? ", " : "", id.expr, id.value );
+        fprintf( file, "%s%s = %lld", ( i > 0 ) ? ", " : "", id.expr,
+                 id.value );
     }
     fprintf( file, ")\n" );
 
 }
 
 
+bool assertion_ids_same_exprs( AssertionIds const ids1,
+                               AssertionIds const ids2 )
+{
+    assertion_ids_assert_valid( ids1 );
+    assertion_ids_assert_valid( ids2 );
+
+    if ( ids1.size != ids2.size ) {
+        return false;
+    }
+    for ( size_t i = 0; i < ids1.size; i += 1 ) {
+        if ( !string_eq( ids1.array[ i ].expr, ids2.array[ i ].expr ) ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+void assertion_ids_print_run_( struct assertion_ids_print_run_options const o )
+{
+    AssertionIds const first = o.first;
+    AssertionIds const last = o.last;
+    assert( assertion_ids_same_exprs( first, last ) );
+    assert( o.count >= 2 );
+    FILE * const file = ( o.file == NULL ) ? stdout : o.file;
+
+    bool changes = false;
+    fprintf( file, "(for " );
+    for ( size_t i = 0; i < first.size; i += 1 ) {
+        AssertionId const from = assertion_ids_get( first, i );
+        AssertionId const to = assertion_ids_get( last, i );
+        fprintf( file, "%s%s = %lld", ( i > 0 ) ? ", " : "",
+                                    from.expr, from.value );
+        if ( to.value != from.value ) {
+            // The values can be as far apart as `LLONG_MIN` and
+            // `LLONG_MAX`, so the step is found from the distance
+            // between them, which only fits an unsigned type.
+            bool const down = to.value < from.value;
+            unsigned long long const distance =
+                down ? ( unsigned long long ) from.value - to.value
+                     : ( unsigned long long ) to.value - from.value;
+            fprintf( file, "..%lld, step %s%llu", to.value,
+                     down ? "-" : "", distance / ( o.count - 1 ) );
+            changes = true;
+        }
+    }
+    if ( !changes ) {
+        // Otherwise, there'd be no indication of how many there were.
+        fprintf( file, ", %zu times", o.count );
+    }
+    fprintf( file, ")\n" );
+}
+
+
 bool assertion_ids_is_empty( AssertionIds const ids )
 {
     assertion_ids_assert_valid( ids );
@@ -176,7 +231,8 @@ void assertion_ids_increase_capacity( AssertionIds * const ids )
     assertion_ids_assert_valid( *ids );
 
     ids->capacity *= 2;
-    ids->array = realloc( ids->array, ids->capacity * sizeof ( AssertionId ) );
+    ids->array = untracked_realloc( ids->array,
+                                    ids->capacity * sizeof ( AssertionId ) );
 }
 
 
@@ -195,7 +251,8 @@ void assertion_ids_decrease_capacity( AssertionIds * const ids )
     // As it is, the elements aren't allocated, so we can simply
     // decrease the `size` as needed.
     ids->size = MIN( ids->size, ids->capacity );
-    ids->array = realloc( ids->array, ids->capacity * sizeof ( AssertionId ) );
+    ids->array = untracked_realloc( ids->array,
+                                    ids->capacity * sizeof ( AssertionId ) );
     if ( ids->capacity == 0 ) {
         // `realloc` may not return `NULL` if the given `size` is `0`,
         // but it will certainly free the given pointer.
@@ -93,7 +93,7 @@ AssertionIds * assertion_ids_new_( struct assertion_ids_new_options );
 AssertionIds * assertion_ids_empty( void );
 
 
-// Takes a variable number of `int` expressions, and allocates and
+// Takes a variable number of integer expressions, and allocates and
 // returns a new `AssertionIds` containing `AssertionId`s corresponding
 // to the given expressions, in the order given. You can pass a literal
 // `0` as the first argument to receive an empty `AssertionIds`.
@@ -132,7 +132,7 @@ bool assertion_ids_eq( AssertionIds, AssertionIds );
 bool assertion_ids_eq_array( AssertionIds, AssertionId const * array );
 
 
-// Takes an `AssertionIds` and a variable number of `int` expressions, and
+// Takes an `AssertionIds` and a variable number of integer expressions, and
 // returns `true` if the given `AssertionIds` has equal `AssertionId`s
 // (according to `assertion_id_eq()`) in the order given.
 #define assertion_ids_eq_each( IDS, ... ) \
@@ -192,5 +192,34 @@ void assertion_ids_print_( struct assertion_ids_print_options );
     } )
 
 
+// Returns `true` if the two `AssertionIds` have the same `size`, and
+// equivalent `expr`s in the same order (regardless of their values).
+// Otherwise, returns `false`.
+bool assertion_ids_same_exprs( AssertionIds, AssertionIds );
+
+
+struct assertion_ids_print_run_options {
+    AssertionIds first;
+    AssertionIds last;
+    size_t count;
+    FILE * file;
+};
+
+void assertion_ids_print_run_( struct assertion_ids_print_run_options );
+
+// Prints a run of `count` identifications with the same `expr`s, whose
+// values progress arithmetically from those of `first` to those of
+// `last`, to the given `file` (or `stdout` if `NULL`). Values that
+// don't change over the run are printed as by `assertion_ids_print()`,
+// and if none change, the `count` is printed too.
+// For example, a run of 5870 identifications from `i = 2, j = 7` to
+// `i = 5871, j = 7` will print:
+//      (for i = 2..5871, step 1, j = 7)
+#define assertion_ids_print_run( ... ) \
+    assertion_ids_print_run_( ( struct assertion_ids_print_run_options ){ \
+        __VA_ARGS__ \
+    } )
+
+
 #endif // ifndef INCLUDED_TESTC_ASSERTION_IDS_H
 
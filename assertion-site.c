@@ -0,0 +1,346 @@
+// assertion-site.c
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "assertion-site.h" // AssertionSite
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "_common.h" // string_eq
+#include "assertion-id.h" // AssertionId, assertion_id_*
+#include "assertion-ids.h" // AssertionIds, assertion_ids_print*
+#include "assertions.h" // assertions_print_min_run
+
+
+static
+bool ids_are_null_iff_size_is_zero( AssertionSite const site )
+// Checks an invariant condition.
+{
+    return ( site.ids_size == 0 && site.ids_exprs == NULL
+                                && site.ids_values == NULL )
+        || ( site.ids_size != 0 && site.ids_exprs != NULL
+                                && site.ids_values != NULL );
+}
+
+
+static
+bool all_columns_are_not_null( AssertionSite const site )
+// Checks an invariant condition.
+{
+    for ( size_t k = 0; k < site.ids_size; k += 1 ) {
+        if ( site.ids_exprs[ k ] == NULL || site.ids_values[ k ] == NULL ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+bool assertion_site_is_valid( AssertionSite const site )
+{
+    return site.file != NULL
+        && site.expr != NULL
+        && ( site.ids_size == 0 || site.fails <= site.fails_capacity )
+        && ids_are_null_iff_size_is_zero( site )
+        && all_columns_are_not_null( site );
+}
+
+
+void assertion_site_assert_valid( AssertionSite const site )
+{
+    assert( site.file != NULL );
+    assert( site.expr != NULL );
+    assert( site.ids_size == 0 || site.fails <= site.fails_capacity );
+    assert( ids_are_null_iff_size_is_zero( site ) );
+    assert( all_columns_are_not_null( site ) );
+}
+
+
+AssertionSite * assertion_site_new_( struct assertion_site_new_options const o )
+{
+    size_t ids_size = 0;
+    if ( o.ids != NULL ) {
+        while ( !assertion_id_is_array_end( o.ids[ ids_size ] ) ) {
+            ids_size += 1;
+        }
+    }
+    AssertionSite * const site = untracked_malloc( sizeof ( AssertionSite ) );
+    *site = ( AssertionSite ){
+        .file = o.file,
+        .line = o.line,
+        .expr = o.expr,
+        .ids_size = ids_size
+    };
+    if ( ids_size > 0 ) {
+        site->ids_exprs = untracked_malloc( ids_size
+                                            * sizeof ( char const * ) );
+        site->ids_values = untracked_malloc( ids_size
+                                             * sizeof ( long long * ) );
+        site->fails_capacity = assertion_ids_initial_capacity;
+        for ( size_t k = 0; k < ids_size; k += 1 ) {
+            site->ids_exprs[ k ] = o.ids[ k ].expr;
+            site->ids_values[ k ] =
+                untracked_malloc( site->fails_capacity * sizeof ( long long ) );
+        }
+    }
+    return site;
+}
+
+
+AssertionSite * assertion_site_copy( AssertionSite const site )
+{
+    assertion_site_assert_valid( site );
+
+    AssertionSite * const copy = untracked_malloc( sizeof site );
+    *copy = site;
+    if ( site.ids_size > 0 ) {
+        copy->ids_exprs = untracked_malloc( site.ids_size
+                                            * sizeof ( char const * ) );
+        memcpy( copy->ids_exprs, site.ids_exprs,
+                site.ids_size * sizeof ( char const * ) );
+        copy->ids_values = untracked_malloc( site.ids_size
+                                             * sizeof ( long long * ) );
+        for ( size_t k = 0; k < site.ids_size; k += 1 ) {
+            copy->ids_values[ k ] =
+                untracked_malloc( site.fails_capacity * sizeof ( long long ) );
+            memcpy( copy->ids_values[ k ], site.ids_values[ k ],
+                    site.fails * sizeof ( long long ) );
+        }
+    }
+    return copy;
+}
+
+
+void assertion_site_free( AssertionSite * const site )
+{
+    if ( site != NULL ) {
+        assertion_site_assert_valid( *site );
+        for ( size_t k = 0; k < site->ids_size; k += 1 ) {
+            untracked_free( site->ids_values[ k ] );
+        }
+        untracked_free( site->ids_values );
+        untracked_free( site->ids_exprs );
+        untracked_free( site );
+    }
+}
+
+
+bool assertion_site_eq( AssertionSite const s1, AssertionSite const s2 )
+{
+    assertion_site_assert_valid( s1 );
+    assertion_site_assert_valid( s2 );
+
+    if ( !assertion_site_is_at( s1, s2.file, s2.line, s2.expr )
+      || s1.passes != s2.passes
+      || s1.fails != s2.fails
+      || s1.ids_size != s2.ids_size ) {
+        return false;
+    }
+    for ( size_t k = 0; k < s1.ids_size; k += 1 ) {
+        if ( !string_eq( s1.ids_exprs[ k ], s2.ids_exprs[ k ] )
+          || memcmp( s1.ids_values[ k ], s2.ids_values[ k ],
+                     s1.fails * sizeof ( long long ) ) != 0 ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+bool assertion_site_is_at( AssertionSite const site,
+                           char const * const file,
+                           int const line,
+                           char const * const expr )
+{
+    return site.line == line
+        && ( site.file == file || string_eq( site.file, file ) )
+        && ( site.expr == expr || string_eq( site.expr, expr ) );
+}
+
+
+void assertion_site_add( AssertionSite * const site,
+                         bool const result,
+                         AssertionId const * const ids )
+{
+    assert( site != NULL );
+    assertion_site_assert_valid( *site );
+
+    if ( result == true ) {
+        site->passes += 1;
+        return;
+    }
+    if ( site->ids_size > 0 ) {
+        assert( ids != NULL );
+        if ( site->fails == site->fails_capacity ) {
+            site->fails_capacity *= 2;
+            for ( size_t k = 0; k < site->ids_size; k += 1 ) {
+                site->ids_values[ k ] = untracked_realloc(
+                    site->ids_values[ k ],
+                    site->fails_capacity * sizeof ( long long ) );
+            }
+        }
+        for ( size_t k = 0; k < site->ids_size; k += 1 ) {
+            assert( !assertion_id_is_array_end( ids[ k ] ) );
+            site->ids_values[ k ][ site->fails ] = ids[ k ].value;
+        }
+    }
+    site->fails += 1;
+}
+
+
+void assertion_site_merge( AssertionSite * const into,
+                           AssertionSite const from )
+{
+    assert( into != NULL );
+    assertion_site_assert_valid( *into );
+    assertion_site_assert_valid( from );
+    assert( assertion_site_is_at( *into, from.file, from.line, from.expr ) );
+    assert( into->ids_size == from.ids_size );
+
+    into->passes += from.passes;
+    if ( into->ids_size > 0 ) {
+        size_t const fails = into->fails + from.fails;
+        if ( fails > into->fails_capacity ) {
+            while ( into->fails_capacity < fails ) {
+                into->fails_capacity *= 2;
+            }
+            for ( size_t k = 0; k < into->ids_size; k += 1 ) {
+                into->ids_values[ k ] = untracked_realloc(
+                    into->ids_values[ k ],
+                    into->fails_capacity * sizeof ( long long ) );
+            }
+        }
+        for ( size_t k = 0; k < into->ids_size; k += 1 ) {
+            memcpy( into->ids_values[ k ] + into->fails,
+                    from.ids_values[ k ], from.fails * sizeof ( long long ) );
+        }
+    }
+    into->fails += from.fails;
+}
+
+
+AssertionId assertion_site_get_id( AssertionSite const site,
+                                   size_t const i,
+                                   size_t const k )
+{
+    assertion_site_assert_valid( site );
+    assert( i < site.fails );
+    assert( k < site.ids_size );
+
+    return ( AssertionId ){ .expr = site.ids_exprs[ k ],
+                            .value = site.ids_values[ k ][ i ] };
+}
+
+
+static
+AssertionIds row_ids( AssertionSite const site, size_t const i,
+                      AssertionId * const buffer )
+// Returns a view of the identifications of the `i`th `false` evaluation
+// of the given site, using the given `buffer` of at least `ids_size`
+// elements as the `array`.
+{
+    for ( size_t k = 0; k < site.ids_size; k += 1 ) {
+        buffer[ k ] = assertion_site_get_id( site, i, k );
+    }
+    return ( AssertionIds ){ .array = buffer,
+                             .size = site.ids_size,
+                             .capacity = site.ids_size };
+}
+
+
+static
+size_t run_length( AssertionSite const site, size_t const first )
+// Returns how many `false` evaluations from `first` onwards have
+// identification values that progress arithmetically.
+{
+    size_t count = 1;
+    while ( first + count < site.fails ) {
+        size_t const next = first + count;
+        for ( size_t k = 0; k < site.ids_size && count >= 2; k += 1 ) {
+            // Compared as unsigned to wrap rather than overflow.
+            unsigned long long const * const column =
+                ( unsigned long long const * ) site.ids_values[ k ];
+            if ( column[ next ] - column[ next - 1 ]
+              != column[ first + 1 ] - column[ first ] ) {
+                return count;
+            }
+        }
+        count += 1;
+    }
+    return count;
+}
+
+
+void assertion_site_print_( bool const result,
+                            struct assertion_site_print_options const o )
+{
+    AssertionSite const site = o.site;
+    assertion_site_assert_valid( site );
+    FILE * const file = ( o.file == NULL ) ? stdout : o.file;
+    char const * const assertion_indent =
+        ( o.assertion_indent == NULL ) ? "" : o.assertion_indent;
+    char const * const ids_indent =
+        ( o.ids_indent == NULL ) ? "" : o.ids_indent;
+    size_t const min_run = ( o.min_run == 0 ) ? assertions_print_min_run
+                                              : o.min_run;
+    size_t const count = ( result == true ) ? site.passes : site.fails;
+
+    if ( count == 0 ) {
+        return;
+    }
+    fprintf( file, "%s%s:  %s  (%s:%d)\n",
+             assertion_indent, ( result == true ) ? "true" : "false",
+             site.expr, site.file, site.line );
+    if ( result == true || site.ids_size == 0 ) {
+        if ( count > 1 ) {
+            fprintf( file, "%s(%zu times)\n", ids_indent, count );
+        }
+        return;
+    }
+
+    AssertionId * const first = untracked_malloc( site.ids_size
+                                                  * sizeof *first );
+    AssertionId * const last = untracked_malloc( site.ids_size * sizeof *last );
+    size_t lines = 0;
+    size_t i = 0;
+    while ( i < site.fails ) {
+        if ( o.ids_limit != 0 && lines == o.ids_limit ) {
+            fprintf( file, "%s... and %zu more\n", ids_indent, site.fails - i );
+            break;
+        }
+        size_t const run = run_length( site, i );
+        fprintf( file, "%s", ids_indent );
+        if ( run >= min_run ) {
+            assertion_ids_print_run( .first = row_ids( site, i, first ),
+                                     .last = row_ids( site, i + run - 1,
+                                                      last ),
+                                     .count = run,
+                                     .file = file );
+            i += run;
+        } else {
+            assertion_ids_print( .ids = row_ids( site, i, first ),
+                                 .file = file );
+            i += 1;
+        }
+        lines += 1;
+    }
+    untracked_free( first );
+    untracked_free( last );
+}
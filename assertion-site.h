@@ -0,0 +1,179 @@
+// assertion-site.h
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef INCLUDED_TESTC_ASSERTION_SITE_H
+#define INCLUDED_TESTC_ASSERTION_SITE_H
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "assertion-id.h" // AssertionId
+#include "assertion-ids.h" // AssertionIds
+
+
+// An assertion site is every evaluation of a boolean expression at a
+// single place in the source code, e.g. in a loop. Rather than an
+// `Assertion` per evaluation, a site stores the expression and the
+// names of its identifications once, counts the evaluations, and only
+// stores the values of the identifications of the `false` evaluations.
+typedef struct AssertionSite {
+
+    // The name of the source file containing the assertion.
+    char const * file;
+
+    // The line of the source file containing the assertion.
+    int line;
+
+    // The boolean expression.
+    char const * expr;
+
+    // How many evaluations of the expression were `true`.
+    size_t passes;
+
+    // How many evaluations of the expression were `false`.
+    size_t fails;
+
+    // How many `false` evaluations the `ids_values` columns can hold
+    // before we need to reallocate them.
+    size_t fails_capacity;
+
+    // How many identifications each evaluation has.
+    size_t ids_size;
+
+    // The `ids_size` identification expressions.
+    char const * * ids_exprs;
+
+    // The `ids_size` columns of identification values, where
+    // `ids_values[ k ][ i ]` is the value of `ids_exprs[ k ]` for the
+    // `i`th `false` evaluation.
+    long long * * ids_values;
+
+    // Invariants:
+    // - `file` and `expr` are not `NULL`
+    // - `fails` is always less than or equal to `fails_capacity`, if
+    //   `ids_size` is not `0`
+    // - `ids_exprs` and `ids_values` are `NULL` if and only if
+    //   `ids_size` is `0`
+    // - `ids_exprs[ k ]` and `ids_values[ k ]` are not `NULL` for all
+    //   `0 <= k < ids_size`
+
+} AssertionSite;
+
+
+// Returns `true` if the invariants hold for the given `AssertionSite`,
+// or `false` if some don't.
+bool assertion_site_is_valid( AssertionSite );
+
+
+// Asserts that the invariants hold for the given `AssertionSite`.
+void assertion_site_assert_valid( AssertionSite );
+
+
+struct assertion_site_new_options {
+    char const * file;
+    int line;
+    char const * expr;
+    AssertionId const * ids;
+};
+
+// Allocates and returns a new `AssertionSite` at the given `file` and
+// `line` for the given `expr`, with no evaluations, and with the
+// identification expressions of the given `ids` array (which should be
+// terminated in the same fashion as `ASSERTION_ID_ARRAY()`, and may be
+// `NULL` for no identifications).
+AssertionSite * assertion_site_new_( struct assertion_site_new_options );
+
+#define assertion_site_new( ... ) \
+    assertion_site_new_( ( struct assertion_site_new_options ){ \
+        __VA_ARGS__ \
+    } )
+
+
+// Copies the given `AssertionSite` into allocated memory, and returns a
+// pointer to that memory. This deeply copies the identification
+// columns, so that any changes to the original won't change the copy.
+AssertionSite * assertion_site_copy( AssertionSite );
+
+
+// Frees the memory allocated for the given `AssertionSite`, its
+// identification columns, and the site itself.
+void assertion_site_free( AssertionSite * site );
+
+
+// Returns `true` if the two sites are at the same place for equivalent
+// expressions, with the same counts and identifications. Otherwise,
+// returns `false`.
+bool assertion_site_eq( AssertionSite, AssertionSite );
+
+
+// Returns `true` if the given site is at the given `file` and `line`
+// for the given `expr`, and `false` otherwise. This is cheap when the
+// arguments are the same pointers the site was created with.
+bool assertion_site_is_at( AssertionSite, char const * file, int line,
+                           char const * expr );
+
+
+// Counts an evaluation of the site's expression with the given
+// `result`. If the `result` is `false`, this also adds the values of
+// the given `ids` (which should have the same expressions the site was
+// created with) to the identification columns, increasing their
+// capacity if necessary.
+void assertion_site_add( AssertionSite * site, bool result,
+                         AssertionId const * ids );
+
+
+// Adds the evaluations of the site `from` to the site `into`, after its
+// own evaluations. Both sites should be at the same place for the same
+// expression, with the same identification expressions.
+void assertion_site_merge( AssertionSite * into, AssertionSite from );
+
+
+// Returns the identification `k` of the `i`th `false` evaluation of the
+// given site.
+AssertionId assertion_site_get_id( AssertionSite, size_t i, size_t k );
+
+
+struct assertion_site_print_options {
+    AssertionSite site;
+    FILE * file;
+    char const * assertion_indent;
+    char const * ids_indent;
+    size_t ids_limit;
+    size_t min_run;
+};
+
+void assertion_site_print_( bool result, struct assertion_site_print_options );
+
+// Prints the evaluations of the given `site` with the given `RESULT` to
+// the `file` (or `stdout` if `NULL`), in the same fashion as
+// `assertions_print()`: an assertion line, which includes the file and
+// line of the site, followed by the identifications of the `false`
+// evaluations, or a count of the evaluations if there are none. Runs of
+// `min_run` (or `assertions_print_min_run` if `0`; see `assertions.h`)
+// or more identifications are printed on a single line, as by
+// `assertion_ids_print_run()`. Nothing is printed if the site has no
+// evaluations with the given `RESULT`.
+#define assertion_site_print( RESULT, ... ) \
+    assertion_site_print_( RESULT, ( struct assertion_site_print_options ){ \
+        __VA_ARGS__ \
+    } )
+
+
+#endif // ifndef INCLUDED_TESTC_ASSERTION_SITE_H
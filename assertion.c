@@ -22,7 +22,7 @@
 #include <assert.h>
 #include <stdio.h>
 
-#include "_common.h" // string_eq
+#include "_common.h" // string_eq, untracked_*
 #include "assertion-id.h" // AssertionId
 #include "assertion-ids.h" // AssertionIds, assertion_ids_*
 
@@ -46,11 +46,12 @@ void assertion_assert_valid( Assertion const a )
 
 Assertion * assertion_new_( struct assertion_new_options const o )
 {
-    Assertion * const a = malloc( sizeof ( Assertion ) );
+    Assertion * const a = untracked_malloc( sizeof ( Assertion ) );
     *a = ( Assertion ){
         .expr = o.expr,
         .result = o.result,
-        .ids = assertion_ids_new( .array = o.ids )
+        .ids = assertion_ids_new( .array = o.ids ),
+        .detail = untracked_strdup( o.detail )
     };
     return a;
 }
@@ -59,12 +60,13 @@ Assertion * assertion_new_( struct assertion_new_options const o )
 Assertion * assertion_copy( Assertion const a )
 {
     assertion_assert_valid( a );
-    Assertion * const copy = malloc( sizeof a );
+    Assertion * const copy = untracked_malloc( sizeof a );
     *copy = ( Assertion ){
         .expr = a.expr,
         .result = a.result,
         .ids = ( a.ids == NULL ) ? assertion_ids_empty()
-                                 : assertion_ids_copy( *( a.ids ) )
+                                 : assertion_ids_copy( *( a.ids ) ),
+        .detail = untracked_strdup( a.detail )
     };
     return copy;
 }
@@ -75,7 +77,8 @@ void assertion_free( Assertion * const a )
     if ( a != NULL ) {
         assertion_assert_valid( *a );
         assertion_ids_free( a->ids );
-        free( a );
+        untracked_free( a->detail );
+        untracked_free( a );
     }
 }
 
@@ -86,6 +89,7 @@ bool assertion_eq( Assertion const a1, Assertion const a2 )
     assertion_assert_valid( a2 );
     return a1.result == a2.result
         && string_eq( a1.expr, a2.expr )
+        && string_eq( a1.detail, a2.detail )
         && ( a1.ids == a2.ids
           || ( !assertion_has_ids( a1 )
             && !assertion_has_ids( a2 ) )
@@ -116,6 +120,28 @@ void assertion_print_( struct assertion_print_options const o )
         fprintf( file, "%s", ids_indent );
         assertion_ids_print( .ids = *( a.ids ), .file = file );
     }
+    assertion_print_detail( .assertion = a,
+                            .file = file,
+                            .ids_indent = ids_indent );
+}
+
+
+void assertion_print_detail_( struct assertion_print_options const o )
+{
+    Assertion const a = o.assertion;
+    assertion_assert_valid( a );
+    FILE * const file = ( o.file == NULL ) ? stdout : o.file;
+    char const * const ids_indent = ( o.ids_indent == NULL ) ? ""
+                                                             : o.ids_indent;
+
+    char const * line = a.detail;
+    while ( line != NULL && *line != '\0' ) {
+        char const * const end = strchr( line, '\n' );
+        int const length = ( end == NULL ) ? ( int ) strlen( line )
+                                           : ( int )( end - line );
+        fprintf( file, "%s%.*s\n", ids_indent, length, line );
+        line = ( end == NULL ) ? NULL : end + 1;
+    }
 }
 
 
@@ -43,6 +43,11 @@ typedef struct Assertion {
     // The sequence of identifications.
     AssertionIds * ids;
 
+    // An explanation of the evaluation, which may span several lines,
+    // e.g. a summary of the measurements that it was made from. This is
+    // owned by the assertion, and may be `NULL`.
+    char * detail;
+
     // Invariants:
     // - `expr` is not `NULL`
 
@@ -81,18 +86,20 @@ struct assertion_new_options {
     char const * expr;
     bool result;
     AssertionId const * ids;
+    char const * detail;
 };
 
 // Allocates and returns a new assertion with the given fields, and
 // identified with a copy of the given `ids` array which should be
 // terminated in the same fashion as `ASSERTION_ID_ARRAY()`. If the
 // given `ids` is `NULL`, then the returned assertion will have an empty
-// (but non-null) `ids`.
+// (but non-null) `ids`. The given `detail` is copied, if it's not
+// `NULL`.
 Assertion * assertion_new_( struct assertion_new_options );
 
 // Allocates and returns a new `Assertion` with the given `bool`
 // expression, and identified with the variable number of given
-// identifying `int` expressions.
+// identifying integer expressions.
 #define assertion_new( EXPR, ... ) \
     assertion_new_( ( struct assertion_new_options ){ \
         .expr = #EXPR, \
@@ -103,13 +110,13 @@ Assertion * assertion_new_( struct assertion_new_options );
 
 // Copies the given `Assertion` into allocated memory, and returns a
 // pointer to that memory. This deeply copies the `ids` of the given
-// `Assertion`, so that any changes to the original or its pointees
-// won't change the copy or its pointees.
+// `Assertion` and its `detail`, so that any changes to the original or
+// its pointees won't change the copy or its pointees.
 Assertion * assertion_copy( Assertion );
 
 
 // Frees the memory allocated for the assertion's identifications
-// array, and the memory allocated for the assertion itself.
+// array and detail, and the memory allocated for the assertion itself.
 void assertion_free( Assertion * const assertion );
 
 
@@ -132,12 +139,24 @@ void assertion_print_( struct assertion_print_options );
 
 // Prints the `assertion` to the `file` (or `stdout` if `NULL`). If the
 // assertion has identifications, this will print those identifications
-// on a subsequent line indented by `ids_indent` (or by `""` if `NULL`).
+// on a subsequent line indented by `ids_indent` (or by `""` if `NULL`),
+// followed by its detail as by `assertion_print_detail()`.
 #define assertion_print( ... ) \
     assertion_print_( ( struct assertion_print_options ){ \
         __VA_ARGS__ \
     } )
 
 
+void assertion_print_detail_( struct assertion_print_options );
+
+// Prints each line of the detail of the `assertion`, if it has one, to
+// the `file` (or `stdout` if `NULL`), indented by `ids_indent` (or by
+// `""` if `NULL`).
+#define assertion_print_detail( ... ) \
+    assertion_print_detail_( ( struct assertion_print_options ){ \
+        __VA_ARGS__ \
+    } )
+
+
 #endif // ifndef INCLUDED_TESTC_ASSERTION_H
 
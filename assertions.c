@@ -21,14 +21,19 @@
 #include <string.h>
 #include <assert.h>
 #include <stdio.h>
+#include <stdint.h>
 
 #include "_common.h" // string_eq
 #include "assertion.h" // Assertion, assertion_*
+#include "assertion-site.h" // AssertionSite, assertion_site_*
 
 
 size_t const assertions_initial_capacity = 32;
 
 
+size_t const assertions_print_min_run = 3;
+
+
 static
 bool array_is_null_iff_capacity_is_zero( Assertions const as )
 // Checks an invariant condition.
@@ -64,12 +69,62 @@ bool all_elements_are_valid( Assertions const as )
 }
 
 
+static
+bool sites_is_null_iff_sites_capacity_is_zero( Assertions const as )
+// Checks an invariant condition.
+{
+    return ( as.sites_capacity == 0 && as.sites == NULL )
+        || ( as.sites_capacity != 0 && as.sites != NULL );
+}
+
+
+static
+bool all_sites_are_valid( Assertions const as )
+// Checks an invariant condition.
+{
+    for ( size_t i = 0; i < as.sites_size; i += 1 ) {
+        if ( as.sites[ i ] == NULL
+          || !assertion_site_is_valid( *( as.sites[ i ] ) ) ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+static
+bool workers_is_null_iff_workers_size_is_zero( Assertions const as )
+// Checks an invariant condition.
+{
+    return ( as.workers_size == 0 ) == ( as.workers == NULL );
+}
+
+
+static
+bool all_workers_are_valid( Assertions const as )
+// Checks an invariant condition.
+{
+    for ( size_t i = 0; i < as.workers_size; i += 1 ) {
+        if ( as.workers[ i ] == NULL
+          || !assertions_is_valid( *( as.workers[ i ] ) ) ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
 bool assertions_is_valid( Assertions const as )
 {
     return as.size <= as.capacity
         && array_is_null_iff_capacity_is_zero( as )
         && all_elements_up_to_size_are_not_null( as )
-        && all_elements_are_valid( as );
+        && all_elements_are_valid( as )
+        && as.sites_size <= as.sites_capacity
+        && sites_is_null_iff_sites_capacity_is_zero( as )
+        && all_sites_are_valid( as )
+        && workers_is_null_iff_workers_size_is_zero( as )
+        && all_workers_are_valid( as );
 }
 
 
@@ -78,10 +133,112 @@ void assertions_assert_valid( Assertions const as )
     assert( as.size <= as.capacity );
     assert( array_is_null_iff_capacity_is_zero( as ) );
     assert( all_elements_up_to_size_are_not_null( as ) );
+    assert( as.sites_size <= as.sites_capacity );
+    assert( sites_is_null_iff_sites_capacity_is_zero( as ) );
     // To get better assertion errors:
     for ( size_t i = 0; i < as.size; i += 1 ) {
         assertion_assert_valid( *( as.array[ i ] ) );
     }
+    for ( size_t i = 0; i < as.sites_size; i += 1 ) {
+        assert( as.sites[ i ] != NULL );
+        assertion_site_assert_valid( *( as.sites[ i ] ) );
+    }
+    assert( workers_is_null_iff_workers_size_is_zero( as ) );
+    for ( size_t i = 0; i < as.workers_size; i += 1 ) {
+        assert( as.workers[ i ] != NULL );
+        assertions_assert_valid( *( as.workers[ i ] ) );
+    }
+}
+
+
+static
+void assert_valid_shallowly( Assertions const as )
+// Asserts the invariants of the given `Assertions` that can be checked
+// in constant time. Functions that are called once per assertion use
+// this rather than `assertions_assert_valid()`, which would make adding
+// `n` assertions take `O(n^2)` time.
+{
+    assert( as.size <= as.capacity );
+    assert( array_is_null_iff_capacity_is_zero( as ) );
+    assert( as.sites_size <= as.sites_capacity );
+    assert( sites_is_null_iff_sites_capacity_is_zero( as ) );
+    assert( workers_is_null_iff_workers_size_is_zero( as ) );
+}
+
+
+static
+size_t site_slot( Assertions const as, int const line )
+// Returns the slot of the `sites_table` of the given `Assertions` to
+// start looking for a site on the given `line` at.
+{
+    return ( ( size_t ) line * 0x9e3779b97f4a7c15ULL )
+         & ( as.sites_table_capacity - 1 );
+}
+
+
+static
+AssertionSite * find_site( Assertions const as,
+                           char const * const file,
+                           int const line,
+                           char const * const expr )
+// Returns the site of the given `Assertions` for the given `file`,
+// `line` and `expr`, or `NULL` if there isn't one.
+{
+    if ( as.sites_table_capacity == 0 ) {
+        return NULL;
+    }
+    size_t const mask = as.sites_table_capacity - 1;
+    for ( size_t i = site_slot( as, line ); as.sites_table[ i ] != 0;
+          i = ( i + 1 ) & mask ) {
+        AssertionSite * const site = as.sites[ as.sites_table[ i ] - 1 ];
+        if ( assertion_site_is_at( *site, file, line, expr ) ) {
+            return site;
+        }
+    }
+    return NULL;
+}
+
+
+static
+void index_site( Assertions * const as, size_t const index )
+// Adds the site at the given index of the `sites` of the given
+// `Assertions` to its `sites_table`, which should have room for it.
+{
+    size_t const mask = as->sites_table_capacity - 1;
+    size_t i = site_slot( *as, as->sites[ index ]->line );
+    while ( as->sites_table[ i ] != 0 ) {
+        i = ( i + 1 ) & mask;
+    }
+    as->sites_table[ i ] = index + 1;
+}
+
+
+static
+void add_site( Assertions * const as, AssertionSite * const site )
+// Adds the given site to the `sites` of the given `Assertions`,
+// increasing the `sites_capacity` if necessary, and indexes it.
+{
+    assert( site != NULL );
+    if ( as->sites_size == as->sites_capacity ) {
+        as->sites_capacity = ( as->sites_capacity == 0 )
+                           ? 4 : as->sites_capacity * 2;
+        as->sites = untracked_realloc( as->sites,
+                             as->sites_capacity * sizeof ( AssertionSite * ) );
+    }
+    as->sites[ as->sites_size ] = site;
+    as->sites_size += 1;
+    // The table is kept at most half full, so its probes stay short.
+    if ( 2 * as->sites_size <= as->sites_table_capacity ) {
+        index_site( as, as->sites_size - 1 );
+        return;
+    }
+    untracked_free( as->sites_table );
+    as->sites_table_capacity = 2 * as->sites_capacity;
+    as->sites_table = untracked_calloc( as->sites_table_capacity,
+                                        sizeof ( size_t ) );
+    for ( size_t i = 0; i < as->sites_size; i += 1 ) {
+        index_site( as, i );
+    }
 }
 
 
@@ -91,11 +248,11 @@ Assertions * assertions_new_( struct assertions_new_options const o )
     size_t const capacity =
         ( o.capacity == 0 ) ? assertions_initial_capacity : o.capacity;
 
-    Assertions * const as = malloc( sizeof ( Assertions ) );
+    Assertions * const as = untracked_malloc( sizeof ( Assertions ) );
     *as = ( Assertions ){
         .size = 0,
         .capacity = capacity,
-        .array = malloc( capacity * sizeof ( Assertion * ) )
+        .array = untracked_malloc( capacity * sizeof ( Assertion * ) )
     };
     if ( array != NULL ) {
         assertions_add_all( as, array );
@@ -117,6 +274,18 @@ Assertions * assertions_copy( Assertions const as )
     for ( size_t i = 0; i < as.size; i += 1 ) {
         assertions_add_( copy, *assertions_get( as, i ) );
     }
+    copy->elided = as.elided;
+    for ( size_t i = 0; i < as.sites_size; i += 1 ) {
+        add_site( copy, assertion_site_copy( *( as.sites[ i ] ) ) );
+    }
+    if ( as.workers_size > 0 ) {
+        copy->workers_size = as.workers_size;
+        copy->workers = untracked_malloc( as.workers_size
+                                          * sizeof ( Assertions * ) );
+        for ( size_t i = 0; i < as.workers_size; i += 1 ) {
+            copy->workers[ i ] = assertions_copy( *( as.workers[ i ] ) );
+        }
+    }
     return copy;
 }
 
@@ -128,8 +297,17 @@ void assertions_free( Assertions * const as )
         for ( size_t i = 0; i < as->size; i += 1 ) {
             assertion_free( as->array[ i ] );
         }
-        free( as->array );
-        free( as );
+        for ( size_t i = 0; i < as->sites_size; i += 1 ) {
+            assertion_site_free( as->sites[ i ] );
+        }
+        for ( size_t i = 0; i < as->workers_size; i += 1 ) {
+            assertions_free( as->workers[ i ] );
+        }
+        untracked_free( as->array );
+        untracked_free( as->sites );
+        untracked_free( as->sites_table );
+        untracked_free( as->workers );
+        untracked_free( as );
     }
 }
 
@@ -139,7 +317,8 @@ bool assertions_eq( Assertions const as1, Assertions const as2 )
     assertions_assert_valid( as1 );
     assertions_assert_valid( as2 );
 
-    if ( as1.size != as2.size ) {
+    if ( as1.size != as2.size || as1.elided != as2.elided
+      || as1.sites_size != as2.sites_size ) {
         return false;
     }
     for ( size_t i = 0; i < as1.size; i += 1 ) {
@@ -148,6 +327,11 @@ bool assertions_eq( Assertions const as1, Assertions const as2 )
             return false;
         }
     }
+    for ( size_t i = 0; i < as1.sites_size; i += 1 ) {
+        if ( !assertion_site_eq( *( as1.sites[ i ] ), *( as2.sites[ i ] ) ) ) {
+            return false;
+        }
+    }
     return true;
 }
 
@@ -162,6 +346,80 @@ bool assertions_eq_array( Assertions const as, Assertion const * const array )
 }
 
 
+static
+size_t next_with_result( Assertions const as, bool const result,
+                         size_t const from )
+// Returns the index of the first assertion at or after `from` with the
+// given `result`, or `as.size` if there isn't one.
+{
+    size_t i = from;
+    while ( i < as.size && as.array[ i ]->result != result ) {
+        i += 1;
+    }
+    return i;
+}
+
+
+struct run {
+    size_t count;
+    size_t last;
+    size_t next;
+};
+
+
+static
+long long id_step( Assertion const from, Assertion const to, size_t const k )
+// Returns the difference in value of the `k`th identifications of the
+// given assertions, wrapping rather than overflowing.
+{
+    return ( long long ) ( ( unsigned long long ) to.ids->array[ k ].value
+                         - ( unsigned long long ) from.ids->array[ k ].value );
+}
+
+
+static
+struct run find_run( Assertions const as, bool const result,
+                     size_t const first )
+// Returns the run of assertions with the given `result` starting at
+// `first` (which should have identifications), up to the next one that
+// has a different expression, differently-named identifications, a
+// detail, or identification values that don't continue the progression
+// of the run.
+{
+    Assertion const a = *as.array[ first ];
+    struct run run = { .count = 1,
+                       .last = first,
+                       .next = next_with_result( as, result, first + 1 ) };
+    size_t second = as.size;
+    while ( run.next < as.size ) {
+        Assertion const b = *as.array[ run.next ];
+        if ( !string_eq( a.expr, b.expr )
+          || !assertion_has_ids( b )
+          || b.detail != NULL
+          || !assertion_ids_same_exprs( *( a.ids ), *( b.ids ) ) ) {
+            break;
+        }
+        if ( run.count >= 2 ) {
+            Assertion const prev = *as.array[ run.last ];
+            bool progresses = true;
+            for ( size_t k = 0; k < a.ids->size && progresses; k += 1 ) {
+                progresses = id_step( prev, b, k )
+                          == id_step( a, *as.array[ second ], k );
+            }
+            if ( !progresses ) {
+                break;
+            }
+        } else {
+            second = run.next;
+        }
+        run.count += 1;
+        run.last = run.next;
+        run.next = next_with_result( as, result, run.next + 1 );
+    }
+    return run;
+}
+
+
 void assertions_print_( bool const result,
                         struct assertions_print_options const o )
 {
@@ -173,28 +431,67 @@ void assertions_print_( bool const result,
     char const * const ids_indent =
         ( o.ids_indent == NULL ) ? "" : o.ids_indent;
 
-    char const * last_expr = NULL;
-    for ( size_t i = 0; i < as.size; i += 1 ) {
-        Assertion const a = *assertions_get( as, i );
-        if ( a.result == result ) {
-            // Don't repeat consecutive equal assertion expressions;
-            // just print the identifications (if any).
-            if ( last_expr != NULL && strcmp( a.expr, last_expr ) == 0 ) {
-                // Separate `if` block so that we don't print the
-                // assertion expression if it has no identifications.
-                if ( assertion_has_ids( a ) ) {
-                    fprintf( file, "%s", ids_indent );
-                    assertion_ids_print( .ids = *( a.ids ), .file = file );
+    size_t i = next_with_result( as, result, 0 );
+    while ( i < as.size ) {
+        // Don't repeat consecutive equal assertion expressions; just
+        // print the identifications (if any) under the first.
+        char const * const expr = as.array[ i ]->expr;
+        fprintf( file, "%s", assertion_indent );
+        assertion_print( .assertion = { .expr = expr, .result = result },
+                         .file = file );
+        size_t lines = 0;
+        size_t unprinted = 0;
+        while ( i < as.size && string_eq( as.array[ i ]->expr, expr ) ) {
+            Assertion const a = *as.array[ i ];
+            if ( !assertion_has_ids( a ) ) {
+                if ( o.ids_limit == 0 || lines < o.ids_limit ) {
+                    assertion_print_detail( .assertion = a,
+                                            .file = file,
+                                            .ids_indent = ids_indent );
                 }
+                i = next_with_result( as, result, i + 1 );
+                continue;
+            }
+            struct run const run = find_run( as, result, i );
+            size_t const taken = ( run.count >= assertions_print_min_run
+                                && a.detail == NULL ) ? run.count : 1;
+            if ( o.ids_limit != 0 && lines == o.ids_limit ) {
+                unprinted += taken;
+            } else if ( taken > 1 ) {
+                fprintf( file, "%s", ids_indent );
+                assertion_ids_print_run(
+                    .first = *( a.ids ),
+                    .last = *( as.array[ run.last ]->ids ),
+                    .count = run.count,
+                    .file = file );
+                lines += 1;
             } else {
-                fprintf( file, "%s", assertion_indent );
-                assertion_print( .assertion = a,
-                                 .file = file,
-                                 .ids_indent = ids_indent );
+                fprintf( file, "%s", ids_indent );
+                assertion_ids_print( .ids = *( a.ids ), .file = file );
+                assertion_print_detail( .assertion = a,
+                                        .file = file,
+                                        .ids_indent = ids_indent );
+                lines += 1;
             }
-            last_expr = a.expr;
+            i = ( taken > 1 ) ? run.next
+                              : next_with_result( as, result, i + 1 );
+        }
+        if ( unprinted > 0 ) {
+            fprintf( file, "%s... and %zu more\n", ids_indent, unprinted );
         }
     }
+    for ( size_t j = 0; j < as.sites_size; j += 1 ) {
+        assertion_site_print( result, .site = *( as.sites[ j ] ),
+                                      .file = file,
+                                      .assertion_indent = assertion_indent,
+                                      .ids_indent = ids_indent,
+                                      .ids_limit = o.ids_limit,
+                                      .min_run = assertions_print_min_run );
+    }
+    if ( result == true && as.elided > 0 ) {
+        fprintf( file, "%strue:  (%zu more, not stored)\n",
+                       assertion_indent, as.elided );
+    }
 }
 
 
@@ -206,25 +503,42 @@ bool assertions_all_true( Assertions const as )
             return false;
         }
     }
+    for ( size_t i = 0; i < as.sites_size; i += 1 ) {
+        if ( as.sites[ i ]->fails > 0 ) {
+            return false;
+        }
+    }
     return true;
 }
 
 
+size_t assertions_count( Assertions const as )
+{
+    assertions_assert_valid( as );
+    size_t count = as.size + as.elided;
+    for ( size_t i = 0; i < as.sites_size; i += 1 ) {
+        count += as.sites[ i ]->passes + as.sites[ i ]->fails;
+    }
+    return count;
+}
+
+
 void assertions_increase_capacity( Assertions * const as )
 {
     assert( as != NULL );
-    assertions_assert_valid( *as );
+    assert_valid_shallowly( *as );
 
     as->capacity = ( as->capacity == 0 ) ? assertions_initial_capacity
                                          : as->capacity * 2;
-    as->array = realloc( as->array, as->capacity * sizeof ( Assertion * ) );
+    as->array = untracked_realloc( as->array,
+                                   as->capacity * sizeof ( Assertion * ) );
 }
 
 
 void assertions_decrease_capacity( Assertions * const as )
 {
     assert( as != NULL );
-    assertions_assert_valid( *as );
+    assert_valid_shallowly( *as );
 
     if ( as->capacity == 0 ) {
         return;
@@ -238,7 +552,8 @@ void assertions_decrease_capacity( Assertions * const as )
         }
         as->size = as->capacity;
     }
-    as->array = realloc( as->array, as->capacity * sizeof ( Assertion * ) );
+    as->array = untracked_realloc( as->array,
+                                   as->capacity * sizeof ( Assertion * ) );
     if ( as->capacity == 0 ) {
         // `realloc` may not return `NULL` if the given `size` is `0`,
         // but it will certainly free the given pointer.
@@ -249,7 +564,7 @@ void assertions_decrease_capacity( Assertions * const as )
 
 Assertion * assertions_get( Assertions const as, long long const i )
 {
-    assertions_assert_valid( as );
+    assert_valid_shallowly( as );
 
     long long const lsize = as.size;
     assert( -lsize <= i && i < lsize );
@@ -260,7 +575,7 @@ Assertion * assertions_get( Assertions const as, long long const i )
 void assertions_add_( Assertions * const as, Assertion const a )
 {
     assert( as != NULL );
-    assertions_assert_valid( *as );
+    assert_valid_shallowly( *as );
     assertion_assert_valid( a );
 
     if ( as->size == as->capacity ) {
@@ -274,7 +589,7 @@ void assertions_add_( Assertions * const as, Assertion const a )
 void assertions_add_ptr( Assertions * const as, Assertion * const a )
 {
     assert( as != NULL );
-    assertions_assert_valid( *as );
+    assert_valid_shallowly( *as );
     assert( a != NULL );
     assertion_assert_valid( *a );
 
@@ -286,10 +601,101 @@ void assertions_add_ptr( Assertions * const as, Assertion * const a )
 }
 
 
-void assertions_add_all( Assertions * const as, Assertion const * const array )
+void assertions_add_at_( Assertions * const as,
+                         struct assertions_add_at_options const o )
+{
+    assert( as != NULL );
+    assert( o.file != NULL );
+    assert( o.expr != NULL );
+
+    AssertionSite * site = find_site( *as, o.file, o.line, o.expr );
+    if ( site == NULL ) {
+        site = assertion_site_new( .file = o.file,
+                                   .line = o.line,
+                                   .expr = o.expr,
+                                   .ids = o.ids );
+        add_site( as, site );
+    }
+    assertion_site_add( site, o.result, o.ids );
+}
+
+
+void assertions_set_workers( Assertions * const as, size_t const count )
+{
+    assert( as != NULL );
+    assertions_assert_valid( *as );
+    assert( as->workers_size == 0 );
+
+    if ( count == 0 ) {
+        return;
+    }
+    as->workers = untracked_malloc( count * sizeof ( Assertions * ) );
+    for ( size_t i = 0; i < count; i += 1 ) {
+        as->workers[ i ] = assertions_empty();
+    }
+    as->workers_size = count;
+}
+
+
+Assertions * assertions_worker( Assertions const as, size_t const index )
+{
+    assert( index < as.workers_size );
+    return as.workers[ index ];
+}
+
+
+static
+void join_worker( Assertions * const as, Assertions * const worker )
+// Moves the assertions and sites of the given `worker` into the given
+// `Assertions`, leaving the `worker` empty.
+{
+    assertions_join( worker );
+    while ( as->capacity - as->size < worker->size ) {
+        assertions_increase_capacity( as );
+    }
+    memcpy( as->array + as->size, worker->array,
+            worker->size * sizeof ( Assertion * ) );
+    as->size += worker->size;
+    worker->size = 0;
+    as->elided += worker->elided;
+    for ( size_t i = 0; i < worker->sites_size; i += 1 ) {
+        AssertionSite * const site = worker->sites[ i ];
+        AssertionSite * const into =
+            find_site( *as, site->file, site->line, site->expr );
+        if ( into == NULL ) {
+            add_site( as, site );
+        } else {
+            assertion_site_merge( into, *site );
+            assertion_site_free( site );
+        }
+    }
+    worker->sites_size = 0;
+    if ( worker->sites_table != NULL ) {
+        memset( worker->sites_table, 0,
+                worker->sites_table_capacity * sizeof ( size_t ) );
+    }
+}
+
+
+void assertions_join( Assertions * const as )
 {
     assert( as != NULL );
     assertions_assert_valid( *as );
+
+    for ( size_t i = 0; i < as->workers_size; i += 1 ) {
+        join_worker( as, as->workers[ i ] );
+        assertions_free( as->workers[ i ] );
+    }
+    untracked_free( as->workers );
+    as->workers = NULL;
+    as->workers_size = 0;
+}
+
+
+void assertions_add_all( Assertions * const as, Assertion const * const array )
+{
+    assert( as != NULL );
+    assert_valid_shallowly( *as );
     assert( array != NULL );
 
     for ( size_t i = 0; array[ i ].expr != NULL; i += 1 ) {
@@ -297,3 +703,132 @@ void assertions_add_all( Assertions * const as, Assertion const * const array )
     }
 }
 
+
+
+static
+int count_trailing_zeros( uint64_t const x )
+// Returns the index of the lowest set bit of `x`, which can't be `0`.
+{
+    assert( x != 0 );
+#if defined( __GNUC__ ) || defined( __clang__ )
+    return __builtin_ctzll( x );
+#else
+    int n = 0;
+    for ( uint64_t y = x; ( y & 1 ) == 0; y >>= 1 ) {
+        n += 1;
+    }
+    return n;
+#endif
+}
+
+
+static
+int count_ones( uint64_t const x )
+// Returns the number of set bits in `x`.
+{
+#if defined( __GNUC__ ) || defined( __clang__ )
+    return __builtin_popcountll( x );
+#else
+    int n = 0;
+    for ( uint64_t y = x; y != 0; y &= y - 1 ) {
+        n += 1;
+    }
+    return n;
+#endif
+}
+
+
+static
+uint64_t bulk_word_failures( struct assertions_add_bulk_options const o,
+                             size_t const w )
+// Returns the mask of the `false` verdicts in word `w` of `o.bits`.
+{
+    size_t const rest = o.size - ( w * 64 );
+    uint64_t const valid = ( rest >= 64 ) ? UINT64_MAX
+                         : ( ( ( uint64_t ) 1 << rest ) - 1 );
+    return ~o.bits[ w ] & valid;
+}
+
+
+static
+void add_bulk_failure( Assertions * const as,
+                       struct assertions_add_bulk_options const o,
+                       size_t const i )
+// Adds the `false` verdict `i` of a bulk addition, without revalidating
+// the whole `Assertions` as `assertions_add_ptr()` would.
+{
+    AssertionId const ids[] = {
+        { .expr = ( o.id_expr == NULL ) ? "i" : o.id_expr,
+          .value = ( o.ids == NULL ) ? ( long long ) i : o.ids[ i ] },
+        ASSERTION_ID_ARRAY_END
+    };
+    if ( as->size == as->capacity ) {
+        assertions_increase_capacity( as );
+    }
+    as->array[ as->size ] = assertion_new_( ( struct assertion_new_options ){
+        .expr = o.expr,
+        .result = false,
+        .ids = ids
+    } );
+    as->size += 1;
+}
+
+
+void assertions_add_bulk_( Assertions * const as,
+                           struct assertions_add_bulk_options const o )
+{
+    assert( as != NULL );
+    assert_valid_shallowly( *as );
+    assert( o.expr != NULL );
+    assert( ( o.results == NULL ) != ( o.bits == NULL ) || o.size == 0 );
+
+    size_t failures = 0;
+    if ( o.bits != NULL ) {
+        // Count the failures first, so that the `array` is reallocated
+        // at most once.
+        size_t total = 0;
+        for ( size_t w = 0; w * 64 < o.size; w += 1 ) {
+            total += count_ones( bulk_word_failures( o, w ) );
+        }
+        while ( as->capacity - as->size < total ) {
+            assertions_increase_capacity( as );
+        }
+        for ( size_t w = 0; w * 64 < o.size; w += 1 ) {
+            // Visit each failure by clearing the lowest set bit until
+            // nothing is left.
+            for ( uint64_t fails = bulk_word_failures( o, w ); fails != 0;
+                  fails &= fails - 1 ) {
+                add_bulk_failure( as, o, ( w * 64 )
+                                       + count_trailing_zeros( fails ) );
+                failures += 1;
+            }
+        }
+    } else if ( o.results != NULL ) {
+        // Check eight verdicts at a time: a word of `true` bytes is
+        // `0x0101010101010101`, and we only look at the individual
+        // verdicts of words that differ from that.
+        uint64_t const all_true = UINT64_MAX / 0xFF;
+        size_t i = 0;
+        if ( sizeof ( bool ) == 1 ) {
+            for ( ; i + 8 <= o.size; i += 8 ) {
+                uint64_t word;
+                memcpy( &word, o.results + i, sizeof word );
+                if ( word != all_true ) {
+                    for ( size_t j = i; j < i + 8; j += 1 ) {
+                        if ( !o.results[ j ] ) {
+                            add_bulk_failure( as, o, j );
+                            failures += 1;
+                        }
+                    }
+                }
+            }
+        }
+        for ( ; i < o.size; i += 1 ) {
+            if ( !o.results[ i ] ) {
+                add_bulk_failure( as, o, i );
+                failures += 1;
+            }
+        }
+    }
+    as->elided += o.size - failures;
+}
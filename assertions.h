@@ -22,9 +22,11 @@
 
 #include <stdbool.h>
 #include <stdlib.h>
+#include <stdint.h>
 
 #include "assertion-id.h" // AssertionId, ASSERTION_ID_ARRAY
 #include "assertion.h" // Assertion, ASSERTION_ARRAY, assertion_new
+#include "assertion-site.h" // AssertionSite
 
 
 // An array-backed sequence of `Assertion` pointers.
@@ -42,10 +44,47 @@ typedef struct Assertions {
     // it can hold before we need to reallocate it.
     size_t capacity;
 
+    // How many `true` assertions have been counted without being
+    // stored in the `array`, e.g. by `assertions_add_bulk()`.
+    size_t elided;
+
+    // A pointer to an array of the sites of the assertions made by
+    // `assertions_add()`, in the order they were first used.
+    AssertionSite * * sites;
+
+    // How many sequential elements from the start of `sites` are
+    // considered valid.
+    size_t sites_size;
+
+    // The total capacity of `sites`.
+    size_t sites_capacity;
+
+    // An open-addressing hash table of the `sites` by their line, so
+    // that the site of an assertion is found in constant time. Each slot
+    // holds one more than the index of a site, or `0` if it's empty.
+    size_t * sites_table;
+
+    // How many slots `sites_table` has: `0`, or a power of two.
+    size_t sites_table_capacity;
+
+    // A pointer to an array of the buffers of the worker threads that
+    // add assertions concurrently; see `assertions_set_workers()`.
+    struct Assertions * * workers;
+
+    // How many worker buffers there are.
+    size_t workers_size;
+
     // Invariants:
     // - `size` is always less than or equal to `capacity`
     // - `array` is `NULL` if and only if `capacity` is `0`
     // - `array[ i ]` is not `NULL` for all `0 <= i < size`
+    // - `sites_size` is always less than or equal to `sites_capacity`
+    // - `sites` is `NULL` if and only if `sites_capacity` is `0`
+    // - `sites[ i ]` is not `NULL` for all `0 <= i < sites_size`
+    // - `sites_table` is `NULL` if and only if `sites_table_capacity`
+    //   is `0`, and otherwise indexes every site in `sites`
+    // - `workers` is `NULL` if and only if `workers_size` is `0`
+    // - `workers[ i ]` is not `NULL` for all `0 <= i < workers_size`
 
 } Assertions;
 
@@ -127,7 +166,8 @@ void assertions_free( Assertions * const assertions );
 
 
 // Returns `true` if the two `Assertions` have the same `size`, with the
-// same `Assertion`s in the same order in their `array`s. Otherwise,
+// same `Assertion`s in the same order in their `array`s, the same
+// `elided` count, and equal `sites` in the same order. Otherwise,
 // returns `false`.
 bool assertions_eq( Assertions const as1, Assertions const as2 );
 
@@ -154,6 +194,7 @@ struct assertions_print_options {
     FILE * file;
     char const * assertion_indent;
     char const * ids_indent;
+    size_t ids_limit;
 };
 
 void assertions_print_( bool result, struct assertions_print_options );
@@ -162,17 +203,43 @@ void assertions_print_( bool result, struct assertions_print_options );
 // `stdout` if `NULL`) with the given `RESULT`, indenting each assertion
 // line with `assertion_indent` (or `""` if `NULL`), and each
 // identification line with `ids_indent` (or `""` if `NULL`).
+//
+// The assertions in the `array` are printed first, followed by those of
+// each of the `sites`, as by `assertion_site_print()`.
+//
+// Consecutive assertions with equal expressions are printed under a
+// single assertion line. Runs of `assertions_print_min_run` or more of
+// those whose identification values progress arithmetically are
+// printed as a single identification line, as by
+// `assertion_ids_print_run()`. An assertion with a detail is never part
+// of a run; its detail is printed under its identifications, as by
+// `assertion_print_detail()`. If `ids_limit` is non-zero, at most that
+// many identification lines are printed per assertion line, followed
+// by a line counting the identifications that weren't printed.
 #define assertions_print( RESULT, ... ) \
     assertions_print_( RESULT, ( struct assertions_print_options ){ \
         __VA_ARGS__ \
     } )
 
 
+// The minimum number of consecutive identifications that
+// `assertions_print()` will print as a run. This is more than `2` so
+// that any two unrelated identifications aren't presented as a run.
+extern size_t const assertions_print_min_run;
+
+
 // Returns `true` if all of the `Assertion`s in the `array` of the given
-// value have a `true` `result` field. Otherwise, returns `false`.
+// value have a `true` `result` field, and none of its `sites` have any
+// `false` evaluations. Otherwise, returns `false`.
 bool assertions_all_true( Assertions );
 
 
+// Returns how many assertions have been made against the given
+// `Assertions`: the `size`, plus the `elided` count, plus the number of
+// evaluations at each of the `sites`.
+size_t assertions_count( Assertions );
+
+
 // Increases the `capacity` of the given `Assertions`, and reallocates
 // the `array` accordingly.
 void assertions_increase_capacity( Assertions * const as );
@@ -196,20 +263,70 @@ Assertion * assertions_get( Assertions, long long index );
 void assertions_add_( Assertions * assertions, Assertion );
 
 
+struct assertions_add_at_options {
+    char const * file;
+    int line;
+    char const * expr;
+    bool result;
+    AssertionId const * ids;
+};
+
+// Counts an evaluation of the given `expr` with the given `result` at
+// the site of the given `Assertions` for the given `file`, `line` and
+// `expr`, adding a new site if there isn't one yet. See
+// `assertion_site_add()`.
+void assertions_add_at_( Assertions * assertions,
+                         struct assertions_add_at_options );
+
+
 // Takes an `Assertions *`, a `bool` expression, and a variable number
-// of `int` expressions for identification, and adds an `Assertion` with
-// that given `bool` expression, identified with  those given `int`
-// expressions, to the given `Assertions`. This is commonly used in
-// loops to create assertions for a range of values. If the first
-// identification expression is a literal `0`, then the added
-// `Assertion` will be given no identification expressions - this
-// prevents printing an identification line.
+// of integer expressions for identification, and records an evaluation of
+// that given `bool` expression, identified with those given integer
+// expressions, at the site of the given `Assertions` for the current
+// source file and line. This is commonly used in loops to create
+// assertions for a range of values: a `true` evaluation is only
+// counted, and a `false` evaluation only stores the values of its
+// identifications. If the first identification expression is a literal
+// `0`, then the evaluations will be given no identification expressions
+// - this prevents printing identification lines.
+//
+// Unlike `assertions_add_()`, this doesn't add an `Assertion` to the
+// `array`, so it doesn't change the `size`, and its evaluations can't
+// be gotten with `assertions_get()`; they're in the `sites`, and
+// counted by `assertions_count()`.
 //
 // This depends on `MACROMAP`, so it can't take more than 128
 // identification expressions, and no expression can begin with more
 // than four parentheses.
 #define assertions_add( ASSERTIONS, EXPR, ... ) \
-    assertions_add_ptr( ASSERTIONS, assertion_new( EXPR, __VA_ARGS__ ) )
+    assertions_add_at_( ASSERTIONS, ( struct assertions_add_at_options ){ \
+        .file = __FILE__, \
+        .line = __LINE__, \
+        .expr = #EXPR, \
+        .result = EXPR, \
+        .ids = ( AssertionId[] ) ASSERTION_ID_ARRAY( __VA_ARGS__ ) \
+    } )
+
+
+// Gives the given `Assertions` a buffer for each of `count` worker
+// threads, which can add to their own buffer (as given by
+// `assertions_worker()`) concurrently with each other, without locking.
+// This has to be called before the workers start, and the buffers
+// should be merged by `assertions_join()` after they finish. Until
+// then, the functions that read an `Assertions` ignore its buffers.
+void assertions_set_workers( Assertions * assertions, size_t count );
+
+
+// Returns the buffer of worker `index` of the given `Assertions`, to
+// add assertions to in the usual ways. Only that worker should use it.
+Assertions * assertions_worker( Assertions, size_t index );
+
+
+// Moves the assertions and sites of each worker buffer of the given
+// `Assertions` into it, in the order of the workers, and frees the
+// buffers. So the result doesn't depend on how the workers were
+// scheduled. `test_run()` calls this when a test returns.
+void assertions_join( Assertions * assertions );
 
 
 // Adds the given `Assertion *` to the given `Assertions` (without
@@ -226,5 +343,36 @@ void assertions_add_ptr( Assertions * assertions, Assertion * assertion );
 void assertions_add_all( Assertions * assertions, Assertion const * array );
 
 
+struct assertions_add_bulk_options {
+    char const * expr;
+    bool const * results;
+    uint64_t const * bits;
+    size_t size;
+    char const * id_expr;
+    int const * ids;
+};
+
+void assertions_add_bulk_( Assertions * assertions,
+                           struct assertions_add_bulk_options );
+
+// Takes an `Assertions *`, a string `EXPR` describing the verdicts, and
+// the verdicts of `size` assertions as either a `bool` array `results`
+// or a bitmask `bits` (where verdict `i` is bit `i % 64` of
+// `bits[ i / 64 ]`). Only the `false` verdicts are added as
+// `Assertion`s; the `true` verdicts are just counted in the `elided`
+// field. Each added `Assertion` is identified by `id_expr` (or `"i"` if
+// `NULL`), with the value `ids[ i ]` if `ids` is given, or `i`
+// otherwise. For example:
+//      assertions_add_bulk( as, "is_prime( xs[ i ] )",
+//                           .results = verdicts, .size = n,
+//                           .id_expr = "xs[ i ]", .ids = xs );
+#define assertions_add_bulk( ASSERTIONS, EXPR, ... ) \
+    assertions_add_bulk_( ASSERTIONS, \
+        ( struct assertions_add_bulk_options ){ \
+            .expr = EXPR, \
+            __VA_ARGS__ \
+        } )
+
+
 #endif // ifndef INCLUDED_TESTC_ASSERTIONS_H
 
@@ -0,0 +1,280 @@
+// baseline.c
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "baseline.h" // BenchResult, assertions_add_baseline_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/utsname.h>
+
+#include "assertion.h" // assertion_new_
+#include "test.h" // test_current_name
+#include "heap.h" // heap_pause, heap_resume
+#include "_common.h" // untracked_*
+
+
+// Guards the baseline file against concurrent updates from this
+// process.
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+static
+uint64_t hash_string( uint64_t hash, char const * const string )
+// Returns the given FNV-1a `hash` updated with the given `string`.
+{
+    for ( char const * c = string; *c != '\0'; c += 1 ) {
+        hash ^= ( unsigned char ) *c;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+
+static
+void cpu_model( char * const buffer, size_t const size )
+// Writes the CPU model to the given `buffer`, or an empty string if we
+// can't find it.
+{
+    buffer[ 0 ] = '\0';
+    FILE * const file = fopen( "/proc/cpuinfo", "r" );
+    if ( file == NULL ) {
+        return;
+    }
+    char line[ 256 ];
+    while ( fgets( line, sizeof line, file ) != NULL ) {
+        char const * const colon = strchr( line, ':' );
+        if ( colon != NULL && strncmp( line, "model name", 10 ) == 0 ) {
+            snprintf( buffer, size, "%s", colon + 1 );
+            break;
+        }
+    }
+    fclose( file );
+}
+
+
+static char fingerprint[ 17 ];
+static pthread_once_t fingerprint_once = PTHREAD_ONCE_INIT;
+
+
+static
+void compute_fingerprint( void )
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    struct utsname names;
+    if ( uname( &names ) == 0 ) {
+        hash = hash_string( hash, names.sysname );
+        hash = hash_string( hash, names.machine );
+    }
+    char model[ 256 ];
+    cpu_model( model, sizeof model );
+    hash = hash_string( hash, model );
+    char processors[ 32 ];
+    snprintf( processors, sizeof processors, "%ld",
+              sysconf( _SC_NPROCESSORS_ONLN ) );
+    hash = hash_string( hash, processors );
+    snprintf( fingerprint, sizeof fingerprint, "%016llx",
+              ( unsigned long long ) hash );
+}
+
+
+char const * baseline_fingerprint( void )
+{
+    heap_pause();
+    pthread_once( &fingerprint_once, compute_fingerprint );
+    heap_resume();
+    return fingerprint;
+}
+
+
+static
+char const * default_path( char const * const path )
+{
+    if ( path != NULL ) {
+        return path;
+    }
+    char const * const env = getenv( "TESTC_BASELINE" );
+    return ( env != NULL && env[ 0 ] != '\0' ) ? env : "testc-baseline.tsv";
+}
+
+
+static
+bool line_is_for( char const * const line, char const * const name,
+                  char const ** const value )
+// Returns `true` if the given line of a baseline file is for the given
+// `name` on this machine, and if so, points `value` to its time.
+{
+    char const * const fp = baseline_fingerprint();
+    size_t const fp_length = strlen( fp );
+    size_t const name_length = strlen( name );
+    if ( strncmp( line, fp, fp_length ) != 0 || line[ fp_length ] != '\t'
+      || strncmp( line + fp_length + 1, name, name_length ) != 0
+      || line[ fp_length + 1 + name_length ] != '\t' ) {
+        return false;
+    }
+    *value = line + fp_length + 1 + name_length + 1;
+    return true;
+}
+
+
+bool baseline_load( char const * const path,
+                    char const * const name,
+                    double * const mean_ns )
+{
+    assert( name != NULL );
+    assert( mean_ns != NULL );
+
+    heap_pause();
+    pthread_mutex_lock( &lock );
+    FILE * const file = fopen( default_path( path ), "r" );
+    bool found = false;
+    if ( file != NULL ) {
+        char * line = NULL;
+        size_t capacity = 0;
+        while ( !found && getline( &line, &capacity, file ) != -1 ) {
+            char const * value;
+            if ( line_is_for( line, name, &value ) ) {
+                *mean_ns = strtod( value, NULL );
+                found = true;
+            }
+        }
+        free( line );
+        fclose( file );
+    }
+    pthread_mutex_unlock( &lock );
+    heap_resume();
+    return found;
+}
+
+
+bool baseline_store( char const * const path_,
+                     char const * const name,
+                     double const mean_ns )
+{
+    assert( name != NULL );
+    char const * const path = default_path( path_ );
+    size_t const tmp_size = strlen( path ) + 5;
+    char * const tmp = untracked_malloc( tmp_size );
+    snprintf( tmp, tmp_size, "%s.tmp", path );
+
+    heap_pause();
+    pthread_mutex_lock( &lock );
+    FILE * const out = fopen( tmp, "w" );
+    bool ok = out != NULL;
+    if ( ok ) {
+        // Copy every other line of the old file, then add ours.
+        FILE * const in = fopen( path, "r" );
+        if ( in != NULL ) {
+            char * line = NULL;
+            size_t capacity = 0;
+            while ( getline( &line, &capacity, in ) != -1 ) {
+                char const * value;
+                if ( !line_is_for( line, name, &value ) ) {
+                    fputs( line, out );
+                }
+            }
+            free( line );
+            fclose( in );
+        }
+        fprintf( out, "%s\t%s\t%.3f\n", baseline_fingerprint(), name,
+                 mean_ns );
+        ok = ( fclose( out ) == 0 ) && ( rename( tmp, path ) == 0 );
+    }
+    pthread_mutex_unlock( &lock );
+    heap_resume();
+    untracked_free( tmp );
+    return ok;
+}
+
+
+bool baseline_is_regression( BenchResult const result,
+                             double const baseline_ns,
+                             double const tolerance )
+{
+    return result.ci_low_ns > baseline_ns * ( 1 + tolerance );
+}
+
+
+static
+bool update_requested( void )
+{
+    char const * const env = getenv( "TESTC_BASELINE_UPDATE" );
+    return env != NULL && env[ 0 ] != '\0' && strcmp( env, "0" ) != 0;
+}
+
+
+void assertions_add_baseline_(
+        Assertions * const assertions,
+        struct assertions_add_baseline_options const o )
+{
+    assert( assertions != NULL );
+    assert( o.expr != NULL );
+    assert( o.label != NULL );
+    double const tolerance = ( o.tolerance == 0 ) ? 0.1 : o.tolerance;
+
+    char * name = NULL;
+    if ( o.name == NULL ) {
+        char const * const test = test_current_name();
+        size_t const size = ( ( test == NULL ) ? 0 : strlen( test ) + 1 )
+                          + strlen( o.label ) + 1;
+        name = untracked_malloc( size );
+        snprintf( name, size, "%s%s%s", ( test == NULL ) ? "" : test,
+                  ( test == NULL ) ? "" : "/", o.label );
+    }
+    char const * const key = ( o.name == NULL ) ? name : o.name;
+
+    BenchResult const result = bench_run( .func = o.func,
+                                          .ctx = o.ctx,
+                                          .samples = o.samples,
+                                          .min_sample_ns = o.min_sample_ns );
+    double baseline_ns;
+    bool passed = true;
+    if ( o.update || update_requested()
+      || !baseline_load( o.path, key, &baseline_ns ) ) {
+        // The assertion fails if the baseline couldn't be stored.
+        passed = baseline_store( o.path, key, result.mean_ns );
+        baseline_ns = result.mean_ns;
+    } else {
+        passed = !baseline_is_regression( result, baseline_ns, tolerance );
+    }
+    untracked_free( name );
+
+    assertions_add_ptr( assertions, assertion_new_(
+        ( struct assertion_new_options ){
+            .expr = o.expr,
+            .result = passed,
+            .ids = ( AssertionId[] ){
+                { .expr = "baseline_ps",
+                  .value = llround( 1000 * baseline_ns ) },
+                { .expr = "measured_ps",
+                  .value = llround( 1000 * result.mean_ns ) },
+                { .expr = "ratio_percent",
+                  .value = ( baseline_ns == 0 ) ? 0
+                         : llround( 100 * result.mean_ns / baseline_ns ) },
+                ASSERTION_ID_ARRAY_END
+            }
+        } ) );
+}
@@ -0,0 +1,108 @@
+// baseline.h
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef INCLUDED_TESTC_BASELINE_H
+#define INCLUDED_TESTC_BASELINE_H
+
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "assertions.h" // Assertions
+#include "bench.h" // BenchResult, bench_fn
+
+
+// Baselines are the mean times of benchmarks, stored in a text file with
+// a line for each benchmark: the fingerprint of the machine it was
+// measured on, its name, and its mean time in nanoseconds, separated by
+// tabs. The file is `$TESTC_BASELINE`, or `testc-baseline.tsv` in the
+// current directory if that isn't set.
+
+
+// Returns a fingerprint of the machine that we're running on, as 16
+// hexadecimal digits: a hash of the operating system, the architecture,
+// the CPU model (where we can find it), and the number of processors.
+// This deliberately doesn't include the host name, which changes on
+// every run on some continuous integration services.
+char const * baseline_fingerprint( void );
+
+
+// Loads the baseline for the given `name` on this machine from the file
+// at the given `path` (or the default if `NULL`) into `mean_ns`, and
+// returns whether there was one.
+bool baseline_load( char const * path, char const * name, double * mean_ns );
+
+
+// Stores the given `mean_ns` as the baseline for the given `name` on
+// this machine in the file at the given `path` (or the default if
+// `NULL`), replacing any previous baseline for it. The file is replaced
+// atomically. Returns whether that succeeded.
+bool baseline_store( char const * path, char const * name, double mean_ns );
+
+
+// Returns `true` if the given `result` is slower than `baseline_ns` by
+// more than the given `tolerance` (e.g. `0.1` for 10%) with 95%
+// confidence, i.e. if even the low end of its confidence interval is.
+bool baseline_is_regression( BenchResult result, double baseline_ns,
+                             double tolerance );
+
+
+struct assertions_add_baseline_options {
+    char const * expr;
+    char const * label;
+    bench_fn func;
+    void * ctx;
+    char const * name;
+    double tolerance;
+    char const * path;
+    bool update;
+    size_t samples;
+    double min_sample_ns;
+};
+
+void assertions_add_baseline_( Assertions * assertions,
+                               struct assertions_add_baseline_options );
+
+// Takes an `Assertions *`, a `bench_fn` expression, and some
+// `bench_run()` options (`ctx`, `samples` and `min_sample_ns`) and
+// baseline options, benchmarks the function, and adds an assertion that
+// it isn't slower than its baseline by more than the `tolerance` (or
+// 10% if `0`), as by `baseline_is_regression()`. The assertion is
+// identified by the baseline and measured times in picoseconds, so
+// that those of very fast functions aren't rounded away, and their ratio
+// as a percentage. For example:
+//      assertions_add_baseline( as, parse_all, .ctx = &input,
+//                                              .tolerance = 0.05 );
+//
+// The baseline is named by the name of the test being run (see
+// `test_current_name()`), a slash, and the function expression, unless
+// a `name` is given. If there's no baseline for that name on this
+// machine yet, or if `update` is `true` or `$TESTC_BASELINE_UPDATE` is
+// set to anything other than `0`, the measured time is stored as the
+// baseline, and the assertion is `true`, unless it couldn't be stored.
+#define assertions_add_baseline( ASSERTIONS, FUNC, ... ) \
+    assertions_add_baseline_( ASSERTIONS, \
+        ( struct assertions_add_baseline_options ){ \
+            .expr = #FUNC " is no slower than its baseline", \
+            .label = #FUNC, \
+            .func = FUNC, \
+            __VA_ARGS__ \
+        } )
+
+
+#endif // ifndef INCLUDED_TESTC_BASELINE_H
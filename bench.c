@@ -0,0 +1,162 @@
+// bench.c
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "bench.h" // BenchResult, bench_fn
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <math.h>
+#include <assert.h>
+
+#include <time.h>
+
+#include "counters.h" // Counters, counters_*
+#include "_common.h" // NELEM, untracked_*
+
+
+uint64_t bench_now_ns( void )
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ( uint64_t ) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+static
+double time_sample( bench_fn const func, void * const ctx,
+                    size_t const iterations )
+// Returns how many nanoseconds it takes to call `func` `iterations`
+// times.
+{
+    uint64_t const start = bench_now_ns();
+    for ( size_t i = 0; i < iterations; i += 1 ) {
+        func( ctx );
+    }
+    return bench_now_ns() - start;
+}
+
+
+static
+int compare_doubles( void const * const a, void const * const b )
+{
+    double const x = *( double const * ) a;
+    double const y = *( double const * ) b;
+    return ( x > y ) - ( x < y );
+}
+
+
+static
+double t_quantile( size_t const df )
+// Returns the 97.5th percentile of Student's t-distribution with the
+// given degrees of freedom, for a two-sided 95% confidence interval.
+{
+    static double const table[] = {
+        12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262,
+        2.228, 2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101,
+        2.093, 2.086, 2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052,
+        2.048, 2.045, 2.042
+    };
+    assert( df > 0 );
+    return ( df <= NELEM( table ) ) ? table[ df - 1 ] : 1.960;
+}
+
+
+BenchResult bench_run_( struct bench_run_options const o )
+{
+    assert( o.func != NULL );
+    size_t const samples = ( o.samples == 0 ) ? 20 : o.samples;
+    double const min_sample_ns =
+        ( o.min_sample_ns == 0 ) ? 1e7 : o.min_sample_ns;
+
+    size_t iterations = o.iterations;
+    if ( iterations == 0 ) {
+        iterations = 1;
+        while ( time_sample( o.func, o.ctx, iterations ) < min_sample_ns
+             && iterations < SIZE_MAX / 2 ) {
+            iterations *= 2;
+        }
+    }
+
+    double * const times = untracked_malloc( samples * sizeof *times );
+    if ( o.counters ) {
+        counters_begin();
+    }
+    for ( size_t i = 0; i < samples; i += 1 ) {
+        times[ i ] = time_sample( o.func, o.ctx, iterations ) / iterations;
+    }
+    Counters const counters = o.counters ? counters_end()
+                                         : ( Counters ){ .values = { 0 } };
+
+    double sum = 0;
+    for ( size_t i = 0; i < samples; i += 1 ) {
+        sum += times[ i ];
+    }
+    double const mean = sum / samples;
+    double squares = 0;
+    for ( size_t i = 0; i < samples; i += 1 ) {
+        squares += ( times[ i ] - mean ) * ( times[ i ] - mean );
+    }
+    double const stddev = ( samples > 1 ) ? sqrt( squares / ( samples - 1 ) )
+                                          : 0;
+    double const margin = ( samples > 1 )
+                        ? t_quantile( samples - 1 ) * stddev / sqrt( samples )
+                        : 0;
+    qsort( times, samples, sizeof *times, compare_doubles );
+    double const median = ( samples % 2 == 1 )
+                        ? times[ samples / 2 ]
+                        : ( times[ samples / 2 - 1 ] + times[ samples / 2 ] )
+                          / 2;
+    BenchResult const result = {
+        .iterations = iterations,
+        .samples = samples,
+        .mean_ns = mean,
+        .median_ns = median,
+        .min_ns = times[ 0 ],
+        .stddev_ns = stddev,
+        .ci_low_ns = mean - margin,
+        .ci_high_ns = mean + margin,
+        .counters = counters
+    };
+    untracked_free( times );
+    return result;
+}
+
+
+void bench_result_print_( struct bench_result_print_options const o )
+{
+    BenchResult const r = o.result;
+    FILE * const file = ( o.file == NULL ) ? stdout : o.file;
+    char const * const indent = ( o.indent == NULL ) ? "" : o.indent;
+
+    fprintf( file, "%sbench:  %.1f ns/op (95%% CI %.1f..%.1f, median %.1f, "
+                   "min %.1f; %zu x %zu)\n",
+             indent, r.mean_ns, r.ci_low_ns, r.ci_high_ns, r.median_ns,
+             r.min_ns, r.samples, r.iterations );
+    for ( size_t k = 0; k < COUNTER_KINDS; k += 1 ) {
+        if ( r.counters.measured[ k ] ) {
+            fprintf( file, "%s", indent );
+            counters_print( .counters = r.counters,
+                            .ops = r.samples * r.iterations,
+                            .file = file );
+            break;
+        }
+    }
+}
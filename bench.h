@@ -0,0 +1,111 @@
+// bench.h
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef INCLUDED_TESTC_BENCH_H
+#define INCLUDED_TESTC_BENCH_H
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "counters.h" // Counters
+
+
+// A function to benchmark, which should perform one operation on the
+// given context.
+typedef void ( * bench_fn )( void * ctx );
+
+
+// The measurements of a benchmark. The times are of a single operation,
+// in nanoseconds.
+typedef struct BenchResult {
+
+    // How many operations were timed together for each sample.
+    size_t iterations;
+
+    // How many samples were taken.
+    size_t samples;
+
+    // The mean, median and fastest of the samples.
+    double mean_ns;
+    double median_ns;
+    double min_ns;
+
+    // The sample standard deviation.
+    double stddev_ns;
+
+    // The 95% confidence interval of the mean.
+    double ci_low_ns;
+    double ci_high_ns;
+
+    // The performance counters of every timed operation, if they were
+    // asked for.
+    Counters counters;
+
+} BenchResult;
+
+
+// Returns the current time of a monotonic clock, in nanoseconds.
+uint64_t bench_now_ns( void );
+
+
+struct bench_run_options {
+    bench_fn func;
+    void * ctx;
+    size_t samples;
+    size_t iterations;
+    double min_sample_ns;
+    bool counters;
+};
+
+BenchResult bench_run_( struct bench_run_options );
+
+// Measures the given `func` called with the given `ctx`, and returns
+// the results. Each sample times `iterations` consecutive operations;
+// if `iterations` is `0`, it's calibrated by doubling it (from `1`)
+// until a sample takes at least `min_sample_ns` (or 10 milliseconds if
+// `0`), which also warms up the caches. Then, `samples` (or `20` if
+// `0`) samples are taken. If `counters` is `true`, the performance
+// counters of the samples are measured too (see `counters.h`).
+#define bench_run( ... ) \
+    bench_run_( ( struct bench_run_options ){ __VA_ARGS__ } )
+
+
+struct bench_result_print_options {
+    BenchResult result;
+    FILE * file;
+    char const * indent;
+};
+
+void bench_result_print_( struct bench_result_print_options );
+
+// Prints the given `result` to the `file` (or `stdout` if `NULL`),
+// indenting each line with `indent` (or `""` if `NULL`). If the result
+// has performance counters, they're printed per operation on a second
+// line. For example:
+//      bench:  41.8 ns/op (95% CI 41.2..42.4, median 41.6, min 40.9; 20 x 262144)
+//      counters:  150.2 cycles/op, 410.0 instructions/op (2.73 IPC)
+#define bench_result_print( ... ) \
+    bench_result_print_( ( struct bench_result_print_options ){ \
+        __VA_ARGS__ \
+    } )
+
+
+#endif // ifndef INCLUDED_TESTC_BENCH_H
@@ -0,0 +1,204 @@
+// complexity.c
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "complexity.h" // ComplexityFit, ComplexityClass
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <assert.h>
+
+#include "assertion.h" // assertion_new_
+#include "bench.h" // bench_run
+#include "heap.h" // heap_pause, heap_resume
+
+
+char const * const complexity_names[ COMPLEXITY_CLASSES ] = {
+    [ COMPLEXITY_1 ]         = "O(1)",
+    [ COMPLEXITY_LOG_N ]     = "O(log n)",
+    [ COMPLEXITY_N ]         = "O(n)",
+    [ COMPLEXITY_N_LOG_N ]   = "O(n log n)",
+    [ COMPLEXITY_N_SQUARED ] = "O(n^2)"
+};
+
+
+static
+double class_function( ComplexityClass const c, double const n )
+// Returns `f( n )` for the given class `O( f( n ) )`.
+{
+    switch ( c ) {
+    case COMPLEXITY_1:         return 1;
+    case COMPLEXITY_LOG_N:     return log2( n );
+    case COMPLEXITY_N:         return n;
+    case COMPLEXITY_N_LOG_N:   return n * log2( n );
+    case COMPLEXITY_N_SQUARED: return n * n;
+    default:                   assert( false ); return 0;
+    }
+}
+
+
+ComplexityFit complexity_fit( size_t const * const sizes,
+                              double const * const times_ns,
+                              size_t const points )
+{
+    assert( sizes != NULL );
+    assert( times_ns != NULL );
+    assert( points >= 2 && points <= COMPLEXITY_MAX_POINTS );
+
+    ComplexityFit fit = { .points = points, .best = COMPLEXITY_1 };
+    double mean = 0;
+    for ( size_t i = 0; i < points; i += 1 ) {
+        fit.sizes[ i ] = sizes[ i ];
+        fit.times_ns[ i ] = times_ns[ i ];
+        mean += times_ns[ i ] / points;
+    }
+    for ( ComplexityClass c = 0; c < COMPLEXITY_CLASSES; c += 1 ) {
+        // The least-squares fit of `t = k * f( n )` is
+        // `k = sum( t * f( n ) ) / sum( f( n ) ^ 2 )`.
+        double tf = 0, ff = 0;
+        for ( size_t i = 0; i < points; i += 1 ) {
+            double const f = class_function( c, sizes[ i ] );
+            tf += times_ns[ i ] * f;
+            ff += f * f;
+        }
+        double const k = ( ff == 0 ) ? 0 : tf / ff;
+        double squares = 0;
+        for ( size_t i = 0; i < points; i += 1 ) {
+            double const residual = times_ns[ i ]
+                                  - k * class_function( c, sizes[ i ] );
+            squares += residual * residual;
+        }
+        fit.coefficients[ c ] = k;
+        fit.errors[ c ] = ( mean == 0 ) ? 0 : sqrt( squares / points ) / mean;
+        if ( fit.errors[ c ] < fit.errors[ fit.best ] ) {
+            fit.best = c;
+        }
+    }
+    return fit;
+}
+
+
+struct sized_call {
+    complexity_fn func;
+    void * ctx;
+    size_t n;
+};
+
+
+static
+void call_sized( void * const arg )
+// Calls the function of the given `struct sized_call` on its size, so
+// that we can benchmark it with `bench_run()`.
+{
+    struct sized_call const * const call = arg;
+    call->func( call->ctx, call->n );
+}
+
+
+ComplexityFit complexity_measure_( struct complexity_measure_options const o )
+{
+    assert( o.func != NULL );
+    size_t const min_size = ( o.min_size == 0 ) ? 16 : o.min_size;
+    size_t const max_size = ( o.max_size == 0 ) ? 16384 : o.max_size;
+    size_t const factor = ( o.factor == 0 ) ? 2 : o.factor;
+    assert( factor >= 2 );
+    assert( min_size < max_size );
+
+    size_t sizes[ COMPLEXITY_MAX_POINTS ];
+    double times[ COMPLEXITY_MAX_POINTS ];
+    size_t points = 0;
+    for ( size_t n = min_size; n <= max_size && points < COMPLEXITY_MAX_POINTS;
+          n *= factor ) {
+        struct sized_call call = { .func = o.func, .ctx = o.ctx, .n = n };
+        BenchResult const r = bench_run(
+            .func = call_sized,
+            .ctx = &call,
+            .samples = ( o.samples == 0 ) ? 5 : o.samples,
+            .min_sample_ns = ( o.min_sample_ns == 0 ) ? 1e6
+                                                       : o.min_sample_ns );
+        sizes[ points ] = n;
+        times[ points ] = r.median_ns;
+        points += 1;
+        if ( n > max_size / factor ) {
+            break;
+        }
+    }
+    return complexity_fit( sizes, times, points );
+}
+
+
+void complexity_fit_print_( struct complexity_fit_print_options const o )
+{
+    ComplexityFit const fit = o.fit;
+    FILE * const file = ( o.file == NULL ) ? stdout : o.file;
+    char const * const indent = ( o.indent == NULL ) ? "" : o.indent;
+
+    fprintf( file, "%s%12s  %14s\n", indent, "n", "time (ns)" );
+    for ( size_t i = 0; i < fit.points; i += 1 ) {
+        fprintf( file, "%s%12zu  %14.1f\n",
+                 indent, fit.sizes[ i ], fit.times_ns[ i ] );
+    }
+    for ( ComplexityClass c = 0; c < COMPLEXITY_CLASSES; c += 1 ) {
+        fprintf( file, "%s%-10s  %6.1f%% error%s\n",
+                 indent, complexity_names[ c ], 100 * fit.errors[ c ],
+                 ( c == fit.best ) ? "  <- best fit" : "" );
+    }
+}
+
+
+void assertions_add_complexity_(
+        Assertions * const assertions,
+        struct assertions_add_complexity_options const o )
+{
+    assert( assertions != NULL );
+    assert( o.expr != NULL );
+    assert( o.max_class < COMPLEXITY_CLASSES );
+
+    ComplexityFit const fit = complexity_measure(
+        .func = o.func,
+        .ctx = o.ctx,
+        .min_size = o.min_size,
+        .max_size = o.max_size,
+        .factor = o.factor,
+        .samples = o.samples,
+        .min_sample_ns = o.min_sample_ns );
+
+    char * table = NULL;
+    size_t size = 0;
+    heap_pause();
+    FILE * const file = open_memstream( &table, &size );
+    complexity_fit_print( .fit = fit, .file = file );
+    fclose( file );
+    heap_resume();
+
+    assertions_add_ptr( assertions, assertion_new_(
+        ( struct assertion_new_options ){
+            .expr = o.expr,
+            .result = fit.best <= o.max_class,
+            .ids = ( AssertionId[] ){
+                { .expr = "fitted", .value = fit.best },
+                ASSERTION_ID_ARRAY_END
+            },
+            .detail = table
+        } ) );
+    heap_pause();
+    free( table );
+    heap_resume();
+}
@@ -0,0 +1,169 @@
+// complexity.h
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef INCLUDED_TESTC_COMPLEXITY_H
+#define INCLUDED_TESTC_COMPLEXITY_H
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "assertions.h" // Assertions
+
+
+// The complexity classes that measurements are fitted against, from the
+// best to the worst.
+typedef enum ComplexityClass {
+    COMPLEXITY_1,
+    COMPLEXITY_LOG_N,
+    COMPLEXITY_N,
+    COMPLEXITY_N_LOG_N,
+    COMPLEXITY_N_SQUARED,
+    COMPLEXITY_CLASSES
+} ComplexityClass;
+
+
+// The names of each complexity class, e.g. `"O(n log n)"`.
+extern char const * const complexity_names[ COMPLEXITY_CLASSES ];
+
+
+// The most sizes that a sweep can measure.
+#define COMPLEXITY_MAX_POINTS 64
+
+
+// A function to measure, which should perform one operation on an input
+// of size `n`, given its context.
+typedef void ( * complexity_fn )( void * ctx, size_t n );
+
+
+// The measurements of a sweep, and how well they fit each class.
+typedef struct ComplexityFit {
+
+    // How many sizes were measured.
+    size_t points;
+
+    // Each size, and the time of an operation on it in nanoseconds.
+    size_t sizes[ COMPLEXITY_MAX_POINTS ];
+    double times_ns[ COMPLEXITY_MAX_POINTS ];
+
+    // For each class, the coefficient `c` that best fits the times to
+    // `c * f( n )`, and the root-mean-square error of that fit relative
+    // to the mean time.
+    double coefficients[ COMPLEXITY_CLASSES ];
+    double errors[ COMPLEXITY_CLASSES ];
+
+    // The class with the least error.
+    ComplexityClass best;
+
+    // Invariants:
+    // - `points` is at least `2`, and at most `COMPLEXITY_MAX_POINTS`
+
+} ComplexityFit;
+
+
+// Fits the given times (in nanoseconds) of operations on inputs of the
+// given sizes against each complexity class, by least squares, and
+// returns the fit. There should be between `2` and
+// `COMPLEXITY_MAX_POINTS` `points`.
+//
+// The fit has no constant term, since with one every class would fit
+// times that don't grow at least as well as `O(1)` does, and the noise
+// would choose between them. So the sizes should be large enough that
+// the fixed overhead of an operation, e.g. of a call and its setup, is
+// negligible next to its time, or it'll look like a slower class grows
+// too slowly, e.g. like `O(log n)` rather than `O(n)`.
+ComplexityFit complexity_fit( size_t const * sizes, double const * times_ns,
+                              size_t points );
+
+
+struct complexity_measure_options {
+    complexity_fn func;
+    void * ctx;
+    size_t min_size;
+    size_t max_size;
+    size_t factor;
+    size_t samples;
+    double min_sample_ns;
+};
+
+ComplexityFit complexity_measure_( struct complexity_measure_options );
+
+// Measures the given `func` on inputs from `min_size` (or `16` if `0`)
+// up to `max_size` (or `16384` if `0`), multiplying the size by `factor`
+// (or `2` if `0`) each time, and returns the fit of those measurements
+// (see `complexity_fit()` for how large the sizes should be).
+// Each size is benchmarked by `bench_run()` with the given `samples`
+// and `min_sample_ns` (or 1 millisecond if `0`), and its time is the
+// median of the samples, which isn't thrown by the odd interruption.
+#define complexity_measure( ... ) \
+    complexity_measure_( ( struct complexity_measure_options ){ \
+        __VA_ARGS__ \
+    } )
+
+
+struct complexity_fit_print_options {
+    ComplexityFit fit;
+    FILE * file;
+    char const * indent;
+};
+
+void complexity_fit_print_( struct complexity_fit_print_options );
+
+// Prints a table of the measurements of the given `fit`, and the error
+// of each class, to the `file` (or `stdout` if `NULL`), indenting each
+// line with `indent` (or `""` if `NULL`).
+#define complexity_fit_print( ... ) \
+    complexity_fit_print_( ( struct complexity_fit_print_options ){ \
+        __VA_ARGS__ \
+    } )
+
+
+struct assertions_add_complexity_options {
+    char const * expr;
+    ComplexityClass max_class;
+    complexity_fn func;
+    void * ctx;
+    size_t min_size;
+    size_t max_size;
+    size_t factor;
+    size_t samples;
+    double min_sample_ns;
+};
+
+void assertions_add_complexity_( Assertions * assertions,
+                                 struct assertions_add_complexity_options );
+
+// Takes an `Assertions *`, a `complexity_fn` expression, a
+// `ComplexityClass`, and some `complexity_measure()` options, measures
+// the function, and adds an assertion that its fitted class is at most
+// the given class. The assertion is identified by the fitted class, and
+// the table of `complexity_fit_print()` is its detail. For example:
+//      assertions_add_complexity( as, insert_all, COMPLEXITY_N_LOG_N,
+//                                 .max_size = 1 << 16 );
+#define assertions_add_complexity( ASSERTIONS, FUNC, CLASS, ... ) \
+    assertions_add_complexity_( ASSERTIONS, \
+        ( struct assertions_add_complexity_options ){ \
+            .expr = "complexity of " #FUNC " <= " #CLASS, \
+            .max_class = CLASS, \
+            .func = FUNC, \
+            __VA_ARGS__ \
+        } )
+
+
+#endif // ifndef INCLUDED_TESTC_COMPLEXITY_H
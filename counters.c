@@ -0,0 +1,370 @@
+// counters.c
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE // syscall
+
+#include "counters.h" // Counters, CounterKind
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+#include "_common.h" // NELEM
+
+
+char const * const counter_names[ COUNTER_KINDS ] = {
+    [ COUNTER_CYCLES ]        = "cycles",
+    [ COUNTER_INSTRUCTIONS ]  = "instructions",
+    [ COUNTER_BRANCH_MISSES ] = "branch misses",
+    [ COUNTER_L1D_MISSES ]    = "L1D misses",
+    [ COUNTER_LLC_MISSES ]    = "LLC misses",
+    [ COUNTER_TASK_CLOCK ]    = "task clock"
+};
+
+
+// How deeply `counters_begin()` calls can be nested.
+#define MAX_DEPTH 16
+
+size_t const counters_max_depth = MAX_DEPTH;
+
+
+// The state of each thread: its open counters, and the counts at each
+// of its `counters_begin()` calls that haven't been ended yet.
+static _Thread_local bool opened = false;
+static _Thread_local int fds[ COUNTER_KINDS ];
+static _Thread_local Counters scopes[ MAX_DEPTH ];
+static _Thread_local size_t depth = 0;
+
+// A key whose destructor closes the counters of a thread that exits,
+// e.g. a worker of `subtests_begin()`, which never calls
+// `counters_close()`.
+static pthread_key_t exit_key;
+static pthread_once_t exit_key_once = PTHREAD_ONCE_INIT;
+
+
+#ifdef __linux__
+
+static
+int open_counter( uint32_t const type, uint64_t const config,
+                  int const group )
+// Returns a file descriptor for a counter of the given event for the
+// calling thread, in the given `group` (or its own if `-1`), or `-1` if
+// it couldn't be opened.
+{
+    struct perf_event_attr attr;
+    memset( &attr, 0, sizeof attr );
+    attr.size = sizeof attr;
+    attr.type = type;
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED
+                     | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    long const fd = syscall( SYS_perf_event_open, &attr, 0, -1, group,
+                             PERF_FLAG_FD_CLOEXEC );
+    return ( fd < 0 ) ? -1 : ( int ) fd;
+}
+
+
+static
+uint64_t cache_miss( uint64_t const cache )
+// Returns the config of a read-miss event for the given cache.
+{
+    return cache
+         | ( PERF_COUNT_HW_CACHE_OP_READ << 8 )
+         | ( PERF_COUNT_HW_CACHE_RESULT_MISS << 16 );
+}
+
+
+// Whether the calling thread's cycles and instructions are counted as a
+// group.
+static _Thread_local bool grouped = false;
+
+
+static
+void open_cycles_and_instructions( bool const group )
+// Opens the cycles and instructions counters, as a group led by the
+// cycles counter if `group` is `true`, so that they're scheduled
+// together and the instructions per cycle are meaningful. If they can't
+// be grouped, they're opened separately.
+{
+    fds[ COUNTER_CYCLES ] =
+        open_counter( PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1 );
+    int const leader = ( group ) ? fds[ COUNTER_CYCLES ] : -1;
+    fds[ COUNTER_INSTRUCTIONS ] =
+        open_counter( PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS,
+                      leader );
+    grouped = leader != -1 && fds[ COUNTER_INSTRUCTIONS ] != -1;
+    if ( fds[ COUNTER_INSTRUCTIONS ] == -1 && leader != -1 ) {
+        fds[ COUNTER_INSTRUCTIONS ] =
+            open_counter( PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS,
+                          -1 );
+    }
+}
+
+
+static
+void open_counters( void )
+// Opens every counter that we're allowed to. Only the cycles and
+// instructions are grouped: the other hardware counters are opened on
+// their own, since a larger group may not fit the counters of the core
+// (or of a virtual machine), and a group that can't be scheduled
+// counts nothing at all.
+{
+    open_cycles_and_instructions( true );
+    fds[ COUNTER_BRANCH_MISSES ] =
+        open_counter( PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, -1 );
+    fds[ COUNTER_L1D_MISSES ] =
+        open_counter( PERF_TYPE_HW_CACHE,
+                      cache_miss( PERF_COUNT_HW_CACHE_L1D ), -1 );
+    fds[ COUNTER_LLC_MISSES ] =
+        open_counter( PERF_TYPE_HW_CACHE,
+                      cache_miss( PERF_COUNT_HW_CACHE_LL ), -1 );
+    fds[ COUNTER_TASK_CLOCK ] =
+        open_counter( PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK, -1 );
+}
+
+
+static
+bool read_counter( int const fd, uint64_t * const value )
+// Reads the count of the given counter into `value`, scaled for the
+// time that it wasn't running, and returns whether that succeeded.
+// If the counter was enabled but never ran, because it couldn't be
+// scheduled, the group of the cycles and instructions is split, so
+// that they can be scheduled separately from then on.
+{
+    uint64_t buffer[ 3 ];    // the value, time enabled, and time running
+    if ( read( fd, buffer, sizeof buffer ) != sizeof buffer ) {
+        return false;
+    }
+    if ( buffer[ 2 ] == 0 ) {
+        if ( buffer[ 1 ] > 0 && grouped && fd == fds[ COUNTER_CYCLES ] ) {
+            close( fds[ COUNTER_INSTRUCTIONS ] );
+            close( fds[ COUNTER_CYCLES ] );
+            open_cycles_and_instructions( false );
+        }
+        return false;
+    }
+    *value = ( buffer[ 2 ] == buffer[ 1 ] )
+           ? buffer[ 0 ]
+           : ( uint64_t )( ( double ) buffer[ 0 ] * buffer[ 1 ]
+                                                  / buffer[ 2 ] );
+    return true;
+}
+
+#else // ifndef __linux__
+
+static
+void open_counters( void )
+{
+    for ( size_t k = 0; k < NELEM( fds ); k += 1 ) {
+        fds[ k ] = -1;
+    }
+}
+
+
+static
+bool read_counter( int const fd, uint64_t * const value )
+{
+    return false;
+}
+
+#endif // ifdef __linux__
+
+
+static
+bool read_thread_clock( uint64_t * const value )
+// Reads the CPU time of the calling thread in nanoseconds into `value`,
+// and returns whether that succeeded.
+{
+#ifdef CLOCK_THREAD_CPUTIME_ID
+    struct timespec ts;
+    if ( clock_gettime( CLOCK_THREAD_CPUTIME_ID, &ts ) == 0 ) {
+        *value = ( uint64_t ) ts.tv_sec * 1000000000 + ts.tv_nsec;
+        return true;
+    }
+#endif
+    return false;
+}
+
+
+static
+void close_counters( void )
+// Closes the calling thread's counters, if they're open.
+{
+    if ( opened ) {
+        for ( size_t k = 0; k < COUNTER_KINDS; k += 1 ) {
+            if ( fds[ k ] != -1 ) {
+                close( fds[ k ] );
+            }
+        }
+        opened = false;
+    }
+}
+
+
+static
+void on_thread_exit( void * const value )
+{
+    close_counters();
+}
+
+
+static
+void make_exit_key( void )
+{
+    pthread_key_create( &exit_key, on_thread_exit );
+}
+
+
+static
+Counters read_counters( void )
+// Returns the current totals of the calling thread's counters.
+{
+    if ( !opened ) {
+        open_counters();
+        opened = true;
+        // The destructor is only called for a non-`NULL` value.
+        pthread_once( &exit_key_once, make_exit_key );
+        pthread_setspecific( exit_key, &opened );
+    }
+    Counters c = { .values = { 0 } };
+    for ( size_t k = 0; k < COUNTER_KINDS; k += 1 ) {
+        c.measured[ k ] = ( fds[ k ] != -1 )
+                       && read_counter( fds[ k ], &c.values[ k ] );
+    }
+    if ( !c.measured[ COUNTER_TASK_CLOCK ] ) {
+        c.measured[ COUNTER_TASK_CLOCK ] =
+            read_thread_clock( &c.values[ COUNTER_TASK_CLOCK ] );
+    }
+    return c;
+}
+
+
+bool counters_are_available( void )
+{
+    Counters const c = read_counters();
+    for ( size_t k = 0; k < COUNTER_KINDS; k += 1 ) {
+        if ( k != COUNTER_TASK_CLOCK && c.measured[ k ] ) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+void counters_begin( void )
+{
+    assert( depth < NELEM( scopes ) );
+    scopes[ depth ] = read_counters();
+    depth += 1;
+}
+
+
+Counters counters_end( void )
+{
+    Counters const end = read_counters();
+    assert( depth > 0 );
+    depth -= 1;
+    Counters const begin = scopes[ depth ];
+    Counters c = { .values = { 0 } };
+    for ( size_t k = 0; k < COUNTER_KINDS; k += 1 ) {
+        // Scaling can make a multiplexed count go backwards.
+        c.measured[ k ] = begin.measured[ k ] && end.measured[ k ];
+        if ( c.measured[ k ] && end.values[ k ] > begin.values[ k ] ) {
+            c.values[ k ] = end.values[ k ] - begin.values[ k ];
+        }
+    }
+    return c;
+}
+
+
+void counters_close( void )
+{
+    assert( depth == 0 );
+    close_counters();
+}
+
+
+double counters_ipc( Counters const c )
+{
+    if ( !c.measured[ COUNTER_CYCLES ]
+      || !c.measured[ COUNTER_INSTRUCTIONS ]
+      || c.values[ COUNTER_CYCLES ] == 0 ) {
+        return 0;
+    }
+    return ( double ) c.values[ COUNTER_INSTRUCTIONS ]
+                    / c.values[ COUNTER_CYCLES ];
+}
+
+
+double counters_per_op( Counters const c, CounterKind const kind,
+                        size_t const ops )
+{
+    assert( kind < COUNTER_KINDS );
+    if ( !c.measured[ kind ] || ops == 0 ) {
+        return 0;
+    }
+    return ( double ) c.values[ kind ] / ops;
+}
+
+
+void counters_print_( struct counters_print_options const o )
+{
+    Counters const c = o.counters;
+    FILE * const file = ( o.file == NULL ) ? stdout : o.file;
+    double const ops = ( o.ops == 0 ) ? 1 : o.ops;
+
+    fprintf( file, "counters:  " );
+    bool any = false;
+    for ( size_t k = 0; k < COUNTER_KINDS; k += 1 ) {
+        if ( !c.measured[ k ] ) {
+            continue;
+        }
+        fprintf( file, "%s", any ? ", " : "" );
+        if ( k == COUNTER_TASK_CLOCK && o.ops == 0 ) {
+            fprintf( file, "%.3f ms %s", c.values[ k ] / 1e6,
+                     counter_names[ k ] );
+        } else if ( k == COUNTER_TASK_CLOCK ) {
+            fprintf( file, "%.1f ns %s/op", c.values[ k ] / ops,
+                     counter_names[ k ] );
+        } else if ( o.ops == 0 ) {
+            fprintf( file, "%llu %s", ( unsigned long long ) c.values[ k ],
+                     counter_names[ k ] );
+        } else {
+            fprintf( file, "%.1f %s/op", c.values[ k ] / ops,
+                     counter_names[ k ] );
+        }
+        if ( k == COUNTER_INSTRUCTIONS && counters_ipc( c ) != 0 ) {
+            fprintf( file, " (%.2f IPC)", counters_ipc( c ) );
+        }
+        any = true;
+    }
+    fprintf( file, "%s\n", any ? "" : "none measured" );
+}
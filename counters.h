@@ -0,0 +1,133 @@
+// counters.h
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef INCLUDED_TESTC_COUNTERS_H
+#define INCLUDED_TESTC_COUNTERS_H
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+
+// On Linux, the counters are the hardware performance counters of the
+// calling thread, opened by `perf_event_open()` and counting only
+// user-space events. If the kernel (or a container's seccomp policy)
+// doesn't allow that, the counters that couldn't be opened are just
+// not measured, and the task clock falls back to the CPU-time clock of
+// the thread. Elsewhere, only the task clock is measured, if the system
+// has a CPU-time clock for threads.
+//
+// Only the calling thread is counted: the work that it hands to other
+// threads, e.g. by `parallel_for()`, subtests, `stress_run()` or
+// `load_measure()`, isn't. Each thread opens its own counters, which
+// are closed when it exits.
+//
+// If the hardware has more events to count than it has counters for,
+// the kernel multiplexes them, and the counts are estimated by scaling.
+// The cycles and instructions are counted together, so that their
+// ratio is meaningful, unless they can't be scheduled together; then
+// they're counted separately from the next `counters_begin()` on.
+
+
+typedef enum CounterKind {
+    COUNTER_CYCLES,
+    COUNTER_INSTRUCTIONS,
+    COUNTER_BRANCH_MISSES,
+    COUNTER_L1D_MISSES,
+    COUNTER_LLC_MISSES,
+    COUNTER_TASK_CLOCK,     // in nanoseconds
+    COUNTER_KINDS
+} CounterKind;
+
+
+// The names of each kind of counter, for printing.
+extern char const * const counter_names[ COUNTER_KINDS ];
+
+
+// The counts of events between a `counters_begin()` and its
+// `counters_end()`.
+typedef struct Counters {
+
+    // The count of each kind of event.
+    uint64_t values[ COUNTER_KINDS ];
+
+    // Whether each kind of event was measured.
+    bool measured[ COUNTER_KINDS ];
+
+    // Invariants:
+    // - `values[ k ]` is `0` if `measured[ k ]` is `false`
+
+} Counters;
+
+
+// Returns `true` if any hardware counters can be measured for the
+// calling thread, and `false` otherwise.
+bool counters_are_available( void );
+
+
+// Starts counting events on the calling thread, until the corresponding
+// `counters_end()` on the same thread. These can be nested, up to
+// `counters_max_depth` deep.
+void counters_begin( void );
+
+
+// Stops counting events for the innermost `counters_begin()` of the
+// calling thread, and returns the counts since then.
+Counters counters_end( void );
+
+
+// How deeply `counters_begin()` calls can be nested on each thread.
+extern size_t const counters_max_depth;
+
+
+// Closes the counters opened for the calling thread. They'll be opened
+// again by the next `counters_begin()`. This can't be called between a
+// `counters_begin()` and its `counters_end()`.
+void counters_close( void );
+
+
+// Returns the instructions per cycle of the given counts, or `0` if
+// either wasn't measured or there were no cycles.
+double counters_ipc( Counters );
+
+
+// Returns the count of the given `kind` divided by `ops`, or `0` if it
+// wasn't measured or `ops` is `0`.
+double counters_per_op( Counters, CounterKind kind, size_t ops );
+
+
+struct counters_print_options {
+    Counters counters;
+    size_t ops;
+    FILE * file;
+};
+
+void counters_print_( struct counters_print_options );
+
+// Prints the measured `counters` on a single line to the `file` (or
+// `stdout` if `NULL`). If `ops` isn't `0`, the counts are printed per
+// operation, i.e. divided by `ops`. For example:
+//      counters:  5120 cycles, 8704 instructions (1.70 IPC), 0.004 ms task clock
+//      counters:  51.2 cycles/op, 87.0 instructions/op (1.70 IPC), 40.0 ns task clock/op
+#define counters_print( ... ) \
+    counters_print_( ( struct counters_print_options ){ __VA_ARGS__ } )
+
+
+#endif // ifndef INCLUDED_TESTC_COUNTERS_H
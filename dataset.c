@@ -0,0 +1,196 @@
+// dataset.c
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "dataset.h" // Dataset, DatasetRecord
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <assert.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "parallel.h" // parallel_for
+#include "_common.h" // untracked_*
+
+
+bool dataset_is_valid( Dataset const * const d )
+{
+    return d != NULL
+        && ( d->data == NULL ) == ( d->size == 0 )
+        && ( d->stride == 0 || d->offsets == NULL )
+        && ( d->stride == 0
+          || d->header + d->records * d->stride <= d->size );
+}
+
+
+void dataset_assert_valid( Dataset const * const d )
+{
+    assert( d != NULL );
+    assert( ( d->data == NULL ) == ( d->size == 0 ) );
+    assert( d->stride == 0 || d->offsets == NULL );
+    assert( d->stride == 0
+         || d->header + d->records * d->stride <= d->size );
+}
+
+
+static
+uint32_t read_length( uint8_t const * const p )
+// Returns the 32-bit little-endian integer at `p`.
+{
+    return ( uint32_t ) p[ 0 ]
+         | ( uint32_t ) p[ 1 ] << 8
+         | ( uint32_t ) p[ 2 ] << 16
+         | ( uint32_t ) p[ 3 ] << 24;
+}
+
+
+static
+bool index_records( Dataset * const d )
+// Finds the offset of each length-prefixed record of the given dataset,
+// and returns whether the last one is complete.
+{
+    size_t capacity = 0;
+    size_t offset = d->header;
+    while ( offset < d->size ) {
+        if ( d->size - offset < 4
+          || d->size - offset - 4 < read_length( d->data + offset ) ) {
+            return false;
+        }
+        if ( d->records == capacity ) {
+            capacity = ( capacity == 0 ) ? 1024 : capacity * 2;
+            d->offsets = untracked_realloc( d->offsets,
+                                            capacity * sizeof ( size_t ) );
+        }
+        d->offsets[ d->records ] = offset;
+        d->records += 1;
+        offset += 4 + read_length( d->data + offset );
+    }
+    return true;
+}
+
+
+Dataset * dataset_open_( struct dataset_open_options const o )
+{
+    assert( o.path != NULL );
+
+    int const fd = open( o.path, O_RDONLY );
+    struct stat st;
+    if ( fd < 0 ) {
+        return NULL;
+    } else if ( fstat( fd, &st ) != 0 || ( size_t ) st.st_size < o.header ) {
+        close( fd );
+        return NULL;
+    }
+    Dataset * const d = untracked_malloc( sizeof ( Dataset ) );
+    *d = ( Dataset ){ .size = st.st_size,
+                      .stride = o.stride,
+                      .header = o.header };
+    if ( d->size > 0 ) {
+        void * const map = mmap( NULL, d->size, PROT_READ, MAP_PRIVATE,
+                                 fd, 0 );
+        if ( map == MAP_FAILED ) {
+            close( fd );
+            untracked_free( d );
+            return NULL;
+        }
+        posix_madvise( map, d->size, POSIX_MADV_SEQUENTIAL );
+        d->data = map;
+    }
+    // The mapping holds its own reference to the file.
+    close( fd );
+
+    bool complete;
+    if ( d->stride != 0 ) {
+        d->records = ( d->size - d->header ) / d->stride;
+        complete = ( d->size - d->header ) % d->stride == 0;
+    } else {
+        complete = index_records( d );
+    }
+    if ( !complete ) {
+        dataset_close( d );
+        return NULL;
+    }
+    dataset_assert_valid( d );
+    return d;
+}
+
+
+void dataset_close( Dataset * const d )
+{
+    if ( d != NULL ) {
+        if ( d->data != NULL ) {
+            munmap( ( void * ) d->data, d->size );
+        }
+        untracked_free( d->offsets );
+        untracked_free( d );
+    }
+}
+
+
+DatasetRecord dataset_get( Dataset const * const d, size_t const index )
+{
+    assert( d != NULL );
+    assert( index < d->records );
+
+    if ( d->stride != 0 ) {
+        size_t const offset = d->header + index * d->stride;
+        return ( DatasetRecord ){ .index = index,
+                                  .offset = offset,
+                                  .data = d->data + offset,
+                                  .size = d->stride };
+    }
+    size_t const prefix = d->offsets[ index ];
+    return ( DatasetRecord ){ .index = index,
+                              .offset = prefix + 4,
+                              .data = d->data + prefix + 4,
+                              .size = read_length( d->data + prefix ) };
+}
+
+
+static
+void run_records( Assertions * const as,
+                  size_t const begin, size_t const end,
+                  void * const ctx )
+// Calls the body of the given `dataset_for_each()` options with each
+// record from `begin` up to `end`.
+{
+    struct dataset_for_each_options const * const o = ctx;
+    for ( size_t i = begin; i < end; i += 1 ) {
+        o->body( as, dataset_get( o->dataset, i ), o->ctx );
+    }
+}
+
+
+void dataset_for_each_( Assertions * const as,
+                        struct dataset_for_each_options o )
+{
+    assert( as != NULL );
+    dataset_assert_valid( o.dataset );
+    assert( o.body != NULL );
+
+    parallel_for( as, .end = o.dataset->records,
+                      .body = run_records,
+                      .ctx = &o,
+                      .threads = o.threads,
+                      .chunk = o.chunk );
+}
@@ -0,0 +1,148 @@
+// dataset.h
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef INCLUDED_TESTC_DATASET_H
+#define INCLUDED_TESTC_DATASET_H
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "assertions.h" // Assertions
+
+
+// A dataset is a file of test vectors that's mapped into memory, rather
+// than read, so that its records can be tested in place. The records
+// are either all `stride` bytes long, or each prefixed by its length as
+// a 32-bit little-endian integer. Either way, the records can start
+// after a `header` of some bytes, which is ignored.
+
+
+// A record of a dataset.
+typedef struct DatasetRecord {
+
+    // The position of the record in the dataset, from `0`.
+    size_t index;
+
+    // The offset of the record's data in the file, in bytes, which
+    // identifies the record in failures, e.g.:
+    //      assertions_add( as, decodes( r.data, r.size ), r.offset );
+    size_t offset;
+
+    // The record's data, in the mapping of the file.
+    uint8_t const * data;
+
+    // The size of the record's data, in bytes.
+    size_t size;
+
+} DatasetRecord;
+
+
+typedef struct Dataset {
+
+    // The mapping of the file, and its size.
+    uint8_t const * data;
+    size_t size;
+
+    // The size of each record, or `0` if they're length-prefixed.
+    size_t stride;
+
+    // The size of the header that precedes the records.
+    size_t header;
+
+    // How many records there are.
+    size_t records;
+
+    // If the records are length-prefixed, the offset of each record's
+    // length prefix, found when the dataset is opened; otherwise `NULL`.
+    size_t * offsets;
+
+    // Invariants:
+    // - `data` is `NULL` if and only if `size` is `0`
+    // - `offsets` is `NULL` if `stride` is not `0`
+    // - `header + records * stride <= size`, if `stride` is not `0`
+
+} Dataset;
+
+
+// Returns `true` if the invariants hold for the given `Dataset`, or
+// `false` if some don't.
+bool dataset_is_valid( Dataset const * dataset );
+
+
+// Asserts that the invariants hold for the given `Dataset`.
+void dataset_assert_valid( Dataset const * dataset );
+
+
+struct dataset_open_options {
+    char const * path;
+    size_t stride;
+    size_t header;
+};
+
+Dataset * dataset_open_( struct dataset_open_options );
+
+// Maps the file at the given `path` into memory, advises the system
+// that it'll be read sequentially, and returns a new `Dataset` of it
+// with records of `stride` bytes (or length-prefixed, if `0`) after a
+// `header` of some bytes. Returns `NULL` if the file couldn't be
+// mapped, or if its last record is cut short. For example:
+//      Dataset * const d = dataset_open( .path = "vectors.bin",
+//                                        .stride = 64 );
+#define dataset_open( ... ) \
+    dataset_open_( ( struct dataset_open_options ){ __VA_ARGS__ } )
+
+
+// Unmaps the file of the given `Dataset` and frees it. The data of its
+// records can't be used afterwards.
+void dataset_close( Dataset * dataset );
+
+
+// Returns the record at the given `index` of the given `Dataset`, which
+// should be less than its number of `records`.
+DatasetRecord dataset_get( Dataset const * dataset, size_t index );
+
+
+typedef void ( * dataset_body )( Assertions * assertions,
+                                 DatasetRecord record, void * ctx );
+
+
+struct dataset_for_each_options {
+    Dataset const * dataset;
+    dataset_body body;
+    void * ctx;
+    size_t threads;
+    size_t chunk;
+};
+
+void dataset_for_each_( Assertions * assertions,
+                        struct dataset_for_each_options );
+
+// Calls the given `body` with each record of the given `dataset`, split
+// across threads as by `parallel_for()` with the given `threads` and
+// `chunk` (see `parallel.h`), so the assertions are added to the given
+// `Assertions` in the order of the records. For example:
+//      dataset_for_each( as, .dataset = d, .body = check_vector );
+#define dataset_for_each( ASSERTIONS, ... ) \
+    dataset_for_each_( ASSERTIONS, ( struct dataset_for_each_options ){ \
+        __VA_ARGS__ \
+    } )
+
+
+#endif // ifndef INCLUDED_TESTC_DATASET_H
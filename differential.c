@@ -0,0 +1,228 @@
+// differential.c
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "differential.h" // DifferentialStats, differential_*
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <math.h>
+#include <assert.h>
+
+#include "assertion.h" // assertion_new_
+#include "bench.h" // bench_now_ns
+#include "parallel.h" // parallel_for
+#include "property.h" // PropertyRng, property_rng_*, property_default_seed
+#include "_common.h" // MIN, untracked_*, print_duration
+
+
+double differential_speedup( DifferentialStats const stats )
+{
+    return ( stats.candidate_ns == 0 )
+         ? 0 : ( double ) stats.reference_ns / stats.candidate_ns;
+}
+
+
+// The state shared by the threads of a differential test.
+struct differential {
+    struct differential_run_options const * o;
+    atomic_size_t mismatches;
+    atomic_uint_least64_t reference_ns;
+    atomic_uint_least64_t candidate_ns;
+};
+
+
+static
+void random_input( uint64_t const seed, size_t const index,
+                   uint8_t * const input, size_t const size )
+// Fills the given `input` with random bytes for the given `index`.
+{
+    PropertyRng rng = property_rng_new( seed + index );
+    for ( size_t i = 0; i < size; i += sizeof ( uint64_t ) ) {
+        uint64_t const x = property_rng_next( &rng );
+        memcpy( input + i, &x, MIN( sizeof x, size - i ) );
+    }
+}
+
+
+static
+uint64_t time_batch( struct differential_run_options const * const o,
+                     differential_fn const func,
+                     uint8_t const * const inputs,
+                     uint8_t * const outputs,
+                     size_t const begin, size_t const end )
+// Runs the given `func` on the inputs from `begin` up to `end`, and
+// returns how many nanoseconds that took.
+{
+    uint64_t const start = bench_now_ns();
+    for ( size_t i = begin; i < end; i += 1 ) {
+        uint8_t * const output = outputs + ( i - begin ) * o->output_size;
+        if ( o->dataset != NULL ) {
+            DatasetRecord const r = dataset_get( o->dataset, i );
+            func( r.data, r.size, output, o->ctx );
+        } else {
+            func( inputs + ( i - begin ) * o->input_size, o->input_size,
+                  output, o->ctx );
+        }
+    }
+    return bench_now_ns() - start;
+}
+
+
+static
+void compare_batch( Assertions * const as, size_t const begin,
+                    size_t const end, void * const ctx )
+// Runs both implementations on the inputs from `begin` up to `end`, and
+// adds an evaluation of whether their outputs are equal for each.
+{
+    struct differential * const d = ctx;
+    struct differential_run_options const * const o = d->o;
+    size_t const n = end - begin;
+    uint8_t * inputs = NULL;
+    if ( o->dataset == NULL ) {
+        inputs = untracked_malloc( MAX( n * o->input_size, 1 ) );
+        for ( size_t i = begin; i < end; i += 1 ) {
+            uint8_t * const input = inputs + ( i - begin ) * o->input_size;
+            if ( o->gen != NULL ) {
+                o->gen( i, input, o->input_size, o->ctx );
+            } else {
+                random_input( o->seed, i, input, o->input_size );
+            }
+        }
+    }
+    uint8_t * const expected = untracked_calloc( MAX( n, 1 ),
+                                                 o->output_size );
+    uint8_t * const actual = untracked_calloc( MAX( n, 1 ), o->output_size );
+
+    // Alternate which goes first, so neither always has a warm cache.
+    uint64_t reference_ns;
+    uint64_t candidate_ns;
+    if ( ( begin / o->batch ) % 2 == 0 ) {
+        reference_ns = time_batch( o, o->reference, inputs, expected,
+                                   begin, end );
+        candidate_ns = time_batch( o, o->candidate, inputs, actual,
+                                   begin, end );
+    } else {
+        candidate_ns = time_batch( o, o->candidate, inputs, actual,
+                                   begin, end );
+        reference_ns = time_batch( o, o->reference, inputs, expected,
+                                   begin, end );
+    }
+    atomic_fetch_add( &d->reference_ns, reference_ns );
+    atomic_fetch_add( &d->candidate_ns, candidate_ns );
+
+    size_t mismatches = 0;
+    for ( size_t i = begin; i < end; i += 1 ) {
+        size_t const offset = ( i - begin ) * o->output_size;
+        bool const equal = ( o->eq != NULL )
+            ? o->eq( expected + offset, actual + offset, o->output_size,
+                     o->ctx )
+            : memcmp( expected + offset, actual + offset,
+                      o->output_size ) == 0;
+        mismatches += !equal;
+        assertions_add_at_( as, ( struct assertions_add_at_options ){
+            .file = o->file,
+            .line = o->line,
+            .expr = o->expr,
+            .result = equal,
+            .ids = ( AssertionId[] ){
+                { .expr = "input", .value = ( long long ) i },
+                ASSERTION_ID_ARRAY_END
+            }
+        } );
+    }
+    atomic_fetch_add( &d->mismatches, mismatches );
+    untracked_free( inputs );
+    untracked_free( expected );
+    untracked_free( actual );
+}
+
+
+DifferentialStats differential_run_( Assertions * const as,
+                                     struct differential_run_options o )
+{
+    assert( as != NULL );
+    assert( o.expr != NULL );
+    assert( o.reference != NULL );
+    assert( o.candidate != NULL );
+    assert( o.dataset != NULL || o.input_size > 0 );
+
+    if ( o.dataset != NULL ) {
+        o.inputs = o.dataset->records;
+    }
+    o.seed = ( o.seed == 0 ) ? property_default_seed() : o.seed;
+    o.batch = ( o.batch == 0 ) ? 1024 : o.batch;
+
+    struct differential d = { .o = &o };
+    atomic_init( &d.mismatches, 0 );
+    atomic_init( &d.reference_ns, 0 );
+    atomic_init( &d.candidate_ns, 0 );
+    parallel_for( as, .end = o.inputs, .body = compare_batch, .ctx = &d,
+                      .threads = o.threads, .chunk = o.batch );
+    DifferentialStats const stats = {
+        .inputs = o.inputs,
+        .mismatches = atomic_load( &d.mismatches ),
+        .reference_ns = atomic_load( &d.reference_ns ),
+        .candidate_ns = atomic_load( &d.candidate_ns ),
+        .seed = ( o.dataset == NULL && o.gen == NULL ) ? o.seed : 0
+    };
+
+    if ( o.min_speedup != 0 ) {
+        double const speedup = differential_speedup( stats );
+        assertions_add_ptr( as, assertion_new_(
+            ( struct assertion_new_options ){
+                .expr = ( o.speed_expr == NULL ) ? o.expr : o.speed_expr,
+                .result = speedup >= o.min_speedup,
+                .ids = ( AssertionId[] ){
+                    { .expr = "reference_ns",
+                      .value = ( long long ) stats.reference_ns },
+                    { .expr = "candidate_ns",
+                      .value = ( long long ) stats.candidate_ns },
+                    { .expr = "speedup_percent",
+                      .value = llround( 100 * speedup ) },
+                    ASSERTION_ID_ARRAY_END
+                }
+            } ) );
+    }
+    return stats;
+}
+
+
+void differential_stats_print_(
+    struct differential_stats_print_options const o )
+{
+    DifferentialStats const s = o.stats;
+    FILE * const file = ( o.file == NULL ) ? stdout : o.file;
+
+    fprintf( file, "differential:  %zu input%s, %zu mismatch%s, "
+                   "%.2fx as fast (reference ",
+             s.inputs, ( s.inputs == 1 ) ? "" : "s",
+             s.mismatches, ( s.mismatches == 1 ) ? "" : "es",
+             differential_speedup( s ) );
+    print_duration( file, s.reference_ns );
+    fprintf( file, ", candidate " );
+    print_duration( file, s.candidate_ns );
+    fprintf( file, ")" );
+    if ( s.seed != 0 ) {
+        fprintf( file, ", seed %llu", ( unsigned long long ) s.seed );
+    }
+    fprintf( file, "\n" );
+}
@@ -0,0 +1,162 @@
+// differential.h
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+
+#ifndef INCLUDED_TESTC_DIFFERENTIAL_H
+#define INCLUDED_TESTC_DIFFERENTIAL_H
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "assertions.h" // Assertions
+#include "dataset.h" // Dataset
+
+
+// Differential testing runs two implementations of the same function,
+// a reference and a candidate (e.g. an optimized rewrite), on the same
+// inputs, and asserts that their outputs are equal. It times both while
+// it's at it, so that one run tells whether the candidate is correct
+// and how much faster it is.
+
+
+// An implementation under test: writes its output for the given input
+// of `input_size` bytes to `output`.
+typedef void ( * differential_fn )( void const * input, size_t input_size,
+                                    void * output, void * ctx );
+
+
+// Writes the input of the given `index` to `input`, which has room for
+// `input_size` bytes.
+typedef void ( * differential_gen )( size_t index, void * input,
+                                     size_t input_size, void * ctx );
+
+
+// Returns `true` if the given outputs of `output_size` bytes are
+// equivalent.
+typedef bool ( * differential_eq )( void const * expected,
+                                    void const * actual,
+                                    size_t output_size, void * ctx );
+
+
+// The results of a differential test.
+typedef struct DifferentialStats {
+
+    // How many inputs both implementations were run on.
+    size_t inputs;
+
+    // How many of those inputs they gave different outputs for.
+    size_t mismatches;
+
+    // The total time that each implementation took over every input,
+    // summed over the threads, in nanoseconds.
+    uint64_t reference_ns;
+    uint64_t candidate_ns;
+
+    // The seed of the random inputs, to replay them with, or `0` if the
+    // inputs weren't random.
+    uint64_t seed;
+
+} DifferentialStats;
+
+
+// Returns how many times as fast as the reference the candidate was,
+// e.g. `4.0` if it took a quarter of the time.
+double differential_speedup( DifferentialStats );
+
+
+struct differential_run_options {
+    char const * file;
+    int line;
+    char const * expr;
+    char const * speed_expr;
+    differential_fn reference;
+    differential_fn candidate;
+    void * ctx;
+    size_t inputs;
+    size_t input_size;
+    size_t output_size;
+    differential_gen gen;
+    Dataset const * dataset;
+    uint64_t seed;
+    differential_eq eq;
+    double min_speedup;
+    size_t threads;
+    size_t batch;
+};
+
+DifferentialStats differential_run_( Assertions * assertions,
+                                     struct differential_run_options );
+
+// Takes an `Assertions *`, two `differential_fn` expressions, and some
+// options, runs both functions on the same inputs, and returns their
+// `DifferentialStats`. An evaluation of whether the outputs of each
+// input are equal, as by the `eq` comparator (or `memcmp()` if `NULL`)
+// on `output_size` bytes, is added to the given `Assertions`, identified
+// by the index of the input. For example:
+//      assertions_add_differential( as, sum_scalar, sum_simd,
+//          .inputs = 1000000, .input_size = 64 * sizeof ( float ),
+//          .output_size = sizeof ( float ), .eq = floats_are_close );
+//
+// The inputs are the records of the given `dataset`, or if that's
+// `NULL`, `inputs` inputs of `input_size` bytes, made by the `gen`
+// function, or random bytes from `seed` (or `property_default_seed()`
+// if `0`; see `property.h`) if that's `NULL`. They're split into batches
+// of `batch` inputs (or `1024` if `0`) across `threads` threads (or
+// `parallel_default_threads()` if `0`; see `parallel.h`). Each batch is
+// run through one function, then the other, and the time of each is
+// added to its total; which function goes first alternates between
+// batches, so that neither always runs on a warm cache.
+//
+// If `min_speedup` isn't `0`, an assertion that the candidate was at
+// least that many times as fast as the reference is also added,
+// identified by the total times and the speedup as a percentage.
+#define assertions_add_differential( ASSERTIONS, REFERENCE, CANDIDATE, ... ) \
+    differential_run_( ASSERTIONS, ( struct differential_run_options ){ \
+        .file = __FILE__, \
+        .line = __LINE__, \
+        .expr = #CANDIDATE "( input ) equals " #REFERENCE "( input )", \
+        .speed_expr = #CANDIDATE " is at least min_speedup times as " \
+                      "fast as " #REFERENCE, \
+        .reference = REFERENCE, \
+        .candidate = CANDIDATE, \
+        __VA_ARGS__ \
+    } )
+
+
+struct differential_stats_print_options {
+    DifferentialStats stats;
+    FILE * file;
+};
+
+void differential_stats_print_( struct differential_stats_print_options );
+
+// Prints the given `stats` on a single line to the `file` (or `stdout`
+// if `NULL`), with the seed of random inputs, which `$TESTC_SEED`
+// replays. For example (wrapped here):
+//      differential:  100000 inputs, 0 mismatches, 3.52x as fast
+//                     (reference 41.2 ms, candidate 11.7 ms), seed 42
+#define differential_stats_print( ... ) \
+    differential_stats_print_( ( struct differential_stats_print_options ){ \
+        __VA_ARGS__ \
+    } )
+
+
+#endif // ifndef INCLUDED_TESTC_DIFFERENTIAL_H
@@ -0,0 +1,125 @@
+// fixture.c
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "fixture.h" // Fixture
+
+#include <stdlib.h>
+#include <assert.h>
+
+#include <pthread.h>
+
+#include "heap.h" // heap_pause, heap_resume
+#include "test.h" // test_is_forked
+#include "_common.h" // untracked_*
+
+
+// The fixtures that are set up, in the order they were set up, guarded
+// by `registry_lock`.
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static Fixture * * registry = NULL;
+static size_t registry_size = 0;
+static size_t registry_capacity = 0;
+
+
+static
+void register_fixture( Fixture * const fixture )
+{
+    pthread_mutex_lock( &registry_lock );
+    if ( registry_size == registry_capacity ) {
+        registry_capacity = ( registry_capacity == 0 )
+                          ? 8 : registry_capacity * 2;
+        registry = untracked_realloc( registry,
+                       registry_capacity * sizeof ( Fixture * ) );
+    }
+    registry[ registry_size ] = fixture;
+    registry_size += 1;
+    pthread_mutex_unlock( &registry_lock );
+}
+
+
+void const * fixture_get( Fixture * const fixture )
+{
+    assert( fixture != NULL );
+    assert( fixture->setup != NULL );
+
+    pthread_mutex_lock( &fixture->lock );
+    if ( !fixture->ready ) {
+        heap_pause();
+        fixture->value = fixture->setup();
+        heap_resume();
+        fixture->ready = true;
+        register_fixture( fixture );
+    }
+    void * const value = fixture->value;
+    pthread_mutex_unlock( &fixture->lock );
+    return value;
+}
+
+
+void * fixture_get_snapshot( Fixture * const fixture )
+{
+    assert( test_is_forked() );
+    return ( void * ) fixture_get( fixture );
+}
+
+
+bool fixture_is_ready( Fixture * const fixture )
+{
+    assert( fixture != NULL );
+
+    pthread_mutex_lock( &fixture->lock );
+    bool const ready = fixture->ready;
+    pthread_mutex_unlock( &fixture->lock );
+    return ready;
+}
+
+
+size_t fixtures_mark( void )
+{
+    pthread_mutex_lock( &registry_lock );
+    size_t const mark = registry_size;
+    pthread_mutex_unlock( &registry_lock );
+    return mark;
+}
+
+
+void fixtures_teardown_to( size_t const mark )
+{
+    while ( true ) {
+        pthread_mutex_lock( &registry_lock );
+        if ( registry_size <= mark ) {
+            pthread_mutex_unlock( &registry_lock );
+            return;
+        }
+        registry_size -= 1;
+        Fixture * const fixture = registry[ registry_size ];
+        pthread_mutex_unlock( &registry_lock );
+
+        // Don't hold the registry lock while tearing down, in case the
+        // teardown gets another fixture.
+        pthread_mutex_lock( &fixture->lock );
+        if ( fixture->teardown != NULL ) {
+            heap_pause();
+            fixture->teardown( fixture->value );
+            heap_resume();
+        }
+        fixture->value = NULL;
+        fixture->ready = false;
+        pthread_mutex_unlock( &fixture->lock );
+    }
+}
@@ -0,0 +1,101 @@
+// fixture.h
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef INCLUDED_TESTC_FIXTURE_H
+#define INCLUDED_TESTC_FIXTURE_H
+
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <pthread.h>
+
+
+// A fixture is an expensive value that many tests share read-only, e.g.
+// a large lookup table. It's set up lazily, by the first `fixture_get()`
+// of any thread, and it's torn down at the end of the `tests_run()`
+// call that set it up, so it's shared by every test of that call
+// (including those run by other threads).
+//
+// Fixtures have to be modifiable, so declare them without `const`:
+//      static Fixture table = FIXTURE( make_table, free_table );
+typedef struct Fixture {
+
+    // Used for displaying the fixture.
+    char const * name;
+
+    // Makes and returns the value of the fixture.
+    void * ( * setup )( void );
+
+    // If not `NULL`, frees the value of the fixture.
+    void ( * teardown )( void * value );
+
+    // The rest is the state of the fixture, which should only be used
+    // through the functions below.
+    pthread_mutex_t lock;
+    bool ready;
+    void * value;
+
+    // Invariants:
+    // - `name` and `setup` are not `NULL`
+    // - `value` is `NULL` if `ready` is `false`
+
+} Fixture;
+
+
+// Evaluates to a literal `Fixture` with the given setup and teardown
+// function expressions.
+#define FIXTURE( SETUP, TEARDOWN ) \
+    { .name = #SETUP, \
+      .setup = SETUP, \
+      .teardown = TEARDOWN, \
+      .lock = PTHREAD_MUTEX_INITIALIZER }
+
+
+// Returns the value of the given fixture, setting it up first if it
+// isn't already. This is safe to call from multiple threads at once:
+// only one will set it up, and the others will wait for it. A fixture's
+// `setup` may get other fixtures. Its allocations aren't counted in the
+// heap usage of the calling test.
+void const * fixture_get( Fixture * fixture );
+
+
+// Like `fixture_get()`, but returns a value that the caller may modify.
+// This can only be called in a test that `test_run()` forked, where the
+// value is the caller's own copy-on-write snapshot of a fixture that
+// was set up before the fork (see `tests_run()`).
+void * fixture_get_snapshot( Fixture * fixture );
+
+
+// Returns `true` if the given fixture has been set up and not yet torn
+// down, and `false` otherwise.
+bool fixture_is_ready( Fixture * fixture );
+
+
+// Returns a mark of the fixtures that are currently set up, to pass to
+// `fixtures_teardown_to()`. `tests_run()` takes one when it starts.
+size_t fixtures_mark( void );
+
+
+// Tears down every fixture that was set up after the given `mark` was
+// taken, in the reverse order of their setup. `tests_run()` calls this
+// before it returns.
+void fixtures_teardown_to( size_t mark );
+
+
+#endif // ifndef INCLUDED_TESTC_FIXTURE_H
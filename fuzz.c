@@ -0,0 +1,653 @@
+// fuzz.c
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "fuzz.h" // FuzzStats, fuzz_fn
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <signal.h>
+#include <errno.h>
+#include <assert.h>
+
+#include <pthread.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "assertion.h" // assertion_new_
+#include "heap.h" // heap_pause, heap_resume
+#include "parallel.h" // parallel_default_threads
+#include "property.h" // PropertyRng, property_rng_*, property_default_seed
+#include "_common.h" // MIN, untracked_*
+
+
+// The size of a map of covered edges, which edges are hashed into.
+#define MAP_SIZE 65536
+
+
+// The map of the edges covered by the input that this thread is
+// running, or `NULL` if it isn't running one.
+static _Thread_local uint8_t * coverage = NULL;
+
+
+#ifdef TESTC_FUZZ
+
+
+#if defined( __clang__ )
+#define NO_COVERAGE __attribute__(( no_sanitize( "coverage" ) ))
+#else
+#define NO_COVERAGE __attribute__(( no_sanitize_coverage ))
+#endif
+
+
+// The last location that this thread covered, to make edges of pairs
+// of locations, in the fashion of AFL.
+static _Thread_local uintptr_t previous = 0;
+
+
+NO_COVERAGE static
+void cover( uintptr_t const location )
+// Marks the edge from the previous location to this one as covered.
+{
+    uintptr_t const here = ( location * 0x9e3779b97f4a7c15ULL ) >> 48;
+    coverage[ ( here ^ previous ) % MAP_SIZE ] = 1;
+    previous = here >> 1;
+}
+
+
+NO_COVERAGE
+void __sanitizer_cov_trace_pc_guard_init( uint32_t * start,
+                                          uint32_t * stop );
+NO_COVERAGE
+void __sanitizer_cov_trace_pc_guard( uint32_t * guard );
+NO_COVERAGE
+void __sanitizer_cov_trace_pc( void );
+
+
+// Called by Clang's `trace-pc-guard` as each module is loaded, which
+// happens before there are any other threads.
+NO_COVERAGE
+void __sanitizer_cov_trace_pc_guard_init( uint32_t * const start,
+                                          uint32_t * const stop )
+{
+    static uint32_t next = 0;
+    for ( uint32_t * g = start; g < stop; g += 1 ) {
+        if ( *g == 0 ) {
+            next += 1;
+            *g = next;
+        }
+    }
+}
+
+
+// Called by Clang's `trace-pc-guard` at each edge.
+NO_COVERAGE
+void __sanitizer_cov_trace_pc_guard( uint32_t * const guard )
+{
+    if ( coverage != NULL ) {
+        cover( *guard );
+    }
+}
+
+
+// Called by GCC's `trace-pc` at each basic block.
+NO_COVERAGE
+void __sanitizer_cov_trace_pc( void )
+{
+    if ( coverage != NULL ) {
+        cover( ( uintptr_t ) __builtin_return_address( 0 ) );
+    }
+}
+
+
+bool fuzz_is_guided( void )
+{
+    return true;
+}
+
+
+#else // ifndef TESTC_FUZZ
+
+
+bool fuzz_is_guided( void )
+{
+    return false;
+}
+
+
+#endif // ifdef TESTC_FUZZ
+
+
+// An input of the corpus.
+struct input {
+    uint8_t * data;
+    size_t size;
+};
+
+
+// The state shared by the threads of a `fuzz_run()`. Everything after
+// `lock` is guarded by it.
+struct fuzzer {
+    struct fuzz_run_options o;
+    char const * artifacts;
+    atomic_size_t runs;
+    atomic_bool stop;
+    pthread_mutex_t lock;
+    struct input * corpus;
+    size_t corpus_size;
+    size_t corpus_capacity;
+    uint8_t seen[ MAP_SIZE ];
+    size_t edges;
+    size_t failures;
+    char reproducer[ 256 ];
+};
+
+
+// The input that this thread is running, for the crash handler.
+static _Thread_local uint8_t const * running = NULL;
+static _Thread_local size_t running_size = 0;
+
+// The directory that the crash handler saves this thread's input in.
+static _Thread_local char const * artifacts = NULL;
+
+
+static
+uint64_t hash( uint8_t const * const data, size_t const size )
+// Returns the 64-bit FNV-1a hash of the given data.
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for ( size_t i = 0; i < size; i += 1 ) {
+        h = ( h ^ data[ i ] ) * 0x100000001b3ULL;
+    }
+    return h;
+}
+
+
+static
+size_t name_input( char * const buffer, size_t const capacity,
+                   char const * const dir, char const * const prefix,
+                   uint8_t const * const data, size_t const size )
+// Writes the path of the given input in the given directory, with the
+// given prefix, to the `buffer`, and returns its length, or `0` if it
+// didn't fit. This is async-signal-safe, for the crash handler.
+{
+    size_t const dir_length = strlen( dir );
+    size_t const prefix_length = strlen( prefix );
+    if ( dir_length + 1 + prefix_length + 16 + 1 > capacity ) {
+        return 0;
+    }
+    size_t n = 0;
+    memcpy( buffer, dir, dir_length );
+    n += dir_length;
+    buffer[ n ] = '/';
+    n += 1;
+    memcpy( buffer + n, prefix, prefix_length );
+    n += prefix_length;
+    uint64_t const h = hash( data, size );
+    for ( int i = 15; i >= 0; i -= 1 ) {
+        buffer[ n ] = "0123456789abcdef"[ ( h >> ( i * 4 ) ) & 0xf ];
+        n += 1;
+    }
+    buffer[ n ] = '\0';
+    return n;
+}
+
+
+static
+bool save_input( char * const path, size_t const capacity,
+                 char const * const dir, char const * const prefix,
+                 uint8_t const * const data, size_t const size )
+// Saves the given input in the given directory, and gives its path via
+// `path`. Returns whether that succeeded. This is async-signal-safe.
+{
+    if ( name_input( path, capacity, dir, prefix, data, size ) == 0 ) {
+        return false;
+    }
+    int const fd = open( path, O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+    if ( fd < 0 ) {
+        return false;
+    }
+    size_t written = 0;
+    while ( written < size ) {
+        ssize_t const n = write( fd, data + written, size - written );
+        if ( n <= 0 ) {
+            break;
+        }
+        written += n;
+    }
+    close( fd );
+    return written == size;
+}
+
+
+// The signals that we save the running input for.
+static int const crash_signals[] = { SIGSEGV, SIGBUS, SIGFPE, SIGILL,
+                                     SIGABRT };
+
+
+static
+void on_crash( int const signal )
+// Saves the input that the crashing thread was running, and then
+// raises the signal again, which the default action handles.
+{
+    if ( running != NULL ) {
+        char message[ 256 ] = "fuzz: saved crash to ";
+        size_t const prefix = strlen( message );
+        if ( save_input( message + prefix, sizeof message - prefix - 1,
+                         artifacts, "crash-", running, running_size ) ) {
+            size_t const length = strlen( message );
+            message[ length ] = '\n';
+            ssize_t const written = write( STDERR_FILENO, message,
+                                           length + 1 );
+            ( void ) written;
+        }
+    }
+    raise( signal );
+}
+
+
+static
+void add_to_corpus( struct fuzzer * const f, uint8_t const * const data,
+                    size_t const size )
+// Adds a copy of the given input to the corpus. The caller should hold
+// the lock.
+{
+    if ( f->corpus_size == f->corpus_capacity ) {
+        f->corpus_capacity = ( f->corpus_capacity == 0 )
+                           ? 64 : f->corpus_capacity * 2;
+        f->corpus = untracked_realloc( f->corpus,
+            f->corpus_capacity * sizeof ( struct input ) );
+    }
+    uint8_t * const copy = untracked_malloc( MAX( size, 1 ) );
+    if ( size > 0 ) {
+        memcpy( copy, data, size );
+    }
+    f->corpus[ f->corpus_size ] = ( struct input ){ .data = copy,
+                                                    .size = size };
+    f->corpus_size += 1;
+}
+
+
+static
+void load_corpus( struct fuzzer * const f )
+// Adds the files of the corpus directory to the corpus, creating the
+// directory if it doesn't exist. Failures and crashes that were saved
+// there aren't added, lest they fail the run again.
+{
+    heap_pause();
+    DIR * const dir = opendir( f->o.corpus );
+    if ( dir == NULL && errno == ENOENT ) {
+        mkdir( f->o.corpus, 0755 );
+    }
+    uint8_t * const buffer = untracked_malloc( f->o.max_size );
+    struct dirent const * entry;
+    while ( dir != NULL && ( entry = readdir( dir ) ) != NULL ) {
+        if ( entry->d_name[ 0 ] == '.'
+          || strncmp( entry->d_name, "fail-", 5 ) == 0
+          || strncmp( entry->d_name, "crash-", 6 ) == 0 ) {
+            continue;
+        }
+        char path[ 512 ];
+        snprintf( path, sizeof path, "%s/%s", f->o.corpus, entry->d_name );
+        FILE * const file = fopen( path, "rb" );
+        if ( file != NULL ) {
+            size_t const size = fread( buffer, 1, f->o.max_size, file );
+            fclose( file );
+            add_to_corpus( f, buffer, size );
+        }
+    }
+    if ( dir != NULL ) {
+        closedir( dir );
+    }
+    untracked_free( buffer );
+    heap_resume();
+}
+
+
+static
+uint8_t interesting_byte( PropertyRng * const rng )
+{
+    static uint8_t const bytes[] = { 0x00, 0x01, 0x7f, 0x80, 0xff, '0',
+                                     '\n', ' ', '"', '\\', '{', '<' };
+    return bytes[ property_rng_next( rng ) % sizeof bytes ];
+}
+
+
+static
+size_t mutate( PropertyRng * const rng, uint8_t * const data,
+               size_t size, size_t const max_size )
+// Applies a random mutation to the given input of `size` bytes, with
+// room for `max_size`, and returns its new size.
+{
+    uint64_t const r = property_rng_next( rng );
+    size_t const at = ( size == 0 ) ? 0 : ( r >> 8 ) % size;
+    switch ( ( size == 0 ) ? 4 : r % 7 ) {
+    case 0:
+        data[ at ] ^= 1 << ( ( r >> 40 ) % 8 );
+        break;
+    case 1:
+        data[ at ] = r >> 40;
+        break;
+    case 2:
+        data[ at ] = interesting_byte( rng );
+        break;
+    case 3:
+        data[ at ] += ( int ) ( ( r >> 40 ) % 35 ) - 17;
+        break;
+    case 4:
+        if ( size < max_size ) {
+            size_t const pos = ( size == 0 ) ? 0 : at + ( r >> 60 ) % 2;
+            memmove( data + pos + 1, data + pos, size - pos );
+            data[ pos ] = ( r & 0x100 ) ? interesting_byte( rng ) : r >> 40;
+            size += 1;
+        }
+        break;
+    case 5: {
+        size_t const n = 1 + ( r >> 40 ) % MIN( size - at, 16 );
+        memmove( data + at, data + at + n, size - at - n );
+        size -= n;
+        break;
+    }
+    case 6: {
+        // Copy a chunk of the input over another part of it.
+        size_t const from = ( r >> 24 ) % size;
+        size_t const n = 1 + ( r >> 40 ) % MIN( size - MAX( at, from ), 32 );
+        memmove( data + at, data + from, n );
+        break;
+    }
+    default:
+        break;
+    }
+    return size;
+}
+
+
+static
+size_t pick( struct fuzzer * const f, PropertyRng * const rng,
+             uint8_t * const data )
+// Copies a random input of the corpus to `data`, sometimes spliced with
+// another, and returns its size.
+{
+    pthread_mutex_lock( &f->lock );
+    struct input const a = f->corpus[ property_rng_next( rng )
+                                      % f->corpus_size ];
+    struct input const b = f->corpus[ property_rng_next( rng )
+                                      % f->corpus_size ];
+    size_t size = MIN( a.size, f->o.max_size );
+    memcpy( data, a.data, size );
+    if ( property_rng_next( rng ) % 8 == 0 && b.size > 0 ) {
+        size_t const cut = ( size == 0 ) ? 0 : property_rng_next( rng ) % size;
+        size_t const from = property_rng_next( rng ) % b.size;
+        size_t const n = MIN( b.size - from, f->o.max_size - cut );
+        memcpy( data + cut, b.data + from, n );
+        size = cut + n;
+    }
+    pthread_mutex_unlock( &f->lock );
+    return size;
+}
+
+
+static
+bool covers_new_edge( uint8_t const * const map, uint8_t const * const known )
+// Returns `true` if the given coverage map has an edge that isn't
+// `known`.
+{
+    for ( size_t i = 0; i < MAP_SIZE; i += sizeof ( uint64_t ) ) {
+        uint64_t m;
+        uint64_t k;
+        memcpy( &m, map + i, sizeof m );
+        memcpy( &k, known + i, sizeof k );
+        if ( ( m & ~k ) != 0 ) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+static
+void learn( struct fuzzer * const f, uint8_t const * const map,
+            uint8_t * const known, uint8_t const * const data,
+            size_t const size )
+// Adds the given input to the corpus if it covers an edge that no other
+// input has, and updates this thread's `known` edges.
+{
+    pthread_mutex_lock( &f->lock );
+    bool added = false;
+    for ( size_t i = 0; i < MAP_SIZE; i += 1 ) {
+        if ( map[ i ] != 0 && f->seen[ i ] == 0 ) {
+            f->seen[ i ] = 1;
+            f->edges += 1;
+            added = true;
+        }
+    }
+    memcpy( known, f->seen, MAP_SIZE );
+    if ( added ) {
+        add_to_corpus( f, data, size );
+        if ( f->o.corpus != NULL ) {
+            char path[ 512 ];
+            save_input( path, sizeof path, f->o.corpus, "", data, size );
+        }
+    }
+    pthread_mutex_unlock( &f->lock );
+}
+
+
+struct worker_arg {
+    struct fuzzer * fuzzer;
+    size_t index;
+};
+
+
+static
+void * work( void * const arg )
+// Runs mutated inputs until the fuzzer has run enough, or an input
+// fails.
+{
+    struct worker_arg const * const w = arg;
+    struct fuzzer * const f = w->fuzzer;
+    PropertyRng rng = property_rng_new( f->o.seed + w->index );
+    uint8_t * const data = untracked_malloc( f->o.max_size );
+    uint8_t * const map = untracked_calloc( MAP_SIZE, 1 );
+    uint8_t * const known = untracked_calloc( MAP_SIZE, 1 );
+    artifacts = f->artifacts;
+    while ( !atomic_load( &f->stop )
+         && atomic_fetch_add( &f->runs, 1 ) < f->o.runs ) {
+        size_t size = pick( f, &rng, data );
+        size_t const mutations = 1 + property_rng_next( &rng ) % 4;
+        for ( size_t i = 0; i < mutations; i += 1 ) {
+            size = mutate( &rng, data, size, f->o.max_size );
+        }
+
+        Assertions * const as = assertions_empty();
+        memset( map, 0, MAP_SIZE );
+        running = data;
+        running_size = size;
+        coverage = map;
+        f->o.func( as, data, size, f->o.ctx );
+        coverage = NULL;
+        running = NULL;
+        bool const passed = assertions_all_true( *as );
+        assertions_free( as );
+
+        if ( !passed ) {
+            pthread_mutex_lock( &f->lock );
+            f->failures += 1;
+            char path[ 256 ];
+            if ( save_input( path, sizeof path, f->artifacts, "fail-",
+                             data, size )
+              && f->reproducer[ 0 ] == '\0' ) {
+                strcpy( f->reproducer, path );
+            }
+            pthread_mutex_unlock( &f->lock );
+            atomic_store( &f->stop, true );
+        } else if ( covers_new_edge( map, known ) ) {
+            learn( f, map, known, data, size );
+        }
+    }
+    untracked_free( data );
+    untracked_free( map );
+    untracked_free( known );
+    return NULL;
+}
+
+
+FuzzStats fuzz_run_( struct fuzz_run_options o )
+{
+    assert( o.func != NULL );
+    if ( o.runs == 0 ) {
+        char const * const env = getenv( "TESTC_FUZZ_RUNS" );
+        o.runs = ( env == NULL ) ? 0 : strtoull( env, NULL, 10 );
+        o.runs = ( o.runs == 0 ) ? 100000 : o.runs;
+    }
+    o.max_size = ( o.max_size == 0 ) ? 4096 : o.max_size;
+    o.seed = ( o.seed == 0 ) ? property_default_seed() : o.seed;
+    size_t const threads = ( o.threads == 0 ) ? parallel_default_threads()
+                                              : o.threads;
+
+    struct fuzzer * const f = untracked_calloc( 1, sizeof ( struct fuzzer ) );
+    f->o = o;
+    f->artifacts = ( o.artifacts != NULL ) ? o.artifacts
+                 : ( o.corpus != NULL ) ? o.corpus : ".";
+    atomic_init( &f->runs, 0 );
+    atomic_init( &f->stop, false );
+    pthread_mutex_init( &f->lock, NULL );
+    if ( o.corpus != NULL ) {
+        load_corpus( f );
+    }
+    if ( f->corpus_size == 0 ) {
+        add_to_corpus( f, NULL, 0 );
+    }
+
+    struct sigaction crash = { .sa_handler = on_crash,
+                               .sa_flags = SA_RESETHAND };
+    sigemptyset( &crash.sa_mask );
+    struct sigaction previous_actions[ sizeof crash_signals
+                                       / sizeof crash_signals[ 0 ] ];
+    for ( size_t i = 0; i < sizeof crash_signals / sizeof crash_signals[ 0 ];
+          i += 1 ) {
+        sigaction( crash_signals[ i ], &crash, &previous_actions[ i ] );
+    }
+
+    // This thread is one of the workers.
+    pthread_t * const ids = untracked_malloc( threads * sizeof ( pthread_t ) );
+    struct worker_arg * const args =
+        untracked_malloc( threads * sizeof ( struct worker_arg ) );
+    size_t started = 0;
+    while ( started + 1 < threads ) {
+        args[ started ] = ( struct worker_arg ){ .fuzzer = f,
+                                                 .index = started + 1 };
+        if ( pthread_create( &ids[ started ], NULL, work,
+                             &args[ started ] ) != 0 ) {
+            break;
+        }
+        started += 1;
+    }
+    work( &( struct worker_arg ){ .fuzzer = f, .index = 0 } );
+    for ( size_t i = 0; i < started; i += 1 ) {
+        pthread_join( ids[ i ], NULL );
+    }
+    for ( size_t i = 0; i < sizeof crash_signals / sizeof crash_signals[ 0 ];
+          i += 1 ) {
+        sigaction( crash_signals[ i ], &previous_actions[ i ], NULL );
+    }
+
+    FuzzStats stats = {
+        .runs = MIN( atomic_load( &f->runs ), o.runs ),
+        .corpus_size = f->corpus_size,
+        .edges = f->edges,
+        .failures = f->failures
+    };
+    strcpy( stats.reproducer, f->reproducer );
+    for ( size_t i = 0; i < f->corpus_size; i += 1 ) {
+        untracked_free( f->corpus[ i ].data );
+    }
+    untracked_free( f->corpus );
+    untracked_free( ids );
+    untracked_free( args );
+    pthread_mutex_destroy( &f->lock );
+    untracked_free( f );
+    return stats;
+}
+
+
+bool fuzz_replay( Assertions * const as, fuzz_fn const func,
+                  void * const ctx, char const * const path )
+{
+    assert( as != NULL );
+    assert( func != NULL );
+    assert( path != NULL );
+
+    heap_pause();
+    FILE * const file = fopen( path, "rb" );
+    heap_resume();
+    if ( file == NULL ) {
+        return false;
+    }
+    size_t size = 0;
+    size_t capacity = 4096;
+    uint8_t * data = untracked_malloc( capacity );
+    size_t n;
+    while ( ( n = fread( data + size, 1, capacity - size, file ) ) > 0 ) {
+        size += n;
+        if ( size == capacity ) {
+            capacity *= 2;
+            data = untracked_realloc( data, capacity );
+        }
+    }
+    heap_pause();
+    fclose( file );
+    heap_resume();
+    func( as, data, size, ctx );
+    untracked_free( data );
+    return true;
+}
+
+
+void assertions_add_fuzz_( Assertions * const as,
+                           struct assertions_add_fuzz_options const o )
+{
+    assert( as != NULL );
+    assert( o.expr != NULL );
+
+    FuzzStats const stats = fuzz_run_( o.run );
+    char detail[ sizeof stats.reproducer + 32 ] = "";
+    if ( stats.reproducer[ 0 ] != '\0' ) {
+        snprintf( detail, sizeof detail, "reproducer: %s", stats.reproducer );
+    }
+    assertions_add_ptr( as, assertion_new_(
+        ( struct assertion_new_options ){
+            .expr = o.expr,
+            .result = stats.failures == 0,
+            .ids = ( AssertionId[] ){
+                { .expr = "runs", .value = ( long long ) stats.runs },
+                { .expr = "corpus", .value = ( long long ) stats.corpus_size },
+                { .expr = "edges", .value = ( long long ) stats.edges },
+                { .expr = "failures", .value = ( long long ) stats.failures },
+                ASSERTION_ID_ARRAY_END
+            },
+            .detail = ( detail[ 0 ] == '\0' ) ? NULL : detail
+        } ) );
+}
@@ -0,0 +1,137 @@
+// fuzz.h
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef INCLUDED_TESTC_FUZZ_H
+#define INCLUDED_TESTC_FUZZ_H
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "assertions.h" // Assertions
+
+
+// Fuzzing runs a test function on a stream of inputs made by mutating
+// the inputs of a corpus. An input that makes the function add a false
+// assertion, or crash, is saved as a reproducer.
+//
+// Fuzzing is guided by coverage if Test.c and the code under test are
+// compiled with `TESTC_FUZZ` defined and SanitizerCoverage enabled (e.g.
+// by `make fuzz`): with Clang's `trace-pc-guard`, or GCC's `trace-pc`.
+// Then, each input that covers a new edge is added to the corpus, so
+// the mutations work their way deeper into the code. Otherwise, the
+// inputs are only mutations of the initial corpus.
+
+
+// A fuzz target: adds assertions about how the code under test handles
+// the given input to the given `Assertions`.
+typedef void ( * fuzz_fn )( Assertions * assertions,
+                            uint8_t const * data, size_t size, void * ctx );
+
+
+// Returns `true` if Test.c was compiled for coverage-guided fuzzing, and
+// `false` otherwise.
+bool fuzz_is_guided( void );
+
+
+// The results of a `fuzz_run()`.
+typedef struct FuzzStats {
+
+    // How many inputs were run.
+    size_t runs;
+
+    // How many inputs the corpus ended with.
+    size_t corpus_size;
+
+    // How many distinct edges the inputs covered, if fuzzing is guided.
+    size_t edges;
+
+    // How many inputs failed before every thread stopped, which is at
+    // most one per thread.
+    size_t failures;
+
+    // The path of the reproducer of the first failure, if there was
+    // one and it could be saved, or an empty string.
+    char reproducer[ 256 ];
+
+} FuzzStats;
+
+
+struct fuzz_run_options {
+    fuzz_fn func;
+    void * ctx;
+    char const * corpus;
+    char const * artifacts;
+    size_t runs;
+    size_t max_size;
+    uint64_t seed;
+    size_t threads;
+};
+
+FuzzStats fuzz_run_( struct fuzz_run_options );
+
+// Fuzzes the given `func` for `runs` inputs (or `$TESTC_FUZZ_RUNS`, or
+// `100000`, if `0`) of up to `max_size` bytes (or `4096` if `0`), on
+// `threads` threads (or `parallel_default_threads()` if `0`; see
+// `parallel.h`) that share one corpus, with mutations seeded by `seed`
+// (or `property_default_seed()` if `0`; see `property.h`).
+//
+// If the `corpus` directory isn't `NULL`, the corpus starts with the
+// files in it, and the inputs that are added to the corpus are saved
+// in it. Otherwise, the corpus starts with an empty input. Fuzzing
+// stops at the first failure, which is saved in the `artifacts`
+// directory (or `corpus`, or the current directory, if `NULL`) as
+// `fail-` or `crash-`, followed by a hash of the input; those files
+// aren't loaded as part of a corpus. Crashes are caught by handlers of
+// the signals that usually mean one, which save the input and then let
+// the signal kill the process.
+#define fuzz_run( ... ) \
+    fuzz_run_( ( struct fuzz_run_options ){ __VA_ARGS__ } )
+
+
+// Adds the assertions of the given `func` on the input in the file at
+// the given `path` to the given `Assertions`, e.g. to replay a
+// reproducer in a test. Returns `false` if the file couldn't be read.
+bool fuzz_replay( Assertions * assertions, fuzz_fn func, void * ctx,
+                  char const * path );
+
+
+struct assertions_add_fuzz_options {
+    char const * expr;
+    struct fuzz_run_options run;
+};
+
+void assertions_add_fuzz_( Assertions * assertions,
+                           struct assertions_add_fuzz_options );
+
+// Takes an `Assertions *`, a `fuzz_fn` expression, and some options of
+// `fuzz_run()`, fuzzes the function, and adds an assertion that no input
+// failed, identified by the runs, the corpus size, the edges and the
+// failures. The path of the reproducer is the detail. For example:
+//      assertions_add_fuzz( as, parse_any, .corpus = "tests/corpus" );
+#define assertions_add_fuzz( ASSERTIONS, FUNC, ... ) \
+    assertions_add_fuzz_( ASSERTIONS, \
+        ( struct assertions_add_fuzz_options ){ \
+            .expr = #FUNC " survives fuzzing", \
+            .run = { .func = FUNC, __VA_ARGS__ } \
+        } )
+
+
+#endif // ifndef INCLUDED_TESTC_FUZZ_H
@@ -0,0 +1,477 @@
+// golden.c
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "golden.h" // golden_diff_, assertions_add_golden_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "assertion.h" // assertion_new_
+#include "dataset.h" // Dataset, dataset_open, dataset_close
+#include "heap.h" // heap_pause, heap_resume
+#include "_common.h" // MIN, untracked_*
+
+
+// How many bytes of a line are printed in a diff, at most.
+#define LINE_LIMIT 200
+
+
+// A line of some data: where it starts, its size without the newline,
+// and a hash of it, so that most unequal lines are told apart quickly.
+struct line {
+    size_t offset;
+    size_t size;
+    uint64_t hash;
+};
+
+
+// The lines of some data.
+struct lines {
+    uint8_t const * data;
+    struct line * array;
+    size_t size;
+};
+
+
+static
+struct lines split_lines( uint8_t const * const data, size_t const size )
+// Returns the lines of the given data, whose `array` the caller should
+// free.
+{
+    struct lines lines = { .data = data };
+    size_t capacity = 0;
+    size_t offset = 0;
+    while ( offset < size ) {
+        uint8_t const * const newline = memchr( data + offset, '\n',
+                                                size - offset );
+        size_t const end = ( newline == NULL ) ? size
+                                               : ( size_t ) ( newline - data );
+        uint64_t hash = 0xcbf29ce484222325ULL;
+        for ( size_t i = offset; i < end; i += 1 ) {
+            hash = ( hash ^ data[ i ] ) * 0x100000001b3ULL;
+        }
+        if ( lines.size == capacity ) {
+            capacity = ( capacity == 0 ) ? 256 : capacity * 2;
+            lines.array = untracked_realloc( lines.array,
+                capacity * sizeof ( struct line ) );
+        }
+        lines.array[ lines.size ] = ( struct line ){ .offset = offset,
+                                                     .size = end - offset,
+                                                     .hash = hash };
+        lines.size += 1;
+        offset = end + 1;
+    }
+    return lines;
+}
+
+
+static
+bool lines_eq( struct lines const * const a, size_t const i,
+               struct lines const * const b, size_t const j )
+{
+    struct line const x = a->array[ i ];
+    struct line const y = b->array[ j ];
+    return x.hash == y.hash
+        && x.size == y.size
+        && memcmp( a->data + x.offset, b->data + y.offset, x.size ) == 0;
+}
+
+
+// An edit of a diff: keeping, deleting or inserting a line, at the given
+// positions in the expected and actual lines.
+struct edit {
+    char type;
+    size_t a;
+    size_t b;
+};
+
+
+struct edits {
+    struct edit * array;
+    size_t size;
+    size_t capacity;
+};
+
+
+static
+void edits_add( struct edits * const edits, char const type,
+                size_t const a, size_t const b )
+{
+    if ( edits->size == edits->capacity ) {
+        edits->capacity = ( edits->capacity == 0 ) ? 64
+                                                   : edits->capacity * 2;
+        edits->array = untracked_realloc( edits->array,
+            edits->capacity * sizeof ( struct edit ) );
+    }
+    edits->array[ edits->size ] = ( struct edit ){ .type = type,
+                                                   .a = a, .b = b };
+    edits->size += 1;
+}
+
+
+static
+bool myers( struct lines const * const a, size_t const a_begin,
+            size_t const a_end, struct lines const * const b,
+            size_t const b_begin, size_t const b_end,
+            size_t const max_edits, struct edits * const edits )
+// Adds the shortest script of edits from the expected lines between
+// `a_begin` and `a_end` to the actual lines between `b_begin` and
+// `b_end` to the given `edits`, by Myers' greedy algorithm. Returns
+// `false`, and adds nothing, if that takes more than `max_edits` edits.
+{
+    long const n = a_end - a_begin;
+    long const m = b_end - b_begin;
+    long const max = MIN( ( size_t ) ( n + m ), max_edits );
+    long const offset = max + 1;
+    long * const v = untracked_calloc( 2 * max + 3, sizeof ( long ) );
+    // The `v` of each round before it's updated, from `-d - 1` to
+    // `d + 1`, to trace the path back from the end.
+    long * * const trace = untracked_malloc( ( max + 1 ) * sizeof ( long * ) );
+    long found = -1;
+    long d = 0;
+    for ( ; d <= max && found < 0; d += 1 ) {
+        trace[ d ] = untracked_malloc( ( 2 * d + 3 ) * sizeof ( long ) );
+        memcpy( trace[ d ], v + offset - d - 1,
+                ( 2 * d + 3 ) * sizeof ( long ) );
+        for ( long k = -d; k <= d; k += 2 ) {
+            long x = ( k == -d || ( k != d && v[ offset + k - 1 ]
+                                              < v[ offset + k + 1 ] ) )
+                   ? v[ offset + k + 1 ]
+                   : v[ offset + k - 1 ] + 1;
+            long y = x - k;
+            while ( x < n && y < m
+                 && lines_eq( a, a_begin + x, b, b_begin + y ) ) {
+                x += 1;
+                y += 1;
+            }
+            v[ offset + k ] = x;
+            if ( x >= n && y >= m ) {
+                found = d;
+                break;
+            }
+        }
+    }
+
+    if ( found >= 0 ) {
+        size_t const first = edits->size;
+        long x = n;
+        long y = m;
+        for ( long e = found; e >= 0; e -= 1 ) {
+            long const * const ve = trace[ e ] + e + 1;
+            long const k = x - y;
+            long const prev_k = ( k == -e || ( k != e && ve[ k - 1 ]
+                                                         < ve[ k + 1 ] ) )
+                              ? k + 1 : k - 1;
+            long const prev_x = ve[ prev_k ];
+            long const prev_y = prev_x - prev_k;
+            while ( x > prev_x && y > prev_y ) {
+                x -= 1;
+                y -= 1;
+                edits_add( edits, ' ', a_begin + x, b_begin + y );
+            }
+            if ( e > 0 ) {
+                if ( x == prev_x ) {
+                    edits_add( edits, '+', a_begin + x, b_begin + prev_y );
+                } else {
+                    edits_add( edits, '-', a_begin + prev_x, b_begin + y );
+                }
+            }
+            x = prev_x;
+            y = prev_y;
+        }
+        // We traced the edits from the end; put them in order.
+        struct edit * const traced = edits->array + first;
+        size_t const count = edits->size - first;
+        for ( size_t i = 0; i < count / 2; i += 1 ) {
+            struct edit const t = traced[ i ];
+            traced[ i ] = traced[ count - 1 - i ];
+            traced[ count - 1 - i ] = t;
+        }
+    }
+    for ( long e = 0; e < d; e += 1 ) {
+        untracked_free( trace[ e ] );
+    }
+    untracked_free( trace );
+    untracked_free( v );
+    return found >= 0;
+}
+
+
+static
+void print_line( FILE * const file, char const type,
+                 struct lines const * const lines, size_t const i )
+{
+    struct line const line = lines->array[ i ];
+    fprintf( file, "%c%.*s%s\n", type, ( int ) MIN( line.size, LINE_LIMIT ),
+             ( char const * ) lines->data + line.offset,
+             ( line.size > LINE_LIMIT ) ? "..." : "" );
+}
+
+
+static
+void print_hunk( FILE * const file, struct edits const * const edits,
+                 size_t const begin, size_t const end,
+                 struct lines const * const a, struct lines const * const b )
+// Prints the edits from `begin` up to `end` as a hunk of a unified
+// diff.
+{
+    size_t a_count = 0;
+    size_t b_count = 0;
+    for ( size_t i = begin; i < end; i += 1 ) {
+        a_count += ( edits->array[ i ].type != '+' );
+        b_count += ( edits->array[ i ].type != '-' );
+    }
+    // Unified diffs number empty ranges by the line before them.
+    size_t const a_start = edits->array[ begin ].a + ( a_count > 0 );
+    size_t const b_start = edits->array[ begin ].b + ( b_count > 0 );
+    fprintf( file, "@@ -%zu,%zu +%zu,%zu @@\n",
+             a_start, a_count, b_start, b_count );
+    for ( size_t i = begin; i < end; i += 1 ) {
+        struct edit const e = edits->array[ i ];
+        if ( e.type == '+' ) {
+            print_line( file, '+', b, e.b );
+        } else {
+            print_line( file, e.type, a, e.a );
+        }
+    }
+}
+
+
+size_t golden_diff_( struct golden_diff_options const o )
+{
+    assert( o.expected != NULL || o.expected_size == 0 );
+    assert( o.actual != NULL || o.actual_size == 0 );
+    FILE * const file = ( o.file == NULL ) ? stdout : o.file;
+    size_t const max_hunks = ( o.hunks == 0 ) ? 3 : o.hunks;
+    size_t const context = ( o.context == 0 ) ? 3 : o.context;
+    size_t const max_edits = ( o.max_edits == 0 ) ? 1000 : o.max_edits;
+
+    struct lines a = split_lines( o.expected, o.expected_size );
+    struct lines b = split_lines( o.actual, o.actual_size );
+
+    // Only diff the lines between the common prefix and suffix, which
+    // is usually most of them.
+    size_t prefix = 0;
+    while ( prefix < a.size && prefix < b.size
+         && lines_eq( &a, prefix, &b, prefix ) ) {
+        prefix += 1;
+    }
+    size_t suffix = 0;
+    while ( suffix < a.size - prefix && suffix < b.size - prefix
+         && lines_eq( &a, a.size - 1 - suffix, &b, b.size - 1 - suffix ) ) {
+        suffix += 1;
+    }
+
+    struct edits edits = { .array = NULL };
+    for ( size_t i = prefix - MIN( prefix, context ); i < prefix; i += 1 ) {
+        edits_add( &edits, ' ', i, i );
+    }
+    bool const diffed = myers( &a, prefix, a.size - suffix,
+                               &b, prefix, b.size - suffix,
+                               max_edits, &edits );
+    size_t hunks = 0;
+    if ( !diffed ) {
+        fprintf( file, "@@ -%zu +%zu @@\n", prefix + 1, prefix + 1 );
+        if ( prefix < a.size ) {
+            print_line( file, '-', &a, prefix );
+        }
+        if ( prefix < b.size ) {
+            print_line( file, '+', &b, prefix );
+        }
+        fprintf( file, "... and more than %zu other edits\n", max_edits );
+        hunks = 1;
+    } else {
+        for ( size_t i = 0; i < MIN( suffix, context ); i += 1 ) {
+            edits_add( &edits, ' ', a.size - suffix + i, b.size - suffix + i );
+        }
+        // Group the changes into hunks that are separated by more than
+        // twice the context of unchanged lines.
+        size_t i = 0;
+        while ( i < edits.size ) {
+            while ( i < edits.size && edits.array[ i ].type == ' ' ) {
+                i += 1;
+            }
+            if ( i == edits.size ) {
+                break;
+            }
+            size_t const begin = ( i > context ) ? i - context : 0;
+            size_t last = i;
+            for ( size_t j = i; j < edits.size
+                             && j - last <= 2 * context + 1; j += 1 ) {
+                if ( edits.array[ j ].type != ' ' ) {
+                    last = j;
+                }
+            }
+            size_t const end = MIN( last + context + 1, edits.size );
+            if ( hunks < max_hunks ) {
+                print_hunk( file, &edits, begin, end, &a, &b );
+            }
+            hunks += 1;
+            i = end;
+        }
+        if ( hunks > max_hunks ) {
+            fprintf( file, "... and %zu more hunk%s\n", hunks - max_hunks,
+                     ( hunks - max_hunks == 1 ) ? "" : "s" );
+        }
+    }
+    untracked_free( edits.array );
+    untracked_free( a.array );
+    untracked_free( b.array );
+    return hunks;
+}
+
+
+static
+bool update_requested( void )
+{
+    char const * const env = getenv( "TESTC_GOLDEN_UPDATE" );
+    return env != NULL && env[ 0 ] != '\0' && strcmp( env, "0" ) != 0;
+}
+
+
+static
+bool store( char const * const path, void const * const data,
+            size_t const size )
+// Replaces the file at the given `path` with the given data, by writing
+// a temporary file next to it, and renaming that over it. Returns
+// whether that succeeded.
+{
+    size_t const tmp_size = strlen( path ) + 12;
+    char * const tmp = untracked_malloc( tmp_size );
+    snprintf( tmp, tmp_size, "%s.tmp-XXXXXX", path );
+    int const fd = mkstemp( tmp );
+    bool ok = fd >= 0;
+    if ( ok ) {
+        size_t written = 0;
+        while ( written < size ) {
+            ssize_t const n = write( fd, ( uint8_t const * ) data + written,
+                                     size - written );
+            if ( n <= 0 ) {
+                break;
+            }
+            written += n;
+        }
+        ok = written == size
+          && fchmod( fd, 0644 ) == 0
+          && fsync( fd ) == 0;
+        ok = ( close( fd ) == 0 ) && ok && ( rename( tmp, path ) == 0 );
+        if ( !ok ) {
+            unlink( tmp );
+        }
+    }
+    untracked_free( tmp );
+    return ok;
+}
+
+
+static
+size_t mismatch_offset( uint8_t const * const a, size_t const a_size,
+                        uint8_t const * const b, size_t const b_size )
+// Returns the offset of the first byte that differs between the given
+// data, or the size of the shorter one if it's a prefix of the other.
+{
+    size_t const size = MIN( a_size, b_size );
+    size_t i = 0;
+    // Skip the equal blocks with `memcmp()`, which is vectorized.
+    while ( i + 4096 <= size && memcmp( a + i, b + i, 4096 ) == 0 ) {
+        i += 4096;
+    }
+    while ( i < size && a[ i ] == b[ i ] ) {
+        i += 1;
+    }
+    return i;
+}
+
+
+void assertions_add_golden_( Assertions * const as,
+                             struct assertions_add_golden_options const o )
+{
+    assert( as != NULL );
+    assert( o.expr != NULL );
+    assert( o.path != NULL );
+    assert( o.data != NULL || o.size == 0 );
+
+    bool const update = o.update || update_requested();
+    Dataset * const golden = update ? NULL
+                           : dataset_open( .path = o.path, .stride = 1 );
+    // Only a golden file that doesn't exist is stored: one that couldn't
+    // be read for another reason, e.g. its permissions, is left alone.
+    bool const missing = update
+        || ( golden == NULL && access( o.path, F_OK ) != 0
+                            && errno == ENOENT );
+    bool passed;
+    size_t expected_size = o.size;
+    size_t offset = o.size;
+    char * detail = NULL;
+    char const * reason = NULL;
+    if ( missing ) {
+        // The assertion fails if the golden file couldn't be stored.
+        passed = store( o.path, o.data, o.size );
+    } else if ( golden == NULL ) {
+        passed = false;
+        reason = "the golden file exists, but couldn't be read";
+    } else {
+        expected_size = golden->size;
+        passed = golden->size == o.size
+              && ( o.size == 0 || memcmp( golden->data, o.data, o.size ) == 0 );
+        if ( !passed ) {
+            offset = mismatch_offset( golden->data, golden->size,
+                                      o.data, o.size );
+            size_t size = 0;
+            heap_pause();
+            FILE * const file = open_memstream( &detail, &size );
+            heap_resume();
+            golden_diff( .expected = golden->data,
+                         .expected_size = golden->size,
+                         .actual = o.data, .actual_size = o.size,
+                         .file = file, .hunks = o.hunks,
+                         .context = o.context );
+            heap_pause();
+            fclose( file );
+            heap_resume();
+        }
+        dataset_close( golden );
+    }
+
+    assertions_add_ptr( as, assertion_new_(
+        ( struct assertion_new_options ){
+            .expr = o.expr,
+            .result = passed,
+            .ids = ( AssertionId[] ){
+                { .expr = "expected_size",
+                  .value = ( long long ) expected_size },
+                { .expr = "actual_size", .value = ( long long ) o.size },
+                { .expr = "mismatch_offset", .value = ( long long ) offset },
+                ASSERTION_ID_ARRAY_END
+            },
+            .detail = ( detail == NULL ) ? reason : detail
+        } ) );
+    heap_pause();
+    free( detail );
+    heap_resume();
+}
@@ -0,0 +1,109 @@
+// golden.h
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+
+#ifndef INCLUDED_TESTC_GOLDEN_H
+#define INCLUDED_TESTC_GOLDEN_H
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "assertions.h" // Assertions
+
+
+// Golden files are snapshots of the expected output of the code under
+// test, stored alongside the tests, e.g. a rendered report. A produced
+// output is checked against its snapshot by mapping the file into
+// memory and comparing the bytes; only if they differ is a line diff
+// of the two computed, to show what changed.
+
+
+struct golden_diff_options {
+    void const * expected;
+    size_t expected_size;
+    void const * actual;
+    size_t actual_size;
+    FILE * file;
+    size_t hunks;
+    size_t context;
+    size_t max_edits;
+};
+
+size_t golden_diff_( struct golden_diff_options );
+
+// Prints a unified diff of the lines of the `expected` data of
+// `expected_size` bytes and the `actual` data of `actual_size` bytes to
+// the `file` (or `stdout` if `NULL`), and returns how many hunks they
+// differ by. The lines are matched by Myers' algorithm, and each hunk
+// has up to `context` lines (or `3` if `0`) of unchanged lines around
+// the changed ones. Only the first `hunks` hunks (or `3` if `0`) are
+// printed, followed by how many more there are. If the lines differ by
+// more than `max_edits` insertions and deletions (or `1000` if `0`),
+// the diff is abandoned, and only the first differing line is printed.
+// For example:
+//      @@ -3,3 +3,3 @@
+//       "name": "widget",
+//      -"price": 10,
+//      +"price": 12,
+//       "stock": 4
+#define golden_diff( ... ) \
+    golden_diff_( ( struct golden_diff_options ){ __VA_ARGS__ } )
+
+
+struct assertions_add_golden_options {
+    char const * expr;
+    char const * path;
+    void const * data;
+    size_t size;
+    bool update;
+    size_t hunks;
+    size_t context;
+};
+
+void assertions_add_golden_( Assertions * assertions,
+                             struct assertions_add_golden_options );
+
+// Takes an `Assertions *`, the path of a golden file, and some options,
+// and adds an assertion that the produced `data` of `size` bytes is the
+// same as the contents of the golden file, identified by their sizes
+// and the offset of their first differing byte (which is the size of
+// the data, if they're the same). If they're not, the detail of the
+// assertion is a diff of the file and the data, as by `golden_diff()`
+// with the given `hunks` and `context`. For example:
+//      assertions_add_golden( as, "tests/golden/report.txt",
+//                             .data = report, .size = strlen( report ) );
+//
+// If the golden file doesn't exist, or if `update` is `true` or
+// `$TESTC_GOLDEN_UPDATE` is set to anything other than `0`, the data is
+// stored as the golden file instead, and the assertion is `true`, unless
+// it couldn't be stored. The file is replaced atomically, so an
+// interrupted update leaves the old snapshot intact. If the golden file
+// exists but can't be read, the assertion is `false`, and the file is
+// left alone.
+#define assertions_add_golden( ASSERTIONS, PATH, ... ) \
+    assertions_add_golden_( ASSERTIONS, \
+        ( struct assertions_add_golden_options ){ \
+            .expr = "output matches the golden file " #PATH, \
+            .path = PATH, \
+            __VA_ARGS__ \
+        } )
+
+
+#endif // ifndef INCLUDED_TESTC_GOLDEN_H
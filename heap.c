@@ -0,0 +1,390 @@
+// heap.c
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "heap.h" // HeapStats
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <assert.h>
+
+#include <pthread.h>
+
+#include "_common.h" // NELEM
+
+
+// How deeply `heap_begin()` calls can be nested.
+#define MAX_DEPTH 16
+
+size_t const heap_max_depth = MAX_DEPTH;
+
+
+// How many `heap_pause()` calls haven't been resumed by this thread.
+static _Thread_local size_t paused = 0;
+
+
+void heap_pause( void )
+{
+    paused += 1;
+}
+
+
+void heap_resume( void )
+{
+    assert( paused > 0 );
+    paused -= 1;
+}
+
+
+void heap_stats_print_( struct heap_stats_print_options const o )
+{
+    HeapStats const s = o.stats;
+    FILE * const file = ( o.file == NULL ) ? stdout : o.file;
+
+    fprintf( file, "heap:  %zu allocation%s, %zu bytes, %zu bytes peak",
+             s.allocations, ( s.allocations == 1 ) ? "" : "s",
+             s.bytes, s.peak_bytes );
+    if ( s.leaked_blocks > 0 ) {
+        fprintf( file, ", %zu leak%s (%zu bytes)",
+                 s.leaked_blocks, ( s.leaked_blocks == 1 ) ? "" : "s",
+                 s.leaked_bytes );
+    }
+    fprintf( file, "\n" );
+}
+
+
+#if defined( TESTC_HEAP ) && defined( __GLIBC__ )
+
+
+// The allocator that we're wrapping.
+extern void * __libc_malloc( size_t );
+extern void * __libc_calloc( size_t, size_t );
+extern void * __libc_realloc( void *, size_t );
+extern void __libc_free( void * );
+
+
+// The state of a `heap_begin()` that hasn't been ended yet.
+struct scope {
+    uint64_t begin;
+    HeapStats stats;
+    size_t live_bytes;
+};
+
+
+// A block allocated while counting, and when it was allocated.
+struct block {
+    void * ptr;
+    size_t size;
+    uint64_t serial;
+};
+
+// A sentinel `ptr` for blocks that have been removed from the table.
+static char removed;
+
+
+// Everything below is guarded by `lock`.
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct scope scopes[ MAX_DEPTH ];
+
+// This is only written with the lock held, but it's also read without
+// the lock to decide whether to take it.
+static _Atomic size_t depth = 0;
+
+// Incremented for every counted allocation, so that the allocations of
+// a scope are those with a `serial` greater than its `begin`.
+static uint64_t serial = 0;
+
+// An open-addressing hash table of the live counted blocks.
+static struct block * table = NULL;
+static size_t table_capacity = 0;
+static size_t table_used = 0;    // including removed blocks
+static size_t table_size = 0;    // excluding removed blocks
+
+
+static
+size_t hash( void const * const ptr )
+{
+    uint64_t x = ( uintptr_t ) ptr;
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    return x;
+}
+
+
+static
+void table_insert( struct block const b );
+
+
+static
+void table_grow( void )
+{
+    struct block * const old = table;
+    size_t const old_capacity = table_capacity;
+    // Only grow the table if it's not mostly removed blocks.
+    if ( table_capacity == 0 ) {
+        table_capacity = 1024;
+    } else if ( ( table_size + 1 ) * 4 > table_capacity ) {
+        table_capacity *= 2;
+    }
+    table = __libc_calloc( table_capacity, sizeof ( struct block ) );
+    table_used = 0;
+    table_size = 0;
+    for ( size_t i = 0; i < old_capacity; i += 1 ) {
+        if ( old[ i ].ptr != NULL && old[ i ].ptr != &removed ) {
+            table_insert( old[ i ] );
+        }
+    }
+    __libc_free( old );
+}
+
+
+static
+void table_insert( struct block const b )
+{
+    if ( ( table_used + 1 ) * 2 > table_capacity ) {
+        table_grow();
+    }
+    size_t i = hash( b.ptr ) & ( table_capacity - 1 );
+    while ( table[ i ].ptr != NULL ) {
+        i = ( i + 1 ) & ( table_capacity - 1 );
+    }
+    table[ i ] = b;
+    table_used += 1;
+    table_size += 1;
+}
+
+
+static
+bool table_remove( void const * const ptr, struct block * const out )
+// Removes the block for `ptr` from the table and gives it via `out`, if
+// there is one. Returns whether there was.
+{
+    if ( table_size == 0 ) {
+        return false;
+    }
+    size_t i = hash( ptr ) & ( table_capacity - 1 );
+    while ( table[ i ].ptr != NULL ) {
+        if ( table[ i ].ptr == ptr ) {
+            *out = table[ i ];
+            table[ i ].ptr = &removed;
+            table_size -= 1;
+            return true;
+        }
+        i = ( i + 1 ) & ( table_capacity - 1 );
+    }
+    return false;
+}
+
+
+static
+void count_allocation( void * const ptr, size_t const size )
+// Counts the allocation of `ptr` in every scope. The caller should hold
+// the lock.
+{
+    serial += 1;
+    table_insert( ( struct block ){ .ptr = ptr,
+                                    .size = size,
+                                    .serial = serial } );
+    for ( size_t i = 0; i < depth; i += 1 ) {
+        struct scope * const s = &scopes[ i ];
+        s->stats.allocations += 1;
+        s->stats.bytes += size;
+        s->live_bytes += size;
+        s->stats.leaked_blocks += 1;
+        if ( s->live_bytes > s->stats.peak_bytes ) {
+            s->stats.peak_bytes = s->live_bytes;
+        }
+    }
+}
+
+
+static
+void count_free( void * const ptr )
+// Counts the freeing of `ptr` in every scope that counted its
+// allocation. The caller should hold the lock.
+{
+    struct block b;
+    if ( !table_remove( ptr, &b ) ) {
+        return;
+    }
+    for ( size_t i = 0; i < depth && scopes[ i ].begin < b.serial; i += 1 ) {
+        struct scope * const s = &scopes[ i ];
+        s->stats.frees += 1;
+        s->live_bytes -= b.size;
+        s->stats.leaked_blocks -= 1;
+    }
+}
+
+
+static
+bool counting( void )
+// Returns `true` if the calling thread's allocations should be counted.
+// This doesn't take the lock, so it may be briefly out of date, but
+// only for allocations that race with a `heap_begin()` or `heap_end()`.
+{
+    return paused == 0 && depth > 0;
+}
+
+
+void * malloc( size_t const size )
+{
+    void * const ptr = __libc_malloc( size );
+    if ( ptr != NULL && counting() ) {
+        pthread_mutex_lock( &lock );
+        if ( depth > 0 ) {
+            count_allocation( ptr, size );
+        }
+        pthread_mutex_unlock( &lock );
+    }
+    return ptr;
+}
+
+
+void * calloc( size_t const n, size_t const size )
+{
+    void * const ptr = __libc_calloc( n, size );
+    if ( ptr != NULL && counting() ) {
+        pthread_mutex_lock( &lock );
+        if ( depth > 0 ) {
+            count_allocation( ptr, n * size );
+        }
+        pthread_mutex_unlock( &lock );
+    }
+    return ptr;
+}
+
+
+// Frees are counted even while the calling thread is paused, since the
+// block may have been allocated while it wasn't; otherwise, it'd stay
+// in the table as a leak, and could be mistaken for a later block at
+// the same address.
+
+
+void * realloc( void * const old, size_t const size )
+{
+    void * const ptr = __libc_realloc( old, size );
+    bool const freed = old != NULL && ( ptr != NULL || size == 0 );
+    bool const allocated = ptr != NULL && counting();
+    if ( depth > 0 && ( freed || allocated ) ) {
+        pthread_mutex_lock( &lock );
+        if ( freed ) {
+            count_free( old );
+        }
+        if ( allocated && depth > 0 ) {
+            count_allocation( ptr, size );
+        }
+        pthread_mutex_unlock( &lock );
+    }
+    return ptr;
+}
+
+
+void free( void * const ptr )
+{
+    if ( ptr != NULL && depth > 0 ) {
+        pthread_mutex_lock( &lock );
+        count_free( ptr );
+        pthread_mutex_unlock( &lock );
+    }
+    __libc_free( ptr );
+}
+
+
+bool heap_is_tracked( void )
+{
+    return true;
+}
+
+
+void heap_begin( void )
+{
+    pthread_mutex_lock( &lock );
+    assert( depth < NELEM( scopes ) );
+    scopes[ depth ] = ( struct scope ){ .begin = serial };
+    depth += 1;
+    pthread_mutex_unlock( &lock );
+}
+
+
+HeapStats heap_end( void )
+{
+    pthread_mutex_lock( &lock );
+    assert( depth > 0 );
+    depth -= 1;
+    struct scope const s = scopes[ depth ];
+    if ( depth == 0 ) {
+        // Forget the leaked blocks; there's nothing left to count them
+        // against.
+        __libc_free( table );
+        table = NULL;
+        table_capacity = 0;
+        table_used = 0;
+        table_size = 0;
+    }
+    pthread_mutex_unlock( &lock );
+
+    HeapStats stats = s.stats;
+    stats.leaked_bytes = s.live_bytes;
+    return stats;
+}
+
+
+HeapStats heap_peek( void )
+{
+    pthread_mutex_lock( &lock );
+    struct scope const s = ( depth == 0 ) ? ( struct scope ){ .begin = 0 }
+                                          : scopes[ depth - 1 ];
+    pthread_mutex_unlock( &lock );
+
+    HeapStats stats = s.stats;
+    stats.leaked_bytes = s.live_bytes;
+    return stats;
+}
+
+
+#else // if !( defined( TESTC_HEAP ) && defined( __GLIBC__ ) )
+
+
+bool heap_is_tracked( void )
+{
+    return false;
+}
+
+
+void heap_begin( void )
+{
+}
+
+
+HeapStats heap_end( void )
+{
+    return ( HeapStats ){ .allocations = 0 };
+}
+
+
+HeapStats heap_peek( void )
+{
+    return ( HeapStats ){ .allocations = 0 };
+}
+
+
+#endif // if defined( TESTC_HEAP ) && defined( __GLIBC__ )
@@ -0,0 +1,170 @@
+// heap.h
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef INCLUDED_TESTC_HEAP_H
+#define INCLUDED_TESTC_HEAP_H
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "assertions.h" // Assertions, assertions_add_at_
+
+
+// Heap instrumentation is opt-in: if Test.c is compiled with
+// `TESTC_HEAP` defined (e.g. by `make heap`), it replaces `malloc()`,
+// `calloc()`, `realloc()` and `free()` with wrappers around the C
+// library's allocator (which has to be glibc), that count the
+// allocations made between `heap_begin()` and `heap_end()` by any
+// thread. Otherwise, the functions below are still available, but
+// nothing is counted.
+//
+// The allocations that Test.c makes for itself, e.g. for `Assertions`,
+// are never counted.
+
+
+// The usage of the heap between a `heap_begin()` and its `heap_end()`.
+typedef struct HeapStats {
+
+    // How many blocks were allocated, including by `realloc()`.
+    size_t allocations;
+
+    // How many of the counted blocks were freed, including by
+    // `realloc()`.
+    size_t frees;
+
+    // The total size of the allocated blocks, in bytes.
+    size_t bytes;
+
+    // The most bytes that were live (allocated and not yet freed) at
+    // once.
+    size_t peak_bytes;
+
+    // How many of the allocated blocks were still live at the end.
+    size_t leaked_blocks;
+
+    // The total size of those blocks, in bytes.
+    size_t leaked_bytes;
+
+} HeapStats;
+
+
+// Returns `true` if Test.c was compiled with heap instrumentation, and
+// `false` otherwise.
+bool heap_is_tracked( void );
+
+
+// Starts counting heap usage, until the corresponding `heap_end()`.
+// These can be nested, up to `heap_max_depth` deep: the usage counted
+// by an inner pair is also counted by the outer pairs.
+void heap_begin( void );
+
+
+// Stops counting heap usage for the innermost `heap_begin()`, and
+// returns the counts since then. If Test.c wasn't compiled with heap
+// instrumentation, all of the counts will be zero.
+HeapStats heap_end( void );
+
+
+// Returns the counts of the innermost `heap_begin()` so far, without
+// ending it, e.g. to watch the live bytes of a long-running loop. If
+// there isn't one, or Test.c wasn't compiled with heap instrumentation,
+// all of the counts will be zero.
+HeapStats heap_peek( void );
+
+
+// How deeply `heap_begin()` calls can be nested.
+extern size_t const heap_max_depth;
+
+
+// Stops counting the allocations of the calling thread, until the
+// corresponding `heap_resume()`. These can be nested. Its frees are
+// still counted, so that a block that was allocated while counting
+// isn't reported as a leak if it's freed while paused.
+void heap_pause( void );
+
+
+// Undoes the last `heap_pause()` of the calling thread.
+void heap_resume( void );
+
+
+struct heap_stats_print_options {
+    HeapStats stats;
+    FILE * file;
+};
+
+void heap_stats_print_( struct heap_stats_print_options );
+
+// Prints the given `stats` on a single line to the `file` (or `stdout`
+// if `NULL`). For example:
+//      heap:  3 allocations, 120 bytes, 64 bytes peak, 1 leak (32 bytes)
+#define heap_stats_print( ... ) \
+    heap_stats_print_( ( struct heap_stats_print_options ){ \
+        __VA_ARGS__ \
+    } )
+
+
+// Takes an `Assertions *`, a `bool` expression, and a series of
+// statements, and evaluates those statements between a `heap_begin()`
+// and `heap_end()`. Then, it adds the `bool` expression, which can
+// refer to the returned `HeapStats` as `heap`, to the given
+// `Assertions`, identified by the counts of those stats. For example:
+//      assertions_add_heap( as, heap.bytes <= 4096, parse( input ) );
+#define assertions_add_heap( ASSERTIONS, EXPR, ... ) \
+    do { \
+        heap_begin(); \
+        __VA_ARGS__; \
+        HeapStats const heap = heap_end(); \
+        assertions_add_at_( ASSERTIONS, \
+            ( struct assertions_add_at_options ){ \
+                .file = __FILE__, \
+                .line = __LINE__, \
+                .expr = #EXPR " for " #__VA_ARGS__, \
+                .result = EXPR, \
+                .ids = ( AssertionId[] ){ \
+                    { .expr = "heap.allocations", \
+                      .value = ( long long ) heap.allocations }, \
+                    { .expr = "heap.bytes", \
+                      .value = ( long long ) heap.bytes }, \
+                    { .expr = "heap.leaked_blocks", \
+                      .value = ( long long ) heap.leaked_blocks }, \
+                    ASSERTION_ID_ARRAY_END \
+                } \
+            } ); \
+    } while ( 0 )
+
+
+// Adds an assertion that the given statements make no allocations.
+#define assertions_add_no_allocations( ASSERTIONS, ... ) \
+    assertions_add_heap( ASSERTIONS, heap.allocations == 0, __VA_ARGS__ )
+
+
+// Adds an assertion that the given statements allocate at most `MAX`
+// bytes in total.
+#define assertions_add_bytes_at_most( ASSERTIONS, MAX, ... ) \
+    assertions_add_heap( ASSERTIONS, heap.bytes <= ( MAX ), __VA_ARGS__ )
+
+
+// Adds an assertion that the given statements free every block they
+// allocate.
+#define assertions_add_no_leaks( ASSERTIONS, ... ) \
+    assertions_add_heap( ASSERTIONS, heap.leaked_blocks == 0, __VA_ARGS__ )
+
+
+#endif // ifndef INCLUDED_TESTC_HEAP_H
@@ -0,0 +1,268 @@
+// histogram.c
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "histogram.h" // Histogram
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <assert.h>
+
+#include "assertion.h" // assertion_new_
+#include "heap.h" // heap_pause, heap_resume
+#include "_common.h" // MIN, NELEM, untracked_*, print_duration
+
+
+// The number of linear buckets for each power of two.
+#define HALF ( 1 << ( HISTOGRAM_PRECISION_BITS - 1 ) )
+
+
+static
+uint64_t counts_sum( Histogram const * const h )
+{
+    uint64_t sum = 0;
+    for ( size_t i = 0; i < HISTOGRAM_BUCKETS; i += 1 ) {
+        sum += h->counts[ i ];
+    }
+    return sum;
+}
+
+
+bool histogram_is_valid( Histogram const * const h )
+{
+    return h != NULL
+        && h->total == counts_sum( h )
+        && ( h->total != 0 || ( h->min == 0 && h->max == 0 ) )
+        && h->min <= h->max;
+}
+
+
+void histogram_assert_valid( Histogram const * const h )
+{
+    assert( h != NULL );
+    assert( h->total == counts_sum( h ) );
+    assert( h->total != 0 || ( h->min == 0 && h->max == 0 ) );
+    assert( h->min <= h->max );
+}
+
+
+Histogram * histogram_new( void )
+{
+    return untracked_calloc( 1, sizeof ( Histogram ) );
+}
+
+
+void histogram_free( Histogram * const h )
+{
+    untracked_free( h );
+}
+
+
+static
+int most_significant_bit( uint64_t const x )
+// Returns the index of the highest set bit of `x`, which can't be `0`.
+{
+    assert( x != 0 );
+#if defined( __GNUC__ ) || defined( __clang__ )
+    return 63 - __builtin_clzll( x );
+#else
+    int n = 0;
+    for ( uint64_t y = x; y > 1; y >>= 1 ) {
+        n += 1;
+    }
+    return n;
+#endif
+}
+
+
+static
+size_t bucket_index( uint64_t const value )
+// Returns the index of the bucket that the given `value` is recorded
+// into.
+{
+    if ( value < 2 * HALF ) {
+        return value;
+    }
+    int const shift = most_significant_bit( value )
+                    - ( HISTOGRAM_PRECISION_BITS - 1 );
+    return ( size_t ) shift * HALF + ( value >> shift );
+}
+
+
+static
+uint64_t bucket_highest( size_t const index )
+// Returns the greatest value that is recorded into the bucket at the
+// given `index`.
+{
+    if ( index < 2 * HALF ) {
+        return index;
+    }
+    int const shift = index / HALF - 1;
+    uint64_t const sub = index - ( size_t ) shift * HALF;
+    // This wraps around to give the right answer for the last bucket.
+    return ( ( sub + 1 ) << shift ) - 1;
+}
+
+
+void histogram_record( Histogram * const h, uint64_t const value )
+{
+    histogram_record_n( h, value, 1 );
+}
+
+
+void histogram_record_n( Histogram * const h,
+                         uint64_t const value,
+                         uint64_t const count )
+{
+    assert( h != NULL );
+    if ( count == 0 ) {
+        return;
+    }
+    h->counts[ bucket_index( value ) ] += count;
+    if ( h->total == 0 || value < h->min ) {
+        h->min = value;
+    }
+    if ( value > h->max ) {
+        h->max = value;
+    }
+    h->total += count;
+    h->sum += ( double ) value * count;
+}
+
+
+void histogram_merge( Histogram * const into, Histogram const * const from )
+{
+    histogram_assert_valid( into );
+    histogram_assert_valid( from );
+
+    if ( from->total == 0 ) {
+        return;
+    }
+    for ( size_t i = 0; i < HISTOGRAM_BUCKETS; i += 1 ) {
+        into->counts[ i ] += from->counts[ i ];
+    }
+    if ( into->total == 0 || from->min < into->min ) {
+        into->min = from->min;
+    }
+    if ( from->max > into->max ) {
+        into->max = from->max;
+    }
+    into->total += from->total;
+    into->sum += from->sum;
+}
+
+
+uint64_t histogram_percentile( Histogram const * const h,
+                               double const percentile )
+{
+    histogram_assert_valid( h );
+    assert( percentile >= 0 && percentile <= 100 );
+
+    if ( h->total == 0 ) {
+        return 0;
+    }
+    double const exact = ceil( percentile / 100 * h->total );
+    uint64_t const rank = ( exact < 1 ) ? 1 : ( uint64_t ) exact;
+    uint64_t seen = 0;
+    for ( size_t i = 0; i < HISTOGRAM_BUCKETS; i += 1 ) {
+        seen += h->counts[ i ];
+        if ( seen >= rank ) {
+            return MIN( bucket_highest( i ), h->max );
+        }
+    }
+    return h->max;
+}
+
+
+double histogram_mean( Histogram const * const h )
+{
+    histogram_assert_valid( h );
+    return ( h->total == 0 ) ? 0 : h->sum / h->total;
+}
+
+
+void histogram_print_( struct histogram_print_options const o )
+{
+    Histogram const * const h = o.histogram;
+    histogram_assert_valid( h );
+    FILE * const file = ( o.file == NULL ) ? stdout : o.file;
+    char const * const indent = ( o.indent == NULL ) ? "" : o.indent;
+
+    fprintf( file, "%shistogram:  %llu value%s", indent,
+             ( unsigned long long ) h->total, ( h->total == 1 ) ? "" : "s" );
+    if ( h->total == 0 ) {
+        fprintf( file, "\n" );
+        return;
+    }
+    fprintf( file, ", min " );
+    print_duration( file, h->min );
+    fprintf( file, ", mean " );
+    print_duration( file, histogram_mean( h ) );
+    fprintf( file, ", max " );
+    print_duration( file, h->max );
+    fprintf( file, "\n%s", indent );
+    static double const percentiles[] = { 50, 90, 99, 99.9, 99.99 };
+    for ( size_t i = 0; i < NELEM( percentiles ); i += 1 ) {
+        fprintf( file, "%sp%g ", ( i == 0 ) ? "" : ", ", percentiles[ i ] );
+        print_duration( file, histogram_percentile( h, percentiles[ i ] ) );
+    }
+    fprintf( file, "\n" );
+}
+
+
+void assertions_add_percentile_(
+        Assertions * const assertions,
+        struct assertions_add_percentile_options const o )
+{
+    assert( assertions != NULL );
+    assert( o.expr != NULL );
+    histogram_assert_valid( o.histogram );
+
+    uint64_t const value = histogram_percentile( o.histogram, o.percentile );
+
+    // The detail is the summary that `histogram_print()` would print.
+    char * summary = NULL;
+    size_t size = 0;
+    heap_pause();
+    FILE * const file = open_memstream( &summary, &size );
+    histogram_print( .histogram = o.histogram, .file = file );
+    fclose( file );
+    heap_resume();
+
+    assertions_add_ptr( assertions, assertion_new_(
+        ( struct assertion_new_options ){
+            .expr = o.expr,
+            .result = value <= o.max,
+            .ids = ( AssertionId[] ){
+                { .expr = "value",
+                  .value = ( long long ) MIN( value, LLONG_MAX ) },
+                { .expr = "count",
+                  .value = ( long long ) MIN( o.histogram->total, LLONG_MAX ) },
+                ASSERTION_ID_ARRAY_END
+            },
+            .detail = summary
+        } ) );
+    heap_pause();
+    free( summary );
+    heap_resume();
+}
@@ -0,0 +1,161 @@
+// histogram.h
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef INCLUDED_TESTC_HISTOGRAM_H
+#define INCLUDED_TESTC_HISTOGRAM_H
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "assertions.h" // Assertions
+
+
+// How many of the highest bits of a value are kept by a histogram: the
+// values that are recorded into the same bucket are within 1 part in
+// `2 ^ ( HISTOGRAM_PRECISION_BITS - 1 )` of each other.
+#define HISTOGRAM_PRECISION_BITS 7
+
+// How many buckets a histogram has: enough for every `uint64_t`.
+#define HISTOGRAM_BUCKETS \
+    ( ( 64 - HISTOGRAM_PRECISION_BITS + 2 ) \
+      << ( HISTOGRAM_PRECISION_BITS - 1 ) )
+
+
+// A histogram of values, typically latencies in nanoseconds, in the
+// fashion of HdrHistogram: values below `2 ^ HISTOGRAM_PRECISION_BITS`
+// have their own bucket, and then every power of two is split into the
+// same number of linear buckets. This takes a fixed amount of memory, so
+// recording a value is just an increment, and since a bucket is reported
+// by its highest value, every value is overstated by at most 1 part in
+// `2 ^ ( HISTOGRAM_PRECISION_BITS - 1 )`, about 1.6%.
+//
+// A histogram isn't safe to record into from multiple threads at once.
+// Rather, give each thread its own, and `histogram_merge()` them after.
+// A `Histogram` initialized to zero is empty.
+typedef struct Histogram {
+
+    // How many values were recorded into each bucket.
+    uint64_t counts[ HISTOGRAM_BUCKETS ];
+
+    // How many values were recorded.
+    uint64_t total;
+
+    // The least and greatest values that were recorded.
+    uint64_t min;
+    uint64_t max;
+
+    // The sum of the values that were recorded.
+    double sum;
+
+    // Invariants:
+    // - `total` is the sum of `counts`
+    // - `min` and `max` are `0` if `total` is `0`, and otherwise
+    //   `min <= max`
+
+} Histogram;
+
+
+// Returns `true` if the invariants hold for the given `Histogram`, or
+// `false` if some don't.
+bool histogram_is_valid( Histogram const * );
+
+
+// Asserts that the invariants hold for the given `Histogram`.
+void histogram_assert_valid( Histogram const * );
+
+
+// Allocates and returns a new empty histogram.
+Histogram * histogram_new( void );
+
+
+// Frees the memory allocated for the given histogram.
+void histogram_free( Histogram * );
+
+
+// Records the given `value` into the given histogram.
+void histogram_record( Histogram *, uint64_t value );
+
+
+// Records the given `value` `count` times into the given histogram.
+void histogram_record_n( Histogram *, uint64_t value, uint64_t count );
+
+
+// Adds the counts of the histogram `from` to the histogram `into`.
+void histogram_merge( Histogram * into, Histogram const * from );
+
+
+// Returns the value at the given `percentile` (from `0` to `100`) of
+// the given histogram: the greatest value that is equivalent to (in the
+// same bucket as) a value that at least that percentage of the recorded
+// values are less than or equal to. Returns `0` if it's empty.
+uint64_t histogram_percentile( Histogram const *, double percentile );
+
+
+// Returns the mean of the values recorded into the given histogram, or
+// `0` if it's empty.
+double histogram_mean( Histogram const * );
+
+
+struct histogram_print_options {
+    Histogram const * histogram;
+    FILE * file;
+    char const * indent;
+};
+
+void histogram_print_( struct histogram_print_options );
+
+// Prints a summary of the given `histogram` of nanoseconds to the
+// `file` (or `stdout` if `NULL`), indenting each line with `indent`
+// (or `""` if `NULL`). For example:
+//      histogram:  10000 values, min 1.2 us, mean 2.31 us, max 812 us
+//      p50 2 us, p90 3.1 us, p99 41 us, p99.9 190 us, p99.99 790 us
+#define histogram_print( ... ) \
+    histogram_print_( ( struct histogram_print_options ){ __VA_ARGS__ } )
+
+
+struct assertions_add_percentile_options {
+    char const * expr;
+    Histogram const * histogram;
+    double percentile;
+    uint64_t max;
+};
+
+void assertions_add_percentile_( Assertions * assertions,
+                                 struct assertions_add_percentile_options );
+
+// Adds an assertion to the given `Assertions *` that the given
+// percentile of the given `Histogram *` is less than or equal to the
+// given `MAX`, identified by that percentile and how many values were
+// recorded. The summary of the histogram is the detail of the
+// assertion, so it's printed if the assertion fails. For example:
+//      assertions_add_percentile( as, &latencies, 99.9, 200000 );
+#define assertions_add_percentile( ASSERTIONS, HISTOGRAM, PERCENTILE, \
+                                   MAX ) \
+    assertions_add_percentile_( ASSERTIONS, \
+        ( struct assertions_add_percentile_options ){ \
+            .expr = "p" #PERCENTILE " of " #HISTOGRAM " <= " #MAX, \
+            .histogram = HISTOGRAM, \
+            .percentile = PERCENTILE, \
+            .max = MAX \
+        } )
+
+
+#endif // ifndef INCLUDED_TESTC_HISTOGRAM_H
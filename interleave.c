@@ -0,0 +1,585 @@
+// interleave.c
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "interleave.h" // InterleaveStats, interleave_fn
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include <pthread.h>
+
+#include "assertion.h" // assertion_new_
+#include "heap.h" // heap_pause, heap_resume
+#include "property.h" // PropertyRng, property_rng_*, property_default_seed
+#include "_common.h" // MIN, MAX, untracked_*
+
+
+// The characters of a schedule, indexed by thread.
+static char const digits[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+
+
+// The `current` thread of a run when the scheduler is to choose the
+// next thread.
+#define SCHEDULER SIZE_MAX
+
+
+// The state of a run, shared by its threads and the scheduler.
+// Everything but `o` and `assertions` is guarded by `lock`; only one
+// thread runs at a time, so the `assertions` don't need to be.
+struct run {
+    struct interleave_run_options const * o;
+    Assertions * assertions;
+    pthread_mutex_t lock;
+    pthread_cond_t turn;
+    size_t current;
+    bool * finished;
+    bool * spinning;
+    bool * reading;
+    bool aborted;
+};
+
+
+struct thread_arg {
+    struct run * run;
+    size_t thread;
+};
+
+
+// The run and thread of the calling thread, if it's running in one.
+static _Thread_local struct run * active = NULL;
+static _Thread_local size_t active_thread = 0;
+
+
+static
+bool wait_for_turn( struct run * const r, size_t const thread )
+// Waits until the scheduler lets the given `thread` run, or aborts the
+// run. The caller should hold the lock. Returns whether the run was
+// aborted.
+{
+    while ( r->current != thread && !r->aborted ) {
+        pthread_cond_wait( &r->turn, &r->lock );
+    }
+    return r->aborted;
+}
+
+
+static
+void yield( bool const spin, bool const read )
+// Gives control of the active run back to the scheduler, and waits
+// until it gives control back to this thread.
+{
+    struct run * const r = active;
+    if ( r == NULL ) {
+        return;
+    }
+    pthread_mutex_lock( &r->lock );
+    r->spinning[ active_thread ] = spin;
+    r->reading[ active_thread ] = read;
+    r->current = SCHEDULER;
+    pthread_cond_broadcast( &r->turn );
+    bool const aborted = wait_for_turn( r, active_thread );
+    pthread_mutex_unlock( &r->lock );
+    if ( aborted ) {
+        pthread_exit( NULL );
+    }
+}
+
+
+void interleave_yield( void )
+{
+    yield( false, false );
+}
+
+
+void interleave_yield_read( void )
+{
+    yield( false, true );
+}
+
+
+void interleave_spin( void )
+{
+    yield( true, true );
+}
+
+
+static
+void finish( void * const arg )
+// Marks the thread of the given `struct thread_arg` as finished, whether
+// its function returned or it was ended by an aborted run.
+{
+    struct thread_arg const * const a = arg;
+    struct run * const r = a->run;
+    active = NULL;
+    pthread_mutex_lock( &r->lock );
+    r->finished[ a->thread ] = true;
+    r->current = SCHEDULER;
+    pthread_cond_broadcast( &r->turn );
+    pthread_mutex_unlock( &r->lock );
+}
+
+
+static
+void * thread_main( void * const arg )
+{
+    struct thread_arg a = *( struct thread_arg * ) arg;
+    struct run * const r = a.run;
+    pthread_mutex_lock( &r->lock );
+    bool const aborted = wait_for_turn( r, a.thread );
+    pthread_mutex_unlock( &r->lock );
+    pthread_cleanup_push( finish, &a );
+    if ( !aborted ) {
+        active = r;
+        active_thread = a.thread;
+        r->o->func( r->assertions, a.thread, r->o->ctx );
+    }
+    pthread_cleanup_pop( true );
+    return NULL;
+}
+
+
+// How the explorer chooses the thread to run at each step.
+enum mode {
+    DEPTH_FIRST,
+    RANDOM,
+    REPLAY
+};
+
+
+// A step of the depth-first search: the `chosen`th of the first
+// `allowed` candidates was run.
+struct choice {
+    size_t chosen;
+    size_t allowed;
+};
+
+
+// The state of an exploration, across its runs.
+struct explorer {
+    struct interleave_run_options o;
+    enum mode mode;
+    InterleaveStats stats;
+
+    // The candidates of the current step.
+    size_t * candidates;
+
+    // The choices of the last run, for `DEPTH_FIRST`.
+    struct choice * trail;
+    size_t trail_size;
+    size_t trail_capacity;
+
+    // The priorities of the threads, and the steps at which the running
+    // thread's is lowered, for `RANDOM`.
+    PropertyRng rng;
+    long long * priorities;
+    size_t * change_points;
+    size_t lowered;
+
+    // The schedule of the current run so far, with a step per byte, and
+    // how many of those steps were preemptions.
+    char * schedule;
+    size_t steps;
+    size_t schedule_capacity;
+    size_t preemptions;
+};
+
+
+static
+size_t find_candidates( struct explorer * const x, struct run const * const r,
+                        size_t const last, bool * const continuing )
+// Gives the threads that could run after the `last` thread in the
+// explorer's `candidates`, in the order that the depth-first search
+// tries them: the `last` thread first, if it can go on, and then the
+// others from the one after it. Threads that are spinning are only
+// candidates if every thread is. Returns how many there are.
+{
+    size_t const n = x->o.threads;
+    size_t const first = ( last == SCHEDULER ) ? 0 : last;
+    *continuing = last != SCHEDULER && !r->finished[ last ]
+                                    && !r->spinning[ last ];
+    size_t size = 0;
+    for ( int spinning = 0; spinning <= 1 && size == 0; spinning += 1 ) {
+        for ( size_t i = 0; i < n; i += 1 ) {
+            size_t const t = ( first + i ) % n;
+            if ( !r->finished[ t ] && r->spinning[ t ] == spinning ) {
+                x->candidates[ size ] = t;
+                size += 1;
+            }
+        }
+    }
+    return size;
+}
+
+
+static
+size_t choose( struct explorer * const x, size_t const last,
+               size_t const count, bool const continuing, bool const spun )
+// Returns the index of the candidate to run after the `last` thread,
+// which might have `spun`.
+{
+    switch ( x->mode ) {
+    case DEPTH_FIRST: {
+        // Which thread runs after a spin doesn't matter much, and the
+        // search would never end if it tried them all around a loop.
+        size_t const allowed =
+            ( spun || ( continuing && x->preemptions == x->o.preemptions ) )
+                ? 1 : count;
+        if ( x->steps < x->trail_size ) {
+            // This is a replay of the previous run up to its last
+            // choice, unless the test case isn't deterministic.
+            struct choice * const c = &x->trail[ x->steps ];
+            c->allowed = allowed;
+            c->chosen = ( c->chosen < allowed ) ? c->chosen : allowed - 1;
+            return c->chosen;
+        }
+        if ( x->trail_size == x->trail_capacity ) {
+            x->trail_capacity = ( x->trail_capacity == 0 )
+                              ? 64 : x->trail_capacity * 2;
+            x->trail = untracked_realloc( x->trail,
+                x->trail_capacity * sizeof ( struct choice ) );
+        }
+        x->trail[ x->trail_size ] = ( struct choice ){ .chosen = 0,
+                                                       .allowed = allowed };
+        x->trail_size += 1;
+        return 0;
+    }
+    case RANDOM: {
+        // A thread that spun has to wait for the others, so it's lowered
+        // like at a change point.
+        bool lower = spun;
+        for ( size_t i = 0; continuing && i < x->o.preemptions; i += 1 ) {
+            lower = lower || x->change_points[ i ] == x->steps;
+        }
+        if ( lower ) {
+            x->lowered += 1;
+            x->priorities[ last ] = -( long long ) x->lowered;
+        }
+        size_t best = 0;
+        for ( size_t i = 1; i < count; i += 1 ) {
+            if ( x->priorities[ x->candidates[ i ] ]
+               > x->priorities[ x->candidates[ best ] ] ) {
+                best = i;
+            }
+        }
+        return best;
+    }
+    case REPLAY: {
+        if ( x->steps < strlen( x->o.schedule ) ) {
+            char const * const d = strchr( digits, x->o.schedule[ x->steps ] );
+            for ( size_t i = 0; d != NULL && i < count; i += 1 ) {
+                if ( x->candidates[ i ] == ( size_t )( d - digits ) ) {
+                    return i;
+                }
+            }
+        }
+        return 0;
+    }
+    default:
+        assert( false );
+        return 0;
+    }
+}
+
+
+static
+void start_random( struct explorer * const x )
+// Gives the threads random priorities, and chooses the steps at which
+// they're lowered, for the next run.
+{
+    size_t const n = x->o.threads;
+    for ( size_t i = 0; i < n; i += 1 ) {
+        size_t const j = property_rng_next( &x->rng ) % ( i + 1 );
+        x->priorities[ i ] = x->priorities[ j ];
+        x->priorities[ j ] = i;
+    }
+    x->lowered = 0;
+    for ( size_t i = 0; i < x->o.preemptions; i += 1 ) {
+        x->change_points[ i ] = 1 + property_rng_next( &x->rng )
+                                    % MAX( x->stats.max_steps, 1 );
+    }
+}
+
+
+static
+bool next_depth_first( struct explorer * const x )
+// Changes the last choice of the trail that has another candidate to
+// the next candidate, and forgets the choices after it. Returns `false`
+// if there's no such choice, i.e. every schedule has been run.
+{
+    while ( x->trail_size > 0 ) {
+        struct choice * const c = &x->trail[ x->trail_size - 1 ];
+        if ( c->chosen + 1 < c->allowed ) {
+            c->chosen += 1;
+            return true;
+        }
+        x->trail_size -= 1;
+    }
+    return false;
+}
+
+
+static
+void add_step( struct explorer * const x, size_t const thread )
+{
+    if ( x->steps + 1 >= x->schedule_capacity ) {
+        x->schedule_capacity *= 2;
+        x->schedule = untracked_realloc( x->schedule, x->schedule_capacity );
+    }
+    x->schedule[ x->steps ] = digits[ thread ];
+    x->steps += 1;
+    x->schedule[ x->steps ] = '\0';
+}
+
+
+static
+char const * schedule_threads( struct explorer * const x,
+                               struct run * const r )
+// Chooses which thread of the run goes at each step, until they've all
+// finished. Returns why the run was aborted, or `NULL` if it wasn't.
+{
+    size_t last = SCHEDULER;
+    char const * reason = NULL;
+    pthread_mutex_lock( &r->lock );
+    while ( true ) {
+        while ( r->current != SCHEDULER ) {
+            pthread_cond_wait( &r->turn, &r->lock );
+        }
+        bool continuing;
+        size_t const count = find_candidates( x, r, last, &continuing );
+        bool const spun = last != SCHEDULER && r->spinning[ last ];
+        if ( count == 0 ) {
+            break;
+        } else if ( r->spinning[ x->candidates[ 0 ] ] ) {
+            reason = "every thread is waiting for another";
+        } else if ( x->steps == x->o.max_steps ) {
+            reason = "too many steps";
+        }
+        if ( reason != NULL ) {
+            r->aborted = true;
+            pthread_cond_broadcast( &r->turn );
+            break;
+        }
+        size_t const next = x->candidates[ choose( x, last, count,
+                                                   continuing, spun ) ];
+        if ( continuing && next != last ) {
+            x->preemptions += 1;
+        }
+        // The threads that were spinning might find that they can go on
+        // after another thread has written to the shared memory.
+        for ( size_t t = 0; !r->reading[ next ] && t < x->o.threads;
+              t += 1 ) {
+            r->spinning[ t ] = r->spinning[ t ] && t == next;
+        }
+        add_step( x, next );
+        last = next;
+        r->current = next;
+        pthread_cond_broadcast( &r->turn );
+    }
+    pthread_mutex_unlock( &r->lock );
+    return reason;
+}
+
+
+static
+void report( struct explorer const * const x, Assertions * const as,
+             Assertions const * const failed, char const * const reason )
+// Adds the failure of the current run, and the assertions that failed
+// in it, to the given `Assertions`.
+{
+    char * detail = NULL;
+    size_t size = 0;
+    heap_pause();
+    FILE * const out = open_memstream( &detail, &size );
+    heap_resume();
+    fprintf( out, "schedule \"%s\" (%zu preemption%s, %zu step%s)\n",
+             x->schedule, x->preemptions, ( x->preemptions == 1 ) ? "" : "s",
+             x->steps, ( x->steps == 1 ) ? "" : "s" );
+    if ( reason != NULL ) {
+        fprintf( out, "aborted: %s\n", reason );
+    }
+    assertions_print( false, .assertions = *failed, .file = out,
+                             .ids_indent = "  " );
+    heap_pause();
+    fclose( out );
+    heap_resume();
+    assertions_add_ptr( as, assertion_new_(
+        ( struct assertion_new_options ){
+            .expr = x->o.expr,
+            .result = false,
+            .ids = ( AssertionId[] ){
+                { .expr = "schedule",
+                  .value = ( long long ) x->stats.schedules },
+                { .expr = "preemptions",
+                  .value = ( long long ) x->preemptions },
+                { .expr = "steps", .value = ( long long ) x->steps },
+                ASSERTION_ID_ARRAY_END
+            },
+            .detail = detail
+        } ) );
+    heap_pause();
+    free( detail );
+    heap_resume();
+}
+
+
+static
+void run_once( struct explorer * const x, Assertions * const as )
+// Runs the test case once, with the schedule that the explorer chooses,
+// and adds whether it passed to the given `Assertions`.
+{
+    struct interleave_run_options const * const o = &x->o;
+    struct run r = {
+        .o = o,
+        .assertions = assertions_empty(),
+        .current = SCHEDULER,
+        .finished = untracked_calloc( o->threads, sizeof ( bool ) ),
+        .spinning = untracked_calloc( o->threads, sizeof ( bool ) ),
+        .reading = untracked_calloc( o->threads, sizeof ( bool ) )
+    };
+    pthread_mutex_init( &r.lock, NULL );
+    pthread_cond_init( &r.turn, NULL );
+    x->steps = 0;
+    x->schedule[ 0 ] = '\0';
+    x->preemptions = 0;
+    if ( x->mode == RANDOM ) {
+        start_random( x );
+    }
+    if ( o->init != NULL ) {
+        o->init( o->ctx );
+    }
+
+    pthread_t * const ids = untracked_malloc( o->threads
+                                              * sizeof ( pthread_t ) );
+    struct thread_arg * const args = untracked_malloc( o->threads
+                                                       * sizeof *args );
+    size_t started = 0;
+    while ( started < o->threads ) {
+        args[ started ] = ( struct thread_arg ){ .run = &r,
+                                                 .thread = started };
+        if ( pthread_create( &ids[ started ], NULL, thread_main,
+                             &args[ started ] ) != 0 ) {
+            break;
+        }
+        started += 1;
+    }
+    char const * reason = NULL;
+    if ( started == o->threads ) {
+        reason = schedule_threads( x, &r );
+    } else {
+        // The schedules need every thread, so abort the threads that
+        // did start before they run.
+        reason = "couldn't create a thread";
+        pthread_mutex_lock( &r.lock );
+        r.aborted = true;
+        pthread_cond_broadcast( &r.turn );
+        pthread_mutex_unlock( &r.lock );
+    }
+    for ( size_t i = 0; i < started; i += 1 ) {
+        pthread_join( ids[ i ], NULL );
+    }
+    if ( reason == NULL && o->check != NULL ) {
+        o->check( r.assertions, o->ctx );
+    }
+
+    x->stats.schedules += 1;
+    x->stats.max_steps = MAX( x->stats.max_steps, x->steps );
+    if ( x->mode == DEPTH_FIRST ) {
+        // Forget the choices past the end of this run, in case it was
+        // shorter than the last.
+        x->trail_size = MIN( x->trail_size, x->steps );
+    }
+    if ( reason == NULL && assertions_all_true( *r.assertions ) ) {
+        assertions_add_at_( as, ( struct assertions_add_at_options ){
+            .file = o->file, .line = o->line, .expr = o->expr,
+            .result = true } );
+    } else {
+        x->stats.failures += 1;
+        report( x, as, r.assertions, reason );
+    }
+    pthread_mutex_destroy( &r.lock );
+    pthread_cond_destroy( &r.turn );
+    assertions_free( r.assertions );
+    untracked_free( r.finished );
+    untracked_free( r.spinning );
+    untracked_free( r.reading );
+    untracked_free( ids );
+    untracked_free( args );
+}
+
+
+InterleaveStats interleave_run_( Assertions * const as,
+                                 struct interleave_run_options o )
+{
+    assert( as != NULL );
+    assert( o.func != NULL );
+    assert( o.expr != NULL );
+
+    o.threads = ( o.threads == 0 ) ? 2 : o.threads;
+    assert( o.threads <= sizeof digits - 1 );
+    o.preemptions = ( o.preemptions == 0 ) ? 2
+                  : ( o.preemptions == INTERLEAVE_NO_PREEMPTIONS ) ? 0
+                  : o.preemptions;
+    o.max_schedules = ( o.max_schedules == 0 ) ? 10000 : o.max_schedules;
+    o.random_schedules = ( o.random_schedules == 0 ) ? 1000
+                                                     : o.random_schedules;
+    o.seed = ( o.seed == 0 ) ? property_default_seed() : o.seed;
+    o.max_steps = ( o.max_steps == 0 ) ? 10000 : o.max_steps;
+    o.max_failures = ( o.max_failures == 0 ) ? 1 : o.max_failures;
+
+    struct explorer x = {
+        .o = o,
+        .candidates = untracked_malloc( o.threads * sizeof ( size_t ) ),
+        .rng = property_rng_new( o.seed ),
+        .priorities = untracked_calloc( o.threads, sizeof ( long long ) ),
+        .change_points = untracked_malloc( MAX( o.preemptions, 1 )
+                                           * sizeof ( size_t ) ),
+        .schedule = untracked_malloc( 64 ),
+        .schedule_capacity = 64
+    };
+    if ( o.schedule != NULL ) {
+        x.mode = REPLAY;
+        run_once( &x, as );
+    } else {
+        x.mode = DEPTH_FIRST;
+        while ( x.stats.schedules < o.max_schedules
+             && x.stats.failures < o.max_failures ) {
+            run_once( &x, as );
+            if ( !next_depth_first( &x ) ) {
+                x.stats.exhausted = true;
+                break;
+            }
+        }
+        x.mode = RANDOM;
+        for ( size_t i = 0; !x.stats.exhausted && i < o.random_schedules
+                         && x.stats.failures < o.max_failures; i += 1 ) {
+            run_once( &x, as );
+        }
+    }
+    untracked_free( x.candidates );
+    untracked_free( x.trail );
+    untracked_free( x.priorities );
+    untracked_free( x.change_points );
+    untracked_free( x.schedule );
+    return x.stats;
+}
@@ -0,0 +1,187 @@
+// interleave.h
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef INCLUDED_TESTC_INTERLEAVE_H
+#define INCLUDED_TESTC_INTERLEAVE_H
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "assertions.h" // Assertions
+
+
+// Interleaving exploration runs a small concurrent test case, e.g. two
+// threads pushing to and popping from a lock-free stack, over and over,
+// with a different schedule of its threads each time. The threads run
+// one at a time, and only switch at the points where the code under
+// test calls `interleave_yield()`, typically through the atomic
+// operation wrappers below. So, unlike a stress test, the schedule of
+// a run is chosen rather than left to luck, and a failing schedule can
+// be replayed exactly.
+//
+// Since only one thread runs at a time, the schedules that are explored
+// are those of a sequentially consistent memory; reorderings by weaker
+// memory orders aren't.
+//
+// A run that fails before its threads have finished, e.g. because every
+// thread is waiting for another, is aborted: each of its threads is
+// ended by `pthread_exit()` in the yield that it's waiting in, without
+// returning to its function. So a function shouldn't hold a lock or
+// other resource across a yield, unless it releases it in a handler of
+// `pthread_cleanup_push()`, which is run then.
+
+
+// The body of a thread of an interleaving test: it should run the given
+// `thread`'s part of the test case on the shared `ctx`, and make its
+// assertions to the given `Assertions`, which is shared by the threads
+// of the run.
+typedef void ( * interleave_fn )( Assertions *, size_t thread, void * ctx );
+
+
+// Lets another thread of an interleaving test run before the calling
+// thread continues, if the schedule says so. Outside of an interleaving
+// test, this does nothing, so the code under test can call it always.
+void interleave_yield( void );
+
+
+// Like `interleave_yield()`, before an operation that only reads the
+// shared memory.
+void interleave_yield_read( void );
+
+
+// Like `interleave_yield()`, for the body of a loop that waits for
+// another thread, e.g. of a spin lock: the calling thread doesn't run
+// again until another thread has run and may have written to the
+// shared memory, i.e. taken a step that didn't start with
+// `interleave_yield_read()`. A run where every thread is waiting like
+// this, or that takes more than `max_steps` steps, fails.
+void interleave_spin( void );
+
+
+// These wrap the generic functions of `<stdatomic.h>` of the same
+// names, and yield before the operation.
+#define interleave_load( OBJECT ) \
+    ( interleave_yield_read(), atomic_load( OBJECT ) )
+
+#define interleave_store( OBJECT, DESIRED ) \
+    ( interleave_yield(), atomic_store( OBJECT, DESIRED ) )
+
+#define interleave_exchange( OBJECT, DESIRED ) \
+    ( interleave_yield(), atomic_exchange( OBJECT, DESIRED ) )
+
+#define interleave_compare_exchange( OBJECT, EXPECTED, DESIRED ) \
+    ( interleave_yield(), \
+      atomic_compare_exchange_strong( OBJECT, EXPECTED, DESIRED ) )
+
+#define interleave_fetch_add( OBJECT, OPERAND ) \
+    ( interleave_yield(), atomic_fetch_add( OBJECT, OPERAND ) )
+
+#define interleave_fetch_sub( OBJECT, OPERAND ) \
+    ( interleave_yield(), atomic_fetch_sub( OBJECT, OPERAND ) )
+
+
+// The results of an interleaving test.
+typedef struct InterleaveStats {
+
+    // How many runs there were, each with its own schedule.
+    size_t schedules;
+
+    // How many of those runs failed.
+    size_t failures;
+
+    // The most steps (i.e. switches to a thread) of any run.
+    size_t max_steps;
+
+    // Whether every schedule with at most `preemptions` preemptions was
+    // run.
+    bool exhausted;
+
+} InterleaveStats;
+
+
+// The `preemptions` of an interleaving test that allows none, since `0`
+// means the default.
+#define INTERLEAVE_NO_PREEMPTIONS SIZE_MAX
+
+struct interleave_run_options {
+    char const * file;
+    int line;
+    char const * expr;
+    interleave_fn func;
+    size_t threads;
+    void * ctx;
+    void ( * init )( void * ctx );
+    void ( * check )( Assertions *, void * ctx );
+    size_t preemptions;
+    size_t max_schedules;
+    size_t random_schedules;
+    uint64_t seed;
+    size_t max_steps;
+    size_t max_failures;
+    char const * schedule;
+};
+
+InterleaveStats interleave_run_( Assertions * assertions,
+                                 struct interleave_run_options );
+
+// Takes an `Assertions *`, an `interleave_fn` expression, and some
+// options, and runs the function on `threads` threads (or `2` if `0`,
+// and at most `36`) under many schedules. Before each run, the `init`
+// function, if it's not `NULL`, should reset the `ctx` to the start of
+// the test case; after each run, the `check` function, if it's not
+// `NULL`, can make assertions about the state that the threads left.
+// For example:
+//      assertions_add_interleavings( as, push_or_pop, .threads = 3,
+//                                        .ctx = &stack,
+//                                        .init = stack_reset,
+//                                        .check = stack_is_consistent );
+//
+// First, the schedules with at most `preemptions` (or `2` if `0`, or
+// none if `INTERLEAVE_NO_PREEMPTIONS`) preemptions, i.e. switches away
+// from a thread that could have gone on, are run in a depth-first
+// order, until they've all been run or `max_schedules` (or `10000` if
+// `0`) have been. If they weren't all run, `random_schedules` (or
+// `1000` if `0`) more are run, which give each thread a random priority
+// from `seed` (or `property_default_seed()` if `0`; see `property.h`),
+// always run the highest-priority thread, and lower the priority of
+// the running thread at `preemptions` random steps (which is
+// "probabilistic concurrency testing").
+//
+// Whether each run passed is added to the given `Assertions`, until
+// `max_failures` (or `1` if `0`) runs have failed. A failed run is
+// identified by its number, its preemptions and its steps, and its
+// detail starts with its schedule, as a string of the thread that was
+// run at each step (`0` to `9`, then `a` to `z`), which is followed by
+// the assertions that failed in it. To run only that schedule, give
+// that string as the `schedule`, e.g. while debugging. The steps after
+// the end of the given `schedule` don't preempt. If the threads of a
+// run couldn't all be created, the run fails without calling `func`.
+#define assertions_add_interleavings( ASSERTIONS, FUNC, ... ) \
+    interleave_run_( ASSERTIONS, ( struct interleave_run_options ){ \
+        .file = __FILE__, \
+        .line = __LINE__, \
+        .expr = #FUNC " passes in every interleaving", \
+        .func = FUNC, \
+        __VA_ARGS__ \
+    } )
+
+
+#endif // ifndef INCLUDED_TESTC_INTERLEAVE_H
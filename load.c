@@ -0,0 +1,248 @@
+// load.c
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "load.h" // LoadCurve, LoadLevel, load_fn
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <assert.h>
+
+#include <pthread.h>
+
+#include "assertion.h" // assertion_new_
+#include "bench.h" // bench_now_ns
+#include "heap.h" // heap_pause, heap_resume
+#include "histogram.h" // Histogram, histogram_*
+#include "parallel.h" // parallel_default_threads
+#include "_common.h" // untracked_*, format_*
+
+
+// The state shared by the workers of a level.
+struct load {
+    struct load_measure_options const * o;
+    pthread_mutex_t gate;
+    pthread_barrier_t start;
+    atomic_bool stop;
+};
+
+
+struct worker {
+    struct load * load;
+    size_t index;
+    uint64_t ops;
+    Histogram * latencies;
+};
+
+
+static
+void * work( void * const arg )
+{
+    struct worker * const w = arg;
+    struct load * const l = w->load;
+    // Wait at the gate until every worker has been started, and then
+    // for the others, which the barrier is sized to.
+    pthread_mutex_lock( &l->gate );
+    pthread_mutex_unlock( &l->gate );
+    pthread_barrier_wait( &l->start );
+    // Each operation ends when the next begins, to halve the reads of
+    // the clock.
+    uint64_t begin = bench_now_ns();
+    while ( !atomic_load_explicit( &l->stop, memory_order_relaxed ) ) {
+        l->o->func( w->index, l->o->ctx );
+        uint64_t const end = bench_now_ns();
+        histogram_record( w->latencies, end - begin );
+        w->ops += 1;
+        begin = end;
+    }
+    return NULL;
+}
+
+
+static
+void sleep_until( uint64_t const deadline_ns )
+// Sleeps until `bench_now_ns()` reaches the given deadline.
+{
+    uint64_t now = bench_now_ns();
+    while ( now < deadline_ns ) {
+        uint64_t const left = deadline_ns - now;
+        struct timespec const t = { .tv_sec = left / 1000000000,
+                                    .tv_nsec = left % 1000000000 };
+        nanosleep( &t, NULL );
+        now = bench_now_ns();
+    }
+}
+
+
+static
+LoadLevel measure_level( struct load_measure_options const * const o,
+                         size_t const workers )
+// Drives the operation with the given number of workers for the
+// duration of a level, and returns its measurements, except for its
+// efficiency. If some workers couldn't be started, the level has fewer.
+{
+    struct load l = { .o = o };
+    atomic_init( &l.stop, false );
+    pthread_mutex_init( &l.gate, NULL );
+
+    // The gate is held until the workers are started, so that the
+    // barrier can be sized to the ones that were.
+    pthread_mutex_lock( &l.gate );
+    pthread_t * const ids = untracked_malloc( workers * sizeof ( pthread_t ) );
+    struct worker * const ws = untracked_malloc( workers * sizeof *ws );
+    size_t started = 0;
+    while ( started < workers ) {
+        ws[ started ] = ( struct worker ){ .load = &l,
+                                           .index = started,
+                                           .latencies = histogram_new() };
+        if ( pthread_create( &ids[ started ], NULL, work,
+                             &ws[ started ] ) != 0 ) {
+            histogram_free( ws[ started ].latencies );
+            break;
+        }
+        started += 1;
+    }
+    pthread_barrier_init( &l.start, NULL, started + 1 );
+    pthread_mutex_unlock( &l.gate );
+    pthread_barrier_wait( &l.start );
+    uint64_t const start = bench_now_ns();
+    sleep_until( start + o->duration_ns );
+    atomic_store( &l.stop, true );
+    Histogram * const latencies = histogram_new();
+    LoadLevel level = { .workers = started };
+    for ( size_t i = 0; i < started; i += 1 ) {
+        pthread_join( ids[ i ], NULL );
+        level.ops += ws[ i ].ops;
+        histogram_merge( latencies, ws[ i ].latencies );
+        histogram_free( ws[ i ].latencies );
+    }
+    level.ns = bench_now_ns() - start;
+    level.ops_per_s = level.ops * 1e9 / level.ns;
+    level.p50_ns = histogram_percentile( latencies, 50 );
+    level.p90_ns = histogram_percentile( latencies, 90 );
+    level.p99_ns = histogram_percentile( latencies, 99 );
+    level.p999_ns = histogram_percentile( latencies, 99.9 );
+    level.max_ns = latencies->max;
+    histogram_free( latencies );
+    pthread_barrier_destroy( &l.start );
+    pthread_mutex_destroy( &l.gate );
+    untracked_free( ids );
+    untracked_free( ws );
+    return level;
+}
+
+
+LoadCurve load_measure_( struct load_measure_options o )
+{
+    assert( o.func != NULL );
+
+    o.max_workers = ( o.max_workers == 0 ) ? parallel_default_threads()
+                                           : o.max_workers;
+    o.duration_ns = ( o.duration_ns == 0 ) ? 100000000 : o.duration_ns;
+
+    LoadCurve curve = { .size = 0 };
+    size_t workers = 1;
+    while ( curve.size < LOAD_MAX_LEVELS ) {
+        LoadLevel level = measure_level( &o, workers );
+        double const single = ( curve.size == 0 ) ? level.ops_per_s
+                            : curve.levels[ 0 ].ops_per_s;
+        level.efficiency = ( single == 0 || level.workers == 0 ) ? 0
+                         : level.ops_per_s / ( single * level.workers );
+        curve.levels[ curve.size ] = level;
+        curve.size += 1;
+        if ( workers == o.max_workers ) {
+            break;
+        }
+        workers = ( workers * 2 < o.max_workers ) ? workers * 2
+                                                  : o.max_workers;
+    }
+    return curve;
+}
+
+
+void load_curve_print_( struct load_curve_print_options const o )
+{
+    LoadCurve const curve = o.curve;
+    FILE * const file = ( o.file == NULL ) ? stdout : o.file;
+    char const * const indent = ( o.indent == NULL ) ? "" : o.indent;
+
+    fprintf( file, "%s%7s  %7s  %10s  %8s  %8s  %8s  %8s\n", indent,
+             "workers", "ops/s", "efficiency", "p50", "p99", "p99.9",
+             "max" );
+    for ( size_t i = 0; i < curve.size; i += 1 ) {
+        LoadLevel const l = curve.levels[ i ];
+        char rate[ 16 ];
+        char p50[ 16 ];
+        char p99[ 16 ];
+        char p999[ 16 ];
+        char max[ 16 ];
+        format_rate( rate, sizeof rate, l.ops_per_s );
+        format_duration( p50, sizeof p50, l.p50_ns );
+        format_duration( p99, sizeof p99, l.p99_ns );
+        format_duration( p999, sizeof p999, l.p999_ns );
+        format_duration( max, sizeof max, l.max_ns );
+        fprintf( file, "%s%7zu  %7s  %9.1f%%  %8s  %8s  %8s  %8s\n",
+                 indent, l.workers, rate, 100 * l.efficiency,
+                 p50, p99, p999, max );
+    }
+}
+
+
+void assertions_add_scaling_(
+        Assertions * const assertions,
+        struct assertions_add_scaling_options const o )
+{
+    assert( assertions != NULL );
+    assert( o.expr != NULL );
+
+    LoadCurve const curve = load_measure(
+        .func = o.func,
+        .ctx = o.ctx,
+        .max_workers = o.max_workers,
+        .duration_ns = o.duration_ns );
+    LoadLevel const last = curve.levels[ curve.size - 1 ];
+
+    char * table = NULL;
+    size_t size = 0;
+    heap_pause();
+    FILE * const file = open_memstream( &table, &size );
+    load_curve_print( .curve = curve, .file = file );
+    fclose( file );
+    heap_resume();
+
+    assertions_add_ptr( assertions, assertion_new_(
+        ( struct assertion_new_options ){
+            .expr = o.expr,
+            .result = last.efficiency >= o.min_efficiency,
+            .ids = ( AssertionId[] ){
+                { .expr = "workers", .value = ( long long ) last.workers },
+                { .expr = "efficiency_percent",
+                  .value = ( long long )( 100 * last.efficiency ) },
+                ASSERTION_ID_ARRAY_END
+            },
+            .detail = table
+        } ) );
+    heap_pause();
+    free( table );
+    heap_resume();
+}
@@ -0,0 +1,167 @@
+// load.h
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef INCLUDED_TESTC_LOAD_H
+#define INCLUDED_TESTC_LOAD_H
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "assertions.h" // Assertions
+
+
+// A load test drives an operation from 1, 2, 4, and so on up to N
+// workers at once, for a fixed time at each level. Each worker performs
+// the next operation as soon as its last one returns (i.e. the load is
+// "closed-loop"), so the throughput at each level is as much as the
+// operation allows, and how it grows with the workers tells how well
+// the operation scales.
+
+
+// The most concurrency levels that a load test can measure.
+#define LOAD_MAX_LEVELS 32
+
+
+// An operation to drive, performed by the given `worker`, given its
+// context. It's called from many threads at once.
+typedef void ( * load_fn )( size_t worker, void * ctx );
+
+
+// The measurements of a concurrency level.
+typedef struct LoadLevel {
+
+    // How many workers performed the operation at once. This is fewer
+    // than the level asked for if some of their threads couldn't be
+    // created.
+    size_t workers;
+
+    // How many operations they performed in total, and how long the
+    // level took, in nanoseconds.
+    uint64_t ops;
+    uint64_t ns;
+
+    // How many operations were performed per second.
+    double ops_per_s;
+
+    // The throughput relative to that of a single worker, times the
+    // workers: `1` if the operation scaled perfectly up to this level.
+    double efficiency;
+
+    // The percentiles and the maximum of the latencies of the
+    // operations, in nanoseconds.
+    uint64_t p50_ns;
+    uint64_t p90_ns;
+    uint64_t p99_ns;
+    uint64_t p999_ns;
+    uint64_t max_ns;
+
+} LoadLevel;
+
+
+// The measurements of every concurrency level of a load test.
+typedef struct LoadCurve {
+
+    // How many levels were measured.
+    size_t size;
+
+    // The levels, in the order of their workers.
+    LoadLevel levels[ LOAD_MAX_LEVELS ];
+
+    // Invariants:
+    // - `size` is at least `1`, and at most `LOAD_MAX_LEVELS`
+    // - `levels[ 0 ].workers` is `1`
+
+} LoadCurve;
+
+
+struct load_measure_options {
+    load_fn func;
+    void * ctx;
+    size_t max_workers;
+    uint64_t duration_ns;
+};
+
+LoadCurve load_measure_( struct load_measure_options );
+
+// Drives the given `func` with 1, 2, 4, and so on up to `max_workers`
+// workers (or `parallel_default_threads()` if `0`; see `parallel.h`),
+// which is always the last level, for `duration_ns` nanoseconds (or 100
+// milliseconds if `0`) at each level, and returns the measurements of
+// each level. For example:
+//      LoadCurve const curve = load_measure( .func = lookup,
+//                                            .ctx = table,
+//                                            .max_workers = 16 );
+#define load_measure( ... ) \
+    load_measure_( ( struct load_measure_options ){ __VA_ARGS__ } )
+
+
+struct load_curve_print_options {
+    LoadCurve curve;
+    FILE * file;
+    char const * indent;
+};
+
+void load_curve_print_( struct load_curve_print_options );
+
+// Prints a table of the levels of the given `curve` to the `file` (or
+// `stdout` if `NULL`), indenting each line with `indent` (or `""` if
+// `NULL`). For example:
+//      workers    ops/s  efficiency       p50       p99     p99.9       max
+//            1    4.12M      100.0%    230 ns    410 ns    1.2 us   38.1 us
+//            2    7.93M       96.2%    240 ns    450 ns   1.94 us   41.7 us
+//            4    9.81M       59.5%    390 ns   1.13 us     12 us    203 us
+#define load_curve_print( ... ) \
+    load_curve_print_( ( struct load_curve_print_options ){ \
+        __VA_ARGS__ \
+    } )
+
+
+struct assertions_add_scaling_options {
+    char const * expr;
+    double min_efficiency;
+    load_fn func;
+    void * ctx;
+    size_t max_workers;
+    uint64_t duration_ns;
+};
+
+void assertions_add_scaling_( Assertions * assertions,
+                              struct assertions_add_scaling_options );
+
+// Takes an `Assertions *`, a `load_fn` expression, a minimum efficiency
+// (from `0` to `1`), and some `load_measure()` options, measures the
+// function, and adds an assertion that its efficiency at the last level
+// is at least that minimum. The assertion is identified by the workers
+// of the last level and its efficiency as a percentage, and the table
+// of `load_curve_print()` is its detail. For example:
+//      assertions_add_scaling( as, lookup, 0.8, .ctx = table,
+//                                               .max_workers = 16 );
+#define assertions_add_scaling( ASSERTIONS, FUNC, MIN_EFFICIENCY, ... ) \
+    assertions_add_scaling_( ASSERTIONS, \
+        ( struct assertions_add_scaling_options ){ \
+            .expr = "scaling efficiency of " #FUNC " >= " #MIN_EFFICIENCY, \
+            .min_efficiency = MIN_EFFICIENCY, \
+            .func = FUNC, \
+            __VA_ARGS__ \
+        } )
+
+
+#endif // ifndef INCLUDED_TESTC_LOAD_H
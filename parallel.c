@@ -0,0 +1,231 @@
+// parallel.c
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "parallel.h" // parallel_body, parallel_for_
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <assert.h>
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include "_common.h" // MIN
+#include "heap.h" // heap_pause, heap_resume
+
+
+size_t parallel_default_threads( void )
+{
+    char const * const env = getenv( "TESTC_THREADS" );
+    if ( env != NULL ) {
+        long const threads = strtol( env, NULL, 10 );
+        if ( threads > 0 ) {
+            return threads;
+        }
+    }
+    long const processors = sysconf( _SC_NPROCESSORS_ONLN );
+    return ( processors > 0 ) ? ( size_t ) processors : 1;
+}
+
+
+// The state shared by the threads of a `parallel_for()`.
+struct loop {
+    Assertions * assertions;
+    struct parallel_for_options o;
+    size_t chunks;
+    atomic_size_t next;
+
+    // These are guarded by the pool's `lock`: how many more workers of
+    // the pool may join this loop, how many have joined it and not yet
+    // left, and the next loop waiting for workers.
+    size_t wanted;
+    size_t helpers;
+    struct loop * waiting;
+};
+
+
+// The workers that help with every `parallel_for()`. They're started as
+// they're first needed, and then wait for loops until the process
+// exits, so that a test that runs many short loops doesn't pay for
+// creating and joining threads on each of them.
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t work;    // signalled when a loop is added
+    pthread_cond_t left;    // broadcast when a worker leaves a loop
+    size_t workers;
+    struct loop * waiting;  // the loops that want more workers
+} pool = { .lock = PTHREAD_MUTEX_INITIALIZER,
+           .work = PTHREAD_COND_INITIALIZER,
+           .left = PTHREAD_COND_INITIALIZER };
+
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+
+
+static
+void run_chunks( struct loop * const loop )
+// Runs the next chunk of the given `struct loop` until there are none
+// left.
+{
+    while ( true ) {
+        size_t const c = atomic_fetch_add( &loop->next, 1 );
+        if ( c >= loop->chunks ) {
+            return;
+        }
+        size_t const begin = loop->o.begin + c * loop->o.chunk;
+        size_t const end = MIN( begin + loop->o.chunk, loop->o.end );
+        loop->o.body( assertions_worker( *( loop->assertions ), c ),
+                      begin, end, loop->o.ctx );
+    }
+}
+
+
+static
+void remove_waiting( struct loop * const loop )
+// Removes the given loop from the pool's waiting loops, if it's there.
+// The pool's lock must be held.
+{
+    struct loop ** l = &pool.waiting;
+    while ( *l != NULL && *l != loop ) {
+        l = &( *l )->waiting;
+    }
+    if ( *l != NULL ) {
+        *l = loop->waiting;
+    }
+}
+
+
+static
+void * pool_worker( void * const arg )
+// Joins the waiting loops of the pool, forever.
+{
+    ( void ) arg;
+    pthread_mutex_lock( &pool.lock );
+    while ( true ) {
+        while ( pool.waiting == NULL ) {
+            pthread_cond_wait( &pool.work, &pool.lock );
+        }
+        struct loop * const loop = pool.waiting;
+        loop->wanted -= 1;
+        loop->helpers += 1;
+        if ( loop->wanted == 0 ) {
+            pool.waiting = loop->waiting;
+        }
+        pthread_mutex_unlock( &pool.lock );
+        run_chunks( loop );
+        pthread_mutex_lock( &pool.lock );
+        loop->helpers -= 1;
+        pthread_cond_broadcast( &pool.left );
+    }
+    return NULL;
+}
+
+
+static
+void reset_pool( void )
+// Forgets the workers of the pool in a forked child, which only has the
+// thread that forked.
+{
+    pthread_mutex_init( &pool.lock, NULL );
+    pthread_cond_init( &pool.work, NULL );
+    pthread_cond_init( &pool.left, NULL );
+    pool.workers = 0;
+    pool.waiting = NULL;
+}
+
+
+static
+void register_reset_pool( void )
+{
+    pthread_atfork( NULL, NULL, reset_pool );
+}
+
+
+static
+void grow_pool( size_t const workers )
+// Starts workers until the pool has the given number of them, or until
+// one can't be started. The pool's lock must be held.
+{
+    pthread_once( &pool_once, register_reset_pool );
+    // The memory of the workers isn't the caller's to account for.
+    heap_pause();
+    pthread_attr_t attr;
+    pthread_attr_init( &attr );
+    pthread_attr_setdetachstate( &attr, PTHREAD_CREATE_DETACHED );
+    pthread_t id;
+    while ( pool.workers < workers
+         && pthread_create( &id, &attr, pool_worker, NULL ) == 0 ) {
+        pool.workers += 1;
+    }
+    pthread_attr_destroy( &attr );
+    heap_resume();
+}
+
+
+void parallel_for_( Assertions * const as,
+                    struct parallel_for_options o )
+{
+    assert( as != NULL );
+    assert( as->workers_size == 0 );
+    assert( o.body != NULL );
+    assert( o.begin <= o.end );
+
+    size_t const size = o.end - o.begin;
+    if ( size == 0 ) {
+        return;
+    }
+    size_t const threads = ( o.threads == 0 ) ? parallel_default_threads()
+                                              : o.threads;
+    if ( o.chunk == 0 ) {
+        o.chunk = ( size + threads * 16 - 1 ) / ( threads * 16 );
+    }
+    struct loop loop = { .assertions = as,
+                         .o = o,
+                         .chunks = ( size + o.chunk - 1 ) / o.chunk };
+    atomic_init( &loop.next, 0 );
+    assertions_set_workers( as, loop.chunks );
+
+    // This thread is one of the workers, so the loop finishes even if
+    // every worker of the pool is busy with other loops (or this loop
+    // is run by one of them).
+    loop.wanted = MIN( threads, loop.chunks ) - 1;
+    bool const helped = loop.wanted > 0;
+    if ( helped ) {
+        pthread_mutex_lock( &pool.lock );
+        grow_pool( loop.wanted );
+        loop.waiting = pool.waiting;
+        pool.waiting = &loop;
+        pthread_cond_broadcast( &pool.work );
+        pthread_mutex_unlock( &pool.lock );
+    }
+    run_chunks( &loop );
+    if ( helped ) {
+        pthread_mutex_lock( &pool.lock );
+        if ( loop.wanted > 0 ) {
+            remove_waiting( &loop );
+            loop.wanted = 0;
+        }
+        while ( loop.helpers > 0 ) {
+            pthread_cond_wait( &pool.left, &pool.lock );
+        }
+        pthread_mutex_unlock( &pool.lock );
+    }
+    assertions_join( as );
+}
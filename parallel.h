@@ -0,0 +1,73 @@
+// parallel.h
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef INCLUDED_TESTC_PARALLEL_H
+#define INCLUDED_TESTC_PARALLEL_H
+
+
+#include <stddef.h>
+
+#include "assertions.h" // Assertions
+
+
+// The body of a parallel loop: it should make its assertions for each
+// index from `begin` up to (but not including) `end` to the given
+// `Assertions`, which belongs to the calling thread.
+typedef void ( * parallel_body )( Assertions * assertions,
+                                  size_t begin, size_t end, void * ctx );
+
+
+// Returns how many threads `parallel_for()` uses by default:
+// `$TESTC_THREADS` if it's set to a positive number, or otherwise the
+// number of online processors.
+size_t parallel_default_threads( void );
+
+
+struct parallel_for_options {
+    size_t begin;
+    size_t end;
+    parallel_body body;
+    void * ctx;
+    size_t threads;
+    size_t chunk;
+};
+
+void parallel_for_( Assertions * assertions, struct parallel_for_options );
+
+// Runs the given `body` over the indexes from `begin` up to `end`,
+// split into chunks of `chunk` indexes (or, if `0`, enough for about
+// sixteen chunks per thread), on `threads` threads (or
+// `parallel_default_threads()` if `0`). Each thread takes the next
+// chunk as soon as it finishes its last, so uneven chunks are balanced.
+// The calling thread is one of them, and the others are taken from a
+// pool that's grown as it's needed and kept until the process exits.
+// Each chunk makes its assertions to its own buffer, which are added to
+// the given `Assertions` in the order of the indexes, so the result is
+// the same as if the whole range was run on a single thread. For
+// example:
+//      parallel_for( as, .end = size, .body = check_range, .ctx = xs );
+//
+// The given `Assertions` can't have worker buffers of its own (see
+// `assertions_set_workers()`) while this runs.
+#define parallel_for( ASSERTIONS, ... ) \
+    parallel_for_( ASSERTIONS, ( struct parallel_for_options ){ \
+        __VA_ARGS__ \
+    } )
+
+
+#endif // ifndef INCLUDED_TESTC_PARALLEL_H
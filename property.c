@@ -0,0 +1,478 @@
+// property.c
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "property.h" // Property, PropertyRng, property_*
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <assert.h>
+
+#include <unistd.h>
+
+#include "assertion.h" // assertion_new_
+#include "heap.h" // heap_pause, heap_resume
+#include "parallel.h" // parallel_for
+#include "_common.h" // untracked_*
+
+
+static
+uint64_t splitmix( uint64_t * const state )
+// Returns the next number of the SplitMix64 generator with the given
+// state, which is what xoshiro's authors recommend for seeding it.
+{
+    uint64_t z = ( *state += 0x9e3779b97f4a7c15ULL );
+    z = ( z ^ ( z >> 30 ) ) * 0xbf58476d1ce4e5b9ULL;
+    z = ( z ^ ( z >> 27 ) ) * 0x94d049bb133111ebULL;
+    return z ^ ( z >> 31 );
+}
+
+
+PropertyRng property_rng_new( uint64_t seed )
+{
+    PropertyRng rng;
+    for ( size_t i = 0; i < 4; i += 1 ) {
+        rng.s[ i ] = splitmix( &seed );
+    }
+    return rng;
+}
+
+
+static
+uint64_t rotl( uint64_t const x, int const k )
+{
+    return ( x << k ) | ( x >> ( 64 - k ) );
+}
+
+
+uint64_t property_rng_next( PropertyRng * const rng )
+{
+    uint64_t * const s = rng->s;
+    uint64_t const result = rotl( s[ 1 ] * 5, 7 ) * 9;
+    uint64_t const t = s[ 1 ] << 17;
+    s[ 2 ] ^= s[ 0 ];
+    s[ 3 ] ^= s[ 1 ];
+    s[ 1 ] ^= s[ 2 ];
+    s[ 0 ] ^= s[ 3 ];
+    s[ 2 ] ^= t;
+    s[ 3 ] = rotl( s[ 3 ], 45 );
+    return result;
+}
+
+
+uint64_t property_draw( Property * const p )
+{
+    assert( p != NULL );
+
+    if ( p->replaying && p->drawn < p->choices_size ) {
+        p->drawn += 1;
+        return p->choices[ p->drawn - 1 ];
+    }
+    // A fresh choice, or a zero past the end of a replayed sequence.
+    if ( p->choices_size == p->choices_capacity ) {
+        p->choices_capacity = ( p->choices_capacity == 0 )
+                            ? 64 : p->choices_capacity * 2;
+        p->choices = untracked_realloc( p->choices,
+            p->choices_capacity * sizeof ( uint64_t ) );
+    }
+    uint64_t const choice = p->replaying ? 0 : property_rng_next( &p->rng );
+    p->choices[ p->choices_size ] = choice;
+    p->choices_size += 1;
+    p->drawn += 1;
+    return choice;
+}
+
+
+static
+uint64_t draw_below( Property * const p, uint64_t const bound )
+// Returns a choice less than `bound` (or any choice if it's `0`), and
+// records that as the choice, so that shrinking works on the value
+// itself rather than the random number it came from.
+{
+    uint64_t const choice = property_draw( p );
+    if ( bound == 0 ) {
+        return choice;
+    }
+    uint64_t const value = choice % bound;
+    p->choices[ p->drawn - 1 ] = value;
+    return value;
+}
+
+
+bool property_bool( Property * const p )
+{
+    return draw_below( p, 2 ) == 1;
+}
+
+
+uint64_t property_uint( Property * const p, uint64_t const max )
+{
+    return draw_below( p, max + 1 );
+}
+
+
+int64_t property_int( Property * const p, int64_t const min, int64_t const max )
+{
+    assert( min <= max );
+
+    // Draw which side of the value closest to zero, and then how far
+    // from it, so that each choice shrinks towards it.
+    int64_t const base = ( min > 0 ) ? min : ( max < 0 ) ? max : 0;
+    uint64_t const above = ( uint64_t ) max - ( uint64_t ) base;
+    uint64_t const below = ( uint64_t ) base - ( uint64_t ) min;
+    bool const up = ( below == 0 )
+                 || ( above != 0 && draw_below( p, 2 ) == 0 );
+    uint64_t const offset = draw_below( p, ( up ? above : below ) + 1 );
+    return up ? ( int64_t ) ( ( uint64_t ) base + offset )
+              : ( int64_t ) ( ( uint64_t ) base - offset );
+}
+
+
+size_t property_choose( Property * const p, size_t const count )
+{
+    assert( count > 0 );
+    return draw_below( p, count );
+}
+
+
+size_t property_bytes( Property * const p, uint8_t * const buffer,
+                       size_t const max_size )
+{
+    size_t const size = property_uint( p, max_size );
+    for ( size_t i = 0; i < size; i += 1 ) {
+        buffer[ i ] = draw_below( p, 256 );
+    }
+    return size;
+}
+
+
+// The printable ASCII characters, simplest first.
+static char const alphabet[] =
+    "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789"
+    " !\"#$%&'()*+,-./:;<=>?@[\\]^_`{|}~";
+
+
+size_t property_string( Property * const p, char * const buffer,
+                        size_t const max_size )
+{
+    assert( max_size > 0 );
+    size_t const length = property_uint( p, max_size - 1 );
+    for ( size_t i = 0; i < length; i += 1 ) {
+        buffer[ i ] = alphabet[ draw_below( p, sizeof alphabet - 1 ) ];
+    }
+    buffer[ length ] = '\0';
+    return length;
+}
+
+
+size_t property_array( Property * const p, property_gen const gen,
+                       void * const array, size_t const element_size,
+                       size_t const max_count )
+{
+    assert( gen != NULL );
+    size_t const count = property_uint( p, max_count );
+    for ( size_t i = 0; i < count; i += 1 ) {
+        gen( p, ( char * ) array + i * element_size );
+    }
+    return count;
+}
+
+
+void property_one_of( Property * const p, property_gen const * const gens,
+                      size_t const count, void * const out )
+{
+    assert( gens != NULL );
+    gens[ property_choose( p, count ) ]( p, out );
+}
+
+
+void property_note( Property * const p, char const * const format, ... )
+{
+    if ( p->notes == NULL ) {
+        return;
+    }
+    va_list args;
+    va_start( args, format );
+    vfprintf( p->notes, format, args );
+    va_end( args );
+    fputc( '\n', p->notes );
+}
+
+
+uint64_t property_default_seed( void )
+{
+    char const * const env = getenv( "TESTC_SEED" );
+    if ( env != NULL && env[ 0 ] != '\0' ) {
+        return strtoull( env, NULL, 10 );
+    }
+    struct timespec t;
+    clock_gettime( CLOCK_REALTIME, &t );
+    uint64_t state = ( uint64_t ) t.tv_sec * 1000000000 + t.tv_nsec
+                   + ( uint64_t ) getpid();
+    // Keep the seed positive as an `AssertionId` value.
+    return splitmix( &state ) >> 1;
+}
+
+
+static
+uint64_t case_seed( uint64_t const seed, size_t const index )
+// Returns the seed of the case at the given `index` of a run.
+{
+    uint64_t state = seed ^ ( ( uint64_t ) index * 0xd1b54a32d192ed03ULL );
+    return splitmix( &state );
+}
+
+
+static
+bool fails( struct assertions_add_property_options const * const o,
+            Property * const p )
+// Runs the property on the given case from the start, and returns
+// whether it failed. If the case is replayed, its choices are replaced
+// by those that it drew.
+{
+    p->drawn = 0;
+    if ( !p->replaying ) {
+        p->choices_size = 0;
+    }
+    bool const holds = o->func( p, o->ctx );
+    p->choices_size = p->drawn;
+    return !holds;
+}
+
+
+// The state shared by the threads checking the cases of a property.
+struct check {
+    struct assertions_add_property_options const * o;
+    atomic_size_t first_failed;
+};
+
+
+static
+void check_cases( Assertions * const as,
+                  size_t const begin, size_t const end,
+                  void * const ctx )
+// Runs the cases from `begin` up to `end`, until one fails or there's
+// already an earlier failure.
+{
+    struct check * const c = ctx;
+    Property p = { .choices = NULL };
+    for ( size_t i = begin; i < end && i < atomic_load( &c->first_failed );
+          i += 1 ) {
+        p.rng = property_rng_new( case_seed( c->o->seed, i ) );
+        if ( fails( c->o, &p ) ) {
+            size_t first = atomic_load( &c->first_failed );
+            while ( i < first && !atomic_compare_exchange_weak(
+                                     &c->first_failed, &first, i ) ) {
+            }
+            break;
+        }
+    }
+    untracked_free( p.choices );
+}
+
+
+static
+bool is_simpler( uint64_t const * const a, size_t const a_size,
+                 uint64_t const * const b, size_t const b_size )
+// Returns `true` if the choices `a` are shorter than the choices `b`,
+// or the same length and lexicographically smaller.
+{
+    if ( a_size != b_size ) {
+        return a_size < b_size;
+    }
+    for ( size_t i = 0; i < a_size; i += 1 ) {
+        if ( a[ i ] != b[ i ] ) {
+            return a[ i ] < b[ i ];
+        }
+    }
+    return false;
+}
+
+
+// The state of shrinking a failed case.
+struct shrink {
+    struct assertions_add_property_options const * o;
+    Property best;
+    Property candidate;
+    size_t runs;
+};
+
+
+static
+bool try_candidate( struct shrink * const s )
+// Replays the candidate, and makes it the best case if it still fails
+// and it's simpler. Returns whether it did.
+{
+    s->runs += 1;
+    Property * const c = &s->candidate;
+    if ( !fails( s->o, c )
+      || !is_simpler( c->choices, c->choices_size,
+                      s->best.choices, s->best.choices_size ) ) {
+        return false;
+    }
+    Property const best = s->best;
+    s->best = *c;
+    s->candidate = best;
+    return true;
+}
+
+
+static
+void set_candidate( struct shrink * const s, size_t const delete_at,
+                    size_t const delete_size )
+// Makes the candidate a copy of the best case without the choices from
+// `delete_at`, of which there are `delete_size`.
+{
+    Property * const c = &s->candidate;
+    size_t const size = s->best.choices_size - delete_size;
+    if ( c->choices_capacity < s->best.choices_size ) {
+        c->choices_capacity = s->best.choices_capacity;
+        c->choices = untracked_realloc( c->choices,
+                                        c->choices_capacity
+                                        * sizeof ( uint64_t ) );
+    }
+    memcpy( c->choices, s->best.choices, delete_at * sizeof ( uint64_t ) );
+    memcpy( c->choices + delete_at,
+            s->best.choices + delete_at + delete_size,
+            ( size - delete_at ) * sizeof ( uint64_t ) );
+    c->choices_size = size;
+}
+
+
+static
+bool shrink_pass( struct shrink * const s )
+// Tries to delete blocks of choices, and then to make each choice
+// smaller. Returns whether the best case changed.
+{
+    bool shrunk = false;
+    for ( size_t k = 8; k > 0; k /= 2 ) {
+        size_t i = 0;
+        while ( i + k <= s->best.choices_size && s->runs < s->o->max_shrinks ) {
+            set_candidate( s, i, k );
+            if ( try_candidate( s ) ) {
+                shrunk = true;
+            } else {
+                i += 1;
+            }
+        }
+    }
+    for ( size_t i = 0; i < s->best.choices_size
+                     && s->runs < s->o->max_shrinks; i += 1 ) {
+        // Search for the smallest value that still fails, assuming that
+        // values below a passing one pass too.
+        uint64_t low = 0;
+        while ( i < s->best.choices_size && low < s->best.choices[ i ]
+             && s->runs < s->o->max_shrinks ) {
+            uint64_t const high = s->best.choices[ i ];
+            uint64_t const mid = ( low == 0 ) ? 0 : low + ( high - low ) / 2;
+            set_candidate( s, 0, 0 );
+            s->candidate.choices[ i ] = mid;
+            if ( try_candidate( s ) ) {
+                shrunk = true;
+            } else if ( mid + 1 >= high ) {
+                break;
+            } else {
+                low = mid + 1;
+            }
+        }
+    }
+    return shrunk;
+}
+
+
+void assertions_add_property_( Assertions * const as,
+                               struct assertions_add_property_options o )
+{
+    assert( as != NULL );
+    assert( o.expr != NULL );
+    assert( o.func != NULL );
+    o.cases = ( o.cases == 0 ) ? 1000 : o.cases;
+    o.seed = ( o.seed == 0 ) ? property_default_seed() : o.seed;
+    o.max_shrinks = ( o.max_shrinks == 0 ) ? 10000 : o.max_shrinks;
+
+    struct check c = { .o = &o };
+    atomic_init( &c.first_failed, o.cases );
+    Assertions * const ignored = assertions_empty();
+    parallel_for( ignored, .end = o.cases, .body = check_cases, .ctx = &c,
+                           .threads = o.threads );
+    assertions_free( ignored );
+    size_t const failed = atomic_load( &c.first_failed );
+    if ( failed == o.cases ) {
+        assertions_add_ptr( as, assertion_new_(
+            ( struct assertion_new_options ){
+                .expr = o.expr,
+                .result = true,
+                .ids = ( AssertionId[] ){
+                    { .expr = "seed", .value = ( long long ) o.seed },
+                    { .expr = "cases", .value = ( long long ) o.cases },
+                    ASSERTION_ID_ARRAY_END
+                }
+            } ) );
+        return;
+    }
+
+    // Regenerate the failed case, shrink it, and replay the result to
+    // take its notes.
+    struct shrink s = { .o = &o };
+    s.best.rng = property_rng_new( case_seed( o.seed, failed ) );
+    fails( &o, &s.best );
+    s.best.replaying = true;
+    s.candidate.replaying = true;
+    while ( s.runs < o.max_shrinks && shrink_pass( &s ) ) {
+    }
+    char * notes = NULL;
+    size_t size = 0;
+    heap_pause();
+    s.best.notes = open_memstream( &notes, &size );
+    heap_resume();
+    bool const still_fails = fails( &o, &s.best );
+    fprintf( s.best.notes, "%s after %zu shrink%s; replay with "
+                           "TESTC_SEED=%llu",
+             still_fails ? "counterexample" : "flaky counterexample",
+             s.runs, ( s.runs == 1 ) ? "" : "s",
+             ( unsigned long long ) o.seed );
+    heap_pause();
+    fclose( s.best.notes );
+    heap_resume();
+
+    assertions_add_ptr( as, assertion_new_(
+        ( struct assertion_new_options ){
+            .expr = o.expr,
+            .result = false,
+            .ids = ( AssertionId[] ){
+                { .expr = "seed", .value = ( long long ) o.seed },
+                { .expr = "case", .value = ( long long ) failed },
+                { .expr = "choices",
+                  .value = ( long long ) s.best.choices_size },
+                ASSERTION_ID_ARRAY_END
+            },
+            .detail = notes
+        } ) );
+    heap_pause();
+    free( notes );
+    heap_resume();
+    untracked_free( s.best.choices );
+    untracked_free( s.candidate.choices );
+}
@@ -0,0 +1,187 @@
+// property.h
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef INCLUDED_TESTC_PROPERTY_H
+#define INCLUDED_TESTC_PROPERTY_H
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "assertions.h" // Assertions
+
+
+// A property is a function that should return `true` for every input
+// that its generators can draw. Each case of a property draws its input
+// from a sequence of choices: fresh random numbers when the case is
+// generated, or a recorded sequence when it's replayed. When a case
+// fails, its sequence is shrunk, by deleting choices and making them
+// smaller, for as long as the property still fails, so the reported
+// counterexample is usually minimal. Every generator draws smaller
+// values from smaller choices, so shrinking works through combinators
+// without any help.
+
+
+// A fast pseudo-random number generator (xoshiro256**).
+typedef struct PropertyRng {
+    uint64_t s[ 4 ];
+} PropertyRng;
+
+
+// Returns a generator seeded by the given `seed`, which may be `0`.
+PropertyRng property_rng_new( uint64_t seed );
+
+
+// Returns the next number from the given generator.
+uint64_t property_rng_next( PropertyRng * rng );
+
+
+// The state of a case of a property, which its generators draw from.
+typedef struct Property {
+
+    // The generator of fresh choices, if the case isn't being replayed.
+    PropertyRng rng;
+
+    // The choices that the case has drawn, or that it's replaying.
+    uint64_t * choices;
+    size_t choices_size;
+    size_t choices_capacity;
+
+    // How many of the `choices` the case has drawn.
+    size_t drawn;
+
+    // Whether the case is replaying `choices`, rather than generating
+    // them. A replayed case that draws past its choices gets zeros.
+    bool replaying;
+
+    // If not `NULL`, where `property_note()` writes to.
+    FILE * notes;
+
+    // Invariants:
+    // - `choices_size <= choices_capacity`
+    // - `choices` is `NULL` if and only if `choices_capacity` is `0`
+    // - `drawn <= choices_size` if `replaying` is `false`
+
+} Property;
+
+
+// Returns a choice of the given case: its next fresh random number, or
+// its next recorded choice. The generators below are built on this.
+uint64_t property_draw( Property * p );
+
+
+// Returns a `bool`, which shrinks to `false`.
+bool property_bool( Property * p );
+
+
+// Returns an integer from `0` to `max` inclusive, which shrinks to `0`.
+uint64_t property_uint( Property * p, uint64_t max );
+
+
+// Returns an integer from `min` to `max` inclusive, which shrinks to
+// whichever of them is closest to `0`, or to `0` if it's between them.
+int64_t property_int( Property * p, int64_t min, int64_t max );
+
+
+// Returns an index from `0` to `count` (which isn't `0`) exclusive, e.g.
+// to choose between generators. It shrinks to `0`.
+size_t property_choose( Property * p, size_t count );
+
+
+// Fills the given `buffer` with up to `max_size` random bytes, and
+// returns how many. It shrinks to fewer, smaller bytes.
+size_t property_bytes( Property * p, uint8_t * buffer, size_t max_size );
+
+
+// Fills the given `buffer` with a null-terminated string of up to
+// `max_size - 1` printable ASCII characters, and returns its length. It
+// shrinks to fewer characters, and then to letters.
+size_t property_string( Property * p, char * buffer, size_t max_size );
+
+
+// A generator of values of some type, which it writes to `out`.
+typedef void ( * property_gen )( Property * p, void * out );
+
+
+// Fills the given `array` with up to `max_count` elements of
+// `element_size` bytes made by `gen`, and returns how many. It shrinks
+// to fewer elements, and smaller ones.
+size_t property_array( Property * p, property_gen gen, void * array,
+                       size_t element_size, size_t max_count );
+
+
+// Makes a value with one of the given `count` generators, chosen at
+// random, and writes it to `out`. It shrinks to the first generator.
+void property_one_of( Property * p, property_gen const * gens,
+                      size_t count, void * out );
+
+
+// Describes the input of a case, in the fashion of `printf()`. This is
+// only kept for the minimal counterexample, where it's printed as the
+// detail of the failed assertion, so it's cheap to call every case.
+void property_note( Property * p, char const * format, ... );
+
+
+// A property: returns whether it holds for the input that it draws
+// from `p`.
+typedef bool ( * property_fn )( Property * p, void * ctx );
+
+
+// Returns the seed that `assertions_add_property()` uses by default:
+// `$TESTC_SEED` if it's set, or a new seed from the clock otherwise.
+uint64_t property_default_seed( void );
+
+
+struct assertions_add_property_options {
+    char const * expr;
+    property_fn func;
+    void * ctx;
+    size_t cases;
+    uint64_t seed;
+    size_t threads;
+    size_t max_shrinks;
+};
+
+void assertions_add_property_( Assertions * assertions,
+                               struct assertions_add_property_options );
+
+// Takes an `Assertions *`, a `property_fn` expression, and some options,
+// and checks the property with `cases` cases (or `1000` if `0`) from the
+// given `seed` (or `property_default_seed()` if `0`), which are spread
+// across threads as by `parallel_for()` with the given `threads` (see
+// `parallel.h`). Each case is seeded by the `seed` and its index, so
+// the first case to fail doesn't depend on the threads. That case is
+// shrunk, by running the property up to `max_shrinks` (or `10000` if
+// `0`) more times, and an assertion that the property holds is added to
+// the given `Assertions`, identified by the seed, the index of the
+// first failed case, and how many choices its shrunk input took. The
+// notes of the shrunk input, and how to replay it, are the detail. For
+// example:
+//      assertions_add_property( as, reverse_twice_is_identity, .ctx = 0 );
+#define assertions_add_property( ASSERTIONS, FUNC, ... ) \
+    assertions_add_property_( ASSERTIONS, \
+        ( struct assertions_add_property_options ){ \
+            .expr = #FUNC " holds", \
+            .func = FUNC, \
+            __VA_ARGS__ \
+        } )
+
+
+#endif // ifndef INCLUDED_TESTC_PROPERTY_H
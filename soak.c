@@ -0,0 +1,355 @@
+// soak.c
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "soak.h" // tests_soak_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+
+#include <unistd.h>
+
+#include "bench.h" // bench_now_ns
+#include "fixture.h" // fixtures_mark, fixtures_teardown_to
+#include "heap.h" // heap_*
+#include "_common.h" // untracked_*, print_duration
+
+
+size_t soak_rss_bytes( void )
+{
+    // The C library allocates the buffer of the file when it's read.
+    heap_pause();
+    unsigned long long pages = 0;
+    FILE * const file = fopen( "/proc/self/statm", "r" );
+    if ( file != NULL ) {
+        if ( fscanf( file, "%*s %llu", &pages ) != 1 ) {
+            pages = 0;
+        }
+        fclose( file );
+    }
+    heap_resume();
+    long const page_size = sysconf( _SC_PAGESIZE );
+    return ( page_size <= 0 ) ? 0 : pages * page_size;
+}
+
+
+// A line fitted to a series of samples by least squares, which is
+// updated as each sample is added, by Welford's method, so that it
+// doesn't lose precision over millions of samples.
+struct trend {
+    size_t n;
+    double mean_x;
+    double mean_y;
+    double cov;
+    double var_x;
+};
+
+
+static
+void trend_add( struct trend * const t, double const x, double const y )
+{
+    t->n += 1;
+    double const dx = x - t->mean_x;
+    t->mean_x += dx / t->n;
+    t->mean_y += ( y - t->mean_y ) / t->n;
+    t->cov += dx * ( y - t->mean_y );
+    t->var_x += dx * ( x - t->mean_x );
+}
+
+
+static
+double trend_slope( struct trend const t )
+{
+    return ( t.var_x > 0 ) ? t.cov / t.var_x : 0;
+}
+
+
+static
+void print_bytes( FILE * const file, double const bytes )
+// Prints the given size with three or four significant digits, in the
+// most fitting unit.
+{
+    double const b = ( bytes < 0 ) ? -bytes : bytes;
+    if ( b < 1e4 ) {
+        fprintf( file, "%.4g B", bytes );
+    } else if ( b < 1e6 ) {
+        fprintf( file, "%.3g kB", bytes / 1e3 );
+    } else if ( b < 1e9 ) {
+        fprintf( file, "%.3g MB", bytes / 1e6 );
+    } else {
+        fprintf( file, "%.3g GB", bytes / 1e9 );
+    }
+}
+
+
+static
+void print_slope( FILE * const file, struct trend const t,
+                  void ( * const print )( FILE *, double ) )
+{
+    double const slope = trend_slope( t );
+    fprintf( file, "%s", ( slope < 0 ) ? "" : "+" );
+    print( file, slope );
+    fprintf( file, "/round" );
+}
+
+
+static
+uint64_t default_duration_ns( void )
+// Returns `$TESTC_SOAK_SECONDS` in nanoseconds if it's set to a positive
+// number, or 60 seconds otherwise.
+{
+    char const * const env = getenv( "TESTC_SOAK_SECONDS" );
+    double const seconds = ( env == NULL ) ? 0 : strtod( env, NULL );
+    return ( seconds > 0 ) ? seconds * 1e9 : 60e9;
+}
+
+
+// The state of a soak.
+struct soak {
+    struct tests_soak_options o;
+    FILE * file;
+    char const * indent;
+    char const * filter;
+
+    // The output of the last test, which is only printed if it failed.
+    FILE * output;
+    char * output_buffer;
+
+    size_t rounds;
+    uint64_t round_ns;
+    struct trend rss;
+    struct trend heap;
+    struct trend * times;
+};
+
+
+static
+void copy_output( struct soak * const s )
+// Copies the output of the last test to the soak's file.
+{
+    long const size = ftell( s->output );
+    rewind( s->output );
+    char buffer[ 4096 ];
+    long copied = 0;
+    while ( copied < size ) {
+        size_t const n = fread( buffer, 1, sizeof buffer, s->output );
+        if ( n == 0 ) {
+            break;
+        }
+        fwrite( buffer, 1, ( copied + ( long ) n > size ) ? size - copied
+                                                          : ( long ) n,
+                s->file );
+        copied += n;
+    }
+}
+
+
+static
+TestRows run_test( struct soak * const s, Test const test )
+// Runs the given test, or each of the rows of a table test, and prints
+// the output if any of them failed.
+{
+    // The output goes to a file with a buffer that was allocated up
+    // front, so that printing it doesn't allocate.
+    rewind( s->output );
+    TestRows const rows = test_run_rows( .test = test,
+                                         .file = s->output,
+                                         .indent = s->indent,
+                                         .ids_limit = s->o.ids_limit,
+                                         .filter = s->filter );
+    if ( rows.failed > 0 ) {
+        copy_output( s );
+    }
+    return rows;
+}
+
+
+static
+void print_summary( struct soak const * const s, uint64_t const elapsed_ns,
+                    size_t const rss )
+{
+    fprintf( s->file, "%ssoak:  round %zu after ", s->indent, s->rounds );
+    print_duration( s->file, elapsed_ns );
+    if ( rss > 0 ) {
+        fprintf( s->file, ", rss " );
+        print_bytes( s->file, rss );
+        if ( s->rss.n >= 2 ) {
+            fprintf( s->file, " (" );
+            print_slope( s->file, s->rss, print_bytes );
+            fprintf( s->file, ")" );
+        }
+    }
+    if ( heap_is_tracked() ) {
+        fprintf( s->file, ", heap " );
+        print_bytes( s->file, heap_peek().leaked_bytes );
+        if ( s->heap.n >= 2 ) {
+            fprintf( s->file, " (" );
+            print_slope( s->file, s->heap, print_bytes );
+            fprintf( s->file, ")" );
+        }
+    }
+    fprintf( s->file, ", round time " );
+    print_duration( s->file, s->round_ns );
+    fprintf( s->file, "\n" );
+}
+
+
+static
+bool check( struct soak const * const s, char const * const what,
+            struct trend const t, double const max,
+            void ( * const print )( FILE *, double ) )
+// Prints whether the slope of the given trend is at most `max`, and
+// returns whether it was. If there were too few samples to fit a line
+// to, it's taken to be.
+{
+    bool const passed = t.n < 3 || trend_slope( t ) <= max;
+    fprintf( s->file, "%s%s:  %s grows by at most ", s->indent,
+             passed ? "pass" : "fail", what );
+    print( s->file, max );
+    if ( t.n < 3 ) {
+        fprintf( s->file, " per round  (too few rounds after the warm-up "
+                          "to tell)\n" );
+    } else {
+        fprintf( s->file, " per round  (" );
+        print_slope( s->file, t, print );
+        fprintf( s->file, " over %zu rounds)\n", t.n );
+    }
+    return passed;
+}
+
+
+int tests_soak_( struct tests_soak_options const o )
+{
+    assert( o.name != NULL );
+    assert( o.tests != NULL );
+
+    uint64_t const duration = ( o.duration_ns == 0 ) ? default_duration_ns()
+                                                     : o.duration_ns;
+    uint64_t const warmup = ( o.warmup_ns == 0 ) ? duration / 10
+                                                 : o.warmup_ns;
+    uint64_t const summary = ( o.summary_ns == 0 ) ? 60000000000ULL
+                                                   : o.summary_ns;
+    size_t tests_size = 0;
+    while ( !test_is_array_end( o.tests[ tests_size ] ) ) {
+        tests_size += 1;
+    }
+    struct soak s = {
+        .o = o,
+        .file = ( o.file == NULL ) ? stdout : o.file,
+        .indent = ( o.indent == NULL ) ? "  " : o.indent,
+        .filter = ( o.filter == NULL ) ? getenv( "TESTC_FILTER" ) : o.filter,
+        .output_buffer = untracked_malloc( BUFSIZ ),
+        .times = untracked_calloc( tests_size + 1, sizeof ( struct trend ) )
+    };
+    heap_pause();
+    s.output = tmpfile();
+    heap_resume();
+
+    fprintf( s.file, "Soaking %s tests for ", o.name );
+    print_duration( s.file, duration );
+    fprintf( s.file, "...\n" );
+    if ( s.output == NULL ) {
+        fprintf( s.file, "%sfail:  couldn't create a file for the output "
+                         "of the tests\n", s.indent );
+        untracked_free( s.output_buffer );
+        untracked_free( s.times );
+        return 1;
+    }
+    setvbuf( s.output, s.output_buffer, _IOFBF, BUFSIZ );
+    size_t const fixtures = fixtures_mark();
+    heap_begin();
+    int failed = 0;
+    uint64_t const start = bench_now_ns();
+    uint64_t next_summary = start + summary;
+    // The round that the last summary was printed after.
+    size_t summarized = 0;
+    uint64_t now = start;
+    while ( failed == 0 && now - start < duration ) {
+        // Only the rounds that start after the warm-up are sampled.
+        bool const warm = now - start >= warmup;
+        uint64_t const round_start = now;
+        for ( size_t i = 0; i < tests_size; i += 1 ) {
+            uint64_t const test_start = bench_now_ns();
+            TestRows const rows = run_test( &s, o.tests[ i ] );
+            failed += rows.failed;
+            if ( warm && rows.run > 0 ) {
+                trend_add( &s.times[ i ], s.rounds,
+                           bench_now_ns() - test_start );
+            }
+        }
+        now = bench_now_ns();
+        s.round_ns = now - round_start;
+        size_t const rss = soak_rss_bytes();
+        if ( warm && rss > 0 ) {
+            trend_add( &s.rss, s.rounds, rss );
+        }
+        if ( warm && heap_is_tracked() ) {
+            trend_add( &s.heap, s.rounds, heap_peek().leaked_bytes );
+        }
+        s.rounds += 1;
+        if ( now >= next_summary ) {
+            print_summary( &s, now - start, rss );
+            summarized = s.rounds;
+            while ( next_summary <= now ) {
+                next_summary += summary;
+            }
+        }
+    }
+    if ( summarized != s.rounds ) {
+        print_summary( &s, now - start, soak_rss_bytes() );
+    }
+    heap_end();
+
+    if ( failed == 0 ) {
+        if ( soak_rss_bytes() > 0 ) {
+            failed += !check( &s, "rss", s.rss,
+                              ( o.max_rss_slope == 0 ) ? 1024
+                                                       : o.max_rss_slope,
+                              print_bytes );
+        }
+        if ( heap_is_tracked() ) {
+            failed += !check( &s, "heap", s.heap,
+                              ( o.max_heap_slope == 0 ) ? 1
+                                                        : o.max_heap_slope,
+                              print_bytes );
+        }
+        for ( size_t i = 0; i < tests_size; i += 1 ) {
+            struct trend const t = s.times[ i ];
+            if ( t.n == 0 ) {
+                continue;
+            }
+            char what[ 256 ];
+            snprintf( what, sizeof what, "time of %s", o.tests[ i ].name );
+            failed += !check( &s, what, t,
+                              ( o.max_time_slope == 0 ) ? t.mean_y / 100
+                                                        : o.max_time_slope,
+                              print_duration );
+        }
+    }
+    fixtures_teardown_to( fixtures );
+    heap_pause();
+    fclose( s.output );
+    heap_resume();
+    untracked_free( s.output_buffer );
+    untracked_free( s.times );
+    return failed;
+}
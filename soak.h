@@ -0,0 +1,96 @@
+// soak.h
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef INCLUDED_TESTC_SOAK_H
+#define INCLUDED_TESTC_SOAK_H
+
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "test.h" // Test
+
+
+// A soak runs tests over and over for a long time, e.g. hours in a
+// nightly job, to find the leaks and slowdowns that only show up after
+// many runs. After each round of the tests, it samples the resident
+// memory of the process, the live bytes of the heap, and the time of
+// each test, and fits a line to each of those series by least squares.
+// If one grows faster than its limit, the soak fails.
+
+
+// Returns the resident set size of this process, in bytes, from
+// `/proc/self/statm`, or `0` if that can't be read.
+size_t soak_rss_bytes( void );
+
+
+struct tests_soak_options {
+    char const * name;
+    Test const * tests;
+    FILE * file;
+    char const * indent;
+    size_t ids_limit;
+    char const * filter;
+    uint64_t duration_ns;
+    uint64_t warmup_ns;
+    uint64_t summary_ns;
+    double max_rss_slope;
+    double max_heap_slope;
+    double max_time_slope;
+};
+
+int tests_soak_( struct tests_soak_options );
+
+// Runs each test in the terminated `tests` array that matches the
+// `filter` (as for `tests_run()`), in rounds, until `duration_ns`
+// nanoseconds have passed (or `$TESTC_SOAK_SECONDS` seconds if `0`, or
+// 60 seconds if that's not set), and prints the results to `file` (or
+// `stdout` if `NULL`), indenting each line with `indent` (or `"  "` if
+// `NULL`). Returns the number of failures. For example:
+//      return tests_soak( .name = "Cache", .tests = cache_tests,
+//                         .duration_ns = 3600 * 1000000000ULL );
+//
+// Each test is run by `test_run_rows()`, so the rows of a table test
+// are run one after another, and timed together as that test. The
+// output of the passed tests isn't printed. If any tests fail in a
+// round, their output (with every row of a table test) is printed, and
+// the soak stops after that round.
+//
+// The samples of the first `warmup_ns` nanoseconds (or a tenth of the
+// duration if `0`) are ignored, so that caches filling up isn't taken
+// for a leak. After that, the slope of each series, per round, has to
+// be at most:
+// - `max_rss_slope` bytes (or `1024` if `0`) for the resident set size,
+//   if it can be read;
+// - `max_heap_slope` bytes (or `1` if `0`) for the live bytes of the
+//   heap, if Test.c was compiled with heap instrumentation (see
+//   `heap.h`);
+// - `max_time_slope` nanoseconds (or 1% of its mean time if `0`) for
+//   the time of each test.
+//
+// A summary of the soak so far is printed every `summary_ns`
+// nanoseconds (or 60 seconds if `0`), so that a long job can be
+// followed in its log. For example:
+//      soak:  round 1200 after 5 min, rss 12.3 MB (+2.1 B/round), heap
+//             1.21 MB (+0 B/round), round time 241 ms (wrapped here)
+#define tests_soak( ... ) \
+    tests_soak_( ( struct tests_soak_options ){ __VA_ARGS__ } )
+
+
+#endif // ifndef INCLUDED_TESTC_SOAK_H
@@ -0,0 +1,179 @@
+// stress.c
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "stress.h" // StressStats, stress_fn
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdatomic.h>
+#include <assert.h>
+
+#include <pthread.h>
+
+#include "bench.h" // bench_now_ns
+#include "parallel.h" // parallel_default_threads
+#include "property.h" // PropertyRng, property_rng_*, property_default_seed
+#include "_common.h" // MAX, untracked_*, print_rate
+
+
+// The state shared by the threads of a `stress_run()`.
+struct stress {
+    Assertions * assertions;
+    struct stress_run_options o;
+    pthread_mutex_t gate;
+    pthread_barrier_t start;
+    pthread_barrier_t end;
+    atomic_size_t round_ops;
+    StressStats stats;
+};
+
+
+struct worker {
+    struct stress * stress;
+    size_t thread;
+};
+
+
+static
+void * work( void * const arg )
+// Runs each round as the given thread. The first thread also times the
+// rounds.
+{
+    struct worker const * const w = arg;
+    struct stress * const s = w->stress;
+    // Wait at the gate until the barriers are sized to the threads that
+    // were started.
+    pthread_mutex_lock( &s->gate );
+    pthread_mutex_unlock( &s->gate );
+    Assertions * const as = assertions_worker( *s->assertions, w->thread );
+    PropertyRng rng = property_rng_new( s->o.seed + w->thread );
+    for ( size_t round = 0; round < s->o.rounds; round += 1 ) {
+        pthread_barrier_wait( &s->start );
+        uint64_t const start = bench_now_ns();
+        // Spin rather than sleep, which would take far longer than the
+        // jitter.
+        uint64_t const jitter = property_rng_next( &rng ) % s->o.jitter_ns;
+        while ( bench_now_ns() - start < jitter ) {
+        }
+        size_t const ops = s->o.func( as, w->thread, round, s->o.ctx );
+        atomic_fetch_add( &s->round_ops, ops );
+        pthread_barrier_wait( &s->end );
+
+        if ( w->thread == 0 ) {
+            uint64_t const ns = MAX( bench_now_ns() - start, 1 );
+            size_t const round_ops = atomic_exchange( &s->round_ops, 0 );
+            double const rate = round_ops * 1e9 / ns;
+            s->stats.ops += round_ops;
+            s->stats.ns += ns;
+            if ( round == 0 || rate < s->stats.min_ops_per_s ) {
+                s->stats.min_ops_per_s = rate;
+            }
+            if ( round == 0 || rate > s->stats.max_ops_per_s ) {
+                s->stats.max_ops_per_s = rate;
+            }
+            if ( s->o.file != NULL ) {
+                fprintf( s->o.file, "round %zu:  %zu ops, ", round,
+                         round_ops );
+                print_rate( s->o.file, rate );
+                fprintf( s->o.file, " ops/s\n" );
+            }
+        }
+    }
+    return NULL;
+}
+
+
+StressStats stress_run_( Assertions * const as,
+                         struct stress_run_options o )
+{
+    assert( as != NULL );
+    assert( as->workers_size == 0 );
+    assert( o.func != NULL );
+
+    o.threads = ( o.threads == 0 ) ? MAX( parallel_default_threads(), 2 )
+                                   : o.threads;
+    o.rounds = ( o.rounds == 0 ) ? 100 : o.rounds;
+    o.jitter_ns = ( o.jitter_ns == 0 ) ? 1000 : o.jitter_ns;
+    o.seed = ( o.seed == 0 ) ? property_default_seed() : o.seed;
+
+    struct stress * const s = untracked_calloc( 1, sizeof ( struct stress ) );
+    s->assertions = as;
+    s->o = o;
+    s->stats = ( StressStats ){ .threads = o.threads, .rounds = o.rounds };
+    atomic_init( &s->round_ops, 0 );
+    pthread_mutex_init( &s->gate, NULL );
+    assertions_set_workers( as, o.threads );
+
+    // This thread is the first of them. The others wait at the gate
+    // until we know how many of them could be started, so that the
+    // barriers can be sized to those.
+    pthread_t * const ids = untracked_malloc( o.threads
+                                              * sizeof ( pthread_t ) );
+    struct worker * const workers = untracked_malloc( o.threads
+                                                      * sizeof *workers );
+    for ( size_t i = 0; i < o.threads; i += 1 ) {
+        workers[ i ] = ( struct worker ){ .stress = s, .thread = i };
+    }
+    pthread_mutex_lock( &s->gate );
+    size_t started = 1;
+    while ( started < o.threads
+         && pthread_create( &ids[ started ], NULL, work,
+                            &workers[ started ] ) == 0 ) {
+        started += 1;
+    }
+    s->stats.threads = started;
+    pthread_barrier_init( &s->start, NULL, started );
+    pthread_barrier_init( &s->end, NULL, started );
+    pthread_mutex_unlock( &s->gate );
+    work( &workers[ 0 ] );
+    for ( size_t i = 1; i < started; i += 1 ) {
+        pthread_join( ids[ i ], NULL );
+    }
+    assertions_join( as );
+
+    StressStats stats = s->stats;
+    stats.ops_per_s = stats.ops * 1e9 / MAX( stats.ns, 1 );
+    pthread_barrier_destroy( &s->start );
+    pthread_barrier_destroy( &s->end );
+    pthread_mutex_destroy( &s->gate );
+    untracked_free( ids );
+    untracked_free( workers );
+    untracked_free( s );
+    return stats;
+}
+
+
+void stress_stats_print_( struct stress_stats_print_options const o )
+{
+    StressStats const s = o.stats;
+    FILE * const file = ( o.file == NULL ) ? stdout : o.file;
+
+    fprintf( file, "stress:  %zu thread%s, %zu round%s, %zu ops, ",
+             s.threads, ( s.threads == 1 ) ? "" : "s",
+             s.rounds, ( s.rounds == 1 ) ? "" : "s", s.ops );
+    print_rate( file, s.ops_per_s );
+    fprintf( file, " ops/s (rounds from " );
+    print_rate( file, s.min_ops_per_s );
+    fprintf( file, " to " );
+    print_rate( file, s.max_ops_per_s );
+    fprintf( file, " ops/s)\n" );
+}
@@ -0,0 +1,121 @@
+// stress.h
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+
+#ifndef INCLUDED_TESTC_STRESS_H
+#define INCLUDED_TESTC_STRESS_H
+
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "assertions.h" // Assertions
+
+
+// Stress testing calls a function from many threads at the same moment,
+// over and over, to make races in the code under test (e.g. a lock-free
+// queue) as likely as possible, and measures its throughput under that
+// contention while it's at it.
+
+
+// The body of a stress test: it should exercise the code under test as
+// the given `thread` in the given `round`, make its assertions to the
+// given `Assertions`, which belongs to the calling thread, and return
+// how many operations it did (e.g. pushes and pops).
+typedef size_t ( * stress_fn )( Assertions * assertions,
+                                size_t thread, size_t round, void * ctx );
+
+
+// The results of a `stress_run()`.
+typedef struct StressStats {
+
+    // How many threads called the function in each round (fewer than
+    // asked for if some threads couldn't be created), and how many
+    // rounds there were.
+    size_t threads;
+    size_t rounds;
+
+    // How many operations the calls returned, in total.
+    size_t ops;
+
+    // The total time of the rounds, from the release of the threads to
+    // the return of the last, in nanoseconds.
+    uint64_t ns;
+
+    // The throughput of every round together, and of the slowest and
+    // fastest rounds, in operations per second.
+    double ops_per_s;
+    double min_ops_per_s;
+    double max_ops_per_s;
+
+} StressStats;
+
+
+struct stress_run_options {
+    stress_fn func;
+    void * ctx;
+    size_t threads;
+    size_t rounds;
+    uint64_t jitter_ns;
+    uint64_t seed;
+    FILE * file;
+};
+
+StressStats stress_run_( Assertions * assertions,
+                         struct stress_run_options );
+
+// Calls the given `func` from `threads` threads (or
+// `parallel_default_threads()` if `0`, but at least two; see
+// `parallel.h`) at once, for `rounds` rounds (or `100` if `0`). In each
+// round, the threads wait at a barrier until they're all ready, and then
+// each waits for a random time of up to `jitter_ns` nanoseconds (or
+// `1000` if `0`), drawn from `seed` (or `property_default_seed()` if
+// `0`; see `property.h`), before it calls `func`, so that the calls
+// overlap differently in each round. Each thread makes its assertions
+// to its own buffer, which are added to the given `Assertions` in the
+// order of the threads when every round is done. If the `file` isn't
+// `NULL`, the throughput of each round is printed to it. For example:
+//      StressStats const s = stress_run( as, .func = push_and_pop,
+//                                            .ctx = queue,
+//                                            .threads = 8 );
+//
+// The given `Assertions` can't have worker buffers of its own (see
+// `assertions_set_workers()`) while this runs.
+#define stress_run( ASSERTIONS, ... ) \
+    stress_run_( ASSERTIONS, ( struct stress_run_options ){ __VA_ARGS__ } )
+
+
+struct stress_stats_print_options {
+    StressStats stats;
+    FILE * file;
+};
+
+void stress_stats_print_( struct stress_stats_print_options );
+
+// Prints the given `stats` on a single line to the `file` (or `stdout`
+// if `NULL`). For example (wrapped here):
+//      stress:  8 threads, 100 rounds, 800000 ops, 6.51M ops/s (rounds
+//               from 5.12M to 7.2M ops/s)
+#define stress_stats_print( ... ) \
+    stress_stats_print_( ( struct stress_stats_print_options ){ \
+        __VA_ARGS__ \
+    } )
+
+
+#endif // ifndef INCLUDED_TESTC_STRESS_H
@@ -0,0 +1,409 @@
+// string-diff.c
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "string-diff.h" // string_diff_, assertions_add_string_eq_at
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "assertion.h" // assertion_new_
+#include "heap.h" // heap_pause, heap_resume
+#include "_common.h" // MIN, string_eq, untracked_*
+
+
+// How many bytes of each string are printed around the first
+// difference, and of each changed region, at most.
+#define EXCERPT_SIZE 32
+
+// Changed regions that are separated by fewer equal bytes than this are
+// printed as one.
+#define MERGE_GAP 8
+
+
+// A region of changed bytes: `a_begin` up to `a_end` of the expected
+// string became `b_begin` up to `b_end` of the actual string.
+struct region {
+    size_t a_begin;
+    size_t a_end;
+    size_t b_begin;
+    size_t b_end;
+};
+
+
+// The state of a diff.
+struct diff {
+    char const * a;
+    char const * b;
+    size_t max_edits;
+    struct region * regions;
+    size_t regions_size;
+    size_t regions_capacity;
+    long * v1;
+    long * v2;
+};
+
+
+static
+void add_region( struct diff * const d, struct region const r )
+// Adds the given region to the diff, merging it with the last one if
+// they're close. The regions are added in order.
+{
+    if ( d->regions_size > 0 ) {
+        struct region * const last = &d->regions[ d->regions_size - 1 ];
+        if ( r.a_begin - last->a_end < MERGE_GAP
+          && r.b_begin - last->b_end < MERGE_GAP ) {
+            last->a_end = r.a_end;
+            last->b_end = r.b_end;
+            return;
+        }
+    }
+    if ( d->regions_size == d->regions_capacity ) {
+        d->regions_capacity = ( d->regions_capacity == 0 )
+                            ? 16 : d->regions_capacity * 2;
+        d->regions = untracked_realloc( d->regions,
+            d->regions_capacity * sizeof ( struct region ) );
+    }
+    d->regions[ d->regions_size ] = r;
+    d->regions_size += 1;
+}
+
+
+static
+bool middle_snake( struct diff * const d, size_t const a0, size_t const n,
+                   size_t const b0, size_t const m,
+                   size_t * const x_out, size_t * const y_out )
+// Finds where the shortest edit script from the `n` bytes at `a0` of the
+// expected string to the `m` bytes at `b0` of the actual string crosses
+// its middle, by searching forwards from the start and backwards from
+// the end at once, and gives it via `x_out` and `y_out`. Returns `false`
+// if the script has more than about `max_edits` edits.
+{
+    char const * const a = d->a + a0;
+    char const * const b = d->b + b0;
+    long const max_d = ( n + m + 1 ) / 2;
+    long const limit = MIN( max_d, ( long ) d->max_edits / 2 + 1 );
+    long const offset = max_d;
+    long const length = 2 * max_d + 2;
+    long * const v1 = d->v1;
+    long * const v2 = d->v2;
+    for ( long i = 0; i < length; i += 1 ) {
+        v1[ i ] = -1;
+        v2[ i ] = -1;
+    }
+    v1[ offset + 1 ] = 0;
+    v2[ offset + 1 ] = 0;
+    long const delta = ( long ) n - ( long ) m;
+    // If the difference in lengths is odd, the paths meet when going
+    // forwards; otherwise, when going backwards.
+    bool const front = delta % 2 != 0;
+    long k1_start = 0;
+    long k1_end = 0;
+    long k2_start = 0;
+    long k2_end = 0;
+    for ( long e = 0; e < limit; e += 1 ) {
+        for ( long k1 = -e + k1_start; k1 <= e - k1_end; k1 += 2 ) {
+            long const k1_offset = offset + k1;
+            long x1 = ( k1 == -e || ( k1 != e && v1[ k1_offset - 1 ]
+                                                 < v1[ k1_offset + 1 ] ) )
+                    ? v1[ k1_offset + 1 ] : v1[ k1_offset - 1 ] + 1;
+            long y1 = x1 - k1;
+            while ( x1 < ( long ) n && y1 < ( long ) m && a[ x1 ] == b[ y1 ] ) {
+                x1 += 1;
+                y1 += 1;
+            }
+            v1[ k1_offset ] = x1;
+            if ( x1 > ( long ) n ) {
+                k1_end += 2;
+            } else if ( y1 > ( long ) m ) {
+                k1_start += 2;
+            } else if ( front ) {
+                long const k2_offset = offset + delta - k1;
+                if ( k2_offset >= 0 && k2_offset < length
+                  && v2[ k2_offset ] != -1
+                  && x1 >= ( long ) n - v2[ k2_offset ] ) {
+                    *x_out = x1;
+                    *y_out = y1;
+                    return true;
+                }
+            }
+        }
+        for ( long k2 = -e + k2_start; k2 <= e - k2_end; k2 += 2 ) {
+            long const k2_offset = offset + k2;
+            long x2 = ( k2 == -e || ( k2 != e && v2[ k2_offset - 1 ]
+                                                 < v2[ k2_offset + 1 ] ) )
+                    ? v2[ k2_offset + 1 ] : v2[ k2_offset - 1 ] + 1;
+            long y2 = x2 - k2;
+            while ( x2 < ( long ) n && y2 < ( long ) m
+                 && a[ n - x2 - 1 ] == b[ m - y2 - 1 ] ) {
+                x2 += 1;
+                y2 += 1;
+            }
+            v2[ k2_offset ] = x2;
+            if ( x2 > ( long ) n ) {
+                k2_end += 2;
+            } else if ( y2 > ( long ) m ) {
+                k2_start += 2;
+            } else if ( !front ) {
+                long const k1_offset = offset + delta - k2;
+                if ( k1_offset >= 0 && k1_offset < length
+                  && v1[ k1_offset ] != -1 ) {
+                    long const x1 = v1[ k1_offset ];
+                    if ( x1 >= ( long ) n - x2 ) {
+                        *x_out = x1;
+                        *y_out = offset + x1 - k1_offset;
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+    if ( limit < max_d ) {
+        return false;
+    }
+    // The paths never met, so there are no bytes in common.
+    *x_out = n;
+    *y_out = 0;
+    return true;
+}
+
+
+static
+bool diff_range( struct diff * const d, size_t a_begin, size_t a_end,
+                 size_t b_begin, size_t b_end )
+// Adds the changed regions between the given range of the expected
+// string and the given range of the actual string to the diff. Returns
+// `false` if that takes more than `max_edits` edits.
+{
+    while ( a_begin < a_end && b_begin < b_end
+         && d->a[ a_begin ] == d->b[ b_begin ] ) {
+        a_begin += 1;
+        b_begin += 1;
+    }
+    while ( a_begin < a_end && b_begin < b_end
+         && d->a[ a_end - 1 ] == d->b[ b_end - 1 ] ) {
+        a_end -= 1;
+        b_end -= 1;
+    }
+    if ( a_begin == a_end || b_begin == b_end ) {
+        if ( a_begin < a_end || b_begin < b_end ) {
+            add_region( d, ( struct region ){ .a_begin = a_begin,
+                                              .a_end = a_end,
+                                              .b_begin = b_begin,
+                                              .b_end = b_end } );
+        }
+        return true;
+    }
+    size_t x;
+    size_t y;
+    if ( !middle_snake( d, a_begin, a_end - a_begin,
+                        b_begin, b_end - b_begin, &x, &y ) ) {
+        return false;
+    }
+    return diff_range( d, a_begin, a_begin + x, b_begin, b_begin + y )
+        && diff_range( d, a_begin + x, a_end, b_begin + y, b_end );
+}
+
+
+static
+void print_escaped( FILE * const file, char const * const s,
+                    size_t const size )
+// Prints the given bytes as they'd be written in a C string literal,
+// except for bytes outside of ASCII, which are printed as they are.
+{
+    for ( size_t i = 0; i < size; i += 1 ) {
+        unsigned char const c = s[ i ];
+        if ( c == '\n' ) {
+            fputs( "\\n", file );
+        } else if ( c == '\t' ) {
+            fputs( "\\t", file );
+        } else if ( c == '"' || c == '\\' ) {
+            fprintf( file, "\\%c", c );
+        } else if ( c < 0x20 || c == 0x7f ) {
+            fprintf( file, "\\x%02x", c );
+        } else {
+            fputc( c, file );
+        }
+    }
+}
+
+
+static
+void print_excerpt( FILE * const file, char const * const label,
+                    char const * const s, size_t const size,
+                    size_t const at )
+// Prints the bytes of the given string around the offset `at`.
+{
+    size_t const begin = ( at > EXCERPT_SIZE / 2 ) ? at - EXCERPT_SIZE / 2
+                                                   : 0;
+    size_t const end = MIN( begin + EXCERPT_SIZE, size );
+    fprintf( file, "  %s%s\"", label, ( begin > 0 ) ? "..." : "" );
+    print_escaped( file, s + begin, end - begin );
+    fprintf( file, "\"%s\n", ( end < size ) ? "..." : "" );
+}
+
+
+static
+void print_region_side( FILE * const file, char const sign,
+                        char const * const s, size_t const begin,
+                        size_t const end )
+{
+    fprintf( file, " %c\"", sign );
+    print_escaped( file, s + begin, MIN( end - begin, EXCERPT_SIZE ) );
+    fprintf( file, "%s\"", ( end - begin > EXCERPT_SIZE ) ? "..." : "" );
+}
+
+
+static
+size_t diff_strings( struct string_diff_options const o,
+                     size_t * const offset )
+// Does `string_diff_()`, and sets `offset` to the offset of the first
+// difference, if the strings differ.
+{
+    FILE * const file = ( o.file == NULL ) ? stdout : o.file;
+    size_t const max_regions = ( o.regions == 0 ) ? 5 : o.regions;
+    if ( string_eq( o.expected, o.actual ) ) {
+        return 0;
+    }
+    char const * const a = ( o.expected == NULL ) ? "(null)" : o.expected;
+    char const * const b = ( o.actual == NULL ) ? "(null)" : o.actual;
+    size_t const a_size = strlen( a );
+    size_t const b_size = strlen( b );
+
+    size_t first = 0;
+    size_t line = 1;
+    size_t column = 1;
+    while ( first < a_size && first < b_size && a[ first ] == b[ first ] ) {
+        if ( a[ first ] == '\n' ) {
+            line += 1;
+            column = 1;
+        } else {
+            column += 1;
+        }
+        first += 1;
+    }
+    *offset = first;
+    fprintf( file, "first difference at offset %zu (line %zu, column %zu):\n",
+             first, line, column );
+    print_excerpt( file, "expected: ", a, a_size, first );
+    print_excerpt( file, "actual:   ", b, b_size, first );
+
+    // Only the bytes after the common prefix and before the common
+    // suffix need a diff.
+    size_t suffix = 0;
+    while ( suffix < a_size - first && suffix < b_size - first
+         && a[ a_size - 1 - suffix ] == b[ b_size - 1 - suffix ] ) {
+        suffix += 1;
+    }
+    size_t const middle = ( a_size - first - suffix ) + ( b_size - first
+                                                          - suffix );
+    struct diff d = {
+        .a = a,
+        .b = b,
+        .max_edits = ( o.max_edits == 0 ) ? 256 : o.max_edits,
+        .v1 = untracked_malloc( ( middle + 3 ) * sizeof ( long ) ),
+        .v2 = untracked_malloc( ( middle + 3 ) * sizeof ( long ) )
+    };
+    size_t regions = 1;
+    if ( !diff_range( &d, first, a_size - suffix, first, b_size - suffix ) ) {
+        fprintf( file, "more than %zu edits; not looking for the changed "
+                       "regions\n", d.max_edits );
+    } else {
+        regions = d.regions_size;
+        fprintf( file, "%zu changed region%s:\n", regions,
+                 ( regions == 1 ) ? "" : "s" );
+        for ( size_t i = 0; i < regions && i < max_regions; i += 1 ) {
+            struct region const r = d.regions[ i ];
+            fprintf( file, "  at %zu:", r.a_begin );
+            print_region_side( file, '-', a, r.a_begin, r.a_end );
+            print_region_side( file, '+', b, r.b_begin, r.b_end );
+            fprintf( file, "\n" );
+        }
+        if ( regions > max_regions ) {
+            fprintf( file, "  ... and %zu more\n", regions - max_regions );
+        }
+    }
+    untracked_free( d.regions );
+    untracked_free( d.v1 );
+    untracked_free( d.v2 );
+    return regions;
+}
+
+
+size_t string_diff_( struct string_diff_options const o )
+{
+    size_t offset;
+    return diff_strings( o, &offset );
+}
+
+
+void assertions_add_string_eq_at( Assertions * const as,
+                                  char const * const file,
+                                  int const line,
+                                  char const * const expr,
+                                  char const * const actual,
+                                  char const * const expected )
+{
+    assert( as != NULL );
+    assert( expr != NULL );
+
+    if ( string_eq( actual, expected ) ) {
+        assertions_add_at_( as, ( struct assertions_add_at_options ){
+            .file = file, .line = line, .expr = expr, .result = true } );
+        return;
+    }
+    size_t const actual_length = ( actual == NULL ) ? 0 : strlen( actual );
+    size_t const expected_length = ( expected == NULL ) ? 0
+                                                        : strlen( expected );
+    // A site only keeps the identifications of its failures, so a
+    // failure is added as an assertion of its own, to keep its diff.
+    size_t offset = 0;
+    char * detail = NULL;
+    size_t size = 0;
+    heap_pause();
+    FILE * const out = open_memstream( &detail, &size );
+    heap_resume();
+    diff_strings( ( struct string_diff_options ){ .expected = expected,
+                                                  .actual = actual,
+                                                  .file = out },
+                  &offset );
+    heap_pause();
+    fclose( out );
+    heap_resume();
+    assertions_add_ptr( as, assertion_new_(
+        ( struct assertion_new_options ){
+            .expr = expr,
+            .result = false,
+            .ids = ( AssertionId[] ){
+                { .expr = "actual_length",
+                  .value = ( long long ) actual_length },
+                { .expr = "expected_length",
+                  .value = ( long long ) expected_length },
+                { .expr = "offset", .value = ( long long ) offset },
+                ASSERTION_ID_ARRAY_END
+            },
+            .detail = detail
+        } ) );
+    heap_pause();
+    free( detail );
+    heap_resume();
+}
@@ -0,0 +1,87 @@
+// string-diff.h
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+
+#ifndef INCLUDED_TESTC_STRING_DIFF_H
+#define INCLUDED_TESTC_STRING_DIFF_H
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "assertions.h" // Assertions
+
+
+struct string_diff_options {
+    char const * expected;
+    char const * actual;
+    FILE * file;
+    size_t regions;
+    size_t max_edits;
+};
+
+size_t string_diff_( struct string_diff_options );
+
+// Prints how the `actual` string differs from the `expected` string to
+// the `file` (or `stdout` if `NULL`), and returns how many regions of
+// changed bytes it found. First, the offset of the first difference is
+// printed, with its line and column, and an excerpt of each string
+// around it. Then, the changed regions are printed, with each's offset
+// in the expected string, up to `regions` of them (or `5` if `0`). For
+// example:
+//      first difference at offset 29 (line 1, column 30):
+//        expected: ..."get\", \"price\": 10, \"stock\": 4}"
+//        actual:   ..."get\", \"price\": 12, \"stock\": 4, \""...
+//      2 changed regions:
+//        at 29: -"0" +"2"
+//        at 42: -"" +", \"sale\": true"
+//
+// The regions are found by the linear-space variant of Myers' algorithm
+// on the bytes between the common prefix and suffix of the strings, so
+// it needs memory in proportion to their lengths. Regions that are
+// only a few bytes apart are printed as one. If the strings differ by
+// more than `max_edits` inserted and deleted bytes (or `256` if `0`),
+// the search is abandoned, only the first difference is printed, and
+// this returns `1`. For equal strings, this prints nothing and
+// returns `0`. A `NULL` string is printed as `(null)`.
+#define string_diff( ... ) \
+    string_diff_( ( struct string_diff_options ){ __VA_ARGS__ } )
+
+
+void assertions_add_string_eq_at( Assertions * assertions,
+                                  char const * file, int line,
+                                  char const * expr,
+                                  char const * actual,
+                                  char const * expected );
+
+// Takes an `Assertions *` and two string expressions, and records an
+// evaluation of whether the strings are equal (or both `NULL`). If they
+// are, that's counted at the site of the given `Assertions` for the
+// current source file and line, as by `assertions_add()`, so this is
+// as cheap as `strcmp()` in a loop. If they aren't, a `false` assertion
+// is added instead, since a site can't keep a detail, identified by the
+// lengths of the strings and the offset of their first difference, with
+// a diff of them as by `string_diff()` as its detail. For example:
+//      assertions_add_string_eq( as, to_json( x ), expected_json );
+#define assertions_add_string_eq( ASSERTIONS, ACTUAL, EXPECTED ) \
+    assertions_add_string_eq_at( ASSERTIONS, __FILE__, __LINE__, \
+        "string_eq( " #ACTUAL ", " #EXPECTED " )", ACTUAL, EXPECTED )
+
+
+#endif // ifndef INCLUDED_TESTC_STRING_DIFF_H
@@ -0,0 +1,394 @@
+// subtest.c
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "subtest.h" // Subtest
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <assert.h>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "parallel.h" // parallel_default_threads
+#include "_common.h" // untracked_*
+
+
+// How many times an idle worker looks for a subtest again before it
+// sleeps until one is spawned.
+#define IDLE_SPINS 64
+
+
+// The subtests spawned by a worker thread that haven't started yet. The
+// owner pushes and pops at the `tail`, and thieves take from the `head`.
+struct deque {
+    pthread_mutex_t lock;
+    Subtest * * items;
+    size_t head;
+    size_t tail;
+    size_t capacity;
+};
+
+
+struct subtest_scheduler {
+    // The deque of each worker, or `NULL` until the first subtest is
+    // spawned, since most tests don't spawn any.
+    struct deque * deques;
+    size_t workers;
+
+    // How many subtests have been spawned and haven't finished.
+    atomic_size_t pending;
+
+    // Idle workers sleep on `wake`, which is signalled when a subtest
+    // is spawned, and broadcast when the last one finishes. `spawns`
+    // counts the spawns, so that a worker won't sleep through one that
+    // came after it looked, and `sleepers` counts the sleeping workers,
+    // so that a spawn only signals if there are any.
+    pthread_mutex_t idle_lock;
+    pthread_cond_t wake;
+    atomic_size_t spawns;
+    atomic_size_t sleepers;
+
+    // The state of the calling thread when the tree began.
+    Subtest * outer_current;
+    struct subtest_scheduler * outer_scheduler;
+    size_t outer_worker;
+};
+
+
+// The subtest running on this thread, the scheduler of its tree, and
+// the index of this thread's deque in it.
+static _Thread_local Subtest * current = NULL;
+static _Thread_local struct subtest_scheduler * scheduler = NULL;
+static _Thread_local size_t worker = 0;
+
+
+static
+Subtest * subtest_new( char const * const name )
+{
+    assert( name != NULL );
+    Subtest * const s = untracked_malloc( sizeof ( Subtest ) );
+    *s = ( Subtest ){ .name = untracked_strdup( name ) };
+    return s;
+}
+
+
+static
+void push( struct deque * const d, Subtest * const s )
+{
+    pthread_mutex_lock( &d->lock );
+    if ( d->tail == d->capacity && d->head > 0 ) {
+        // Reclaim the slots of the stolen subtests before growing.
+        memmove( d->items, d->items + d->head,
+                 ( d->tail - d->head ) * sizeof ( Subtest * ) );
+        d->tail -= d->head;
+        d->head = 0;
+    }
+    if ( d->tail == d->capacity ) {
+        d->capacity = ( d->capacity == 0 ) ? 64 : d->capacity * 2;
+        d->items = untracked_realloc( d->items,
+                                      d->capacity * sizeof ( Subtest * ) );
+    }
+    d->items[ d->tail ] = s;
+    d->tail += 1;
+    pthread_mutex_unlock( &d->lock );
+}
+
+
+static
+Subtest * take( struct deque * const d, bool const steal )
+// Returns the oldest subtest of the deque if `steal` is `true`, or its
+// newest subtest if not, or `NULL` if it's empty.
+{
+    Subtest * s = NULL;
+    pthread_mutex_lock( &d->lock );
+    if ( d->head < d->tail ) {
+        if ( steal ) {
+            s = d->items[ d->head ];
+            d->head += 1;
+        } else {
+            d->tail -= 1;
+            s = d->items[ d->tail ];
+        }
+    }
+    pthread_mutex_unlock( &d->lock );
+    return s;
+}
+
+
+void subtest_spawn_( struct subtest_spawn_options const o )
+{
+    assert( current != NULL );
+    assert( scheduler != NULL );
+    assert( o.func != NULL );
+
+    Subtest * const s = subtest_new( ( o.name == NULL ) ? "" : o.name );
+    s->func = o.func;
+    s->ctx = o.ctx;
+    s->free_ctx = o.free_ctx;
+    if ( current->children_size == current->children_capacity ) {
+        current->children_capacity = ( current->children_capacity == 0 )
+                                   ? 8 : current->children_capacity * 2;
+        current->children = untracked_realloc( current->children,
+            current->children_capacity * sizeof ( Subtest * ) );
+    }
+    current->children[ current->children_size ] = s;
+    current->children_size += 1;
+    if ( scheduler->deques == NULL ) {
+        // The first subtest is spawned by the test itself, before there
+        // are any other workers.
+        scheduler->deques = untracked_calloc( scheduler->workers,
+                                              sizeof ( struct deque ) );
+        for ( size_t i = 0; i < scheduler->workers; i += 1 ) {
+            pthread_mutex_init( &scheduler->deques[ i ].lock, NULL );
+        }
+    }
+    atomic_fetch_add( &scheduler->pending, 1 );
+    push( &scheduler->deques[ worker ], s );
+    atomic_fetch_add( &scheduler->spawns, 1 );
+    if ( atomic_load( &scheduler->sleepers ) > 0 ) {
+        pthread_mutex_lock( &scheduler->idle_lock );
+        pthread_cond_signal( &scheduler->wake );
+        pthread_mutex_unlock( &scheduler->idle_lock );
+    }
+}
+
+
+Subtest const * subtest_current( void )
+{
+    return current;
+}
+
+
+Subtest * subtests_begin( char const * const name )
+{
+    Subtest * const root = subtest_new( name );
+    struct subtest_scheduler * const s =
+        untracked_malloc( sizeof ( struct subtest_scheduler ) );
+    *s = ( struct subtest_scheduler ){
+        .workers = parallel_default_threads(),
+        .outer_current = current,
+        .outer_scheduler = scheduler,
+        .outer_worker = worker
+    };
+    atomic_init( &s->pending, 0 );
+    atomic_init( &s->spawns, 0 );
+    atomic_init( &s->sleepers, 0 );
+    root->scheduler = s;
+    current = root;
+    scheduler = s;
+    worker = 0;
+    return root;
+}
+
+
+static
+void run( Subtest * const s )
+// Runs the given subtest on this thread, as the current subtest.
+{
+    Subtest * const outer = current;
+    current = s;
+    s->assertions = s->func( s->ctx );
+    assert( s->assertions != NULL );
+    assertions_join( s->assertions );
+    if ( s->free_ctx != NULL ) {
+        s->free_ctx( s->ctx );
+    }
+    current = outer;
+}
+
+
+struct worker_arg {
+    struct subtest_scheduler * scheduler;
+    size_t index;
+};
+
+
+static
+void * work( void * const arg )
+// Runs subtests from this worker's deque, or stolen from the others,
+// until every subtest of the tree has finished. While there are none
+// to take, it sleeps, so that it doesn't slow the others down.
+{
+    struct worker_arg const * const w = arg;
+    struct subtest_scheduler * const s = w->scheduler;
+    scheduler = s;
+    worker = w->index;
+    size_t victim = worker;
+    size_t spins = 0;
+    while ( atomic_load( &s->pending ) > 0 ) {
+        size_t const spawns = atomic_load( &s->spawns );
+        Subtest * t = take( &s->deques[ worker ], false );
+        for ( size_t i = 1; t == NULL && i < s->workers; i += 1 ) {
+            victim = ( victim + 1 ) % s->workers;
+            if ( victim != worker ) {
+                t = take( &s->deques[ victim ], true );
+            }
+        }
+        if ( t == NULL && spins < IDLE_SPINS ) {
+            spins += 1;
+            sched_yield();
+            continue;
+        }
+        if ( t == NULL ) {
+            pthread_mutex_lock( &s->idle_lock );
+            atomic_fetch_add( &s->sleepers, 1 );
+            while ( atomic_load( &s->spawns ) == spawns
+                 && atomic_load( &s->pending ) > 0 ) {
+                pthread_cond_wait( &s->wake, &s->idle_lock );
+            }
+            atomic_fetch_sub( &s->sleepers, 1 );
+            pthread_mutex_unlock( &s->idle_lock );
+            spins = 0;
+            continue;
+        }
+        spins = 0;
+        run( t );
+        if ( atomic_fetch_sub( &s->pending, 1 ) == 1 ) {
+            pthread_mutex_lock( &s->idle_lock );
+            pthread_cond_broadcast( &s->wake );
+            pthread_mutex_unlock( &s->idle_lock );
+        }
+    }
+    return NULL;
+}
+
+
+static
+void finish( Subtest * const s )
+// Sets whether each subtest of the tree passed, and how many
+// descendants it has.
+{
+    s->passed = assertions_all_true( *( s->assertions ) );
+    s->descendants = 0;
+    for ( size_t i = 0; i < s->children_size; i += 1 ) {
+        Subtest * const child = s->children[ i ];
+        finish( child );
+        s->passed = s->passed && child->passed;
+        s->descendants += 1 + child->descendants;
+    }
+}
+
+
+void subtests_end( Subtest * const root, Assertions * const assertions )
+{
+    assert( root != NULL );
+    assert( root == current );
+    assert( assertions != NULL );
+
+    struct subtest_scheduler * const s = root->scheduler;
+    root->assertions = assertions;
+    if ( atomic_load( &s->pending ) > 0 ) {
+        // This thread is the first worker.
+        pthread_mutex_init( &s->idle_lock, NULL );
+        pthread_cond_init( &s->wake, NULL );
+        size_t const spawned = s->workers - 1;
+        pthread_t * const ids = untracked_malloc( ( spawned + 1 )
+                                                  * sizeof ( pthread_t ) );
+        struct worker_arg * const args =
+            untracked_malloc( ( spawned + 1 ) * sizeof ( struct worker_arg ) );
+        size_t started = 0;
+        while ( started < spawned ) {
+            args[ started ] = ( struct worker_arg ){ .scheduler = s,
+                                                     .index = started + 1 };
+            if ( pthread_create( &ids[ started ], NULL, work,
+                                 &args[ started ] ) != 0 ) {
+                break;
+            }
+            started += 1;
+        }
+        work( &( struct worker_arg ){ .scheduler = s, .index = 0 } );
+        for ( size_t i = 0; i < started; i += 1 ) {
+            pthread_join( ids[ i ], NULL );
+        }
+        untracked_free( ids );
+        untracked_free( args );
+        pthread_cond_destroy( &s->wake );
+        pthread_mutex_destroy( &s->idle_lock );
+    }
+    finish( root );
+
+    current = s->outer_current;
+    scheduler = s->outer_scheduler;
+    worker = s->outer_worker;
+    for ( size_t i = 0; s->deques != NULL && i < s->workers; i += 1 ) {
+        pthread_mutex_destroy( &s->deques[ i ].lock );
+        untracked_free( s->deques[ i ].items );
+    }
+    untracked_free( s->deques );
+    untracked_free( s );
+    root->scheduler = NULL;
+}
+
+
+void subtest_free( Subtest * const s )
+{
+    if ( s != NULL ) {
+        assert( s->scheduler == NULL );
+        for ( size_t i = 0; i < s->children_size; i += 1 ) {
+            subtest_free( s->children[ i ] );
+        }
+        untracked_free( s->children );
+        assertions_free( s->assertions );
+        untracked_free( s->name );
+        untracked_free( s );
+    }
+}
+
+
+void subtests_print_( struct subtests_print_options const o )
+{
+    assert( o.subtest != NULL );
+    FILE * const file = ( o.file == NULL ) ? stdout : o.file;
+    char const * const indent = ( o.indent == NULL ) ? "" : o.indent;
+    size_t const depth = o.depth + 1;
+    char * const indent1 = untracked_repeat( indent, depth );
+    char * const indent2 = untracked_repeat( indent, depth + 1 );
+    char * const indent3 = untracked_repeat( indent, depth + 2 );
+
+    for ( size_t i = 0; i < o.subtest->children_size; i += 1 ) {
+        Subtest const * const child = o.subtest->children[ i ];
+        fprintf( file, "%s%s:  %s", indent1,
+                 child->passed ? "pass" : "fail", child->name );
+        if ( child->descendants > 0 ) {
+            fprintf( file, "  (%zu subtest%s)", child->descendants,
+                     ( child->descendants == 1 ) ? "" : "s" );
+        }
+        fprintf( file, "\n" );
+        if ( !child->passed ) {
+            assertions_print( false, .assertions = *( child->assertions ),
+                                     .file = file,
+                                     .assertion_indent = indent2,
+                                     .ids_indent = indent3,
+                                     .ids_limit = o.ids_limit );
+            subtests_print( .subtest = child,
+                            .file = file,
+                            .indent = indent,
+                            .depth = depth,
+                            .ids_limit = o.ids_limit );
+        }
+    }
+    untracked_free( indent1 );
+    untracked_free( indent2 );
+    untracked_free( indent3 );
+}
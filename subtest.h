@@ -0,0 +1,146 @@
+// subtest.h
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef INCLUDED_TESTC_SUBTEST_H
+#define INCLUDED_TESTC_SUBTEST_H
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "assertions.h" // Assertions
+
+
+// A test (or a subtest) can spawn subtests, e.g. one per input file,
+// which can spawn subtests of their own, e.g. one per record of that
+// file. The subtests are run after the function that spawned them
+// returns, on a pool of `parallel_default_threads()` threads (see
+// `parallel.h`) that each have a deque of the subtests they spawned:
+// a thread runs its own most-recent subtest, or when it has none, it
+// steals the oldest subtest of another thread. `test_run()` waits for
+// every subtest of its test, and reports them as a tree in the order
+// they were spawned, whichever order they ran in.
+
+
+typedef Assertions * ( * subtest_fn )( void * ctx );
+
+
+// A subtest, and the tree of its own subtests.
+typedef struct Subtest {
+
+    // Used for displaying the results of the subtest.
+    char * name;
+
+    // Generates and returns a sequence of assertions; `NULL` for the
+    // root of a tree, which is the test that `test_run()` runs.
+    subtest_fn func;
+
+    // Given to `func`, and then to `free_ctx` if it's not `NULL`.
+    void * ctx;
+    void ( * free_ctx )( void * ctx );
+
+    // The assertions returned by `func`, or `NULL` if it hasn't run.
+    Assertions * assertions;
+
+    // The subtests that `func` spawned, in the order it spawned them.
+    struct Subtest * * children;
+    size_t children_size;
+    size_t children_capacity;
+
+    // Whether the subtest and all of its descendants passed, and how
+    // many descendants it has, once its tree has finished.
+    bool passed;
+    size_t descendants;
+
+    // The state of the scheduler, if this is the root of a tree.
+    struct subtest_scheduler * scheduler;
+
+    // Invariants:
+    // - `name` is not `NULL`
+    // - `children` is `NULL` if and only if `children_capacity` is `0`
+    // - `children_size` is less than or equal to `children_capacity`
+
+} Subtest;
+
+
+struct subtest_spawn_options {
+    char const * name;
+    subtest_fn func;
+    void * ctx;
+    void ( * free_ctx )( void * ctx );
+};
+
+void subtest_spawn_( struct subtest_spawn_options );
+
+// Spawns a subtest of the test or subtest that's running on the calling
+// thread, with a copy of the given `name`, that will call `func` with
+// the given `ctx` (and then `free_ctx`, if it's not `NULL`, with the
+// same `ctx`). For example:
+//      subtest_spawn( .name = path, .func = test_file, .ctx = path );
+#define subtest_spawn( ... ) \
+    subtest_spawn_( ( struct subtest_spawn_options ){ __VA_ARGS__ } )
+
+
+// Returns the test or subtest that's running on the calling thread, or
+// `NULL` if there isn't one.
+Subtest const * subtest_current( void );
+
+
+// Starts a tree of subtests with a root of the given `name`, which is
+// current on the calling thread until the corresponding `subtests_end()`.
+// These can be nested. `test_run()` calls this for each test.
+Subtest * subtests_begin( char const * name );
+
+
+// Sets the `assertions` of the given `root`, which should be the current
+// root of the calling thread, runs the subtests of its tree until there
+// are none left, and restores the tree that was current before the
+// corresponding `subtests_begin()`. The caller owns the tree.
+void subtests_end( Subtest * root, Assertions * assertions );
+
+
+// Frees the given subtest, with its name, assertions and descendants.
+void subtest_free( Subtest * subtest );
+
+
+struct subtests_print_options {
+    Subtest const * subtest;
+    FILE * file;
+    char const * indent;
+    size_t depth;
+    size_t ids_limit;
+};
+
+void subtests_print_( struct subtests_print_options );
+
+// Prints the tree of subtests below the given finished `subtest` to the
+// `file` (or `stdout` if `NULL`), as `test_run()` prints tests, with
+// each level indented by another `indent`, starting at `depth` + 1.
+// The descendants of the subtests that passed are only counted, to
+// keep the output short: for example,
+//      pass:  a.txt  (1000 subtests)
+//      fail:  b.txt  (2 subtests)
+//        pass:  record 0
+//        fail:  record 1
+//          false:  r.size > 0  (tests/subtest.c:42)
+#define subtests_print( ... ) \
+    subtests_print_( ( struct subtests_print_options ){ __VA_ARGS__ } )
+
+
+#endif // ifndef INCLUDED_TESTC_SUBTEST_H
@@ -0,0 +1,180 @@
+// test-cases.c
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "test-cases.h" // TestCase, test_case_gen
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+
+#include <pthread.h>
+
+#include "test.h" // Test, test_run
+#include "heap.h" // heap_*
+#include "fixture.h" // fixtures_*
+#include "parallel.h" // parallel_default_threads
+#include "_common.h" // untracked_*
+
+
+// The state shared by the threads of a `test_cases_run()`, guarded by
+// `lock`.
+struct run {
+    struct test_cases_run_options o;
+    pthread_mutex_t lock;
+    pthread_cond_t printed;
+
+    // The index of the next case to take from the generator, or of the
+    // case after the last one if `done` is `true`.
+    size_t next;
+    bool done;
+
+    // The index of the first case whose results haven't been printed,
+    // and the results of the cases from there, in a ring of `window`.
+    size_t first;
+    char * * outputs;
+    size_t * output_sizes;
+
+    int failed;
+};
+
+
+static
+bool take( struct run * const r, TestCase * const c )
+// Fills in the given case with the next case of the run, once it's
+// within the window, and returns `true`; or returns `false` if there are
+// no more cases. The caller should hold the lock.
+{
+    while ( !r->done && r->next - r->first >= r->o.window ) {
+        pthread_cond_wait( &r->printed, &r->lock );
+    }
+    if ( r->done ) {
+        return false;
+    }
+    c->index = r->next;
+    if ( !r->o.next( r->o.state, c ) ) {
+        r->done = true;
+        pthread_cond_broadcast( &r->printed );
+        return false;
+    }
+    r->next += 1;
+    return true;
+}
+
+
+static
+void print_ready( struct run * const r )
+// Prints the results of the cases from `first` that have finished, in
+// order. The caller should hold the lock.
+{
+    FILE * const file = ( r->o.file == NULL ) ? stdout : r->o.file;
+    size_t slot = r->first % r->o.window;
+    while ( r->outputs[ slot ] != NULL ) {
+        fwrite( r->outputs[ slot ], 1, r->output_sizes[ slot ], file );
+        heap_pause();
+        free( r->outputs[ slot ] );
+        heap_resume();
+        r->outputs[ slot ] = NULL;
+        r->first += 1;
+        slot = r->first % r->o.window;
+    }
+    pthread_cond_broadcast( &r->printed );
+}
+
+
+static
+void * work( void * const arg )
+// Runs the cases of the run, one at a time, until there are none left.
+{
+    struct run * const r = arg;
+    TestCase c = { .index = 0 };
+    pthread_mutex_lock( &r->lock );
+    while ( take( r, &c ) ) {
+        pthread_mutex_unlock( &r->lock );
+        char * output = NULL;
+        size_t size = 0;
+        heap_pause();
+        FILE * const file = open_memstream( &output, &size );
+        heap_resume();
+        c.name[ TEST_CASE_NAME_SIZE - 1 ] = '\0';
+        bool const passed = test_run(
+            .test = { .name = c.name,
+                      .func_ctx = r->o.func,
+                      .ctx = &c.params },
+            .file = file,
+            .indent = r->o.indent,
+            .ids_limit = r->o.ids_limit );
+        heap_pause();
+        fclose( file );
+        heap_resume();
+        pthread_mutex_lock( &r->lock );
+        if ( !passed ) {
+            r->failed += 1;
+        }
+        r->outputs[ c.index % r->o.window ] = output;
+        r->output_sizes[ c.index % r->o.window ] = size;
+        print_ready( r );
+    }
+    pthread_mutex_unlock( &r->lock );
+    return NULL;
+}
+
+
+int test_cases_run_( struct test_cases_run_options o )
+{
+    assert( o.name != NULL );
+    assert( o.next != NULL );
+    assert( o.func != NULL );
+    FILE * const file = ( o.file == NULL ) ? stdout : o.file;
+    o.indent = ( o.indent == NULL ) ? "  " : o.indent;
+    size_t const threads = heap_is_tracked() ? 1
+                         : ( o.threads == 0 ) ? parallel_default_threads()
+                         : o.threads;
+    o.window = ( o.window == 0 ) ? 4 * threads : o.window;
+
+    fprintf( file, "Running %s tests...\n", o.name );
+    size_t const fixtures = fixtures_mark();
+    struct run r = {
+        .o = o,
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+        .printed = PTHREAD_COND_INITIALIZER,
+        .outputs = untracked_calloc( o.window, sizeof ( char * ) ),
+        .output_sizes = untracked_calloc( o.window, sizeof ( size_t ) )
+    };
+    // This thread is one of the workers.
+    pthread_t * const ids = untracked_malloc( threads * sizeof ( pthread_t ) );
+    size_t started = 0;
+    while ( started + 1 < threads
+         && pthread_create( &ids[ started ], NULL, work, &r ) == 0 ) {
+        started += 1;
+    }
+    work( &r );
+    for ( size_t i = 0; i < started; i += 1 ) {
+        pthread_join( ids[ i ], NULL );
+    }
+    assert( r.first == r.next );
+    untracked_free( ids );
+    untracked_free( r.outputs );
+    untracked_free( r.output_sizes );
+    pthread_mutex_destroy( &r.lock );
+    pthread_cond_destroy( &r.printed );
+    fixtures_teardown_to( fixtures );
+    return r.failed;
+}
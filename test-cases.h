@@ -0,0 +1,103 @@
+// test-cases.h
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef INCLUDED_TESTC_TEST_CASES_H
+#define INCLUDED_TESTC_TEST_CASES_H
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "test.h" // test_ctx_fn
+
+
+// A generated suite is one test function that's run for each case that
+// a generator gives, one at a time, so a suite of millions of cases
+// never has to be stored as a `Test[]`.
+
+
+// How long the name of a case can be, including the terminating null.
+#define TEST_CASE_NAME_SIZE 128
+
+// How large the parameters of a case can be, in bytes.
+#define TEST_CASE_PARAMS_SIZE 128
+
+
+// A case of a generated suite, which the generator fills in.
+typedef struct TestCase {
+
+    // The position of the case in the suite, from `0`; this is set by
+    // the runner before the generator is called.
+    size_t index;
+
+    // Used for displaying and naming the results of the case.
+    char name[ TEST_CASE_NAME_SIZE ];
+
+    // The parameters of the case, which the test function is given a
+    // pointer to, suitably aligned for any type. The alignment members
+    // stand in for C11's `max_align_t`, so that this builds under C99.
+    union {
+        long double align_long_double;
+        long long align_long_long;
+        void * align_pointer;
+        void ( * align_function )( void );
+        unsigned char bytes[ TEST_CASE_PARAMS_SIZE ];
+    } params;
+
+} TestCase;
+
+
+// Fills in the given case with the next case of a suite, and returns
+// `true`, or returns `false` if there are no more cases. It's given the
+// `state` that was given to `test_cases_run()`, and it's never called by
+// more than one thread at a time.
+typedef bool ( * test_case_gen )( void * state, TestCase * next );
+
+
+struct test_cases_run_options {
+    char const * name;
+    test_case_gen next;
+    void * state;
+    test_ctx_fn func;
+    FILE * file;
+    char const * indent;
+    size_t ids_limit;
+    size_t threads;
+    size_t window;
+};
+
+// Runs the given test `func` for each case given by `next`, as
+// `tests_run()` runs each test of an array, with a pointer to the
+// case's `params` as its context. Returns the number of failures.
+//
+// The cases are taken from the generator as they're needed by a pool of
+// `threads` threads (or `parallel_default_threads()` if `0`; see
+// `parallel.h`), and each case's results are printed in the order of the
+// cases. At most `window` cases (or four per thread if `0`) are taken
+// ahead of the first case whose results haven't been printed, to bound
+// the memory held for the results. If Test.c was compiled with heap
+// instrumentation, the cases are run on a single thread, so that each
+// case's heap usage is its own.
+int test_cases_run_( struct test_cases_run_options );
+
+#define test_cases_run( ... ) \
+    test_cases_run_( ( struct test_cases_run_options ){ __VA_ARGS__ } )
+
+
+#endif // ifndef INCLUDED_TESTC_TEST_CASES_H
@@ -16,61 +16,287 @@
 // along with this program. If not, see <http://www.gnu.org/licenses/>.
 
 
+#define _POSIX_C_SOURCE 200809L
+
 #include "test.h" // Test
 
+#include <stdarg.h>
 #include <stdbool.h>
+#include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
 
+#include <fnmatch.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
 #include "assertion.h" // TestAssertion, test_assertion*
-#include "_common.h" // string_eq
+#include "heap.h" // HeapStats, heap_*
+#include "counters.h" // Counters, counters_*
+#include "fixture.h" // fixtures_*
+#include "subtest.h" // Subtest, subtest_*, subtests_*
+#include "_common.h" // string_eq, untracked_*
 
 
 bool test_eq( Test const t1, Test const t2 )
 {
     return t1.func == t2.func
+        && t1.func_ctx == t2.func_ctx
+        && t1.setup == t2.setup
+        && t1.teardown == t2.teardown
+        && t1.ctx == t2.ctx
+        && t1.rows == t2.rows
+        && t1.row_size == t2.row_size
+        && t1.rows_size == t2.rows_size
+        && string_eq( t1.row_format, t2.row_format )
         && string_eq( t1.name, t2.name );
 }
 
 
+bool test_is_array_end( Test const t )
+{
+    return t.func == NULL && t.func_ctx == NULL;
+}
+
+
+char const * test_current_name( void )
+{
+    Subtest const * const s = subtest_current();
+    return ( s == NULL ) ? NULL : s->name;
+}
+
+
+// Whether this process was forked by `test_run()`.
+static bool forked = false;
+
+
+bool test_is_forked( void )
+{
+    return forked;
+}
+
+
 static
-char * repeat( char const * const string, size_t const times )
+bool run_forked( struct test_run_options o )
+// Runs the test of the given options in a child process, as described
+// by `test_run()`. The child writes whether the test passed as a single
+// byte, followed by its output, to a pipe, and we copy that output to
+// ours.
 {
-    char * const new = calloc( ( strlen( string ) * times ) + 1, 1 );
-    for ( size_t i = 0; i < times; i += 1 ) {
-        strcat( new, string );
+    FILE * const file = ( o.file == NULL ) ? stdout : o.file;
+    char const * const indent = ( o.indent == NULL ) ? "" : o.indent;
+
+    // Otherwise, the child would inherit and flush our buffered output.
+    fflush( file );
+    fflush( stdout );
+    int fds[ 2 ];
+    bool const piped = ( pipe( fds ) == 0 );
+    pid_t const pid = piped ? fork() : -1;
+    if ( piped && pid < 0 ) {
+        close( fds[ 0 ] );
+        close( fds[ 1 ] );
+    }
+    if ( pid == 0 ) {
+        close( fds[ 0 ] );
+        forked = true;
+        // The counters that we inherited count the parent's thread, so
+        // close them to have the child's thread open its own.
+        counters_close();
+        char * output = NULL;
+        size_t size = 0;
+        o.file = open_memstream( &output, &size );
+        o.fork = false;
+        bool const passed = test_run_( o );
+        fclose( o.file );
+        // `_exit()` doesn't flush, so flush what the test itself printed
+        // to a buffered `stdout`, before the results that follow it.
+        fflush( stdout );
+        FILE * const pipe_file = fdopen( fds[ 1 ], "w" );
+        fputc( passed ? 'P' : 'F', pipe_file );
+        fwrite( output, 1, size, pipe_file );
+        fflush( pipe_file );
+        fclose( pipe_file );
+        _exit( 0 );
+    }
+
+    bool passed = false;
+    char result = '\0';
+    if ( pid > 0 ) {
+        close( fds[ 1 ] );
+        char buffer[ 4096 ];
+        ssize_t n;
+        bool first = true;
+        while ( ( n = read( fds[ 0 ], buffer, sizeof buffer ) ) > 0 ) {
+            size_t const skip = first ? 1 : 0;
+            if ( first ) {
+                result = buffer[ 0 ];
+                first = false;
+            }
+            fwrite( buffer + skip, 1, n - skip, file );
+        }
+        close( fds[ 0 ] );
+    }
+    int status = 0;
+    if ( pid > 0 && waitpid( pid, &status, 0 ) == pid
+      && WIFEXITED( status ) && ( result == 'P' || result == 'F' ) ) {
+        passed = ( result == 'P' );
+    } else {
+        fprintf( file, "%sfail:  %s\n%s%s", indent, o.test.name, indent,
+                 indent );
+        if ( pid < 0 ) {
+            fprintf( file, "couldn't fork the test\n" );
+        } else if ( WIFSIGNALED( status ) ) {
+            fprintf( file, "killed by signal %d (%s)\n",
+                     WTERMSIG( status ), strsignal( WTERMSIG( status ) ) );
+        } else {
+            fprintf( file, "exited with status %d before it finished\n",
+                     WEXITSTATUS( status ) );
+        }
     }
-    return new;
+    return passed;
 }
 
 
 bool test_run_( struct test_run_options const o )
 {
+    if ( o.fork ) {
+        return run_forked( o );
+    }
+
     Test const test = o.test;
     FILE * const file = ( o.file == NULL ) ? stdout : o.file;
     char const * const indent = ( o.indent == NULL ) ? "" : o.indent;
 
-    Assertions * const as = test.func();
+    assert( ( test.func == NULL ) != ( test.func_ctx == NULL ) );
+    assert( test.rows == NULL );
+
+    Subtest * const tree = subtests_begin( test.name );
+    void * const ctx = ( test.setup == NULL ) ? test.ctx : test.setup();
+    heap_begin();
+    if ( o.counters ) {
+        counters_begin();
+    }
+    Assertions * const as = ( test.func != NULL ) ? test.func()
+                                                  : test.func_ctx( ctx );
+    Counters const counters = o.counters ? counters_end()
+                                         : ( Counters ){ .values = { 0 } };
     assert( as != NULL );
-    bool const passed = assertions_all_true( *as );
-    fprintf( file, "%s%s:  %s\n",
-             indent, passed ? "pass" : "fail", test.name );
+    assertions_join( as );
+    subtests_end( tree, as );
+    HeapStats const heap = heap_end();
+    if ( test.teardown != NULL ) {
+        test.teardown( ctx );
+    }
+    bool const passed = tree->passed;
+    fprintf( file, "%s%s:  %s", indent, passed ? "pass" : "fail", test.name );
+    if ( tree->descendants > 0 ) {
+        fprintf( file, "  (%zu subtest%s)", tree->descendants,
+                 ( tree->descendants == 1 ) ? "" : "s" );
+    }
+    fprintf( file, "\n" );
+    char * const indent2 = untracked_repeat( indent, 2 );
+    char * const indent3 = untracked_repeat( indent, 3 );
+    if ( heap_is_tracked() ) {
+        fprintf( file, "%s", indent2 );
+        heap_stats_print( .stats = heap, .file = file );
+    }
+    if ( o.counters ) {
+        fprintf( file, "%s", indent2 );
+        counters_print( .counters = counters, .file = file );
+    }
     if ( !passed ) {
-        char * const indent2 = repeat( indent, 2 );
-        char * const indent3 = repeat( indent, 3 );
         assertions_print( false, .assertions = *as,
                                  .file = file,
                                  .assertion_indent = indent2,
-                                 .ids_indent = indent3 );
-        free( indent2 );
-        free( indent3 );
+                                 .ids_indent = indent3,
+                                 .ids_limit = o.ids_limit );
+        subtests_print( .subtest = tree,
+                        .file = file,
+                        .indent = indent,
+                        .depth = 1,
+                        .ids_limit = o.ids_limit );
     }
-    assertions_free( as );
+    untracked_free( indent2 );
+    untracked_free( indent3 );
+    subtest_free( tree );
     return passed;
 }
 
 
+static
+void format_string( char * const buffer, size_t const size,
+                    char const * const format, ... )
+// Like `snprintf()`, but for a format that isn't a literal.
+{
+    va_list args;
+    va_start( args, format );
+    vsnprintf( buffer, size, format, args );
+    va_end( args );
+}
+
+
+static
+void name_row( char * const buffer, size_t const size, Test const test,
+               size_t const row )
+// Writes the name of the given row of the given table test to the
+// `buffer` of `size` bytes, as described by `Test`.
+{
+    int const n = snprintf( buffer, size, "%s/", test.name );
+    if ( n >= 0 && ( size_t ) n < size ) {
+        format_string( buffer + n, size - n,
+                       ( test.row_format == NULL ) ? "%zu" : test.row_format,
+                       row );
+    }
+}
+
+
+static
+bool matches( char const * const filter, char const * const name )
+// Returns `true` if there's no `filter` (or it's empty), or if the given
+// `name` matches it.
+{
+    return filter == NULL || filter[ 0 ] == '\0'
+        || fnmatch( filter, name, 0 ) == 0;
+}
+
+
+TestRows test_run_rows_( struct test_run_rows_options const o )
+{
+    TestRows result = { .run = 0 };
+    Test test = o.test;
+    size_t const rows = ( test.rows == NULL ) ? 1 : test.rows_size;
+    for ( size_t r = 0; r < rows; r += 1 ) {
+        char row_name[ 256 ];
+        if ( o.test.rows != NULL ) {
+            name_row( row_name, sizeof row_name, o.test, r );
+            test.name = row_name;
+            char const * const row = ( char const * ) o.test.rows
+                                   + r * o.test.row_size;
+            // A `test_ctx_fn` takes a mutable context, for those made by
+            // a `setup`, but it's only given a row to read (see `rows`).
+            test.ctx = ( void * ) row;
+            test.rows = NULL;
+        }
+        if ( !matches( o.filter, test.name ) ) {
+            continue;
+        }
+        bool const passed = test_run( .test = test,
+                                      .file = o.file,
+                                      .indent = o.indent,
+                                      .ids_limit = o.ids_limit,
+                                      .counters = o.counters,
+                                      .fork = o.fork );
+        result.run += 1;
+        if ( !passed ) {
+            result.failed += 1;
+        }
+    }
+    return result;
+}
+
+
 int tests_run_( struct tests_run_options const o )
 {
     char const * const name = o.name;
@@ -81,15 +307,24 @@ int tests_run_( struct tests_run_options const o )
     char const * const indent = ( o.indent == NULL ) ? "  " : o.indent;
 
     fprintf( file, "Running %s tests...\n", name );
+    size_t const fixtures = fixtures_mark();
+    for ( size_t i = 0; o.fixtures != NULL && o.fixtures[ i ] != NULL;
+          i += 1 ) {
+        fixture_get( o.fixtures[ i ] );
+    }
+    char const * const filter = ( o.filter == NULL ) ? getenv( "TESTC_FILTER" )
+                                                     : o.filter;
     int failed = 0;
-    for ( size_t i = 0; tests[ i ].func != NULL; i += 1 ) {
-        bool const passed = test_run( .test = tests[ i ],
-                                      .file = file,
-                                      .indent = indent );
-        if ( !passed ) {
-            failed += 1;
-        }
+    for ( size_t i = 0; !test_is_array_end( tests[ i ] ); i += 1 ) {
+        failed += test_run_rows( .test = tests[ i ],
+                                 .file = file,
+                                 .indent = indent,
+                                 .ids_limit = o.ids_limit,
+                                 .counters = o.counters,
+                                 .fork = o.fork,
+                                 .filter = filter ).failed;
     }
+    fixtures_teardown_to( fixtures );
     return failed;
 }
 
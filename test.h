@@ -26,10 +26,14 @@
 #include <macromap.h/macromap.h> // MACROMAP, MACROMAP2
 
 #include "assertions.h" // Assertions
+#include "fixture.h" // Fixture
 
 
 typedef Assertions * ( * test_fn )( void );
 
+// A test function that takes the context made by its test's `setup`.
+typedef Assertions * ( * test_ctx_fn )( void * ctx );
+
 
 // A test is a named function that generates an array of assertions. A
 // test is considered to pass if all of these assertions were true.
@@ -41,10 +45,37 @@ typedef struct Test {
     // Generates and returns a sequence of assertions.
     test_fn func;
 
+    // Like `func`, but takes the context returned by `setup`. A test
+    // has either a `func` or a `func_ctx`.
+    test_ctx_fn func_ctx;
+
+    // If not `NULL`, called before the test function to make a fresh
+    // context for it, which is freed by `teardown` (if not `NULL`)
+    // after the test function returns. These aren't counted in the
+    // heap usage or performance counters of the test.
+    void * ( * setup )( void );
+    void ( * teardown )( void * ctx );
+
+    // If `setup` is `NULL`, given to `func_ctx` as its context instead,
+    // e.g. for the parameters of a generated test.
+    void * ctx;
+
+    // If not `NULL`, `tests_run()` runs `func_ctx` once for each of the
+    // `rows_size` rows of `row_size` bytes in this array, with a pointer
+    // to the row as its context (which it shouldn't modify). Each row is
+    // reported as a test named by `name`, a slash, and `row_format` (or
+    // `"%zu"` if `NULL`) formatted with the index of the row.
+    void const * rows;
+    size_t row_size;
+    size_t rows_size;
+    char const * row_format;
+
     // Invariants:
     // - `name` is not `NULL`
-    // - `func` is not `NULL`
-    // - `func()` is not `NULL`
+    // - exactly one of `func` and `func_ctx` is not `NULL`
+    // - `func()` or `func_ctx()` is not `NULL`
+    // - if `rows` is not `NULL`, `func_ctx` is not `NULL`, `setup` is
+    //   `NULL`, and `row_size` is not `0`
 
 } Test;
 
@@ -53,16 +84,48 @@ typedef struct Test {
 #define TEST( FUNC ) { .func = FUNC, .name = #FUNC }
 
 
+// Evaluates to a literal `Test` with the given `test_ctx_fn`
+// expression, which will be given a context made by `SETUP` and freed
+// by `TEARDOWN` (either of which may be `NULL`).
+#define TEST_CTX( FUNC, SETUP, TEARDOWN ) \
+    { .func_ctx = FUNC, .setup = SETUP, .teardown = TEARDOWN, .name = #FUNC }
+
+
+// Evaluates to a literal `Test` with the given `test_ctx_fn` expression,
+// which is run for each row of the given array (which must be an
+// array, not a pointer), named with the given `printf()` format of the
+// row's index (as a `size_t`). For example, with a `static struct
+// parse_case const parse_cases[] = { ... }`:
+//      TEST_TABLE( parse_works, parse_cases, "row %zu" )
+#define TEST_TABLE( FUNC, TABLE, FORMAT ) \
+    { .func_ctx = FUNC, \
+      .rows = TABLE, \
+      .row_size = sizeof ( TABLE )[ 0 ], \
+      .rows_size = sizeof ( TABLE ) / sizeof ( TABLE )[ 0 ], \
+      .row_format = FORMAT, \
+      .name = #FUNC }
+
+
+// Evaluates to a literal `Test` that violates an invariant of `Test`,
+// with neither a `func` nor a `func_ctx`, which is intended to only be
+// used as an end-sentinel of a `Test` array, and otherwise ignored.
+#define TEST_ARRAY_END { .func = NULL, .func_ctx = NULL }
+
+
+// Returns `true` if the given `Test` is an end-sentinel, as given by
+// `TEST_ARRAY_END`, and `false` otherwise.
+bool test_is_array_end( Test );
+
+
 // Takes a series of `test_fn` expressions, and evaluates to a literal
-// `Test[]` terminated by an `Test` with a `NULL` `func` field (which
-// violates an invariant of `Assertion`, but is intended to only be used
-// as an end-sentinel, and otherwise ignored).
+// `Test[]` terminated by `TEST_ARRAY_END`. To mix in tests made by
+// `TEST_CTX()`, write out the array with `TEST()` and `TEST_ARRAY_END`.
 //
 // This depends on `MACROMAP`, so it can't take more than 128
 // expressions, and no expression can begin with more than four
 // parentheses.
 #define TEST_ARRAY( ... ) \
-    { MACROMAP( TEST_ARRAY_EL, __VA_ARGS__ ) { .func = NULL } }
+    { MACROMAP( TEST_ARRAY_EL, __VA_ARGS__ ) TEST_ARRAY_END }
 #define TEST_ARRAY_EL( FUNC ) TEST( FUNC ),
 
 
@@ -74,26 +137,100 @@ struct test_run_options {
     Test test;
     FILE * file;
     char const * indent;
+    size_t ids_limit;
+    bool counters;
+    bool fork;
 };
 
-// Runs the given `test`, prints the results to `file` (or `stdout` if
-// `NULL`), indenting each line with `indent` (or `""` if `NULL`), and
-// returns `true` if the test passed or `false` if it failed.
+// Runs the given `test`, which can't be a table, prints the results to
+// `file` (or `stdout` if `NULL`), indenting each line with `indent` (or
+// `""` if `NULL`), and returns `true` if the test passed or `false` if
+// it failed. The false assertions are printed by `assertions_print()`
+// with the given `ids_limit`. If Test.c was compiled with heap
+// instrumentation (see `heap.h`), the heap usage of the test is printed
+// as well. If `counters` is `true`, the performance counters of the
+// thread that runs the test (see `counters.h`) are printed too. If the
+// test spawned subtests (see `subtest.h`), they're run before this
+// returns, and the test only passes if they all do; the failed subtests
+// are printed as a tree below the test.
+//
+// If `fork` is `true`, the test is run in a child process, which sends
+// its results back over a pipe. The child has a copy-on-write snapshot
+// of the memory of this process, so the test can modify any fixtures
+// that were already set up (see `fixture_get_snapshot()`) without
+// affecting later tests. If the child dies before it sends its results,
+// e.g. from a signal, the test fails. This should only be done from a
+// single-threaded process.
 bool test_run_( struct test_run_options );
 #define test_run( ... ) \
     test_run_( ( struct test_run_options ){ __VA_ARGS__ } )
 
 
+// Returns the name of the test or subtest being run by `test_run()` on
+// the calling thread, or `NULL` if there isn't one.
+char const * test_current_name( void );
+
+
+// Returns `true` if this process is a child forked by `test_run()` to
+// run a test, and `false` otherwise.
+bool test_is_forked( void );
+
+
+// How many of the rows of a test were run by `test_run_rows()`, and how
+// many of those failed.
+typedef struct TestRows {
+    size_t run;
+    size_t failed;
+} TestRows;
+
+
+struct test_run_rows_options {
+    Test test;
+    FILE * file;
+    char const * indent;
+    size_t ids_limit;
+    bool counters;
+    bool fork;
+    char const * filter;
+};
+
+// Runs the given `test` by `test_run()` with the given options, or, if
+// it's a table test (see `TEST_TABLE()`), runs each of its rows as a
+// test of its own, named as described by `Test`. Only the tests (and
+// rows) whose names match the `filter` pattern are run, if it's not
+// `NULL` or empty, as matched by `fnmatch()`.
+TestRows test_run_rows_( struct test_run_rows_options );
+#define test_run_rows( ... ) \
+    test_run_rows_( ( struct test_run_rows_options ){ __VA_ARGS__ } )
+
+
 struct tests_run_options {
     char const * name;
     Test const * tests;
     FILE * file;
     char const * indent;
+    size_t ids_limit;
+    bool counters;
+    bool fork;
+    Fixture * const * fixtures;
+    char const * filter;
 };
 
 // Runs each test in the terminated `tests` array, prints the results to
 // `file` (or `stdout` if `NULL`), indenting each line with `indent` (or
-// `"  "` if `NULL`), and returns the number of failures.
+// `"  "` if `NULL`), and returns the number of failures. Each test is
+// run by `test_run()` with the given `ids_limit`, `counters` and
+// `fork`. Each row of a table test (see `TEST_TABLE()`) is run as a
+// test of its own.
+//
+// Only the tests (and rows) whose names match the `filter` pattern (or
+// `$TESTC_FILTER` if `NULL`) are run, if there is one, as matched by
+// `fnmatch()`: e.g. `"parse_*"`, or `"parse_works/row 1?"`.
+//
+// The given `NULL`-terminated array of `fixtures` (if not `NULL`) is
+// set up before any tests are run, so that forked tests get snapshots
+// of them. Those fixtures, and the fixtures that the tests set up by
+// `fixture_get()`, are torn down before this returns (see `fixture.h`).
 int tests_run_( struct tests_run_options );
 #define tests_run( ... ) \
     tests_run_( ( struct tests_run_options ){ __VA_ARGS__ } )
@@ -34,7 +34,9 @@ static AssertionId const examples[] = {
     { .value = 1, .expr = "ab" },
     { .value = 2, .expr = "" },
     { .value = 2, .expr = "a" },
-    { .value = 2, .expr = "ab" }
+    { .value = 2, .expr = "ab" },
+    { .value = 1LL << 40, .expr = "a" },
+    { .value = ( 1LL << 40 ) + 1, .expr = "a" }
 };
 
 
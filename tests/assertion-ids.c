@@ -17,6 +17,7 @@
 
 
 #include <string.h>
+#include <limits.h>
 #include <assert.h>
 
 #include <test.h>
@@ -24,6 +25,8 @@
 #include <assertion-ids.h> // AssertionIds, assertion_ids_*
 #include <_common.h> // NELEM
 
+#include "read-back.h" // read_back
+
 
 #define EXAMPLE_IDSS \
     { \
@@ -328,6 +331,41 @@ Assertions * assertion_ids_decrease_capacity__no_trim( void )
 }
 
 
+static
+Assertions * assertion_ids_print_run__spans_every_value( void )
+{
+    // Given:
+    AssertionIds * const low = assertion_ids_new( .array = ( AssertionId[] ){
+        { .expr = "x", .value = LLONG_MIN },
+        { .expr = "y", .value = 4 },
+        ASSERTION_ID_ARRAY_END
+    } );
+    AssertionIds * const high = assertion_ids_new( .array = ( AssertionId[] ){
+        { .expr = "x", .value = LLONG_MAX },
+        { .expr = "y", .value = -2 },
+        ASSERTION_ID_ARRAY_END
+    } );
+    FILE * const file = tmpfile();
+    // When:
+    assertion_ids_print_run( .first = *low, .last = *high, .count = 2,
+                             .file = file );
+    assertion_ids_print_run( .first = *high, .last = *low, .count = 4,
+                             .file = file );
+    // Then:
+    char * const text = read_back( file );
+    Assertions * const as = assertions( strcmp( text,
+        "(for x = -9223372036854775808..9223372036854775807, "
+        "step 18446744073709551615, y = 4..-2, step -6)\n"
+        "(for x = 9223372036854775807..-9223372036854775808, "
+        "step -6148914691236517205, y = -2..4, step 2)\n" ) == 0 );
+
+    free( text );
+    assertion_ids_free( low );
+    assertion_ids_free( high );
+    return as;
+}
+
+
 Test const assertion_ids_tests[] = TEST_ARRAY(
     assertion_ids_new__zero_capacity,
     assertion_ids_new__nonzero_capacity,
@@ -340,6 +378,7 @@ Test const assertion_ids_tests[] = TEST_ARRAY(
     assertion_ids_eq_array__works,
     assertion_ids_is_empty__works,
     assertion_ids_increase_capacity__works,
-    assertion_ids_decrease_capacity__no_trim
+    assertion_ids_decrease_capacity__no_trim,
+    assertion_ids_print_run__spans_every_value
 );
 
@@ -0,0 +1,137 @@
+// tests/assertion-site.c
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <test.h>
+
+#include "read-back.h" // read_back
+
+
+static
+AssertionSite * make_ex_site( void )
+{
+    AssertionSite * const site = assertion_site_new(
+        .file = "foo.c",
+        .line = 12,
+        .expr = "xs[ i ] < y",
+        .ids = ( AssertionId[] ){ { .expr = "i" }, { .expr = "y" },
+                                  ASSERTION_ID_ARRAY_END }
+    );
+    for ( int i = 0; i < 20; i += 1 ) {
+        int const y = 3;
+        assertion_site_add( site, i % 3 != 0,
+                            ( AssertionId[] ) ASSERTION_ID_ARRAY( i, y ) );
+    }
+    return site;
+}
+
+
+static
+Assertions * assertion_site_new__no_ids( void )
+{
+    AssertionSite * const site = assertion_site_new( .file = "foo.c",
+                                                     .line = 1,
+                                                     .expr = "x" );
+    assertion_site_add( site, false, NULL );
+    assertion_site_add( site, true, NULL );
+    assertion_site_assert_valid( *site );
+    Assertions * const as = assertions(
+        site->ids_size == 0,
+        site->passes == 1,
+        site->fails == 1,
+        assertion_site_is_at( *site, "foo.c", 1, "x" ),
+        !assertion_site_is_at( *site, "foo.c", 2, "x" ),
+        !assertion_site_is_at( *site, "bar.c", 1, "x" )
+    );
+    assertion_site_free( site );
+    return as;
+}
+
+
+static
+Assertions * assertion_site_add__stores_failing_ids( void )
+{
+    AssertionSite * const site = make_ex_site();
+    assertion_site_assert_valid( *site );
+    Assertions * const as = assertions(
+        site->passes == 13,
+        site->fails == 7,
+        site->ids_size == 2
+    );
+    for ( size_t i = 0; i < site->fails; i += 1 ) {
+        AssertionId const i_id = assertion_site_get_id( *site, i, 0 );
+        AssertionId const y_id = assertion_site_get_id( *site, i, 1 );
+        assertions_add( as, assertion_id_eq( i_id, ( AssertionId ){
+                                .expr = "i", .value = 3 * ( int ) i } ), i );
+        assertions_add( as, assertion_id_eq( y_id, ( AssertionId ){
+                                .expr = "y", .value = 3 } ), i );
+    }
+    assertion_site_free( site );
+    return as;
+}
+
+
+static
+Assertions * assertion_site_copy__gives_equal( void )
+{
+    AssertionSite * const site = make_ex_site();
+    AssertionSite * const copy = assertion_site_copy( *site );
+    bool const eq = assertion_site_eq( *site, *copy );
+    assertion_site_add( copy, false,
+                        ( AssertionId[] ) ASSERTION_ID_ARRAY( 1, 2 ) );
+    Assertions * const as = assertions(
+        eq,
+        !assertion_site_eq( *site, *copy ),
+        site->fails + 1 == copy->fails
+    );
+    assertion_site_free( site );
+    assertion_site_free( copy );
+    return as;
+}
+
+
+static
+Assertions * assertion_site_print__runs( void )
+{
+    AssertionSite * const site = make_ex_site();
+    FILE * const file = tmpfile();
+    assertion_site_print( false, .site = *site, .file = file,
+                                 .ids_indent = "  " );
+    assertion_site_print( true, .site = *site, .file = file,
+                                .ids_indent = "  " );
+    char * const text = read_back( file );
+    assertion_site_free( site );
+    Assertions * const as = assertions( strcmp( text,
+        "false:  xs[ i ] < y  (foo.c:12)\n"
+        "  (for i = 0..18, step 3, y = 3)\n"
+        "true:  xs[ i ] < y  (foo.c:12)\n"
+        "  (13 times)\n" ) == 0 );
+    free( text );
+    return as;
+}
+
+
+Test const assertion_site_tests[] = TEST_ARRAY(
+    assertion_site_new__no_ids,
+    assertion_site_add__stores_failing_ids,
+    assertion_site_copy__gives_equal,
+    assertion_site_print__runs
+);
+
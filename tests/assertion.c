@@ -17,10 +17,13 @@
 
 
 #include <stdlib.h>
+#include <stdio.h>
 #include <string.h>
 
 #include <test.h>
 
+#include "read-back.h" // read_back
+
 #include <_common.h> // NELEM
 
 
@@ -140,11 +143,48 @@ Assertions * assertion_eq__works( void )
 }
 
 
+static
+Assertions * assertion_print__detail( void )
+{
+    char detail[] = "first line\nsecond line";
+    Assertion * const a = assertion_new_( ( struct assertion_new_options ){
+        .expr = "x < y",
+        .result = false,
+        .detail = detail
+    } );
+    // The detail should be copied:
+    detail[ 0 ] = 'F';
+    Assertion * const copy = assertion_copy( *a );
+    Assertion * const plain = assertion_new( false, 0 );
+
+    FILE * const file = tmpfile();
+    assertion_print( .assertion = *a, .file = file, .ids_indent = "  " );
+    char * const text = read_back( file );
+
+    Assertions * const as = assertions(
+        strcmp( a->detail, "first line\nsecond line" ) == 0,
+        a->detail != copy->detail,
+        assertion_eq( *a, *copy ),
+        !assertion_eq( *a, ( Assertion ){ .expr = "x < y" } ),
+        plain->detail == NULL,
+        strcmp( text, "false:  x < y\n"
+                      "  first line\n"
+                      "  second line\n" ) == 0
+    );
+    free( text );
+    assertion_free( a );
+    assertion_free( copy );
+    assertion_free( plain );
+    return as;
+}
+
+
 Test const assertion_tests[] = TEST_ARRAY(
     assertion_new__no_ids,
     assertion_new__some_ids,
     assertion_copy__gives_equal,
-    assertion_eq__works
+    assertion_eq__works,
+    assertion_print__detail
 );
 
 
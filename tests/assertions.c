@@ -17,11 +17,18 @@
 
 
 #include <stdlib.h>
+#include <stdio.h>
 #include <string.h>
 #include <assert.h>
 
+#include <pthread.h>
+
 #include <test.h>
 
+#include "read-back.h" // read_back
+
+#include <_common.h> // NELEM, MIN
+
 
 static
 Assertions * make_ex_assertions( void )
@@ -36,6 +43,22 @@ Assertions * make_ex_assertions( void )
 }
 
 
+static
+char * printed( bool const result, Assertions const as,
+                size_t const ids_limit )
+// Returns what `assertions_print()` prints for the given arguments.
+{
+    FILE * const file = tmpfile();
+    assertions_print( result, .assertions = as,
+                              .file = file,
+                              .assertion_indent = "> ",
+                              .ids_indent = "  ",
+                              .ids_limit = ids_limit );
+    char * const text = read_back( file );
+    return text;
+}
+
+
 static
 Assertions * assertions_get__nonnegative( void )
 {
@@ -222,13 +245,386 @@ Assertions * assertions_add__beyond_capacity( void )
 }
 
 
+static
+Assertions * assertions_add_bulk__bools( void )
+{
+    // Given verdicts with failures at either end, and in the middle of
+    // an otherwise-true run of eight:
+    bool results[ 21 ];
+    for ( size_t i = 0; i < NELEM( results ); i += 1 ) {
+        results[ i ] = !( i == 0 || i == 11 || i == 20 );
+    }
+
+    // When we add them in bulk:
+    Assertions * const new = assertions_empty();
+    assertions_add_bulk( new, "results[ i ]", .results = results,
+                                               .size = NELEM( results ) );
+
+    // Then only the failures should be stored, but all of the
+    // assertions should be counted:
+    assertions_assert_valid( *new );
+    Assertions * const as = assertions(
+        new->size == 3,
+        new->elided == NELEM( results ) - 3,
+        assertions_count( *new ) == NELEM( results ),
+        !assertions_all_true( *new )
+    );
+    int const fails[] = { 0, 11, 20 };
+    for ( size_t i = 0; i < NELEM( fails ); i += 1 ) {
+        Assertion const a = *assertions_get( *new, i );
+        assertions_add( as, a.result == false, i );
+        assertions_add( as, strcmp( a.expr, "results[ i ]" ) == 0, i );
+        assertions_add( as, assertion_ids_eq_array( *( a.ids ),
+            ( AssertionId[] ){ { .expr = "i", .value = fails[ i ] },
+                               ASSERTION_ID_ARRAY_END } ), i );
+    }
+
+    assertions_free( new );
+    return as;
+}
+
+
+static
+Assertions * assertions_add_bulk__bits( void )
+{
+    // Given a bitmask of 130 verdicts, where verdicts 3, 64 and 129 are
+    // false, and with garbage in the bits past the end:
+    uint64_t const bits[] = {
+        ~( ( uint64_t ) 1 << 3 ),
+        ~( uint64_t ) 1,
+        ( uint64_t ) 1
+    };
+    int const ids[ 130 ] = { [ 3 ] = -3, [ 64 ] = -64, [ 129 ] = -129 };
+
+    // When we add them in bulk with the given identifications:
+    Assertions * const new = assertions_empty();
+    assertions_add_bulk( new, "bits", .bits = bits,
+                                      .size = 130,
+                                      .id_expr = "ids[ i ]",
+                                      .ids = ids );
+
+    // Then only the failures should be stored, with the given
+    // identifications:
+    assertions_assert_valid( *new );
+    Assertions * const as = assertions(
+        new->size == 3,
+        assertions_count( *new ) == 130
+    );
+    int const fails[] = { -3, -64, -129 };
+    for ( size_t i = 0; i < MIN( NELEM( fails ), new->size ); i += 1 ) {
+        AssertionId const id = assertion_ids_get(
+            *( assertions_get( *new, i )->ids ), 0 );
+        assertions_add( as, id.value == fails[ i ], i );
+        assertions_add( as, strcmp( id.expr, "ids[ i ]" ) == 0, i );
+    }
+
+    assertions_free( new );
+    return as;
+}
+
+
+static
+Assertions * assertions_add_bulk__all_true( void )
+{
+    bool results[ 100 ];
+    for ( size_t i = 0; i < NELEM( results ); i += 1 ) {
+        results[ i ] = true;
+    }
+    Assertions * const new = assertions( 1 == 1 );
+    assertions_add_bulk( new, "results[ i ]", .results = results,
+                                               .size = NELEM( results ) );
+    Assertions * const copy = assertions_copy( *new );
+    Assertions * const as = assertions(
+        new->size == 1,
+        assertions_all_true( *new ),
+        assertions_count( *new ) == NELEM( results ) + 1,
+        assertions_count( *copy ) == assertions_count( *new )
+    );
+    assertions_free( new );
+    assertions_free( copy );
+    return as;
+}
+
+
+static
+Assertions * assertions_eq__compares_the_elided_counts( void )
+{
+    // Given a sequence with elided true assertions, and a copy of it
+    // that elided one fewer:
+    bool const results[] = { true, true, false };
+    Assertions * const new = assertions_empty();
+    assertions_add_bulk( new, "results[ i ]", .results = results,
+                                              .size = NELEM( results ) );
+    Assertions * const copy = assertions_copy( *new );
+    Assertions * const fewer = assertions_copy( *new );
+    fewer->elided -= 1;
+
+    // Then only the exact copy should be equal to it:
+    Assertions * const as = assertions(
+        assertions_eq( *copy, *new ),
+        !assertions_eq( *fewer, *new )
+    );
+
+    assertions_free( new );
+    assertions_free( copy );
+    assertions_free( fewer );
+    return as;
+}
+
+
+static
+Assertions * assertions_print__runs( void )
+{
+    // Given false assertions for `2 <= i < 40`, interrupted by true
+    // assertions, followed by some that don't progress:
+    Assertions * const new = assertions_empty();
+    for ( int i = 0; i < 40; i += 1 ) {
+        assertions_add_ptr( new, assertion_new( i < 2, i ) );
+        assertions_add_ptr( new, assertion_new( true, i ) );
+    }
+    for ( int i = 0; i < 3; i += 1 ) {
+        int const j = i * i;
+        assertions_add_ptr( new, assertion_new( false, i, j ) );
+    }
+    int const k = 4;
+    for ( int i = 0; i < 3; i += 1 ) {
+        assertions_add_ptr( new, assertion_new( false, k ) );
+    }
+
+    // When we print the false assertions:
+    char * const text = printed( false, *new, 0 );
+
+    // Then each run should be printed on a single line:
+    Assertions * const as = assertions( strcmp( text,
+        "> false:  i < 2\n"
+        "  (for i = 2..39, step 1)\n"
+        "> false:  false\n"
+        "  (for i = 0, j = 0)\n"
+        "  (for i = 1, j = 1)\n"
+        "  (for i = 2, j = 4)\n"
+        "  (for k = 4, 3 times)\n" ) == 0 );
+
+    free( text );
+    assertions_free( new );
+    return as;
+}
+
+
+static
+Assertions * assertions_print__ids_limit( void )
+{
+    // Given an assertion that fails for scattered identifications:
+    Assertions * const new = assertions_empty();
+    for ( int i = 0; i < 10; i += 1 ) {
+        int const j = i * i;
+        assertions_add_ptr( new, assertion_new( j > 100, j ) );
+    }
+
+    // When we print the false assertions with a limit:
+    char * const text = printed( false, *new, 2 );
+
+    // Then only that many identification lines should be printed:
+    Assertions * const as = assertions( strcmp( text,
+        "> false:  j > 100\n"
+        "  (for j = 0)\n"
+        "  (for j = 1)\n"
+        "  ... and 8 more\n" ) == 0 );
+
+    free( text );
+    assertions_free( new );
+    return as;
+}
+
+
+static
+Assertions * assertions_add__groups_by_site( void )
+{
+    // Given assertions made at two sites in a loop:
+    Assertions * const new = assertions_empty();
+    int const line = __LINE__ + 2;
+    for ( int i = 0; i < 100; i += 1 ) {
+        assertions_add( new, i % 10 != 5, i );
+        assertions_add( new, i >= 0, 0 );
+    }
+
+    // Then the evaluations should be grouped by those sites, and only
+    // the identifications of the failures should be stored:
+    assertions_assert_valid( *new );
+    Assertions * const as = assertions(
+        new->size == 0,
+        new->sites_size == 2,
+        assertions_count( *new ) == 200,
+        !assertions_all_true( *new )
+    );
+    if ( new->sites_size == 2 ) {
+        AssertionSite const s0 = *( new->sites[ 0 ] );
+        AssertionSite const s1 = *( new->sites[ 1 ] );
+        assertions_add( as, s0.line == line, 0 );
+        assertions_add( as, s0.passes == 90 && s0.fails == 10, 0 );
+        assertions_add( as, s1.passes == 100 && s1.fails == 0, 0 );
+        assertions_add( as, s1.ids_size == 0, 0 );
+        for ( size_t i = 0; i < s0.fails; i += 1 ) {
+            assertions_add( as,
+                assertion_site_get_id( s0, i, 0 ).value == 5 + 10 * ( int ) i,
+                i );
+        }
+
+        // And printing them should show where they were made:
+        char * const text = printed( false, *new, 0 );
+        char expected[ 256 ];
+        snprintf( expected, sizeof expected,
+                  "> false:  i %% 10 != 5  (%s:%d)\n"
+                  "  (for i = 5..95, step 10)\n", __FILE__, line );
+        assertions_add( as, strcmp( text, expected ) == 0, 0 );
+        free( text );
+    }
+
+    Assertions * const copy = assertions_copy( *new );
+    assertions_add( as, assertions_eq( *copy, *new ), 0 );
+    assertions_free( copy );
+    assertions_free( new );
+    return as;
+}
+
+
+struct worker {
+    Assertions * as;
+    int index;
+};
+
+
+static
+void * add_from_worker( void * const arg )
+{
+    struct worker const * const w = arg;
+    Assertions * const as = assertions_worker( *( w->as ), w->index );
+    for ( int i = 0; i < 1000; i += 1 ) {
+        assertions_add( as, i % 250 != 0, w->index, i );
+    }
+    assertions_add_ptr( as, assertion_new( w->index < 0, w->index ) );
+    return NULL;
+}
+
+
+static
+Assertions * assertions_add_at__finds_sites_among_many( void )
+{
+    // Given sites on many lines of two files:
+    Assertions * const new = assertions_empty();
+    char const * const files[] = { "a.c", "b.c" };
+    char b_copy[] = "b.c";
+    for ( int round = 0; round < 2; round += 1 ) {
+        for ( int line = 0; line < 1000; line += 1 ) {
+            for ( size_t f = 0; f < 2; f += 1 ) {
+                // The second round names a file by another pointer:
+                char const * const file = ( round == 1 && f == 1 )
+                                        ? b_copy : files[ f ];
+                assertions_add_at_( new, ( struct assertions_add_at_options ){
+                    .file = file, .line = line, .expr = "x",
+                    .result = true } );
+            }
+        }
+    }
+
+    // Then each evaluation should be counted at its own site:
+    Assertions * const as = assertions(
+        new->sites_size == 2000,
+        assertions_count( *new ) == 4000
+    );
+    for ( size_t i = 0; i < new->sites_size; i += 1 ) {
+        AssertionSite const site = *( new->sites[ i ] );
+        assertions_add( as, site.passes == 2
+                         && site.line == ( int ) i / 2
+                         && strcmp( site.file, files[ i % 2 ] ) == 0, i );
+    }
+    assertions_free( new );
+    return as;
+}
+
+
+static
+Assertions * assertions_join__merges_in_order( void )
+{
+    // Given:
+    Assertions * const new = assertions_empty();
+    assertions_add_ptr( new, assertion_new( 1 < 0, 0 ) );
+    assertions_set_workers( new, 4 );
+    pthread_t threads[ 4 ];
+    struct worker workers[ 4 ];
+
+    // When:
+    for ( int i = 3; i >= 0; i -= 1 ) {
+        workers[ i ] = ( struct worker ){ .as = new, .index = i };
+        pthread_create( &threads[ i ], NULL, add_from_worker, &workers[ i ] );
+    }
+    for ( size_t i = 0; i < 4; i += 1 ) {
+        pthread_join( threads[ i ], NULL );
+    }
+    assertions_join( new );
+
+    // Then every worker's assertions should be added, in worker order:
+    Assertions * const as = assertions(
+        new->workers_size == 0,
+        new->size == 5,
+        new->sites_size == 1,
+        assertions_count( *new ) == 4005,
+        new->sites[ 0 ]->passes == 3984,
+        new->sites[ 0 ]->fails == 16
+    );
+    for ( int i = 0; i < 4; i += 1 ) {
+        Assertion const * const a = assertions_get( *new, i + 1 );
+        assertions_add( as, a->ids->array[ 0 ].value == i, i );
+        for ( int j = 0; j < 4; j += 1 ) {
+            AssertionSite const site = *( new->sites[ 0 ] );
+            assertions_add( as,
+                assertion_site_get_id( site, i * 4 + j, 0 ).value == i
+             && assertion_site_get_id( site, i * 4 + j, 1 ).value == j * 250,
+                i, j );
+        }
+    }
+    assertions_free( new );
+    return as;
+}
+
+
+static
+Assertions * assertions_join__copies_and_frees_workers( void )
+{
+    Assertions * const new = assertions_empty();
+    assertions_set_workers( new, 2 );
+    assertions_add( assertions_worker( *new, 1 ), false, 0 );
+    Assertions * const copy = assertions_copy( *new );
+    assertions_join( copy );
+    Assertions * const as = assertions(
+        copy->sites_size == 1,
+        copy->sites[ 0 ]->fails == 1,
+        new->workers_size == 2,
+        assertions_worker( *new, 1 )->sites_size == 1,
+        assertions_is_valid( *new )
+    );
+    assertions_free( copy );
+    assertions_free( new );
+    return as;
+}
+
+
 Test const assertions_tests[] = TEST_ARRAY(
     assertions_get__nonnegative,
     assertions_get__negative,
     assertions_increase_capacity__works,
     assertions_decrease_capacity__no_trim,
     assertions_add__up_to_capacity,
-    assertions_add__beyond_capacity
+    assertions_add__beyond_capacity,
+    assertions_add_bulk__bools,
+    assertions_add_bulk__bits,
+    assertions_add_bulk__all_true,
+    assertions_eq__compares_the_elided_counts,
+    assertions_print__runs,
+    assertions_print__ids_limit,
+    assertions_add__groups_by_site,
+    assertions_add_at__finds_sites_among_many,
+    assertions_join__merges_in_order,
+    assertions_join__copies_and_frees_workers
 );
 
 
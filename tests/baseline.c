@@ -0,0 +1,172 @@
+// tests/baseline.c
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include <unistd.h>
+
+#include <test.h>
+#include <baseline.h>
+
+
+static
+char * temporary_path( void )
+// Returns the path of a new empty file, which the caller should remove.
+{
+    char * const path = strdup( "/tmp/testc-baseline-XXXXXX" );
+    close( mkstemp( path ) );
+    return path;
+}
+
+
+static
+void spin( void * const ctx )
+{
+    volatile size_t sum = 0;
+    for ( size_t i = 0; i < 100; i += 1 ) {
+        sum += i;
+    }
+}
+
+
+static
+Assertions * baseline_fingerprint__is_hex( void )
+{
+    char const * const fp = baseline_fingerprint();
+    Assertions * const as = assertions(
+        strlen( fp ) == 16,
+        strcmp( fp, baseline_fingerprint() ) == 0
+    );
+    for ( int i = 0; fp[ i ] != '\0'; i += 1 ) {
+        assertions_add( as, isxdigit( ( unsigned char ) fp[ i ] ), i );
+    }
+    return as;
+}
+
+
+static
+Assertions * baseline_store__replaces( void )
+{
+    char * const path = temporary_path();
+    double a = 0, b = 0;
+    bool const missing = baseline_load( path, "a", &a );
+    bool const stored = baseline_store( path, "a", 12.5 )
+                     && baseline_store( path, "b", 100 )
+                     && baseline_store( path, "a", 25 );
+    bool const found = baseline_load( path, "a", &a )
+                    && baseline_load( path, "b", &b );
+    bool const prefix = baseline_load( path, "", &b );
+    remove( path );
+    free( path );
+    return assertions( !missing, stored, found, a == 25, b == 100,
+                       !prefix );
+}
+
+
+static
+Assertions * baseline_is_regression__uses_ci( void )
+{
+    BenchResult const r = { .mean_ns = 120, .ci_low_ns = 105,
+                            .ci_high_ns = 135 };
+    return assertions(
+        !baseline_is_regression( r, 100, 0.1 ),
+        baseline_is_regression( r, 100, 0.04 ),
+        !baseline_is_regression( r, 120, 0 ),
+        baseline_is_regression( r, 50, 0.5 )
+    );
+}
+
+
+static
+Assertions * assertions_add_baseline__works( void )
+{
+    char * const path = temporary_path();
+    Assertions * const new = assertions_empty();
+
+    // The first measurement is stored as the baseline:
+    assertions_add_baseline( new, spin, .path = path,
+                                        .samples = 5,
+                                        .min_sample_ns = 1e5 );
+    double stored = 0;
+    bool const found = baseline_load( path,
+        "assertions_add_baseline__works/spin", &stored );
+
+    // A much faster baseline fails, unless we're updating it:
+    baseline_store( path, "fast", 0.001 );
+    assertions_add_baseline( new, spin, .path = path,
+                                        .name = "fast",
+                                        .samples = 5,
+                                        .min_sample_ns = 1e5 );
+    assertions_add_baseline( new, spin, .path = path,
+                                        .name = "fast",
+                                        .update = true,
+                                        .samples = 5,
+                                        .min_sample_ns = 1e5 );
+    double updated = 0;
+    baseline_load( path, "fast", &updated );
+    remove( path );
+    free( path );
+
+    Assertions * const as = assertions(
+        new->size == 3,
+        found,
+        stored > 0,
+        updated > 1,
+        assertions_get( *new, 0 )->result == true,
+        assertions_get( *new, 1 )->result == false,
+        assertions_get( *new, 2 )->result == true,
+        strcmp( assertions_get( *new, 0 )->expr,
+                "spin is no slower than its baseline" ) == 0,
+        strcmp( assertions_get( *new, 1 )->ids->array[ 0 ].expr,
+                "baseline_ps" ) == 0,
+        assertions_get( *new, 1 )->ids->array[ 0 ].value == 1,
+        strcmp( assertions_get( *new, 1 )->ids->array[ 2 ].expr,
+                "ratio_percent" ) == 0
+    );
+    assertions_free( new );
+    return as;
+}
+
+
+static
+Assertions * assertions_add_baseline__fails_if_it_cant_store( void )
+{
+    Assertions * const baseline = assertions_empty();
+    assertions_add_baseline( baseline, spin,
+                             .path = "/nonexistent/testc/baselines.tsv",
+                             .samples = 5,
+                             .min_sample_ns = 1e5 );
+    bool const failed = baseline->size == 1
+                     && !assertions_get( *baseline, 0 )->result;
+    assertions_free( baseline );
+    return assertions( failed );
+}
+
+
+Test const baseline_tests[] = TEST_ARRAY(
+    baseline_fingerprint__is_hex,
+    baseline_store__replaces,
+    baseline_is_regression__uses_ci,
+    assertions_add_baseline__works,
+    assertions_add_baseline__fails_if_it_cant_store
+);
+
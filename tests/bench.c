@@ -0,0 +1,98 @@
+// tests/bench.c
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <test.h>
+#include <bench.h>
+
+
+static
+void count( void * const ctx )
+{
+    size_t * const calls = ctx;
+    *calls += 1;
+}
+
+
+static
+void spin( void * const ctx )
+{
+    volatile size_t sum = 0;
+    for ( size_t i = 0; i < 100; i += 1 ) {
+        sum += i;
+    }
+}
+
+
+static
+Assertions * bench_run__calibrates( void )
+{
+    BenchResult const r = bench_run( .func = spin,
+                                     .samples = 5,
+                                     .min_sample_ns = 1e6 );
+    return assertions(
+        r.samples == 5,
+        r.mean_ns > 0,
+        r.min_ns <= r.median_ns,
+        r.ci_low_ns <= r.mean_ns,
+        r.mean_ns <= r.ci_high_ns,
+        // A single call of `spin()` is much faster than a millisecond:
+        r.iterations > 1
+    );
+}
+
+
+static
+Assertions * bench_run__fixed_iterations( void )
+{
+    size_t calls = 0;
+    BenchResult const r = bench_run( .func = count,
+                                     .ctx = &calls,
+                                     .samples = 3,
+                                     .iterations = 10 );
+    return assertions(
+        r.iterations == 10,
+        r.samples == 3,
+        calls == 30
+    );
+}
+
+
+static
+Assertions * bench_run__counters( void )
+{
+    BenchResult const r = bench_run( .func = spin,
+                                     .samples = 3,
+                                     .iterations = 1000,
+                                     .counters = true );
+    BenchResult const without = bench_run( .func = spin,
+                                           .samples = 3,
+                                           .iterations = 1000 );
+    return assertions(
+        r.counters.measured[ COUNTER_TASK_CLOCK ],
+        r.counters.values[ COUNTER_TASK_CLOCK ] > 0,
+        !without.counters.measured[ COUNTER_TASK_CLOCK ]
+    );
+}
+
+
+Test const bench_tests[] = TEST_ARRAY(
+    bench_run__calibrates,
+    bench_run__fixed_iterations,
+    bench_run__counters
+);
+
@@ -0,0 +1,88 @@
+// tests/complexity.c
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <test.h>
+#include <complexity.h>
+
+#include "read-back.h" // read_back
+
+
+static
+Assertions * complexity_fit__finds_each_class( void )
+{
+    size_t sizes[ 11 ];
+    double times[ 11 ];
+    Assertions * const as = assertions_empty();
+    for ( int c = 0; c < COMPLEXITY_CLASSES; c += 1 ) {
+        for ( size_t i = 0; i < 11; i += 1 ) {
+            sizes[ i ] = ( size_t ) 16 << i;
+            double const n = sizes[ i ];
+            double const f = ( c == COMPLEXITY_1 ) ? 1
+                           : ( c == COMPLEXITY_LOG_N ) ? log2( n )
+                           : ( c == COMPLEXITY_N ) ? n
+                           : ( c == COMPLEXITY_N_LOG_N ) ? n * log2( n )
+                           : n * n;
+            // Add a few percent of noise:
+            times[ i ] = 5 * f * ( 1 + 0.03 * ( ( int ) ( i % 3 ) - 1 ) );
+        }
+        ComplexityFit const fit = complexity_fit( sizes, times, 11 );
+        assertions_add( as, fit.best == ( ComplexityClass ) c, c );
+        assertions_add( as, fabs( fit.coefficients[ c ] - 5 ) < 0.2, c );
+        assertions_add( as, fit.errors[ c ] < 0.05, c );
+    }
+    return as;
+}
+
+
+static
+Assertions * complexity_fit_print__marks_the_best_fit( void )
+{
+    size_t sizes[ 6 ];
+    double times[ 6 ];
+    for ( size_t i = 0; i < 6; i += 1 ) {
+        sizes[ i ] = ( size_t ) 64 << i;
+        times[ i ] = 0.5 * sizes[ i ] * sizes[ i ];
+    }
+    ComplexityFit const fit = complexity_fit( sizes, times, 6 );
+    FILE * const file = tmpfile();
+    complexity_fit_print( .fit = fit, .file = file, .indent = "  " );
+    char * const text = read_back( file );
+    Assertions * const as = assertions(
+        fit.best == COMPLEXITY_N_SQUARED,
+        fit.errors[ COMPLEXITY_N_SQUARED ] < 1e-9,
+        strncmp( text, "             n       time (ns)\n"
+                       "            64          2048.0\n", 60 ) == 0,
+        strstr( text, "  O(n^2)         0.0% error  <- best fit\n" ) != NULL,
+        // Only the best fit is marked:
+        strstr( strstr( text, "<- best fit" ) + 1, "<- best fit" ) == NULL
+    );
+    free( text );
+    return as;
+}
+
+
+Test const complexity_tests[] = TEST_ARRAY(
+    complexity_fit__finds_each_class,
+    complexity_fit_print__marks_the_best_fit
+);
+
@@ -0,0 +1,199 @@
+// tests/counters.c
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <dirent.h>
+#include <pthread.h>
+
+#include <test.h>
+#include <counters.h>
+
+#include "read-back.h" // read_back
+
+
+static
+void work( size_t const iterations )
+{
+    volatile size_t sum = 0;
+    for ( size_t i = 0; i < iterations; i += 1 ) {
+        sum += i;
+    }
+}
+
+
+static
+char * printed( Counters const counters, size_t const ops )
+// Returns what `counters_print()` prints for the given arguments.
+{
+    FILE * const file = tmpfile();
+    counters_print( .counters = counters, .ops = ops, .file = file );
+    char * const text = read_back( file );
+    return text;
+}
+
+
+static
+Assertions * counters_end__measures( void )
+{
+    counters_begin();
+    work( 1000000 );
+    Counters const c = counters_end();
+
+    Assertions * const as = assertions(
+        c.measured[ COUNTER_TASK_CLOCK ],
+        c.values[ COUNTER_TASK_CLOCK ] > 0,
+        c.measured[ COUNTER_CYCLES ] == counters_are_available()
+    );
+    if ( c.measured[ COUNTER_INSTRUCTIONS ] ) {
+        assertions_add( as, c.values[ COUNTER_INSTRUCTIONS ] >= 1000000, 0 );
+    }
+    for ( int k = 0; k < COUNTER_KINDS; k += 1 ) {
+        assertions_add( as, c.measured[ k ] || c.values[ k ] == 0, k );
+    }
+    return as;
+}
+
+
+static
+Assertions * counters_end__nests( void )
+{
+    counters_begin();
+    work( 1000 );
+    counters_begin();
+    work( 100000 );
+    Counters const inner = counters_end();
+    work( 1000 );
+    Counters const outer = counters_end();
+
+    Assertions * const as = assertions_empty();
+    for ( int k = 0; k < COUNTER_KINDS; k += 1 ) {
+        assertions_add( as, inner.measured[ k ] == outer.measured[ k ], k );
+    }
+    assertions_add( as,
+        outer.values[ COUNTER_INSTRUCTIONS ]
+            >= inner.values[ COUNTER_INSTRUCTIONS ], 0 );
+    return as;
+}
+
+
+static
+Assertions * counters_ipc__works( void )
+{
+    Counters const c = {
+        .values = { [ COUNTER_CYCLES ] = 200,
+                    [ COUNTER_INSTRUCTIONS ] = 300 },
+        .measured = { [ COUNTER_CYCLES ] = true,
+                      [ COUNTER_INSTRUCTIONS ] = true }
+    };
+    Counters const no_cycles = {
+        .values = { [ COUNTER_INSTRUCTIONS ] = 300 },
+        .measured = { [ COUNTER_INSTRUCTIONS ] = true }
+    };
+    return assertions(
+        counters_ipc( c ) == 1.5,
+        counters_ipc( no_cycles ) == 0,
+        counters_per_op( c, COUNTER_CYCLES, 4 ) == 50,
+        counters_per_op( c, COUNTER_CYCLES, 0 ) == 0,
+        counters_per_op( c, COUNTER_BRANCH_MISSES, 4 ) == 0
+    );
+}
+
+
+static
+Assertions * counters_print__works( void )
+{
+    Counters const c = {
+        .values = { [ COUNTER_CYCLES ] = 200,
+                    [ COUNTER_INSTRUCTIONS ] = 300,
+                    [ COUNTER_TASK_CLOCK ] = 2000000 },
+        .measured = { [ COUNTER_CYCLES ] = true,
+                      [ COUNTER_INSTRUCTIONS ] = true,
+                      [ COUNTER_TASK_CLOCK ] = true }
+    };
+    char * const totals = printed( c, 0 );
+    char * const per_op = printed( c, 4 );
+    char * const none = printed( ( Counters ){ .values = { 0 } }, 0 );
+
+    Assertions * const as = assertions(
+        strcmp( totals, "counters:  200 cycles, 300 instructions (1.50 IPC), "
+                        "2.000 ms task clock\n" ) == 0,
+        strcmp( per_op, "counters:  50.0 cycles/op, 75.0 instructions/op "
+                        "(1.50 IPC), 500000.0 ns task clock/op\n" ) == 0,
+        strcmp( none, "counters:  none measured\n" ) == 0
+    );
+    free( totals );
+    free( per_op );
+    free( none );
+    return as;
+}
+
+
+static
+size_t open_fds( void )
+// Returns how many file descriptors this process has open, or `0` if
+// that can't be found.
+{
+    DIR * const dir = opendir( "/proc/self/fd" );
+    if ( dir == NULL ) {
+        return 0;
+    }
+    size_t count = 0;
+    while ( readdir( dir ) != NULL ) {
+        count += 1;
+    }
+    closedir( dir );
+    return count;
+}
+
+
+static
+void * count_work( void * const arg )
+{
+    counters_begin();
+    work( 1000 );
+    counters_end();
+    return NULL;
+}
+
+
+static
+Assertions * counters_begin__closes_when_threads_exit( void )
+{
+    size_t const before = open_fds();
+    for ( size_t i = 0; i < 4; i += 1 ) {
+        pthread_t id;
+        if ( pthread_create( &id, NULL, count_work, NULL ) == 0 ) {
+            pthread_join( id, NULL );
+        }
+    }
+    size_t const after = open_fds();
+    return assertions( after == before );
+}
+
+
+Test const counters_tests[] = TEST_ARRAY(
+    counters_end__measures,
+    counters_end__nests,
+    counters_ipc__works,
+    counters_print__works,
+    counters_begin__closes_when_threads_exit
+);
+
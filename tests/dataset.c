@@ -0,0 +1,180 @@
+// tests/dataset.c
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <unistd.h>
+
+#include <test.h>
+#include <dataset.h>
+
+
+static
+char * write_temporary( uint8_t const * const data, size_t const size )
+// Returns the path of a new file with the given contents, which the
+// caller should remove.
+{
+    char * const path = strdup( "/tmp/testc-dataset-XXXXXX" );
+    int const fd = mkstemp( path );
+    if ( size > 0 && write( fd, data, size ) != ( ssize_t ) size ) {
+        path[ 0 ] = '\0';
+    }
+    close( fd );
+    return path;
+}
+
+
+static
+void check_sum( Assertions * const as, DatasetRecord const r,
+                void * const ctx )
+// Asserts that the last byte of the record is the sum of the others.
+{
+    uint8_t sum = 0;
+    for ( size_t i = 0; i + 1 < r.size; i += 1 ) {
+        sum += r.data[ i ];
+    }
+    assertions_add( as, r.size > 0 && r.data[ r.size - 1 ] == sum,
+                        r.offset );
+}
+
+
+static
+Assertions * dataset_for_each__checks_fixed_records( void )
+{
+    // Given a header, and records of four bytes where every tenth is
+    // wrong:
+    size_t const records = 1000;
+    size_t const size = 8 + records * 4;
+    uint8_t * const data = malloc( size );
+    memcpy( data, "VECTORS\n", 8 );
+    for ( size_t i = 0; i < records; i += 1 ) {
+        uint8_t * const r = data + 8 + i * 4;
+        r[ 0 ] = i;
+        r[ 1 ] = i >> 8;
+        r[ 2 ] = 7;
+        r[ 3 ] = r[ 0 ] + r[ 1 ] + r[ 2 ] + ( i % 10 == 3 );
+    }
+    char * const path = write_temporary( data, size );
+
+    // When:
+    Dataset * const d = dataset_open( .path = path, .stride = 4,
+                                      .header = 8 );
+    Dataset * const cut = dataset_open( .path = path, .stride = 3,
+                                        .header = 8 );
+    Assertions * const new = assertions_empty();
+    if ( d != NULL ) {
+        dataset_for_each( new, .dataset = d, .body = check_sum, .chunk = 7 );
+    }
+
+    // Then:
+    Assertions * const as = assertions(
+        d != NULL,
+        cut == NULL,
+        dataset_open( .path = "/nonexistent/testc" ) == NULL,
+        new->sites_size == 1
+    );
+    if ( d != NULL && new->sites_size == 1 ) {
+        AssertionSite const site = *( new->sites[ 0 ] );
+        DatasetRecord const r = dataset_get( d, 13 );
+        assertions_add( as, dataset_is_valid( d )
+                         && d->records == records
+                         && site.passes == 900
+                         && site.fails == 100
+                         && r.index == 13
+                         && r.offset == 8 + 13 * 4
+                         && r.data == d->data + r.offset
+                         && r.size == 4, 0 );
+        for ( size_t i = 0; i < site.fails; i += 1 ) {
+            assertions_add( as, assertion_site_get_id( site, i, 0 ).value
+                                    == ( long long ) ( 8 + ( i * 10 + 3 ) * 4 ),
+                                ( int ) i );
+        }
+    }
+    assertions_free( new );
+    dataset_close( d );
+    remove( path );
+    free( path );
+    free( data );
+    return as;
+}
+
+
+static
+Assertions * dataset_open__indexes_prefixed_records( void )
+{
+    // Given records of 0 to 4 bytes, prefixed by their lengths:
+    uint8_t data[ 64 ];
+    size_t size = 0;
+    for ( uint8_t n = 0; n < 5; n += 1 ) {
+        data[ size ] = n;
+        memset( data + size + 1, 0, 3 );
+        memset( data + size + 4, n, n );
+        size += 4 + n;
+    }
+    char * const path = write_temporary( data, size );
+    char * const cut_path = write_temporary( data, size - 1 );
+    char * const empty_path = write_temporary( data, 0 );
+
+    // When:
+    Dataset * const d = dataset_open( .path = path );
+    Dataset * const cut = dataset_open( .path = cut_path );
+    Dataset * const empty = dataset_open( .path = empty_path );
+
+    // Then:
+    Assertions * const as = assertions(
+        d != NULL,
+        cut == NULL,
+        empty != NULL
+    );
+    if ( d != NULL && empty != NULL ) {
+        assertions_add( as, dataset_is_valid( d )
+                         && dataset_is_valid( empty )
+                         && d->records == 5
+                         && empty->records == 0, 0 );
+        size_t offset = 0;
+        for ( size_t i = 0; i < d->records; i += 1 ) {
+            DatasetRecord const r = dataset_get( d, i );
+            assertions_add( as, r.index == i
+                             && r.size == i
+                             && r.offset == offset + 4
+                             && ( i == 0 || r.data[ i - 1 ] == i ),
+                                ( int ) i );
+            offset += 4 + i;
+        }
+    }
+    dataset_close( d );
+    dataset_close( empty );
+    remove( path );
+    remove( cut_path );
+    remove( empty_path );
+    free( path );
+    free( cut_path );
+    free( empty_path );
+    return as;
+}
+
+
+Test const dataset_tests[] = TEST_ARRAY(
+    dataset_for_each__checks_fixed_records,
+    dataset_open__indexes_prefixed_records
+);
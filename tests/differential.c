@@ -0,0 +1,298 @@
+// tests/differential.c
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <unistd.h>
+
+#include <test.h>
+#include <differential.h>
+
+#include "read-back.h" // read_back
+
+
+static
+void sum_bytes( void const * const input, size_t const size,
+                void * const output, void * const ctx )
+{
+    uint8_t const * const bytes = input;
+    uint64_t sum = 0;
+    for ( size_t i = 0; i < size; i += 1 ) {
+        sum += bytes[ i ];
+    }
+    memcpy( output, &sum, sizeof sum );
+}
+
+
+static
+void sum_bytes_unrolled( void const * const input, size_t const size,
+                         void * const output, void * const ctx )
+{
+    uint8_t const * const bytes = input;
+    uint64_t sums[ 4 ] = { 0 };
+    size_t i = 0;
+    for ( ; i + 4 <= size; i += 4 ) {
+        for ( size_t k = 0; k < 4; k += 1 ) {
+            sums[ k ] += bytes[ i + k ];
+        }
+    }
+    for ( ; i < size; i += 1 ) {
+        sums[ 0 ] += bytes[ i ];
+    }
+    uint64_t const sum = sums[ 0 ] + sums[ 1 ] + sums[ 2 ] + sums[ 3 ];
+    memcpy( output, &sum, sizeof sum );
+}
+
+
+static
+void sum_bytes_slowly( void const * const input, size_t const size,
+                       void * const output, void * const ctx )
+{
+    uint8_t const * const bytes = input;
+    volatile uint64_t sum = 0;
+    for ( int k = 0; k < 100; k += 1 ) {
+        for ( size_t i = 0; i < size; i += 1 ) {
+            sum += bytes[ i ];
+        }
+    }
+    uint64_t const result = sum / 100;
+    memcpy( output, &result, sizeof result );
+}
+
+
+static
+void index_input( size_t const index, void * const input,
+                  size_t const size, void * const ctx )
+{
+    uint32_t const x = index;
+    memcpy( input, &x, sizeof x );
+}
+
+
+static
+void identity( void const * const input, size_t const size,
+               void * const output, void * const ctx )
+{
+    memcpy( output, input, sizeof ( uint32_t ) );
+}
+
+
+static
+void wrong_every_thousand( void const * const input, size_t const size,
+                           void * const output, void * const ctx )
+{
+    uint32_t x;
+    memcpy( &x, input, sizeof x );
+    x += ( x % 1000 == 7 );
+    memcpy( output, &x, sizeof x );
+}
+
+
+static
+void square_root( void const * const input, size_t const size,
+                  void * const output, void * const ctx )
+{
+    uint32_t x;
+    memcpy( &x, input, sizeof x );
+    double const y = sqrt( x );
+    memcpy( output, &y, sizeof y );
+}
+
+
+static
+void square_root_roughly( void const * const input, size_t const size,
+                          void * const output, void * const ctx )
+{
+    uint32_t x;
+    memcpy( &x, input, sizeof x );
+    double const y = ( x == 0 ) ? 0 : exp( log( x ) / 2 );
+    memcpy( output, &y, sizeof y );
+}
+
+
+static
+bool are_close( void const * const expected, void const * const actual,
+                size_t const size, void * const ctx )
+{
+    double x;
+    double y;
+    memcpy( &x, expected, sizeof x );
+    memcpy( &y, actual, sizeof y );
+    return fabs( x - y ) <= 1e-3 * ( 1 + fabs( x ) );
+}
+
+
+static
+Assertions * assertions_add_differential__passes_equal_outputs( void )
+{
+    Assertions * const diff = assertions_empty();
+    DifferentialStats const stats = assertions_add_differential( diff,
+        sum_bytes, sum_bytes_unrolled, .inputs = 5000, .input_size = 37,
+        .output_size = sizeof ( uint64_t ), .seed = 1 );
+    Assertions * const as = assertions_empty();
+    assertions_add( as, stats.inputs == 5000, stats.inputs );
+    assertions_add( as, stats.mismatches == 0, stats.mismatches );
+    assertions_add( as, assertions_all_true( *diff ), 0 );
+    assertions_add( as, diff->sites_size == 1
+                     && diff->sites[ 0 ]->passes == 5000, diff->sites_size );
+    assertions_free( diff );
+    return as;
+}
+
+
+static
+Assertions * assertions_add_differential__identifies_mismatches( void )
+{
+    Assertions * const diff = assertions_empty();
+    DifferentialStats const stats = assertions_add_differential( diff,
+        identity, wrong_every_thousand, .inputs = 5000,
+        .input_size = sizeof ( uint32_t ), .output_size = sizeof ( uint32_t ),
+        .gen = index_input, .batch = 100 );
+    Assertions * const as = assertions_empty();
+    assertions_add( as, stats.mismatches == 5, stats.mismatches );
+    assertions_add( as, diff->sites_size == 1, diff->sites_size );
+    AssertionSite const * const site = diff->sites[ 0 ];
+    assertions_add( as, site->passes == 4995 && site->fails == 5,
+                        site->passes, site->fails );
+    for ( size_t i = 0; i < site->fails && i < 5; i += 1 ) {
+        assertions_add( as, site->ids_values[ 0 ][ i ]
+                            == ( long long ) ( i * 1000 + 7 ), i );
+    }
+    assertions_free( diff );
+    return as;
+}
+
+
+static
+Assertions * assertions_add_differential__uses_the_comparator( void )
+{
+    Assertions * const exact = assertions_empty();
+    Assertions * const close = assertions_empty();
+    DifferentialStats const exact_stats = assertions_add_differential( exact,
+        square_root, square_root_roughly, .inputs = 1000,
+        .input_size = sizeof ( uint32_t ), .output_size = sizeof ( double ),
+        .gen = index_input );
+    DifferentialStats const close_stats = assertions_add_differential( close,
+        square_root, square_root_roughly, .inputs = 1000,
+        .input_size = sizeof ( uint32_t ), .output_size = sizeof ( double ),
+        .gen = index_input, .eq = are_close );
+    Assertions * const as = assertions_empty();
+    assertions_add( as, exact_stats.mismatches > 0, exact_stats.mismatches );
+    assertions_add( as, close_stats.mismatches == 0, close_stats.mismatches );
+    assertions_add( as, assertions_all_true( *close ), 0 );
+    assertions_free( exact );
+    assertions_free( close );
+    return as;
+}
+
+
+static
+Assertions * assertions_add_differential__runs_the_records_of_datasets( void )
+{
+    uint8_t data[ 4 * 300 ];
+    for ( size_t i = 0; i < sizeof data; i += 1 ) {
+        data[ i ] = i * 7;
+    }
+    char * const path = strdup( "/tmp/testc-differential-XXXXXX" );
+    int const fd = mkstemp( path );
+    bool const written = write( fd, data, sizeof data )
+                      == ( ssize_t ) sizeof data;
+    close( fd );
+    Dataset * const d = dataset_open( .path = path, .stride = 4 );
+    Assertions * const as = assertions_empty();
+    assertions_add( as, written && d != NULL, 0 );
+    if ( d != NULL ) {
+        Assertions * const diff = assertions_empty();
+        DifferentialStats const stats = assertions_add_differential( diff,
+            sum_bytes, sum_bytes_unrolled, .dataset = d,
+            .output_size = sizeof ( uint64_t ) );
+        assertions_add( as, stats.inputs == 300, stats.inputs );
+        assertions_add( as, stats.mismatches == 0, stats.mismatches );
+        assertions_free( diff );
+        dataset_close( d );
+    }
+    remove( path );
+    free( path );
+    return as;
+}
+
+
+static
+Assertions * assertions_add_differential__asserts_the_speedup( void )
+{
+    Assertions * const faster = assertions_empty();
+    Assertions * const slower = assertions_empty();
+    DifferentialStats const stats = assertions_add_differential( faster,
+        sum_bytes_slowly, sum_bytes, .inputs = 2000, .input_size = 64,
+        .output_size = sizeof ( uint64_t ), .min_speedup = 2 );
+    assertions_add_differential( slower,
+        sum_bytes, sum_bytes_slowly, .inputs = 2000, .input_size = 64,
+        .output_size = sizeof ( uint64_t ), .min_speedup = 2 );
+    Assertions * const as = assertions_empty();
+    assertions_add( as, differential_speedup( stats ) > 2,
+                        stats.reference_ns, stats.candidate_ns );
+    assertions_add( as, faster->size == 1 && faster->array[ 0 ]->result,
+                        faster->size );
+    assertions_add( as, slower->size == 1 && !slower->array[ 0 ]->result,
+                        slower->size );
+    assertions_add( as, assertions_all_true( *faster ), 0 );
+    assertions_free( faster );
+    assertions_free( slower );
+    return as;
+}
+
+
+static
+Assertions * differential_stats_print__prints_the_seed( void )
+{
+    Assertions * const diff = assertions_empty();
+    DifferentialStats const random = assertions_add_differential( diff,
+        sum_bytes, sum_bytes_unrolled, .inputs = 10, .input_size = 8,
+        .output_size = sizeof ( uint64_t ), .seed = 42 );
+    DifferentialStats const generated = assertions_add_differential( diff,
+        identity, identity, .inputs = 10, .input_size = sizeof ( uint32_t ),
+        .output_size = sizeof ( uint32_t ), .gen = index_input );
+    FILE * const file = tmpfile();
+    differential_stats_print( .stats = random, .file = file );
+    char * const text = read_back( file );
+    Assertions * const as = assertions_empty();
+    assertions_add( as, random.seed == 42, random.seed );
+    assertions_add( as, generated.seed == 0, generated.seed );
+    assertions_add( as, strncmp( text, "differential:  10 inputs, "
+                                       "0 mismatches, ", 40 ) == 0, 0 );
+    assertions_add( as, strstr( text, "), seed 42\n" ) != NULL, 0 );
+    free( text );
+    assertions_free( diff );
+    return as;
+}
+
+
+Test const differential_tests[] = TEST_ARRAY(
+    assertions_add_differential__passes_equal_outputs,
+    assertions_add_differential__identifies_mismatches,
+    assertions_add_differential__uses_the_comparator,
+    assertions_add_differential__runs_the_records_of_datasets,
+    assertions_add_differential__asserts_the_speedup,
+    differential_stats_print__prints_the_seed
+);
@@ -0,0 +1,147 @@
+// tests/fixture.c
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <pthread.h>
+
+#include <test.h>
+#include <fixture.h>
+
+
+static int setups = 0;
+static int teardowns = 0;
+
+
+static
+void * make_table( void )
+{
+    setups += 1;
+    int * const table = malloc( 1000 * sizeof ( int ) );
+    for ( int i = 0; i < 1000; i += 1 ) {
+        table[ i ] = i * i;
+    }
+    return table;
+}
+
+
+static
+void free_table( void * const table )
+{
+    teardowns += 1;
+    free( table );
+}
+
+
+static Fixture table = FIXTURE( make_table, free_table );
+
+
+static
+Assertions * uses_table( void )
+{
+    int const * const t = fixture_get( &table );
+    return assertions( t[ 30 ] == 900 );
+}
+
+
+static
+Assertions * fixture_get__sets_up_once( void )
+{
+    int const before = setups;
+    bool const was_ready = fixture_is_ready( &table );
+    int const * const t1 = fixture_get( &table );
+    int const * const t2 = fixture_get( &table );
+    return assertions(
+        t1 == t2,
+        t1[ 12 ] == 144,
+        fixture_is_ready( &table ),
+        setups - before == ( was_ready ? 0 : 1 )
+    );
+}
+
+
+static
+Assertions * tests_run__tears_down_fixtures( void )
+{
+    // Given:
+    Test const ts[] = TEST_ARRAY( uses_table, uses_table, uses_table );
+    FILE * const output = fopen( "/dev/null", "w" );
+    int const setups_before = setups;
+    int const teardowns_before = teardowns;
+    size_t const mark = fixtures_mark();
+
+    // When:
+    int const fails = tests_run( .name = "table", .tests = ts,
+                                 .file = output );
+    fclose( output );
+
+    // Then the table should have been set up and torn down once, if it
+    // wasn't already set up by an outer `tests_run()`:
+    bool const outer = fixture_is_ready( &table );
+    return assertions(
+        fails == 0,
+        outer || setups - setups_before == 1,
+        outer || teardowns - teardowns_before == 1,
+        fixtures_mark() == mark
+    );
+}
+
+
+static
+void * get_table( void * const arg )
+{
+    return ( void * ) fixture_get( &table );
+}
+
+
+static
+Assertions * fixture_get__is_thread_safe( void )
+{
+    // Given:
+    size_t const mark = fixtures_mark();
+    bool const was_ready = fixture_is_ready( &table );
+    pthread_t threads[ 8 ];
+    void * results[ 8 ];
+
+    // When:
+    for ( size_t i = 0; i < 8; i += 1 ) {
+        pthread_create( &threads[ i ], NULL, get_table, NULL );
+    }
+    for ( size_t i = 0; i < 8; i += 1 ) {
+        pthread_join( threads[ i ], &results[ i ] );
+    }
+
+    // Then:
+    Assertions * const as = assertions_empty();
+    for ( int i = 0; i < 8; i += 1 ) {
+        assertions_add( as, results[ i ] == results[ 0 ], i );
+    }
+    // If we set it up, then we can tear it down:
+    fixtures_teardown_to( mark );
+    assertions_add( as, was_ready || !fixture_is_ready( &table ), 0 );
+    return as;
+}
+
+
+Test const fixture_tests[] = TEST_ARRAY(
+    fixture_get__sets_up_once,
+    tests_run__tears_down_fixtures,
+    fixture_get__is_thread_safe
+);
+
@@ -0,0 +1,184 @@
+// tests/fuzz.c
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <dirent.h>
+#include <unistd.h>
+
+#include <test.h>
+#include <fuzz.h>
+
+
+static
+void no_magic( Assertions * const as, uint8_t const * const data,
+               size_t const size, void * const ctx )
+{
+    assertions_add( as, size < 3 || memcmp( data, "FUZ", 3 ) != 0, size );
+}
+
+
+static
+void anything_goes( Assertions * const as, uint8_t const * const data,
+                    size_t const size, void * const ctx )
+{
+    size_t sum = 0;
+    for ( size_t i = 0; i < size; i += 1 ) {
+        sum += data[ i ];
+    }
+    assertions_add( as, sum <= 255 * size, size );
+}
+
+
+static
+char * make_corpus( char const * const seed )
+// Returns the path of a new directory containing a file with the given
+// contents.
+{
+    char * const dir = strdup( "/tmp/testc-fuzz-XXXXXX" );
+    if ( mkdtemp( dir ) != NULL ) {
+        char path[ 256 ];
+        snprintf( path, sizeof path, "%s/seed", dir );
+        FILE * const file = fopen( path, "wb" );
+        if ( file != NULL ) {
+            fputs( seed, file );
+            fclose( file );
+        }
+    }
+    return dir;
+}
+
+
+static
+void remove_corpus( char * const dir )
+{
+    DIR * const d = opendir( dir );
+    struct dirent const * entry;
+    while ( d != NULL && ( entry = readdir( d ) ) != NULL ) {
+        if ( entry->d_name[ 0 ] != '.' ) {
+            char path[ 512 ];
+            snprintf( path, sizeof path, "%s/%s", dir, entry->d_name );
+            remove( path );
+        }
+    }
+    if ( d != NULL ) {
+        closedir( d );
+    }
+    rmdir( dir );
+    free( dir );
+}
+
+
+static
+Assertions * fuzz_run__saves_a_reproducer_of_a_failure( void )
+{
+    char * const dir = make_corpus( "FUY" );
+    FuzzStats const stats = fuzz_run( .func = no_magic, .corpus = dir,
+                                      .runs = 200000, .seed = 7 );
+    Assertions * const as = assertions_empty();
+    assertions_add( as, stats.failures >= 1, stats.failures );
+    assertions_add( as, stats.runs < 200000, stats.runs );
+    assertions_add( as, strncmp( stats.reproducer, dir, strlen( dir ) ) == 0
+                     && strstr( stats.reproducer, "/fail-" ) != NULL, 0 );
+
+    // Replaying the reproducer fails in the same way.
+    Assertions * const replayed = assertions_empty();
+    assertions_add( as, fuzz_replay( replayed, no_magic, NULL,
+                                     stats.reproducer ), 0 );
+    assertions_add( as, !assertions_all_true( *replayed ), 0 );
+    assertions_free( replayed );
+    remove_corpus( dir );
+    return as;
+}
+
+
+static
+Assertions * fuzz_run__doesnt_load_failures_into_the_corpus( void )
+{
+    char * const dir = make_corpus( "ok" );
+    char path[ 256 ];
+    snprintf( path, sizeof path, "%s/fail-0123456789abcdef", dir );
+    FILE * const file = fopen( path, "wb" );
+    if ( file != NULL ) {
+        fputs( "FUZ", file );
+        fclose( file );
+    }
+    FuzzStats const stats = fuzz_run( .func = anything_goes, .corpus = dir,
+                                      .runs = 10, .threads = 1 );
+    Assertions * const as = assertions_empty();
+    assertions_add( as, file != NULL, 0 );
+    assertions_add( as, stats.corpus_size == 1 || fuzz_is_guided(),
+                        stats.corpus_size );
+    remove_corpus( dir );
+    return as;
+}
+
+
+static
+Assertions * fuzz_run__runs_every_input_of_a_robust_target( void )
+{
+    FuzzStats const stats = fuzz_run( .func = anything_goes, .runs = 2000,
+                                      .max_size = 64, .threads = 2 );
+    Assertions * const as = assertions_empty();
+    assertions_add( as, stats.runs == 2000, stats.runs );
+    assertions_add( as, stats.failures == 0, stats.failures );
+    assertions_add( as, stats.reproducer[ 0 ] == '\0', 0 );
+    assertions_add( as, stats.corpus_size >= 1, stats.corpus_size );
+    assertions_add( as, fuzz_is_guided() || stats.edges == 0, stats.edges );
+    return as;
+}
+
+
+static
+Assertions * fuzz_replay__fails_on_missing_files( void )
+{
+    Assertions * const as = assertions_empty();
+    Assertions * const replayed = assertions_empty();
+    assertions_add( as, !fuzz_replay( replayed, no_magic, NULL,
+                                      "/nonexistent/testc" ), 0 );
+    assertions_add( as, replayed->size == 0 && replayed->sites_size == 0, 0 );
+    assertions_free( replayed );
+    return as;
+}
+
+
+static
+Assertions * assertions_add_fuzz__adds_one_assertion( void )
+{
+    Assertions * const fuzzed = assertions_empty();
+    assertions_add_fuzz( fuzzed, anything_goes, .runs = 500, .seed = 1 );
+    Assertions * const as = assertions_empty();
+    assertions_add( as, fuzzed->size == 1, fuzzed->size );
+    assertions_add( as, assertions_all_true( *fuzzed ), 0 );
+    assertions_free( fuzzed );
+    return as;
+}
+
+
+Test const fuzz_tests[] = TEST_ARRAY(
+    fuzz_run__saves_a_reproducer_of_a_failure,
+    fuzz_run__doesnt_load_failures_into_the_corpus,
+    fuzz_run__runs_every_input_of_a_robust_target,
+    fuzz_replay__fails_on_missing_files,
+    assertions_add_fuzz__adds_one_assertion
+);
@@ -0,0 +1,224 @@
+// tests/golden.c
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <test.h>
+#include <golden.h>
+
+#include "read-back.h" // read_back
+
+
+static
+char * diffed( char const * const expected, char const * const actual,
+               size_t const hunks, size_t const max_edits,
+               size_t * const hunks_found )
+// Returns the diff of the given strings, and gives how many hunks it has
+// via `hunks_found`.
+{
+    FILE * const file = tmpfile();
+    *hunks_found = golden_diff( .expected = expected,
+                                .expected_size = strlen( expected ),
+                                .actual = actual,
+                                .actual_size = strlen( actual ),
+                                .file = file, .hunks = hunks,
+                                .max_edits = max_edits );
+    return read_back( file );
+}
+
+
+static
+Assertions * golden_diff__prints_unified_hunks( void )
+{
+    size_t hunks;
+    char * const text = diffed(
+        "a\nb\nc\nd\ne\nf\ng\nh\ni\nj\nk\nl\nm\nn\n",
+        "a\nb\nX\nd\ne\nf\ng\nh\ni\nj\nk\nl\nm\nn\nz\n",
+        0, 0, &hunks );
+    Assertions * const as = assertions_empty();
+    assertions_add( as, hunks == 2, hunks );
+    assertions_add( as, strcmp( text,
+        "@@ -1,6 +1,6 @@\n a\n b\n-c\n+X\n d\n e\n f\n"
+        "@@ -12,3 +12,4 @@\n l\n m\n n\n+z\n" ) == 0, 0 );
+    free( text );
+    return as;
+}
+
+
+static
+Assertions * golden_diff__prints_nothing_for_equal_data( void )
+{
+    size_t hunks;
+    char * const text = diffed( "a\nb\n", "a\nb\n", 0, 0, &hunks );
+    Assertions * const as = assertions( hunks == 0, text[ 0 ] == '\0' );
+    free( text );
+    return as;
+}
+
+
+static
+Assertions * golden_diff__limits_the_hunks( void )
+{
+    char expected[ 512 ] = "";
+    char actual[ 512 ] = "";
+    for ( int i = 0; i < 50; i += 1 ) {
+        char line[ 16 ];
+        snprintf( line, sizeof line, "%d\n", i );
+        strcat( expected, line );
+        strcat( actual, ( i % 10 == 5 ) ? "changed\n" : line );
+    }
+    size_t hunks;
+    char * const text = diffed( expected, actual, 2, 0, &hunks );
+    Assertions * const as = assertions_empty();
+    assertions_add( as, hunks == 5, hunks );
+    assertions_add( as, strstr( text, "@@ -13,7 +13,7 @@\n" ) != NULL, 0 );
+    assertions_add( as, strstr( text, "@@ -23," ) == NULL, 0 );
+    assertions_add( as, strstr( text, "... and 3 more hunks\n" ) != NULL, 0 );
+    free( text );
+    return as;
+}
+
+
+static
+Assertions * golden_diff__abandons_long_diffs( void )
+{
+    size_t hunks;
+    char * const text = diffed( "same\n1\n2\n3\n", "same\n4\n5\n6\n",
+                                0, 2, &hunks );
+    Assertions * const as = assertions_empty();
+    assertions_add( as, hunks == 1, hunks );
+    assertions_add( as, strcmp( text, "@@ -2 +2 @@\n-1\n+4\n"
+                                      "... and more than 2 other edits\n" )
+                        == 0, 0 );
+    free( text );
+    return as;
+}
+
+
+static
+Assertions * assertions_add_golden__stores_then_compares( void )
+{
+    char dir[] = "/tmp/testc-golden-XXXXXX";
+    Assertions * const as = assertions_empty();
+    if ( mkdtemp( dir ) == NULL ) {
+        assertions_add( as, false, 0 );
+        return as;
+    }
+    char path[ 64 ];
+    snprintf( path, sizeof path, "%s/report.txt", dir );
+    char const * const report = "total: 3\nitems: a, b, c\nok\n";
+    char const * const changed = "total: 4\nitems: a, b, c\nok\n";
+
+    Assertions * const stored = assertions_empty();
+    assertions_add_golden( stored, path, .data = report,
+                                         .size = strlen( report ) );
+    assertions_add( as, assertions_all_true( *stored ), 0 );
+    FILE * const file = fopen( path, "r" );
+    char contents[ 64 ] = "";
+    if ( file != NULL ) {
+        fread( contents, 1, sizeof contents - 1, file );
+        fclose( file );
+    }
+    assertions_add( as, strcmp( contents, report ) == 0, 0 );
+
+    Assertions * const same = assertions_empty();
+    assertions_add_golden( same, path, .data = report,
+                                       .size = strlen( report ) );
+    assertions_add( as, assertions_all_true( *same ), 0 );
+
+    Assertions * const different = assertions_empty();
+    assertions_add_golden( different, path, .data = changed,
+                                            .size = strlen( changed ) );
+    assertions_add( as, different->size == 1, different->size );
+    if ( different->size == 1 ) {
+        Assertion const * const a = different->array[ 0 ];
+        assertions_add( as, !a->result, 0 );
+        assertions_add( as, a->ids->array[ 2 ].value == 7,
+                            a->ids->array[ 2 ].value );
+        assertions_add( as, a->detail != NULL && strcmp( a->detail,
+            "@@ -1,3 +1,3 @@\n-total: 3\n+total: 4\n items: a, b, c\n ok\n" )
+                                                 == 0, 0 );
+    }
+
+    Assertions * const updated = assertions_empty();
+    assertions_add_golden( updated, path, .data = changed,
+                                          .size = strlen( changed ),
+                                          .update = true );
+    assertions_add_golden( updated, path, .data = changed,
+                                          .size = strlen( changed ) );
+    assertions_add( as, updated->size == 2 && assertions_all_true( *updated ),
+                        updated->size );
+
+    assertions_free( stored );
+    assertions_free( same );
+    assertions_free( different );
+    assertions_free( updated );
+    remove( path );
+    rmdir( dir );
+    return as;
+}
+
+
+static
+Assertions * assertions_add_golden__fails_if_it_cant_store( void )
+{
+    Assertions * const golden = assertions_empty();
+    assertions_add_golden( golden, "/nonexistent/testc/golden.txt",
+                           .data = "x", .size = 1 );
+    bool const failed = golden->size == 1 && !golden->array[ 0 ]->result;
+    assertions_free( golden );
+    return assertions( failed );
+}
+
+
+static
+Assertions * assertions_add_golden__fails_if_it_cant_read( void )
+{
+    // A directory exists, but can't be read as a golden file.
+    char * const dir = strdup( "/tmp/testc-golden-XXXXXX" );
+    bool const made = mkdtemp( dir ) != NULL;
+    Assertions * const golden = assertions_empty();
+    assertions_add_golden( golden, dir, .data = "x", .size = 1 );
+    bool const failed = golden->size == 1 && !golden->array[ 0 ]->result
+        && golden->array[ 0 ]->detail != NULL
+        && strstr( golden->array[ 0 ]->detail, "couldn't be read" ) != NULL;
+    struct stat st;
+    bool const kept = stat( dir, &st ) == 0 && S_ISDIR( st.st_mode );
+    assertions_free( golden );
+    rmdir( dir );
+    free( dir );
+    return assertions( made, failed, kept );
+}
+
+
+Test const golden_tests[] = TEST_ARRAY(
+    golden_diff__prints_unified_hunks,
+    golden_diff__prints_nothing_for_equal_data,
+    golden_diff__limits_the_hunks,
+    golden_diff__abandons_long_diffs,
+    assertions_add_golden__stores_then_compares,
+    assertions_add_golden__fails_if_it_cant_store,
+    assertions_add_golden__fails_if_it_cant_read
+);
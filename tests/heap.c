@@ -0,0 +1,190 @@
+// tests/heap.c
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <stdlib.h>
+
+#include <test.h>
+#include <heap.h>
+
+
+// The pointers are `volatile` so that the compiler can't elide the
+// allocations.
+
+static
+void allocate_and_free( size_t const size )
+{
+    void * volatile const ptr = malloc( size );
+    free( ptr );
+}
+
+
+static
+Assertions * heap_end__counts_allocations( void )
+{
+    heap_begin();
+    void * volatile const leaked = malloc( 100 );
+    void * volatile ptr = malloc( 10 );
+    ptr = realloc( ptr, 30 );
+    free( ptr );
+    HeapStats const stats = heap_end();
+    free( leaked );
+
+    if ( !heap_is_tracked() ) {
+        return assertions( stats.allocations == 0, stats.bytes == 0 );
+    }
+    return assertions(
+        stats.allocations == 3,
+        stats.frees == 2,
+        stats.bytes == 140,
+        stats.peak_bytes == 130,
+        stats.leaked_blocks == 1,
+        stats.leaked_bytes == 100
+    );
+}
+
+
+static
+Assertions * heap_end__nests( void )
+{
+    heap_begin();
+    void * volatile const outer = malloc( 8 );
+    heap_begin();
+    allocate_and_free( 16 );
+    void * volatile const inner = malloc( 32 );
+    HeapStats const inner_stats = heap_end();
+    free( inner );
+    free( outer );
+    HeapStats const outer_stats = heap_end();
+
+    if ( !heap_is_tracked() ) {
+        return assertions( inner_stats.allocations == 0,
+                           outer_stats.allocations == 0 );
+    }
+    return assertions(
+        inner_stats.allocations == 2,
+        inner_stats.leaked_blocks == 1,
+        outer_stats.allocations == 3,
+        outer_stats.frees == 3,
+        outer_stats.leaked_blocks == 0
+    );
+}
+
+
+static
+Assertions * heap_end__excludes_testc( void )
+{
+    heap_begin();
+    Assertions * const as = assertions( 1 == 1 );
+    for ( int i = 0; i < 100; i += 1 ) {
+        assertions_add( as, i >= 0, i );
+    }
+    Assertions * const copy = assertions_copy( *as );
+    assertions_free( copy );
+    HeapStats const stats = heap_end();
+    assertions_add( as, stats.allocations == 0, 0 );
+    return as;
+}
+
+
+static
+Assertions * heap_peek__counts_the_innermost_scope_so_far( void )
+{
+    HeapStats const outside = heap_peek();
+    heap_begin();
+    void * volatile const kept = malloc( 24 );
+    allocate_and_free( 8 );
+    HeapStats const during = heap_peek();
+    free( kept );
+    HeapStats const end = heap_end();
+
+    Assertions * const as = assertions( outside.allocations == 0,
+                                        outside.leaked_bytes == 0 );
+    if ( !heap_is_tracked() ) {
+        assertions_add( as, during.allocations == 0, during.allocations );
+        return as;
+    }
+    assertions_add( as, during.allocations == 2 && during.bytes == 32,
+                        during.allocations, during.bytes );
+    assertions_add( as, during.leaked_blocks == 1
+                     && during.leaked_bytes == 24,
+                        during.leaked_blocks, during.leaked_bytes );
+    // Peeking doesn't end the scope.
+    assertions_add( as, end.allocations == 2 && end.leaked_blocks == 0,
+                        end.allocations, end.leaked_blocks );
+    return as;
+}
+
+
+static
+Assertions * assertions_add_heap__works( void )
+{
+    Assertions * const new = assertions_empty();
+    assertions_add_no_allocations( new, ( void ) 0 );
+    assertions_add_no_leaks( new, allocate_and_free( 64 ) );
+    assertions_add_bytes_at_most( new, 64, allocate_and_free( 64 ) );
+    assertions_add_bytes_at_most( new, 63, allocate_and_free( 64 ) );
+    assertions_add_no_allocations( new, allocate_and_free( 1 ) );
+    Assertions * const as = assertions(
+        new->sites_size == 5,
+        heap_is_tracked() ? !assertions_all_true( *new )
+                          : assertions_all_true( *new )
+    );
+    for ( size_t i = 0; i < new->sites_size; i += 1 ) {
+        AssertionSite const site = *( new->sites[ i ] );
+        bool const should_fail = heap_is_tracked() && i >= 3;
+        assertions_add( as, site.fails == should_fail, i );
+    }
+    assertions_free( new );
+    return as;
+}
+
+
+static
+Assertions * heap_pause__still_counts_frees( void )
+{
+    heap_begin();
+    void * volatile const ptr = malloc( 24 );
+    void * volatile grown = malloc( 8 );
+    heap_pause();
+    free( ptr );
+    grown = realloc( grown, 64 );
+    heap_resume();
+    HeapStats const stats = heap_end();
+    free( grown );
+
+    if ( !heap_is_tracked() ) {
+        return assertions( stats.allocations == 0, stats.frees == 0 );
+    }
+    return assertions(
+        stats.allocations == 2,
+        stats.frees == 2,
+        stats.leaked_blocks == 0,
+        stats.leaked_bytes == 0
+    );
+}
+
+
+Test const heap_tests[] = TEST_ARRAY(
+    heap_end__counts_allocations,
+    heap_end__nests,
+    heap_end__excludes_testc,
+    heap_peek__counts_the_innermost_scope_so_far,
+    heap_pause__still_counts_frees,
+    assertions_add_heap__works
+);
+
@@ -0,0 +1,166 @@
+// tests/histogram.c
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <pthread.h>
+
+#include <test.h>
+#include <histogram.h>
+
+#include "read-back.h" // read_back
+
+
+static
+Assertions * histogram_percentile__small_values_are_exact( void )
+{
+    Histogram * const h = histogram_new();
+    Histogram * const empty = histogram_new();
+    for ( uint64_t v = 0; v < 100; v += 1 ) {
+        histogram_record( h, v );
+    }
+    Assertions * const as = assertions(
+        histogram_is_valid( h ),
+        h->total == 100,
+        h->min == 0,
+        h->max == 99,
+        histogram_mean( h ) == 49.5,
+        histogram_percentile( h, 0 ) == 0,
+        histogram_percentile( h, 50 ) == 49,
+        histogram_percentile( h, 99 ) == 98,
+        histogram_percentile( h, 100 ) == 99,
+        histogram_percentile( empty, 99 ) == 0
+    );
+    histogram_free( h );
+    histogram_free( empty );
+    return as;
+}
+
+
+static
+Assertions * histogram_percentile__large_values_are_close( void )
+{
+    Histogram * const h = histogram_new();
+    histogram_record_n( h, 1000000, 99 );
+    histogram_record( h, 2000000 );
+    histogram_record( h, UINT64_MAX );
+    uint64_t const p50 = histogram_percentile( h, 50 );
+    uint64_t const p99 = histogram_percentile( h, 99 );
+    Assertions * const as = assertions(
+        histogram_is_valid( h ),
+        h->total == 101,
+        p50 >= 1000000,
+        p50 <= 1016000,
+        p99 >= 2000000,
+        p99 <= 2032000,
+        histogram_percentile( h, 100 ) == UINT64_MAX
+    );
+    histogram_free( h );
+    return as;
+}
+
+
+static
+void * record_thread( void * const arg )
+{
+    Histogram * const h = arg;
+    for ( uint64_t v = 1; v <= 1000; v += 1 ) {
+        histogram_record( h, v * 10 );
+    }
+    return NULL;
+}
+
+
+static
+Assertions * histogram_merge__combines_threads( void )
+{
+    Histogram * hs[ 4 ];
+    pthread_t threads[ 4 ];
+    for ( size_t i = 0; i < 4; i += 1 ) {
+        hs[ i ] = histogram_new();
+        pthread_create( &threads[ i ], NULL, record_thread, hs[ i ] );
+    }
+    Histogram * const merged = histogram_new();
+    for ( size_t i = 0; i < 4; i += 1 ) {
+        pthread_join( threads[ i ], NULL );
+        histogram_merge( merged, hs[ i ] );
+    }
+    Assertions * const as = assertions(
+        histogram_is_valid( merged ),
+        merged->total == 4000,
+        merged->min == 10,
+        merged->max == 10000,
+        histogram_mean( merged ) == histogram_mean( hs[ 0 ] ),
+        histogram_percentile( merged, 50 )
+            == histogram_percentile( hs[ 0 ], 50 )
+    );
+    for ( size_t i = 0; i < 4; i += 1 ) {
+        histogram_free( hs[ i ] );
+    }
+    histogram_free( merged );
+    return as;
+}
+
+
+static
+Assertions * assertions_add_percentile__has_summary( void )
+{
+    Histogram * const h = histogram_new();
+    for ( uint64_t v = 1; v <= 1000; v += 1 ) {
+        histogram_record( h, v * 1000 );
+    }
+    Assertions * const new = assertions_empty();
+    assertions_add_percentile( new, h, 50, 600000 );
+    assertions_add_percentile( new, h, 99.9, 200000 );
+    histogram_free( h );
+
+    FILE * const file = tmpfile();
+    assertions_print( false, .assertions = *new,
+                             .file = file,
+                             .ids_indent = "  " );
+    char * const text = read_back( file );
+
+    Assertion const * const fail = assertions_get( *new, 1 );
+    Assertions * const as = assertions(
+        assertions_get( *new, 0 )->result == true,
+        fail->result == false,
+        strcmp( fail->expr, "p99.9 of h <= 200000" ) == 0,
+        fail->detail != NULL,
+        strcmp( text,
+            "false:  p99.9 of h <= 200000\n"
+            "  (for value = 1000000, count = 1000)\n"
+            "  histogram:  1000 values, min 1 us, mean 500 us, max 1 ms\n"
+            "  p50 504 us, p90 901 us, p99 991 us, p99.9 1 ms, "
+                "p99.99 1 ms\n" ) == 0
+    );
+    free( text );
+    assertions_free( new );
+    return as;
+}
+
+
+Test const histogram_tests[] = TEST_ARRAY(
+    histogram_percentile__small_values_are_exact,
+    histogram_percentile__large_values_are_close,
+    histogram_merge__combines_threads,
+    assertions_add_percentile__has_summary
+);
+
@@ -0,0 +1,294 @@
+// tests/interleave.c
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#include <pthread.h>
+
+#include <test.h>
+#include <interleave.h>
+
+
+static atomic_int counter;
+static atomic_bool locked;
+static atomic_bool ready;
+
+
+static
+void reset( void * const ctx )
+{
+    atomic_store( &counter, 0 );
+    atomic_store( &locked, false );
+    atomic_store( &ready, false );
+}
+
+
+static
+void check_counter( Assertions * const as, void * const ctx )
+{
+    int const expected = *( int * ) ctx;
+    assertions_add( as, atomic_load( &counter ) == expected,
+                        atomic_load( &counter ) );
+}
+
+
+static
+void racy_increment( Assertions * const as, size_t const thread,
+                     void * const ctx )
+{
+    int const value = interleave_load( &counter );
+    interleave_store( &counter, value + 1 );
+}
+
+
+static
+void atomic_increment( Assertions * const as, size_t const thread,
+                       void * const ctx )
+{
+    interleave_fetch_add( &counter, 1 );
+    interleave_fetch_add( &counter, 1 );
+}
+
+
+static
+void locked_increment( Assertions * const as, size_t const thread,
+                       void * const ctx )
+{
+    while ( interleave_exchange( &locked, true ) ) {
+        interleave_spin();
+    }
+    int const value = interleave_load( &counter );
+    interleave_store( &counter, value + 1 );
+    interleave_store( &locked, false );
+}
+
+
+static
+void wait_for_ready( Assertions * const as, size_t const thread,
+                     void * const ctx )
+{
+    // Nothing makes it ready.
+    while ( !interleave_load( &ready ) ) {
+        interleave_spin();
+    }
+}
+
+
+static
+void count_cleanup( void * const arg )
+{
+    atomic_fetch_add( ( atomic_int * ) arg, 1 );
+}
+
+
+static
+void wait_with_cleanup( Assertions * const as, size_t const thread,
+                        void * const ctx )
+{
+    pthread_cleanup_push( count_cleanup, ctx );
+    wait_for_ready( as, thread, NULL );
+    pthread_cleanup_pop( false );
+}
+
+
+static
+char * schedule_of( Assertion const * const a )
+// Returns the schedule at the start of the given assertion's detail.
+{
+    char const * const begin = strchr( a->detail, '"' ) + 1;
+    size_t const size = strchr( begin, '"' ) - begin;
+    char * const schedule = malloc( size + 1 );
+    memcpy( schedule, begin, size );
+    schedule[ size ] = '\0';
+    return schedule;
+}
+
+
+static
+Assertions * interleave__finds_a_lost_update( void )
+{
+    int expected = 2;
+    Assertions * const racy = assertions_empty();
+    InterleaveStats const stats = assertions_add_interleavings( racy,
+        racy_increment, .threads = 2, .ctx = &expected, .init = reset,
+                        .check = check_counter, .seed = 1 );
+    Assertions * const as = assertions_empty();
+    assertions_add( as, stats.failures == 1 && racy->size == 1,
+                        stats.failures, racy->size );
+    if ( racy->size != 1 ) {
+        assertions_free( racy );
+        return as;
+    }
+    Assertion const * const a = racy->array[ 0 ];
+    assertions_add( as, a->result == false && a->ids->size == 3, 0 );
+    assertions_add( as, strncmp( a->detail, "schedule \"", 10 ) == 0, 0 );
+    assertions_add( as, strstr( a->detail, "counter" ) != NULL, 0 );
+    // The same schedule fails again when it's replayed.
+    char * const schedule = schedule_of( a );
+    long long const steps = a->ids->array[ 2 ].value;
+    assertions_add( as, ( long long ) strlen( schedule ) == steps, steps );
+    Assertions * const replayed = assertions_empty();
+    InterleaveStats const replay = assertions_add_interleavings( replayed,
+        racy_increment, .threads = 2, .ctx = &expected, .init = reset,
+                        .check = check_counter, .schedule = schedule );
+    assertions_add( as, replay.schedules == 1 && replay.failures == 1,
+                        replay.schedules, replay.failures );
+    assertions_add( as, replayed->size == 1
+                     && strcmp( replayed->array[ 0 ]->detail, a->detail ) == 0,
+                        replayed->size );
+    free( schedule );
+    assertions_free( replayed );
+    assertions_free( racy );
+    return as;
+}
+
+
+static
+Assertions * interleave__runs_every_schedule_of_correct_code( void )
+{
+    int expected = 6;
+    Assertions * const correct = assertions_empty();
+    InterleaveStats const stats = assertions_add_interleavings( correct,
+        atomic_increment, .threads = 3, .ctx = &expected, .init = reset,
+                          .check = check_counter );
+    Assertions * const as = assertions( stats.exhausted,
+                                        stats.failures == 0,
+                                        stats.schedules > 100,
+                                        stats.max_steps == 9,
+                                        assertions_all_true( *correct ) );
+    assertions_add( as, assertions_count( *correct ) == stats.schedules,
+                        assertions_count( *correct ), stats.schedules );
+    assertions_free( correct );
+    return as;
+}
+
+
+static
+Assertions * interleave__bounds_the_preemptions( void )
+{
+    int expected = 6;
+    Assertions * const none = assertions_empty();
+    InterleaveStats const s0 = assertions_add_interleavings( none,
+        atomic_increment, .threads = 3, .ctx = &expected, .init = reset,
+                          .check = check_counter,
+                          .preemptions = INTERLEAVE_NO_PREEMPTIONS );
+    Assertions * const one = assertions_empty();
+    InterleaveStats const s1 = assertions_add_interleavings( one,
+        atomic_increment, .threads = 3, .ctx = &expected, .init = reset,
+                          .check = check_counter, .preemptions = 1 );
+    Assertions * const two = assertions_empty();
+    InterleaveStats const s2 = assertions_add_interleavings( two,
+        atomic_increment, .threads = 3, .ctx = &expected, .init = reset,
+                          .check = check_counter, .preemptions = 2 );
+    bool const passed = assertions_all_true( *none );
+    assertions_free( none );
+    assertions_free( one );
+    assertions_free( two );
+    return assertions( s0.exhausted, s1.exhausted, s2.exhausted, passed,
+                       s0.schedules < s1.schedules,
+                       s1.schedules < s2.schedules );
+}
+
+
+static
+Assertions * interleave__lets_spinning_threads_wait( void )
+{
+    int expected = 3;
+    Assertions * const locking = assertions_empty();
+    InterleaveStats const stats = assertions_add_interleavings( locking,
+        locked_increment, .threads = 3, .ctx = &expected, .init = reset,
+                          .check = check_counter );
+    Assertions * const as = assertions( stats.failures == 0,
+                                        assertions_all_true( *locking ) );
+    assertions_free( locking );
+
+    Assertions * const waiting = assertions_empty();
+    InterleaveStats const s = assertions_add_interleavings( waiting,
+        wait_for_ready, .threads = 2, .max_schedules = 5 );
+    assertions_add( as, s.failures == 1 && waiting->size == 1,
+                        s.failures, waiting->size );
+    if ( waiting->size == 1 ) {
+        assertions_add( as, strstr( waiting->array[ 0 ]->detail,
+                                    "every thread is waiting" ) != NULL, 0 );
+    }
+    assertions_free( waiting );
+    return as;
+}
+
+
+static
+Assertions * interleave__cleans_up_aborted_threads( void )
+{
+    atomic_int cleanups;
+    atomic_init( &cleanups, 0 );
+    Assertions * const waiting = assertions_empty();
+    InterleaveStats const stats = assertions_add_interleavings( waiting,
+        wait_with_cleanup, .threads = 2, .ctx = &cleanups, .init = reset );
+    Assertions * const as = assertions(
+        stats.failures == stats.schedules,
+        atomic_load( &cleanups ) == 2 * ( int ) stats.schedules
+    );
+    assertions_free( waiting );
+    return as;
+}
+
+
+static
+Assertions * interleave__samples_random_schedules( void )
+{
+    int expected = 6;
+    Assertions * const sampled = assertions_empty();
+    InterleaveStats const stats = assertions_add_interleavings( sampled,
+        atomic_increment, .threads = 3, .ctx = &expected, .init = reset,
+                          .check = check_counter, .max_schedules = 10,
+                          .random_schedules = 50 );
+    Assertions * const as = assertions( !stats.exhausted,
+                                        stats.schedules == 60,
+                                        stats.failures == 0 );
+    assertions_free( sampled );
+    return as;
+}
+
+
+static
+Assertions * interleave__does_nothing_outside_of_a_run( void )
+{
+    atomic_int x;
+    atomic_init( &x, 1 );
+    interleave_yield();
+    interleave_spin();
+    int expected = 1;
+    bool const exchanged = interleave_compare_exchange( &x, &expected, 5 );
+    return assertions( exchanged, interleave_fetch_sub( &x, 2 ) == 5,
+                       interleave_load( &x ) == 3 );
+}
+
+
+Test const interleave_tests[] = TEST_ARRAY(
+    interleave__finds_a_lost_update,
+    interleave__runs_every_schedule_of_correct_code,
+    interleave__bounds_the_preemptions,
+    interleave__lets_spinning_threads_wait,
+    interleave__cleans_up_aborted_threads,
+    interleave__samples_random_schedules,
+    interleave__does_nothing_outside_of_a_run
+);
@@ -0,0 +1,144 @@
+// tests/load.c
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <pthread.h>
+
+#include <test.h>
+#include <load.h>
+#include <string-diff.h>
+
+#include "read-back.h" // read_back
+
+
+static
+void nap( size_t const worker, void * const ctx )
+// Sleeps for 100 microseconds, which scales to any number of workers.
+{
+    struct timespec const t = { .tv_nsec = 100000 };
+    nanosleep( &t, NULL );
+}
+
+
+static
+void nap_alone( size_t const worker, void * const ctx )
+// Sleeps for 100 microseconds while holding the given lock, which
+// doesn't scale at all.
+{
+    pthread_mutex_t * const lock = ctx;
+    pthread_mutex_lock( lock );
+    nap( worker, NULL );
+    pthread_mutex_unlock( lock );
+}
+
+
+static
+Assertions * load_measure__doubles_the_workers_up_to_the_max( void )
+{
+    LoadCurve const curve = load_measure( .func = nap,
+                                          .max_workers = 6,
+                                          .duration_ns = 20000000 );
+    Assertions * const as = assertions( curve.size == 4 );
+    size_t const workers[] = { 1, 2, 4, 6 };
+    for ( size_t i = 0; i < curve.size && i < 4; i += 1 ) {
+        LoadLevel const l = curve.levels[ i ];
+        assertions_add( as, l.workers == workers[ i ], i, l.workers );
+        assertions_add( as, l.ops > 0 && l.ns >= 20000000, i );
+        assertions_add( as, l.ops_per_s > 0 && l.ops_per_s < 1e4 * l.workers,
+                            i );
+        assertions_add( as, 100000 <= l.p50_ns && l.p50_ns <= l.p90_ns
+                         && l.p90_ns <= l.p99_ns && l.p99_ns <= l.p999_ns
+                         && l.p999_ns <= l.max_ns, i );
+    }
+    assertions_add( as, curve.levels[ 0 ].efficiency == 1, 0 );
+    return as;
+}
+
+
+static
+Assertions * assertions_add_scaling__checks_the_last_level( void )
+{
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    Assertions * const scaling = assertions_empty();
+    assertions_add_scaling( scaling, nap, 0.5, .max_workers = 4,
+                                               .duration_ns = 20000000 );
+    assertions_add_scaling( scaling, nap_alone, 0.8, .ctx = &lock,
+                                                     .max_workers = 4,
+                                                     .duration_ns = 20000000 );
+    Assertions * const as = assertions( scaling->size == 2 );
+    if ( scaling->size == 2 ) {
+        Assertion const * const a = scaling->array[ 0 ];
+        Assertion const * const b = scaling->array[ 1 ];
+        assertions_add( as, a->result == true && b->result == false, 0 );
+        assertions_add( as, a->ids->array[ 0 ].value == 4
+                         && b->ids->array[ 0 ].value == 4, 0 );
+        assertions_add( as, b->ids->array[ 1 ].value < 80,
+                            b->ids->array[ 1 ].value );
+        assertions_add( as, strncmp( b->detail, "workers", 7 ) == 0, 0 );
+        assertions_add( as, strcmp( b->expr, "scaling efficiency of "
+                                             "nap_alone >= 0.8" ) == 0, 0 );
+    }
+    assertions_free( scaling );
+    return as;
+}
+
+
+static
+Assertions * load_curve_print__prints_a_row_per_level( void )
+{
+    LoadCurve curve = { .size = 2 };
+    curve.levels[ 0 ] = ( LoadLevel ){ .workers = 1,
+                                       .ops_per_s = 4120000,
+                                       .efficiency = 1,
+                                       .p50_ns = 230,
+                                       .p99_ns = 410,
+                                       .p999_ns = 1200,
+                                       .max_ns = 38100 };
+    curve.levels[ 1 ] = ( LoadLevel ){ .workers = 2,
+                                       .ops_per_s = 7930000,
+                                       .efficiency = 0.962,
+                                       .p50_ns = 240,
+                                       .p99_ns = 450,
+                                       .p999_ns = 1940,
+                                       .max_ns = 41700 };
+    FILE * const file = tmpfile();
+    load_curve_print( .curve = curve, .file = file, .indent = "  " );
+    char * const text = read_back( file );
+    Assertions * const as = assertions_empty();
+    assertions_add_string_eq( as, text,
+        "  workers    ops/s  efficiency       p50       p99     p99.9"
+        "       max\n"
+        "        1    4.12M      100.0%    230 ns    410 ns    1.2 us"
+        "   38.1 us\n"
+        "        2    7.93M       96.2%    240 ns    450 ns   1.94 us"
+        "   41.7 us\n" );
+    free( text );
+    return as;
+}
+
+
+Test const load_tests[] = TEST_ARRAY(
+    load_measure__doubles_the_workers_up_to_the_max,
+    assertions_add_scaling__checks_the_last_level,
+    load_curve_print__prints_a_row_per_level
+);
@@ -22,8 +22,29 @@
 extern Test const assertion_id_tests[];
 extern Test const assertion_ids_tests[];
 extern Test const assertion_tests[];
+extern Test const assertion_site_tests[];
 extern Test const assertions_tests[];
 extern Test const test_tests[];
+extern Test const heap_tests[];
+extern Test const counters_tests[];
+extern Test const bench_tests[];
+extern Test const baseline_tests[];
+extern Test const histogram_tests[];
+extern Test const complexity_tests[];
+extern Test const fixture_tests[];
+extern Test const parallel_tests[];
+extern Test const subtest_tests[];
+extern Test const test_cases_tests[];
+extern Test const dataset_tests[];
+extern Test const property_tests[];
+extern Test const fuzz_tests[];
+extern Test const differential_tests[];
+extern Test const golden_tests[];
+extern Test const string_diff_tests[];
+extern Test const stress_tests[];
+extern Test const interleave_tests[];
+extern Test const load_tests[];
+extern Test const soak_tests[];
 
 
 int main( void )
@@ -32,8 +53,29 @@ int main( void )
         tests_run( "AssertionId", assertion_id_tests ),
         tests_run( "AssertionIds", assertion_ids_tests ),
         tests_run( "Assertion", assertion_tests ),
+        tests_run( "AssertionSite", assertion_site_tests ),
         tests_run( "Assertions", assertions_tests ),
-        tests_run( "Test", test_tests )
+        tests_run( "Test", test_tests ),
+        tests_run( "Heap", heap_tests ),
+        tests_run( "Counters", counters_tests, .counters = true ),
+        tests_run( "Bench", bench_tests ),
+        tests_run( "Baseline", baseline_tests ),
+        tests_run( "Histogram", histogram_tests ),
+        tests_run( "Complexity", complexity_tests ),
+        tests_run( "Fixture", fixture_tests ),
+        tests_run( "Parallel", parallel_tests ),
+        tests_run( "Subtest", subtest_tests ),
+        tests_run( "TestCases", test_cases_tests ),
+        tests_run( "Dataset", dataset_tests ),
+        tests_run( "Property", property_tests ),
+        tests_run( "Fuzz", fuzz_tests ),
+        tests_run( "Differential", differential_tests ),
+        tests_run( "Golden", golden_tests ),
+        tests_run( "StringDiff", string_diff_tests ),
+        tests_run( "Stress", stress_tests ),
+        tests_run( "Interleave", interleave_tests ),
+        tests_run( "Load", load_tests ),
+        tests_run( "Soak", soak_tests )
     );
 }
 
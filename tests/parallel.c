@@ -0,0 +1,179 @@
+// tests/parallel.c
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <stdlib.h>
+
+#include <dirent.h>
+
+#include <test.h>
+#include <parallel.h>
+
+
+static
+void check_increasing( Assertions * const as,
+                       size_t const begin, size_t const end,
+                       void * const ctx )
+// Asserts that the given `int` array is increasing at each index.
+{
+    int const * const xs = ctx;
+    for ( size_t i = begin; i < end; i += 1 ) {
+        assertions_add( as, xs[ i ] < xs[ i + 1 ], ( int ) i, xs[ i ] );
+    }
+}
+
+
+static
+int * new_mostly_increasing( size_t const size )
+// Returns an array of `size` values that are increasing, except at
+// every index that's a multiple of 97.
+{
+    int * const xs = malloc( size * sizeof ( int ) );
+    for ( size_t i = 0; i < size; i += 1 ) {
+        xs[ i ] = ( i % 97 == 1 ) ? 0 : ( int ) i;
+    }
+    return xs;
+}
+
+
+static
+Assertions * parallel_for__is_same_as_serial( void )
+{
+    // Given:
+    size_t const size = 100000;
+    int * const xs = new_mostly_increasing( size );
+    Assertions * const serial = assertions_empty();
+    assertions_add( serial, true, 0 );
+    Assertions * const chunked = assertions_copy( *serial );
+    Assertions * const dynamic = assertions_copy( *serial );
+
+    // When:
+    check_increasing( serial, 0, size - 1, xs );
+    parallel_for( chunked, .end = size - 1, .body = check_increasing,
+                           .ctx = xs, .threads = 8, .chunk = 1 );
+    parallel_for( dynamic, .end = size - 1, .body = check_increasing,
+                           .ctx = xs );
+
+    // Then:
+    Assertions * const as = assertions(
+        serial->sites_size == 2,
+        serial->sites[ 1 ]->fails == ( size - 2 ) / 97 + 1,
+        chunked->workers_size == 0,
+        assertions_eq( *chunked, *serial ),
+        assertions_eq( *dynamic, *serial )
+    );
+    assertions_free( serial );
+    assertions_free( chunked );
+    assertions_free( dynamic );
+    free( xs );
+    return as;
+}
+
+
+static
+void count_calls( Assertions * const as,
+                  size_t const begin, size_t const end,
+                  void * const ctx )
+// Asserts that the range is within 10 to 20, and counts the call.
+{
+    ( void ) ctx;
+    assertions_add( as, begin >= 10 && end <= 20 && begin < end,
+                        ( int ) begin, ( int ) end );
+}
+
+
+static
+Assertions * parallel_for__covers_the_range( void )
+{
+    Assertions * const empty = assertions_empty();
+    Assertions * const uneven = assertions_empty();
+    parallel_for( empty, .begin = 10, .end = 10, .body = count_calls );
+    parallel_for( uneven, .begin = 10, .end = 20, .body = count_calls,
+                          .threads = 3, .chunk = 4 );
+    Assertions * const as = assertions(
+        assertions_count( *empty ) == 0,
+        assertions_count( *uneven ) == 3,
+        uneven->sites[ 0 ]->passes == 3
+    );
+    assertions_free( empty );
+    assertions_free( uneven );
+    return as;
+}
+
+
+static
+size_t threads( void )
+// Returns how many threads this process has, or `0` if that can't be
+// found.
+{
+    DIR * const dir = opendir( "/proc/self/task" );
+    if ( dir == NULL ) {
+        return 0;
+    }
+    size_t count = 0;
+    while ( readdir( dir ) != NULL ) {
+        count += 1;
+    }
+    closedir( dir );
+    return count;
+}
+
+
+static
+void count_threads( Assertions * const as,
+                    size_t const begin, size_t const end,
+                    void * const ctx )
+// Sets the given `size_t` to how many threads this process has while
+// the first chunk runs.
+{
+    ( void ) as;
+    ( void ) end;
+    if ( begin == 0 ) {
+        *( size_t * ) ctx = threads();
+    }
+}
+
+
+static
+Assertions * parallel_for__reuses_its_threads( void )
+{
+    // Given:
+    Assertions * const ignored = assertions_empty();
+    size_t first = 0;
+    parallel_for( ignored, .end = 8, .body = count_threads,
+                           .ctx = &first, .threads = 4, .chunk = 1 );
+    size_t const before = threads();
+
+    // When:
+    size_t second = 0;
+    parallel_for( ignored, .end = 8, .body = count_threads,
+                           .ctx = &second, .threads = 4, .chunk = 1 );
+
+    // Then:
+    assertions_free( ignored );
+    return assertions(
+        first == before,
+        second == before
+    );
+}
+
+
+Test const parallel_tests[] = TEST_ARRAY(
+    parallel_for__is_same_as_serial,
+    parallel_for__covers_the_range,
+    parallel_for__reuses_its_threads
+);
@@ -0,0 +1,167 @@
+// tests/property.c
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <stdint.h>
+#include <string.h>
+
+#include <test.h>
+#include <property.h>
+
+
+static
+Assertions * property_rng_next__is_seeded( void )
+{
+    PropertyRng a = property_rng_new( 42 );
+    PropertyRng b = property_rng_new( 42 );
+    PropertyRng c = property_rng_new( 43 );
+    Assertions * const as = assertions_empty();
+    bool differs = false;
+    for ( int i = 0; i < 100; i += 1 ) {
+        uint64_t const x = property_rng_next( &a );
+        assertions_add( as, x == property_rng_next( &b ), i );
+        differs = differs || x != property_rng_next( &c );
+    }
+    assertions_add( as, differs, 0 );
+    return as;
+}
+
+
+static
+void gen_small( Property * const p, void * const out )
+{
+    *( int64_t * ) out = property_int( p, -50, 50 );
+}
+
+
+static
+bool reverse_twice_is_identity( Property * const p, void * const ctx )
+{
+    int64_t xs[ 32 ];
+    int64_t ys[ 32 ];
+    size_t const n = property_array( p, gen_small, xs, sizeof xs[ 0 ], 32 );
+    for ( size_t i = 0; i < n; i += 1 ) {
+        ys[ i ] = xs[ n - 1 - i ];
+    }
+    bool holds = true;
+    for ( size_t i = 0; i < n; i += 1 ) {
+        holds = holds && ys[ n - 1 - i ] == xs[ i ];
+    }
+    return holds;
+}
+
+
+static
+bool ints_are_small( Property * const p, void * const ctx )
+{
+    int64_t const x = property_int( p, -1000000, 1000000 );
+    property_note( p, "x = %lld", ( long long ) x );
+    return x < 1000;
+}
+
+
+static
+bool sums_are_small( Property * const p, void * const ctx )
+{
+    int64_t xs[ 16 ];
+    size_t const n = property_array( p, gen_small, xs, sizeof xs[ 0 ], 16 );
+    int64_t sum = 0;
+    for ( size_t i = 0; i < n; i += 1 ) {
+        sum += xs[ i ];
+    }
+    property_note( p, "n = %zu, sum = %lld", n, ( long long ) sum );
+    return sum < 60;
+}
+
+
+static
+bool strings_have_no_z( Property * const p, void * const ctx )
+{
+    char s[ 16 ];
+    property_string( p, s, sizeof s );
+    property_note( p, "s = \"%s\"", s );
+    return strchr( s, 'z' ) == NULL;
+}
+
+
+static
+Assertions * assertions_add_property__passes( void )
+{
+    Assertions * const new = assertions_empty();
+    assertions_add_property( new, reverse_twice_is_identity, .seed = 1 );
+    Assertion const * const a = assertions_get( *new, 0 );
+    Assertions * const as = assertions(
+        a->result == true,
+        strcmp( a->expr, "reverse_twice_is_identity holds" ) == 0,
+        a->ids->array[ 0 ].value == 1,
+        a->ids->array[ 1 ].value == 1000
+    );
+    assertions_free( new );
+    return as;
+}
+
+
+static
+Assertions * assertions_add_property__shrinks( void )
+{
+    Assertions * const new = assertions_empty();
+    assertions_add_property( new, ints_are_small, .seed = 7 );
+    assertions_add_property( new, sums_are_small, .seed = 7 );
+    assertions_add_property( new, strings_have_no_z, .seed = 7 );
+    Assertion const * const ints = assertions_get( *new, 0 );
+    Assertion const * const sums = assertions_get( *new, 1 );
+    Assertion const * const strings = assertions_get( *new, 2 );
+    Assertions * const as = assertions(
+        ints->result == false,
+        strncmp( ints->detail, "x = 1000\ncounterexample after ", 30 ) == 0,
+        strstr( ints->detail, "replay with TESTC_SEED=7" ) != NULL,
+        ints->ids->array[ 0 ].value == 7,
+        ints->ids->array[ 2 ].value == 2,
+        sums->result == false,
+        strstr( sums->detail, ", sum = 60\n" ) != NULL,
+        strings->result == false,
+        strncmp( strings->detail, "s = \"z\"\n", 8 ) == 0
+    );
+    assertions_free( new );
+    return as;
+}
+
+
+static
+Assertions * assertions_add_property__is_deterministic( void )
+{
+    Assertions * const serial = assertions_empty();
+    Assertions * const parallel = assertions_empty();
+    assertions_add_property( serial, sums_are_small, .seed = 99,
+                                                     .threads = 1 );
+    assertions_add_property( parallel, sums_are_small, .seed = 99,
+                                                       .threads = 4 );
+    Assertions * const as = assertions(
+        assertions_eq( *serial, *parallel )
+    );
+    assertions_free( serial );
+    assertions_free( parallel );
+    return as;
+}
+
+
+Test const property_tests[] = TEST_ARRAY(
+    property_rng_next__is_seeded,
+    assertions_add_property__passes,
+    assertions_add_property__shrinks,
+    assertions_add_property__is_deterministic
+);
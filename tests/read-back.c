@@ -0,0 +1,39 @@
+// tests/read-back.c
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+
+#include "read-back.h" // read_back
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+
+
+char * read_back( FILE * const file )
+{
+    assert( file != NULL );
+
+    long const size = ftell( file );
+    assert( size >= 0 );
+    rewind( file );
+    char * const text = calloc( size + 1, 1 );
+    size_t const read = fread( text, 1, size, file );
+    text[ read ] = '\0';
+    fclose( file );
+    return text;
+}
@@ -0,0 +1,33 @@
+// tests/read-back.h
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+
+#ifndef INCLUDED_TESTC_TESTS_READ_BACK_H
+#define INCLUDED_TESTC_TESTS_READ_BACK_H
+
+
+#include <stdio.h>
+
+
+// Reads everything that was written to the given file (which should be
+// open for reading and writing, e.g. by `tmpfile()`), closes it, and
+// returns what was read as an allocated string, for the caller to free.
+char * read_back( FILE * file );
+
+
+#endif // ifndef INCLUDED_TESTC_TESTS_READ_BACK_H
@@ -0,0 +1,247 @@
+// tests/soak.c
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#define _DEFAULT_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <sys/mman.h>
+
+#include <test.h>
+#include <soak.h>
+#include <heap.h>
+
+#include "read-back.h" // read_back
+
+#include <_common.h> // NELEM
+
+
+static
+void nap( long const ns )
+{
+    struct timespec const t = { .tv_nsec = ns };
+    nanosleep( &t, NULL );
+}
+
+
+static
+void * map( size_t const size )
+// Returns `size` bytes of newly mapped memory, after writing to every
+// page of it so that it's resident.
+{
+    char volatile * const pages = mmap( NULL, size, PROT_READ | PROT_WRITE,
+                                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+    for ( size_t i = 0; i < size; i += 1024 ) {
+        pages[ i ] = 1;
+    }
+    return ( void * ) pages;
+}
+
+
+static
+char * soak_output( Test const * const tests, int * const failed,
+                    double const max_rss_slope, double const max_time_slope )
+// Soaks the given tests for 150 milliseconds, and returns what it
+// printed.
+{
+    FILE * const file = tmpfile();
+    *failed = tests_soak( .name = "Inner",
+                          .tests = tests,
+                          .file = file,
+                          .filter = "",
+                          .duration_ns = 150000000,
+                          .summary_ns = 50000000,
+                          .max_rss_slope = max_rss_slope,
+                          .max_time_slope = max_time_slope );
+    return read_back( file );
+}
+
+
+static
+Assertions * steady( void )
+{
+    nap( 1000000 );
+    return assertions( true );
+}
+
+
+static
+Assertions * tests_soak__passes_steady_tests( void )
+{
+    int failed;
+    char * const output = soak_output( ( Test[] ) TEST_ARRAY( steady ),
+                                       &failed, 1000000, 100000 );
+    Assertions * const as = assertions(
+        failed == 0,
+        strncmp( output, "Soaking Inner tests for 150 ms...\n", 34 ) == 0,
+        strstr( output, "  soak:  round " ) != NULL,
+        strstr( output, "  pass:  rss grows by at most" ) != NULL,
+        strstr( output, "  pass:  time of steady grows by at most" ) != NULL,
+        strstr( output, "fail" ) == NULL,
+        // The passed tests aren't printed.
+        strstr( output, "pass:  steady" ) == NULL );
+    free( output );
+    return as;
+}
+
+
+// The pages and blocks leaked by `leaky()`, to be freed after the soak.
+// The pages are mapped rather than allocated, because the C library may
+// hand out memory that was freed by earlier tests, and is still
+// resident.
+static void * leaked_pages[ 1024 ];
+static void * leaked_blocks[ 1024 ];
+static size_t leaked_size = 0;
+static size_t const leaked_pages_size = 256 * 1024;
+
+
+static
+Assertions * leaky( void )
+{
+    if ( leaked_size < NELEM( leaked_pages ) ) {
+        leaked_pages[ leaked_size ] = map( leaked_pages_size );
+        leaked_blocks[ leaked_size ] = malloc( 64 );
+        leaked_size += 1;
+    }
+    nap( 1000000 );
+    return assertions( true );
+}
+
+
+static
+Assertions * tests_soak__fails_when_memory_grows( void )
+{
+    int failed;
+    char * const output = soak_output( ( Test[] ) TEST_ARRAY( leaky ),
+                                       &failed, 65536, 0 );
+    for ( size_t i = 0; i < leaked_size; i += 1 ) {
+        munmap( leaked_pages[ i ], leaked_pages_size );
+        free( leaked_blocks[ i ] );
+    }
+    leaked_size = 0;
+    Assertions * const as = assertions(
+        failed >= 1,
+        strstr( output, "  fail:  rss grows by at most 65.5 kB" ) != NULL );
+    assertions_add( as, !heap_is_tracked()
+                     || strstr( output, "  fail:  heap grows" ) != NULL, 0 );
+    free( output );
+    return as;
+}
+
+
+static size_t slowing_calls = 0;
+
+
+static
+Assertions * slowing( void )
+{
+    slowing_calls += 1;
+    nap( slowing_calls * 200000 );
+    return assertions( true );
+}
+
+
+static
+Assertions * tests_soak__fails_when_a_test_slows_down( void )
+{
+    int failed;
+    char * const output = soak_output(
+        ( Test[] ) TEST_ARRAY( steady, slowing ), &failed, 1000000, 50000 );
+    Assertions * const as = assertions(
+        failed >= 1,
+        strstr( output, "  fail:  time of slowing grows by at most 50 us" )
+            != NULL );
+    free( output );
+    return as;
+}
+
+
+static
+Assertions * failing( void )
+{
+    return assertions( false );
+}
+
+
+static
+Assertions * tests_soak__stops_at_a_failed_round( void )
+{
+    int failed;
+    char * const output = soak_output(
+        ( Test[] ) TEST_ARRAY( steady, failing ), &failed, 0, 0 );
+    char const * const first = strstr( output, "  fail:  failing" );
+    Assertions * const as = assertions(
+        failed == 1,
+        first != NULL,
+        first != NULL && strstr( first + 1, "  fail:  failing" ) == NULL,
+        strstr( output, "soak:  round 1 after" ) != NULL,
+        strstr( output, "grows by at most" ) == NULL );
+    free( output );
+    return as;
+}
+
+
+static int const numbers[] = { 2, 4, 5, 6 };
+
+
+static
+Assertions * is_even( void * const ctx )
+{
+    int const * const x = ctx;
+    return assertions( *x % 2 == 0 );
+}
+
+
+static
+Assertions * tests_soak__names_the_failed_rows( void )
+{
+    int failed;
+    char * const output = soak_output(
+        ( Test[] ){ TEST_TABLE( is_even, numbers, NULL ), TEST_ARRAY_END },
+        &failed, 0, 0 );
+    Assertions * const as = assertions(
+        failed == 1,
+        strstr( output, "  fail:  is_even/2\n" ) != NULL );
+    free( output );
+    return as;
+}
+
+
+static
+Assertions * soak_rss_bytes__grows_with_touched_memory( void )
+{
+    size_t const before = soak_rss_bytes();
+    size_t const size = 16 * 1024 * 1024;
+    void * const pages = map( size );
+    size_t const after = soak_rss_bytes();
+    munmap( pages, size );
+    return assertions( before > 0, after >= before + size / 2 );
+}
+
+
+Test const soak_tests[] = TEST_ARRAY(
+    tests_soak__passes_steady_tests,
+    tests_soak__fails_when_memory_grows,
+    tests_soak__fails_when_a_test_slows_down,
+    tests_soak__stops_at_a_failed_round,
+    tests_soak__names_the_failed_rows,
+    soak_rss_bytes__grows_with_touched_memory
+);
@@ -0,0 +1,155 @@
+// tests/stress.c
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#include <sched.h>
+
+#include <test.h>
+#include <stress.h>
+#include <bench.h>
+
+#include "read-back.h" // read_back
+
+
+enum { THREADS = 4, ROUNDS = 20 };
+
+
+struct calls {
+    atomic_int counts[ THREADS ][ ROUNDS ];
+    atomic_size_t inside[ ROUNDS ];
+    atomic_size_t overlapped;
+};
+
+
+static
+size_t count_call( Assertions * const as, size_t const thread,
+                   size_t const round, void * const ctx )
+{
+    struct calls * const c = ctx;
+    atomic_fetch_add( &c->counts[ thread ][ round ], 1 );
+    // Wait a while for the other threads of this round to arrive.
+    atomic_fetch_add( &c->inside[ round ], 1 );
+    uint64_t const start = bench_now_ns();
+    while ( atomic_load( &c->inside[ round ] ) < THREADS
+         && bench_now_ns() - start < 100000000 ) {
+        sched_yield();
+    }
+    if ( atomic_load( &c->inside[ round ] ) == THREADS ) {
+        atomic_fetch_add( &c->overlapped, 1 );
+    }
+    assertions_add( as, thread != 1 || round != 2, thread, round );
+    return thread + 1;
+}
+
+
+static
+Assertions * stress_run__calls_every_thread_in_every_round( void )
+{
+    struct calls * const c = calloc( 1, sizeof *c );
+    Assertions * const stressed = assertions_empty();
+    StressStats const stats = stress_run( stressed, .func = count_call,
+                                                    .ctx = c,
+                                                    .threads = THREADS,
+                                                    .rounds = ROUNDS );
+    Assertions * const as = assertions_empty();
+    for ( size_t t = 0; t < THREADS; t += 1 ) {
+        for ( size_t r = 0; r < ROUNDS; r += 1 ) {
+            assertions_add( as, atomic_load( &c->counts[ t ][ r ] ) == 1,
+                                t, r );
+        }
+    }
+    // Every call saw every other call of its round.
+    assertions_add( as, atomic_load( &c->overlapped ) == THREADS * ROUNDS,
+                        atomic_load( &c->overlapped ) );
+    assertions_add( as, stats.threads == THREADS && stats.rounds == ROUNDS,
+                        stats.threads, stats.rounds );
+    assertions_add( as, stats.ops == ( 1 + 2 + 3 + 4 ) * ROUNDS, stats.ops );
+    assertions_add( as, stats.min_ops_per_s <= stats.ops_per_s
+                     && stats.ops_per_s <= stats.max_ops_per_s
+                     && stats.min_ops_per_s > 0, 0 );
+    free( c );
+
+    // The assertions of the threads are gathered in one site.
+    assertions_add( as, stressed->sites_size == 1, stressed->sites_size );
+    if ( stressed->sites_size == 1 ) {
+        AssertionSite const * const site = stressed->sites[ 0 ];
+        assertions_add( as, site->passes == THREADS * ROUNDS - 1
+                         && site->fails == 1, site->passes, site->fails );
+        assertions_add( as, site->ids_values[ 0 ][ 0 ] == 1
+                         && site->ids_values[ 1 ][ 0 ] == 2, 0 );
+    }
+    assertions_free( stressed );
+    return as;
+}
+
+
+static
+size_t increment( Assertions * const as, size_t const thread,
+                  size_t const round, void * const ctx )
+{
+    atomic_size_t * const counter = ctx;
+    for ( int i = 0; i < 1000; i += 1 ) {
+        atomic_fetch_add( counter, 1 );
+    }
+    return 1000;
+}
+
+
+static
+Assertions * stress_run__prints_each_round( void )
+{
+    atomic_size_t counter;
+    atomic_init( &counter, 0 );
+    Assertions * const stressed = assertions_empty();
+    FILE * const file = tmpfile();
+    StressStats const stats = stress_run( stressed, .func = increment,
+                                                    .ctx = &counter,
+                                                    .threads = 3,
+                                                    .rounds = 5,
+                                                    .file = file );
+    char * const text = read_back( file );
+    size_t lines = 0;
+    bool all_rounds = true;
+    char const * line = text;
+    while ( *line != '\0' ) {
+        char expected[ 32 ];
+        snprintf( expected, sizeof expected, "round %zu:  3000 ops, ", lines );
+        all_rounds = all_rounds && strncmp( line, expected,
+                                            strlen( expected ) ) == 0;
+        lines += 1;
+        char const * const end = strchr( line, '\n' );
+        line = ( end == NULL ) ? line + strlen( line ) : end + 1;
+    }
+    free( text );
+    assertions_free( stressed );
+    return assertions( lines == 5, all_rounds,
+                       atomic_load( &counter ) == 15000,
+                       stats.ops == 15000 );
+}
+
+
+Test const stress_tests[] = TEST_ARRAY(
+    stress_run__calls_every_thread_in_every_round,
+    stress_run__prints_each_round
+);
@@ -0,0 +1,171 @@
+// tests/string-diff.c
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <test.h>
+#include <string-diff.h>
+
+#include "read-back.h" // read_back
+
+
+static
+char * diffed( char const * const expected, char const * const actual,
+               size_t const max_edits, size_t * const regions )
+// Returns the diff of the given strings, and gives how many changed
+// regions it found via `regions`.
+{
+    FILE * const file = tmpfile();
+    *regions = string_diff( .expected = expected,
+                            .actual = actual,
+                            .file = file,
+                            .max_edits = max_edits );
+    return read_back( file );
+}
+
+
+static
+Assertions * string_diff__prints_the_first_difference_and_regions( void )
+{
+    size_t regions;
+    char * const text = diffed(
+        "{\"name\": \"widget\", \"price\": 10, \"stock\": 4}",
+        "{\"name\": \"widget\", \"price\": 12, \"stock\": 4, \"sale\": true}",
+        0, &regions );
+    Assertions * const as = assertions_empty();
+    assertions_add( as, regions == 2, regions );
+    assertions_add( as, strcmp( text,
+        "first difference at offset 29 (line 1, column 30):\n"
+        "  expected: ...\"get\\\", \\\"price\\\": 10, \\\"stock\\\": 4}\"\n"
+        "  actual:   ...\"get\\\", \\\"price\\\": 12, \\\"stock\\\": 4, \\\"\"...\n"
+        "2 changed regions:\n"
+        "  at 29: -\"0\" +\"2\"\n"
+        "  at 42: -\"\" +\", \\\"sale\\\": true\"\n" ) == 0, 0 );
+    free( text );
+    return as;
+}
+
+
+static
+Assertions * string_diff__counts_lines_and_merges_close_regions( void )
+{
+    size_t regions;
+    char * const text = diffed( "one\ntwo\nthree\n", "one\ntoo\nthrea\n",
+                                0, &regions );
+    Assertions * const as = assertions_empty();
+    assertions_add( as, regions == 1, regions );
+    assertions_add( as, strstr( text, "(line 2, column 2)" ) != NULL, 0 );
+    assertions_add( as, strstr( text, "  at 5: -\"wo\\nthree\" "
+                                      "+\"oo\\nthrea\"\n" ) != NULL, 0 );
+    free( text );
+    return as;
+}
+
+
+static
+Assertions * string_diff__handles_equal_and_null_strings( void )
+{
+    size_t equal;
+    char * const nothing = diffed( "same", "same", 0, &equal );
+    size_t null;
+    char * const text = diffed( NULL, "x", 0, &null );
+    Assertions * const as = assertions_empty();
+    assertions_add( as, equal == 0 && nothing[ 0 ] == '\0', equal );
+    assertions_add( as, null == 1, null );
+    assertions_add( as, strstr( text, "expected: \"(null)\"" ) != NULL, 0 );
+    free( nothing );
+    free( text );
+    return as;
+}
+
+
+static
+Assertions * string_diff__abandons_long_diffs( void )
+{
+    char expected[ 201 ];
+    char actual[ 201 ];
+    for ( int i = 0; i < 200; i += 1 ) {
+        expected[ i ] = 'a' + i % 7;
+        actual[ i ] = 'a' + ( i * 5 ) % 11;
+    }
+    expected[ 200 ] = '\0';
+    actual[ 200 ] = '\0';
+    size_t regions;
+    char * const text = diffed( expected, actual, 16, &regions );
+    Assertions * const as = assertions_empty();
+    assertions_add( as, regions == 1, regions );
+    assertions_add( as, strstr( text, "more than 16 edits" ) != NULL, 0 );
+    free( text );
+    return as;
+}
+
+
+static
+Assertions * assertions_add_string_eq__counts_passes_at_a_site( void )
+{
+    char buffer[ 16 ];
+    Assertions * const strings = assertions_empty();
+    for ( int i = 0; i < 100; i += 1 ) {
+        snprintf( buffer, sizeof buffer, "%d", i % 10 );
+        assertions_add_string_eq( strings, buffer, ( i % 10 == 3 ) ? "3"
+                                                   : buffer );
+    }
+    Assertions * const as = assertions_empty();
+    assertions_add( as, strings->size == 0, strings->size );
+    assertions_add( as, strings->sites_size == 1
+                     && strings->sites[ 0 ]->passes == 100,
+                        strings->sites_size );
+    assertions_free( strings );
+    return as;
+}
+
+
+static
+Assertions * assertions_add_string_eq__details_failures( void )
+{
+    Assertions * const strings = assertions_empty();
+    assertions_add_string_eq( strings, "hello, world", "hello, word" );
+    assertions_add_string_eq( strings, ( char const * ) NULL, NULL );
+    Assertions * const as = assertions_empty();
+    assertions_add( as, strings->size == 1, strings->size );
+    if ( strings->size == 1 ) {
+        Assertion const * const a = strings->array[ 0 ];
+        assertions_add( as, !a->result, 0 );
+        assertions_add( as, a->ids->array[ 0 ].value == 12
+                         && a->ids->array[ 1 ].value == 11
+                         && a->ids->array[ 2 ].value == 10,
+                            a->ids->array[ 2 ].value );
+        assertions_add( as, a->detail != NULL
+                         && strstr( a->detail, "  at 10: -\"\" +\"l\"\n" )
+                            != NULL, 0 );
+    }
+    assertions_free( strings );
+    return as;
+}
+
+
+Test const string_diff_tests[] = TEST_ARRAY(
+    string_diff__prints_the_first_difference_and_regions,
+    string_diff__counts_lines_and_merges_close_regions,
+    string_diff__handles_equal_and_null_strings,
+    string_diff__abandons_long_diffs,
+    assertions_add_string_eq__counts_passes_at_a_site,
+    assertions_add_string_eq__details_failures
+);
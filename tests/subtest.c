@@ -0,0 +1,147 @@
+// tests/subtest.c
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#include <test.h>
+#include <subtest.h>
+
+#include "read-back.h" // read_back
+
+
+// The record that fails, and how many records have been tested.
+static int failing = -1;
+static atomic_int records = 0;
+
+
+static
+Assertions * test_record( void * const ctx )
+{
+    int const id = ( intptr_t ) ctx;
+    atomic_fetch_add( &records, 1 );
+    return assertions( id != failing,
+                       strcmp( test_current_name(),
+                                  subtest_current()->name ) == 0 );
+}
+
+
+static
+Assertions * test_file( void * const ctx )
+{
+    int const file = ( intptr_t ) ctx;
+    for ( int r = 0; r < 5; r += 1 ) {
+        char name[ 32 ];
+        snprintf( name, sizeof name, "record %d", r );
+        subtest_spawn( .name = name, .func = test_record,
+                       .ctx = ( void * ) ( intptr_t ) ( file * 5 + r ) );
+    }
+    return assertions( file >= 0 );
+}
+
+
+static
+Assertions * test_suite( void )
+{
+    for ( int f = 0; f < 4; f += 1 ) {
+        char name[ 32 ];
+        snprintf( name, sizeof name, "file %d", f );
+        subtest_spawn( .name = name, .func = test_file,
+                       .ctx = ( void * ) ( intptr_t ) f );
+    }
+    return assertions( true );
+}
+
+
+static
+char * run_suite( int const fail, bool * const passed )
+// Runs `test_suite` with the given failing record, and returns its
+// output.
+{
+    failing = fail;
+    atomic_store( &records, 0 );
+    FILE * const output = tmpfile();
+    *passed = test_run( .test = TEST( test_suite ),
+                        .file = output,
+                        .indent = "  " );
+    char * const text = read_back( output );
+    return text;
+}
+
+
+static
+bool starts_with( char const * const string, char const * const prefix )
+{
+    return strncmp( string, prefix, strlen( prefix ) ) == 0;
+}
+
+
+static
+Assertions * test_run__runs_subtests( void )
+{
+    bool passed;
+    char * const text = run_suite( -1, &passed );
+    Assertions * const as = assertions(
+        passed,
+        atomic_load( &records ) == 20,
+        starts_with( text, "  pass:  test_suite  (24 subtests)\n" ),
+        strstr( text, "file" ) == NULL
+    );
+    free( text );
+    return as;
+}
+
+
+static
+Assertions * test_run__prints_failed_subtests_as_tree( void )
+{
+    bool passed;
+    char * const text = run_suite( 7, &passed );
+    char const * const tree = strstr( text, "    pass:  file 0" );
+    Assertions * const as = assertions(
+        !passed,
+        atomic_load( &records ) == 20,
+        starts_with( text, "  fail:  test_suite  (24 subtests)\n" ),
+        tree != NULL
+    );
+    if ( tree != NULL ) {
+        assertions_add( as,
+            starts_with( tree,
+                "    pass:  file 0  (5 subtests)\n"
+                "    fail:  file 1  (5 subtests)\n"
+                "      pass:  record 0\n"
+                "      pass:  record 1\n"
+                "      fail:  record 2\n"
+                "        false:  id != failing\n"
+                "      pass:  record 3\n"
+                "      pass:  record 4\n"
+                "    pass:  file 2  (5 subtests)\n"
+                "    pass:  file 3  (5 subtests)\n" ), 0 );
+    }
+    free( text );
+    return as;
+}
+
+
+Test const subtest_tests[] = TEST_ARRAY(
+    test_run__runs_subtests,
+    test_run__prints_failed_subtests_as_tree
+);
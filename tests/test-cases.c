@@ -0,0 +1,105 @@
+// tests/test-cases.c
+
+// Copyright (C) 2013  Malcolm Inglis <http://minglis.id.au/>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <test.h>
+#include <test-cases.h>
+
+#include "read-back.h" // read_back
+
+
+struct pair {
+    int x;
+    int y;
+};
+
+
+static
+bool next_pair( void * const state, TestCase * const c )
+// Gives the pairs of `x` and `y` from `0` to `29`, up to the count
+// pointed to by `state`.
+{
+    if ( c->index == *( size_t * ) state ) {
+        return false;
+    }
+    struct pair * const p = ( struct pair * ) c->params.bytes;
+    *p = ( struct pair ){ .x = c->index / 30, .y = c->index % 30 };
+    snprintf( c->name, sizeof c->name, "pair %d, %d", p->x, p->y );
+    return true;
+}
+
+
+static
+Assertions * test_pair( void * const ctx )
+{
+    struct pair const * const p = ctx;
+    return assertions( p->x + p->y == p->y + p->x,
+                       p->x != 7 || p->y != 3 );
+}
+
+
+static
+char * run_pairs( size_t count, size_t const threads, size_t const window,
+                  int * const failed )
+// Runs the first `count` pairs, and returns the output.
+{
+    FILE * const output = tmpfile();
+    *failed = test_cases_run( .name = "pairs", .next = next_pair,
+                              .state = &count, .func = test_pair,
+                              .file = output,
+                              .threads = threads, .window = window );
+    char * const text = read_back( output );
+    return text;
+}
+
+
+static
+Assertions * test_cases_run__runs_each_case_in_order( void )
+{
+    int serial_failed;
+    int parallel_failed;
+    int none_failed;
+    char * const serial = run_pairs( 900, 1, 0, &serial_failed );
+    char * const parallel = run_pairs( 900, 4, 2, &parallel_failed );
+    char * const none = run_pairs( 0, 4, 0, &none_failed );
+    char const * const first = strstr( serial, "  pass:  pair 0, 0\n" );
+    char const * const last = strstr( serial, "  pass:  pair 29, 29\n" );
+    Assertions * const as = assertions(
+        serial_failed == 1,
+        parallel_failed == 1,
+        none_failed == 0,
+        strcmp( serial, parallel ) == 0,
+        strcmp( none, "Running pairs tests...\n" ) == 0,
+        first != NULL,
+        last != NULL,
+        first < last,
+        strstr( serial, "  fail:  pair 7, 3\n" ) != NULL
+    );
+    free( serial );
+    free( parallel );
+    free( none );
+    return as;
+}
+
+
+Test const test_cases_tests[] = TEST_ARRAY(
+    test_cases_run__runs_each_case_in_order
+);
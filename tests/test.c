@@ -21,7 +21,18 @@
 #include <stdio.h>
 #include <assert.h>
 
+#include <string.h>
+#include <ctype.h>
+#include <signal.h>
+#include <time.h>
+
+#include <unistd.h>
+
 #include <test.h> // Test, Assertions, TEST*, test*, assertion*
+#include <fixture.h> // Fixture, FIXTURE, fixture_*
+#include <counters.h> // counters_begin, counters_end
+
+#include "read-back.h" // read_back
 
 #include <_common.h> // NELEM
 
@@ -36,10 +47,33 @@ static Assertions * func_2( void ) { return assertions_empty(); }
 static Assertions * func_fail_1( void ) { return assertions( 2 == 2, 1 < 1 ); }
 static Assertions * func_fail_2( void ) { return assertions( false ); }
 
+static Assertions * func_ctx_1( void * const ctx ) { return assertions( ctx != NULL ); }
+static void * setup_1( void ) { return malloc( 1 ); }
+static void teardown_1( void * const ctx ) { free( ctx ); }
+
 // This lets us test that `TEST_ARRAY` works when its arguments aren't
 // just function names.
 static test_fn func_gen( int const x, int const y ) { return func_1; }
 
+struct sum {
+    int x;
+    int y;
+    int sum;
+};
+
+static struct sum const sums[] = {
+    { 1, 2, 3 },
+    { 2, 2, 4 },
+    { 2, 3, 6 },
+    { 0, 0, 0 }
+};
+
+static Assertions * sum_is_right( void * const ctx )
+{
+    struct sum const * const s = ctx;
+    return assertions( s->x + s->y == s->sum );
+}
+
 // None of these tests should be equal.
 static Test const tests[] = {
     { .func = func_1,      .name = "" },
@@ -51,8 +85,45 @@ static Test const tests[] = {
     { .func = func_fail_1, .name = "" },
     { .func = func_fail_1, .name = "foo" },
     { .func = func_fail_1, .name = "example name" },
+    { .func_ctx = func_ctx_1, .name = "foo" },
+    { .func_ctx = func_ctx_1, .setup = setup_1, .name = "foo" },
+    { .func_ctx = func_ctx_1, .setup = setup_1, .teardown = teardown_1,
+      .name = "foo" },
+    { .func_ctx = func_ctx_1, .ctx = ( void * ) tests, .name = "foo" },
+    TEST_TABLE( sum_is_right, sums, NULL ),
+    TEST_TABLE( sum_is_right, sums, "%zu" ),
 };
 
+static void * make_counter( void ) { return calloc( 1, sizeof ( int ) ); }
+static Fixture counter = FIXTURE( make_counter, free );
+
+// Each of these should see a fresh copy of the counter when forked.
+static Assertions * func_increment( void )
+{
+    int * const c = fixture_get_snapshot( &counter );
+    *c += 1;
+    return assertions( test_is_forked(), *c == 1 );
+}
+
+static Assertions * func_crash( void ) { raise( SIGTERM ); return NULL; }
+static Assertions * func_exit( void ) { _exit( 0 ); }
+
+// Spins for 50 milliseconds of CPU time.
+static Assertions * func_spin( void )
+{
+    clock_t const start = clock();
+    while ( clock() - start < CLOCKS_PER_SEC / 20 ) {
+    }
+    return assertions_empty();
+}
+
+// Prints to `stdout`, without flushing it.
+static Assertions * func_print( void )
+{
+    printf( "printed by the test\n" );
+    return assertions_empty();
+}
+
 // ----------
 // End of example functions and data.
 // ----------
@@ -107,7 +178,7 @@ Assertions * TEST_ARRAY__gives_right_tests( void )
             .func = func_2,
             .name = "func_2"
         } ),
-        ts[ 3 ].func == NULL
+        test_is_array_end( ts[ 3 ] )
     );
 }
 
@@ -164,6 +235,246 @@ Assertions * tests_run__all_fails( void )
 }
 
 
+static
+Assertions * tests_run__setup_and_teardown( void )
+{
+    // Given:
+    Test const ts[] = {
+        TEST( func_1 ),
+        TEST_CTX( func_ctx_1, setup_1, teardown_1 ),
+        TEST_CTX( func_ctx_1, NULL, NULL ),
+        TEST_ARRAY_END
+    };
+    FILE * const output = open_output();
+
+    // When:
+    int const fails = tests_run( .name = "ctx", .tests = ts, .file = output );
+    fclose( output );
+
+    // Then only the test without a setup should fail:
+    return assertions(
+        fails == 1,
+        test_eq( ts[ 1 ], ( Test ){ .func_ctx = func_ctx_1,
+                                    .setup = setup_1,
+                                    .teardown = teardown_1,
+                                    .name = "func_ctx_1" } ),
+        test_is_array_end( ts[ 3 ] ),
+        !test_is_array_end( ts[ 2 ] )
+    );
+}
+
+
+static
+char * run_to_text( Test const * const ts, char const * const filter,
+                    int * const fails )
+// Runs the given tests with the given filter, and returns the output.
+{
+    FILE * const output = tmpfile();
+    *fails = tests_run( .name = "tests", .tests = ts, .file = output,
+                        .filter = filter );
+    char * const text = read_back( output );
+    return text;
+}
+
+
+static
+Assertions * tests_run__runs_each_row_of_tables( void )
+{
+    // Given:
+    Test const ts[] = {
+        TEST( func_1 ),
+        TEST_TABLE( sum_is_right, sums, "%zu" ),
+        TEST_TABLE( sum_is_right, sums, "row %zu of 4" ),
+        TEST_ARRAY_END
+    };
+
+    // When:
+    int fails;
+    char * const text = run_to_text( ts, "", &fails );
+
+    // Then each row should be its own test, in order:
+    char const * const lines[] = {
+        "  pass:  func_1\n",
+        "  pass:  sum_is_right/0\n",
+        "  pass:  sum_is_right/1\n",
+        "  fail:  sum_is_right/2\n",
+        "  pass:  sum_is_right/3\n",
+        "  pass:  sum_is_right/row 0 of 4\n",
+        "  fail:  sum_is_right/row 2 of 4\n"
+    };
+    Assertions * const as = assertions(
+        fails == 2,
+        ts[ 1 ].rows == sums,
+        ts[ 1 ].row_size == sizeof ( struct sum ),
+        ts[ 1 ].rows_size == 4
+    );
+    char const * last = text;
+    for ( size_t i = 0; i < sizeof lines / sizeof lines[ 0 ]; i += 1 ) {
+        char const * const line = strstr( last, lines[ i ] );
+        assertions_add( as, line != NULL, ( int ) i );
+        last = ( line == NULL ) ? last : line;
+    }
+    free( text );
+    return as;
+}
+
+
+static
+Assertions * tests_run__filters_by_name( void )
+{
+    // Given:
+    Test const ts[] = {
+        TEST( func_1 ),
+        TEST( func_fail_1 ),
+        TEST_TABLE( sum_is_right, sums, "%zu" ),
+        TEST_ARRAY_END
+    };
+
+    // When:
+    int func_fails;
+    int row_fails;
+    char * const funcs = run_to_text( ts, "func_*", &func_fails );
+    char * const rows = run_to_text( ts, "sum_is_right/[13]", &row_fails );
+
+    // Then:
+    Assertions * const as = assertions(
+        func_fails == 1,
+        strstr( funcs, "func_1" ) != NULL,
+        strstr( funcs, "sum_is_right" ) == NULL,
+        row_fails == 0,
+        strstr( rows, "func_" ) == NULL,
+        strstr( rows, "sum_is_right/0" ) == NULL,
+        strstr( rows, "  pass:  sum_is_right/1\n" ) != NULL,
+        strstr( rows, "sum_is_right/2" ) == NULL,
+        strstr( rows, "  pass:  sum_is_right/3\n" ) != NULL
+    );
+    free( funcs );
+    free( rows );
+    return as;
+}
+
+
+static
+Assertions * tests_run__fork_gives_snapshots( void )
+{
+    // Given:
+    Test const ts[] = TEST_ARRAY( func_increment, func_increment,
+                                  func_increment );
+    Fixture * const fixtures[] = { &counter, NULL };
+    FILE * const output = open_output();
+
+    // When:
+    int const fails = tests_run( .name = "fork", .tests = ts,
+                                 .file = output,
+                                 .fork = true,
+                                 .fixtures = fixtures );
+    fclose( output );
+
+    // Then:
+    return assertions(
+        fails == 0,
+        !test_is_forked(),
+        !fixture_is_ready( &counter )
+    );
+}
+
+
+static
+Assertions * tests_run__fork_isolates_crashes( void )
+{
+    // Given:
+    Test const ts[] = TEST_ARRAY( func_1, func_crash, func_exit, func_2,
+                                  func_fail_1 );
+    FILE * const output = tmpfile();
+
+    // When:
+    int const fails = tests_run( .name = "crashes", .tests = ts,
+                                 .file = output,
+                                 .fork = true );
+    char * const text = read_back( output );
+
+    // Then:
+    Assertions * const as = assertions(
+        fails == 3,
+        strstr( text, "  pass:  func_1\n" ) != NULL,
+        strstr( text, "  fail:  func_crash\n"
+                      "    killed by signal 15" ) != NULL,
+        strstr( text, "  fail:  func_exit\n"
+                      "    exited with status 0 before it finished\n" )
+            != NULL,
+        strstr( text, "  pass:  func_2\n" ) != NULL,
+        strstr( text, "  fail:  func_fail_1\n" ) != NULL,
+        strstr( text, "    false:  1 < 1" ) != NULL
+    );
+    free( text );
+    return as;
+}
+
+
+static
+Assertions * tests_run__fork_counts_the_child( void )
+{
+    // Given: this thread's counters are open, and would be inherited.
+    counters_begin();
+    counters_end();
+    Test const ts[] = TEST_ARRAY( func_spin );
+    FILE * const output = tmpfile();
+
+    // When:
+    int const fails = tests_run( .name = "spin", .tests = ts,
+                                 .file = output,
+                                 .fork = true,
+                                 .counters = true );
+    char * const text = read_back( output );
+
+    // Then: the child's task clock includes its spinning.
+    char const * const unit = strstr( text, " ms task clock" );
+    char const * number = unit;
+    while ( number != NULL && number > text
+         && ( isdigit( number[ -1 ] ) || number[ -1 ] == '.' ) ) {
+        number -= 1;
+    }
+    double const ms = ( unit == NULL ) ? 0 : strtod( number, NULL );
+    Assertions * const as = assertions_empty();
+    assertions_add( as, fails == 0, fails );
+    assertions_add( as, ms >= 40, ( long long ) ms );
+    free( text );
+    return as;
+}
+
+
+static
+Assertions * tests_run__fork_flushes_the_child( void )
+{
+    // Given: our `stdout` is redirected to a file, so it's fully
+    // buffered.
+    fflush( stdout );
+    FILE * const captured = tmpfile();
+    int const saved = dup( STDOUT_FILENO );
+    dup2( fileno( captured ), STDOUT_FILENO );
+    Test const ts[] = TEST_ARRAY( func_print );
+    FILE * const output = tmpfile();
+
+    // When:
+    int const fails = tests_run( .name = "print", .tests = ts,
+                                 .file = output,
+                                 .fork = true );
+    fflush( stdout );
+    dup2( saved, STDOUT_FILENO );
+    close( saved );
+    fclose( output );
+    char * const text = read_back( captured );
+
+    // Then: what the child printed wasn't lost.
+    Assertions * const as = assertions(
+        fails == 0,
+        strstr( text, "printed by the test\n" ) != NULL
+    );
+    free( text );
+    return as;
+}
+
+
 static
 Assertions * tests_return_val__works( void )
 {
@@ -185,6 +496,13 @@ Test const test_tests[] = TEST_ARRAY(
     tests_run__no_fails,
     tests_run__some_fails,
     tests_run__all_fails,
+    tests_run__setup_and_teardown,
+    tests_run__runs_each_row_of_tables,
+    tests_run__filters_by_name,
+    tests_run__fork_gives_snapshots,
+    tests_run__fork_isolates_crashes,
+    tests_run__fork_counts_the_child,
+    tests_run__fork_flushes_the_child,
     tests_return_val__works
 );
 